@@ -0,0 +1,11 @@
+#include "h.c"
+static void
+#include "o.c"
+int main(){ char a[512],b[512]; long bad=0; srand(1);
+ double special[]={0.1,0.05,0.0999999999,1e-10,1e-9,0.5,0.0005,0.00049999999,0.0015,2.5e-7,123456.0005,1e12,-0.0004,-0.0,0.1+1e-17,0.125,0.0625, 1099511.6277765, 0.01, 0.001,0.0001,1e-5,1e-6,1e-7,1e-8};
+ for(int k=0;k<2;k++) for(unsigned i=0;i<sizeof special/sizeof *special;i++){ double d=special[i]; orig_dtostr(a,sizeof a,d,k); _cairo_dtostr(b,sizeof b,d,k); if(strcmp(a,b)){printf("MISMATCH %.20g k=%d orig=%s new=%s\n",d,k,a,b);bad++;}}
+ for(long n=0;n<20000000;n++){ double d; int m=rand()%5;
+  if(m==0) d=(rand()-RAND_MAX/2)/1000.0; else if(m==1) d=(rand()/(double)RAND_MAX-0.5)*pow(10,rand()%24-12);
+  else if(m==2) d=(rand()%200000-100000)/1000.0 + (rand()%3-1)*5e-7; else if (m==3) d=(rand()%2000000)/1e7; else d=ldexp(rand(), -(rand()%60));
+  int k=rand()&1; orig_dtostr(a,sizeof a,d,k); _cairo_dtostr(b,sizeof b,d,k); if(strcmp(a,b)){ if(bad<20) printf("MISMATCH %.20g k=%d orig=%s new=%s\n",d,k,a,b); bad++;}}
+ printf("bad=%ld\n",bad); return 0;}
@@ -565,6 +565,7 @@ const cairo_perf_case_t perf_cases[] = {
     { FUNC(tessellate), 100, 100},
     { FUNC(subimage_copy), 16, 512},
     { FUNC(hash_table), 16, 16},
+    { FUNC(pdf_font_subsets), 512, 512},
     { FUNC(pattern_create_radial), 16, 16},
     { FUNC(zrusin), 415, 415},
     { FUNC(world_map), 800, 800},
@@ -590,5 +591,6 @@ const cairo_perf_case_t perf_cases[] = {
     { FUNC(wave), 500, 500 },
     { FUNC(fill_clip), 16, 512 },
     { FUNC(tiger), 16, 1024 },
+    { FUNC(scan_converters), 512, 512 },
     { NULL }
 };
@@ -98,6 +98,10 @@ basename_no_ext (char *path)
 #include <fontconfig/fontconfig.h>
 #endif
 
+#if CAIRO_HAS_REAL_PTHREAD
+#include <pthread.h>
+#endif
+
 #define CAIRO_PERF_ITERATIONS_DEFAULT	15
 #define CAIRO_PERF_LOW_STD_DEV		0.05
 #define CAIRO_PERF_MIN_STD_DEV_COUNT	3
@@ -369,13 +373,16 @@ static void
 usage (const char *argv0)
 {
     fprintf (stderr,
-"Usage: %s [-clrsv] [-i iterations] [-t tile-size] [-x exclude-file] [test-names ... | traces ...]\n"
+"Usage: %s [-clrsv] [-f first[:count]] [-i iterations] [-j threads] [-t tile-size] [-x exclude-file] [test-names ... | traces ...]\n"
 "\n"
 "Run the cairo performance test suite over the given tests (all by default)\n"
 "The command-line arguments are interpreted as follows:\n"
 "\n"
 "  -c	use surface cache; keep a cache of surfaces to be reused\n"
+"  -f	frames; only time count pages starting from first of compiled traces\n"
 "  -i	iterations; specify the number of iterations per test case\n"
+"  -j	threads; replay each trace on this many threads at once, each\n"
+"	running all the iterations to its own target surface\n"
 "  -l	list only; just list selected test case names without executing\n"
 "  -r	raw; display each time measurement instead of summary statistics\n"
 "  -s	sync; only sum the elapsed time of the indiviual operations\n"
@@ -385,7 +392,11 @@ usage (const char *argv0)
 "\n"
 "If test names are given they are used as sub-string matches so a command\n"
 "such as \"%s firefox\" can be used to run all firefox traces.\n"
-"Alternatively, you can specify a list of filenames to execute.\n",
+"Alternatively, you can specify a list of filenames to execute.\n"
+"\n"
+"Traces compiled with \"csi-bind -c\" and named *.ctrace are replayed\n"
+"directly from the mapped file.  For these the pages before the window\n"
+"selected by -f are still replayed to recreate their state, but untimed.\n",
 	     argv0, argv0);
 }
 
@@ -453,6 +464,9 @@ parse_options (cairo_perf_t *perf,
     perf->observe = FALSE;
     perf->list_only = FALSE;
     perf->tile_size = 0;
+    perf->first_frame = 0;
+    perf->num_frames = -1;
+    perf->threads = 1;
     perf->names = NULL;
     perf->num_names = 0;
     perf->summary = stdout;
@@ -461,7 +475,7 @@ parse_options (cairo_perf_t *perf,
     perf->num_exclude_names = 0;
 
     while (1) {
-	c = _cairo_getopt (argc, argv, "ci:lrst:vx:");
+	c = _cairo_getopt (argc, argv, "cf:i:j:lrst:vx:");
 	if (c == -1)
 	    break;
 
@@ -469,6 +483,16 @@ parse_options (cairo_perf_t *perf,
 	case 'c':
 	    use_surface_cache = 1;
 	    break;
+	case 'f':
+	    perf->first_frame = strtoul (optarg, &end, 10);
+	    if (*end == ':')
+		perf->num_frames = strtoul (end + 1, &end, 10);
+	    if (*end != '\0') {
+		fprintf (stderr, "Invalid argument for -f (not first[:count]): %s\n",
+			 optarg);
+		exit (1);
+	    }
+	    break;
 	case 'i':
 	    perf->exact_iterations = TRUE;
 	    perf->iterations = strtoul (optarg, &end, 10);
@@ -478,6 +502,14 @@ parse_options (cairo_perf_t *perf,
 		exit (1);
 	    }
 	    break;
+	case 'j':
+	    perf->threads = strtoul (optarg, &end, 10);
+	    if (*end != '\0' || perf->threads == 0) {
+		fprintf (stderr, "Invalid argument for -j (not a positive integer): %s\n",
+			 optarg);
+		exit (1);
+	    }
+	    break;
 	case 'l':
 	    perf->list_only = TRUE;
 	    break;
@@ -520,6 +552,18 @@ parse_options (cairo_perf_t *perf,
 	exit (1);
     }
 
+    if (perf->threads > 1) {
+#if CAIRO_HAS_REAL_PTHREAD
+	if (perf->observe || perf->raw || use_surface_cache) {
+	    fprintf (stderr, "Can't mix threads with observer, raw or surface cache. Sorry.\n");
+	    exit (1);
+	}
+#else
+	fprintf (stderr, "Threads are not supported by this build. Sorry.\n");
+	exit (1);
+#endif
+    }
+
     if (verbose && perf->summary == NULL)
 	perf->summary = stderr;
 #if HAVE_UNISTD_H
@@ -639,6 +683,212 @@ _tiling_surface_create (void		 *closure,
     return observer;
 }
 
+#if CAIRO_HAS_REAL_PTHREAD
+/* Concurrent replay: every thread replays the trace perf->iterations
+ * times to its own target surface, each with its own interpreter, so
+ * that the only state they share is that inside cairo itself.
+ */
+struct replay_thread {
+    pthread_t thread;
+    cairo_perf_t *perf;
+    const cairo_boilerplate_target_t *target;
+    const char *trace;
+    cairo_bool_t compiled;
+    cairo_time_t *times;
+    unsigned int count;
+    cairo_stats_t stats;
+    cairo_status_t status;
+};
+
+static pthread_mutex_t replay_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t replay_cond = PTHREAD_COND_INITIALIZER;
+static cairo_bool_t replay_started;
+
+static void *
+replay_thread (void *closure)
+{
+    struct replay_thread *t = closure;
+    cairo_perf_t *perf = t->perf;
+    struct trace args = { t->target };
+    const cairo_script_interpreter_hooks_t hooks = {
+	&args,
+	perf->tile_size ? _tiling_surface_create : _similar_surface_create,
+	NULL, /* surface_destroy */
+	_context_create,
+	NULL, /* context_destroy */
+	NULL, /* show_page */
+	NULL, /* copy_page */
+	_source_image_create,
+    };
+
+    args.tile_size = perf->tile_size;
+
+    /* Start all the replays together */
+    pthread_mutex_lock (&replay_mutex);
+    while (! replay_started)
+	pthread_cond_wait (&replay_cond, &replay_mutex);
+    pthread_mutex_unlock (&replay_mutex);
+
+    for (t->count = 0; t->count < perf->iterations && ! user_interrupt; ) {
+	cairo_script_interpreter_t *csi;
+	cairo_time_t start;
+
+	args.surface = t->target->create_surface (NULL,
+						  CAIRO_CONTENT_COLOR_ALPHA,
+						  1, 1,
+						  1, 1,
+						  CAIRO_BOILERPLATE_MODE_PERF,
+						  &args.closure);
+	fill_surface (args.surface); /* remove any clear flags */
+	if (cairo_surface_status (args.surface)) {
+	    t->status = cairo_surface_status (args.surface);
+	    break;
+	}
+
+	csi = cairo_script_interpreter_create ();
+	cairo_script_interpreter_install_hooks (csi, &hooks);
+
+	if (t->compiled && perf->first_frame)
+	    cairo_script_interpreter_run_compiled (csi, t->trace,
+						   0, perf->first_frame);
+
+	start = _cairo_time_get ();
+
+	if (t->compiled) {
+	    cairo_script_interpreter_run_compiled (csi, t->trace,
+						   perf->first_frame,
+						   perf->num_frames);
+	} else {
+	    cairo_script_interpreter_run (csi, t->trace);
+	}
+	cairo_script_interpreter_finish (csi);
+
+	fill_surface (args.surface); /* queue a write to the sync'ed surface */
+	if (t->target->synchronize)
+	    t->target->synchronize (args.closure);
+
+	t->times[t->count++] = _cairo_time_get_delta (start);
+
+	cairo_surface_destroy (args.surface);
+	if (t->target->cleanup)
+	    t->target->cleanup (args.closure);
+
+	t->status = cairo_script_interpreter_destroy (csi);
+	if (t->status)
+	    break;
+    }
+
+    return NULL;
+}
+
+static void
+cairo_perf_trace_concurrent (cairo_perf_t			*perf,
+			     const cairo_boilerplate_target_t	*target,
+			     const char				*trace,
+			     const char				*name,
+			     cairo_bool_t			 compiled)
+{
+    struct replay_thread *threads;
+    cairo_time_t *times, start, elapsed;
+    cairo_stats_t stats;
+    cairo_status_t status;
+    unsigned int n, started, count;
+
+    threads = xcalloc (perf->threads, sizeof (struct replay_thread));
+    times = xmalloc (perf->threads * perf->iterations * sizeof (cairo_time_t));
+
+    replay_started = FALSE;
+    for (started = 0; started < perf->threads; started++) {
+	struct replay_thread *t = &threads[started];
+
+	t->perf = perf;
+	t->target = target;
+	t->trace = trace;
+	t->compiled = compiled;
+	t->times = times + started * perf->iterations;
+	if (pthread_create (&t->thread, NULL, replay_thread, t))
+	    break;
+    }
+
+    pthread_mutex_lock (&replay_mutex);
+    replay_started = TRUE;
+    start = _cairo_time_get ();
+    pthread_cond_broadcast (&replay_cond);
+    pthread_mutex_unlock (&replay_mutex);
+
+    for (n = 0; n < started; n++)
+	pthread_join (threads[n].thread, NULL);
+    elapsed = _cairo_time_get_delta (start);
+
+    /* Per-thread latencies, then of all the replays together */
+    status = CAIRO_STATUS_SUCCESS;
+    count = 0;
+    for (n = 0; n < started; n++) {
+	struct replay_thread *t = &threads[n];
+
+	if (t->status && status == CAIRO_STATUS_SUCCESS)
+	    status = t->status;
+
+	if (t->count)
+	    _cairo_stats_compute (&t->stats, t->times, t->count);
+
+	memmove (times + count, t->times, t->count * sizeof (cairo_time_t));
+	count += t->count;
+    }
+
+    if (perf->summary == NULL)
+	goto out;
+
+    fprintf (perf->summary,
+	     "[%3d] %8s %28s ",
+	     perf->test_number,
+	     perf->target->name,
+	     name);
+    if (status) {
+	fprintf (perf->summary, "Error during replay: %s\n",
+		 cairo_status_to_string (status));
+	goto out;
+    }
+    if (count == 0) {
+	fprintf (perf->summary, "\n");
+	goto out;
+    }
+
+    _cairo_stats_compute (&stats, times, count);
+    fprintf (perf->summary,
+	     "%#8.3f %#8.3f %#6.2f%% %4d/%d\n",
+	     _cairo_time_to_s (stats.min_ticks),
+	     _cairo_time_to_s (stats.median_ticks),
+	     stats.std_dev * 100.0,
+	     stats.iterations, count);
+
+    for (n = 0; n < started; n++) {
+	struct replay_thread *t = &threads[n];
+
+	if (t->count == 0)
+	    continue;
+
+	fprintf (perf->summary,
+		 "[ # ] %8s %22s %3d: %#8.3f %#8.3f %#6.2f%% %4d/%d\n",
+		 "", "thread", n,
+		 _cairo_time_to_s (t->stats.min_ticks),
+		 _cairo_time_to_s (t->stats.median_ticks),
+		 t->stats.std_dev * 100.0,
+		 t->stats.iterations, t->count);
+    }
+
+    fprintf (perf->summary,
+	     "[ # ] %8s %28s %.2f replays/s on %d threads\n",
+	     "", "throughput:",
+	     count / _cairo_time_to_s (elapsed), started);
+    fflush (perf->summary);
+
+out:
+    free (times);
+    free (threads);
+}
+#endif
+
 static void
 cairo_perf_trace (cairo_perf_t			   *perf,
 		  const cairo_boilerplate_target_t *target,
@@ -651,6 +901,8 @@ cairo_perf_trace (cairo_perf_t			   *perf,
     struct trace args = { target };
     int low_std_dev_count;
     char *trace_cpy, *name;
+    const char *dot;
+    cairo_bool_t compiled;
     const cairo_script_interpreter_hooks_t hooks = {
 	&args,
 	perf->tile_size ? _tiling_surface_create : _similar_surface_create,
@@ -665,6 +917,9 @@ cairo_perf_trace (cairo_perf_t			   *perf,
     args.tile_size = perf->tile_size;
     args.observe = perf->observe;
 
+    dot = strrchr (trace, '.');
+    compiled = dot != NULL && strcmp (dot, ".ctrace") == 0;
+
     trace_cpy = xstrdup (trace);
     name = basename_no_ext (trace_cpy);
 
@@ -697,6 +952,13 @@ cairo_perf_trace (cairo_perf_t			   *perf,
 	first_run = FALSE;
     }
 
+#if CAIRO_HAS_REAL_PTHREAD
+    if (perf->threads > 1) {
+	cairo_perf_trace_concurrent (perf, target, trace, name, compiled);
+	goto out;
+    }
+#endif
+
     times = perf->times;
     paint = times + perf->iterations;
     mask = paint + perf->iterations;
@@ -749,12 +1011,23 @@ cairo_perf_trace (cairo_perf_t			   *perf,
 	csi = cairo_script_interpreter_create ();
 	cairo_script_interpreter_install_hooks (csi, &hooks);
 
+	/* The pages before the window create the state it uses */
+	if (compiled && perf->first_frame)
+	    cairo_script_interpreter_run_compiled (csi, trace,
+						   0, perf->first_frame);
+
 	if (! perf->observe) {
 	    cairo_perf_yield ();
 	    cairo_perf_timer_start ();
 	}
 
-	cairo_script_interpreter_run (csi, trace);
+	if (compiled) {
+	    cairo_script_interpreter_run_compiled (csi, trace,
+						   perf->first_frame,
+						   perf->num_frames);
+	} else {
+	    cairo_script_interpreter_run (csi, trace);
+	}
 	line_no = cairo_script_interpreter_get_line_number (csi);
 
 	/* Finish before querying timings in case we are using an intermediate
@@ -971,7 +1244,7 @@ cairo_perf_trace_dir (cairo_perf_t		       *perf,
 	    dot = strrchr (de->d_name, '.');
 	    if (dot == NULL)
 		goto next;
-	    if (strcmp (dot, ".trace"))
+	    if (strcmp (dot, ".trace") && strcmp (dot, ".ctrace"))
 		goto next;
 
 	    num_traces++;
@@ -85,6 +85,13 @@ typedef struct _cairo_perf {
 
     unsigned int tile_size;
 
+    /* Window of pages to time when replaying compiled traces */
+    unsigned int first_frame;
+    unsigned int num_frames;
+
+    /* Number of replays of each trace to run concurrently */
+    unsigned int threads;
+
     /* Stuff used internally */
     cairo_time_t *times;
     const cairo_boilerplate_target_t **targets;
@@ -197,6 +204,7 @@ CAIRO_PERF_DECL (hatching);
 CAIRO_PERF_DECL (tessellate);
 CAIRO_PERF_DECL (text);
 CAIRO_PERF_DECL (glyphs);
+CAIRO_PERF_DECL (pdf_font_subsets);
 CAIRO_PERF_DECL (hash_table);
 CAIRO_PERF_DECL (pattern_create_radial);
 CAIRO_PERF_DECL (zrusin);
@@ -229,5 +237,6 @@ CAIRO_PERF_DECL (a1_pixel);
 CAIRO_PERF_DECL (sierpinski);
 CAIRO_PERF_DECL (fill_clip);
 CAIRO_PERF_DECL (tiger);
+CAIRO_PERF_DECL (scan_converters);
 
 #endif
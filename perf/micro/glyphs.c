@@ -170,6 +170,113 @@ DECL(48ca, 48, CAIRO_ANTIALIAS_SUBPIXEL)
 DECL(8mono, 8, CAIRO_ANTIALIAS_NONE)
 DECL(48mono, 48, CAIRO_ANTIALIAS_NONE)
 
+#if CAIRO_HAS_REAL_PTHREAD
+#include <pthread.h>
+
+/* Several threads each drawing text into their own image, either all
+ * with the same scaled font or each with a different size, to measure
+ * contention on the global glyph caches.
+ */
+#define GLYPH_THREADS 16
+#define GLYPH_THREAD_TEXT "the jay, pig, fox, zebra and my wolves quack"
+
+typedef struct {
+    cairo_surface_t *surface;
+    double font_size;
+    int loops;
+} glyph_thread_t;
+
+static void *
+draw_glyphs_thread (void *closure)
+{
+    glyph_thread_t *thread = closure;
+    cairo_font_extents_t extents;
+    int width, height, loops;
+    double y;
+    cairo_t *cr;
+
+    width = cairo_image_surface_get_width (thread->surface);
+    height = cairo_image_surface_get_height (thread->surface);
+
+    cr = cairo_create (thread->surface);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_select_font_face (cr,
+			    "@cairo:",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, thread->font_size);
+    cairo_font_extents (cr, &extents);
+
+    for (loops = thread->loops; loops--; ) {
+	for (y = extents.ascent; y < height; y += extents.height) {
+	    double x = 0;
+	    do {
+		cairo_text_extents_t text;
+
+		cairo_move_to (cr, x, y);
+		cairo_show_text (cr, GLYPH_THREAD_TEXT);
+		cairo_text_extents (cr, GLYPH_THREAD_TEXT, &text);
+		x += text.x_advance;
+	    } while (x < width);
+	}
+    }
+
+    cairo_destroy (cr);
+    return NULL;
+}
+
+static cairo_time_t
+do_glyphs_threaded (cairo_bool_t distinct_fonts,
+		    cairo_t *cr, int width, int height, int loops)
+{
+    glyph_thread_t threads[GLYPH_THREADS];
+    pthread_t tid[GLYPH_THREADS];
+    int n, started;
+
+    for (n = 0; n < GLYPH_THREADS; n++) {
+	threads[n].surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+							 width, height);
+	threads[n].font_size = distinct_fonts ? 10 + n : 12;
+	threads[n].loops = loops;
+    }
+
+    cairo_perf_timer_start ();
+
+    for (started = 0; started < GLYPH_THREADS; started++) {
+	if (pthread_create (&tid[started], NULL,
+			    draw_glyphs_thread, &threads[started]))
+	    break;
+    }
+    for (n = 0; n < started; n++)
+	pthread_join (tid[n], NULL);
+
+    cairo_perf_timer_stop ();
+
+    for (n = 0; n < GLYPH_THREADS; n++)
+	cairo_surface_destroy (threads[n].surface);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_glyphs_threaded_shared (cairo_t *cr, int width, int height, int loops)
+{
+    return do_glyphs_threaded (FALSE, cr, width, height, loops);
+}
+
+static cairo_time_t
+do_glyphs_threaded_distinct (cairo_t *cr, int width, int height, int loops)
+{
+    return do_glyphs_threaded (TRUE, cr, width, height, loops);
+}
+
+static double
+count_glyphs_threaded (cairo_t *cr, int width, int height)
+{
+    return GLYPH_THREADS * count_glyphs12 (cr, width, height);
+}
+#endif
+
 cairo_bool_t
 glyphs_enabled (cairo_perf_t *perf)
 {
@@ -199,4 +306,9 @@ glyphs (cairo_perf_t *perf, cairo_t *cr, int width, int height)
     cairo_perf_cover_sources_and_operators (perf, "glyphs48mono", do_glyphs48mono, count_glyphs48mono);
     cairo_perf_cover_sources_and_operators (perf, "glyphs48", do_glyphs48, count_glyphs48);
     cairo_perf_cover_sources_and_operators (perf, "glyphs48ca", do_glyphs48ca, count_glyphs48ca);
+
+#if CAIRO_HAS_REAL_PTHREAD
+    cairo_perf_run (perf, "glyphs-threaded-shared", do_glyphs_threaded_shared, count_glyphs_threaded);
+    cairo_perf_run (perf, "glyphs-threaded-distinct", do_glyphs_threaded_distinct, count_glyphs_threaded);
+#endif
 }
@@ -26,6 +26,10 @@
  */
 #include "cairo-perf.h"
 
+#ifndef MIN
+#define MIN(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+
 #define NUM_SEGMENTS 256
 
 static unsigned state;
@@ -119,6 +123,63 @@ draw_random_curve (cairo_t *cr, cairo_fill_rule_t fill_rule,
     return cairo_perf_timer_elapsed ();
 }
 
+/* A comb of non-intersecting teeth of random heights: every edge is
+ * active across the lower part of the surface, and the edges begin in
+ * random order along the sweep line. The circular clip routes the fill
+ * through the tessellator rather than straight to a scan converter.
+ */
+static cairo_time_t
+draw_comb (cairo_t *cr, int num_teeth, int width, int height, int loops)
+{
+    double step = (double) width / num_teeth;
+    int i;
+
+    cairo_save (cr);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_paint (cr);
+
+    state = 0x12345678;
+    cairo_arc (cr, width / 2., height / 2., MIN (width, height) / 2., 0, 2 * M_PI);
+    cairo_clip (cr);
+
+    cairo_set_source_rgb (cr, 1, 0, 0);
+
+    cairo_new_path (cr);
+    cairo_move_to (cr, 0, height);
+    for (i = 0; i < num_teeth; i++) {
+	cairo_line_to (cr, (i + .5) * step, uniform_random (0, height - 1));
+	cairo_line_to (cr, (i + 1) * step, height);
+    }
+    cairo_close_path (cr);
+
+    cairo_perf_timer_start ();
+    while (loops--)
+        cairo_fill_preserve (cr);
+    cairo_perf_timer_stop ();
+
+    cairo_restore (cr);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+comb_256 (cairo_t *cr, int width, int height, int loops)
+{
+    return draw_comb (cr, 256, width, height, loops);
+}
+
+static cairo_time_t
+comb_1024 (cairo_t *cr, int width, int height, int loops)
+{
+    return draw_comb (cr, 1024, width, height, loops);
+}
+
+static cairo_time_t
+comb_4096 (cairo_t *cr, int width, int height, int loops)
+{
+    return draw_comb (cr, 4096, width, height, loops);
+}
+
 static cairo_time_t
 random_eo (cairo_t *cr, int width, int height, int loops)
 {
@@ -157,4 +218,8 @@ intersections (cairo_perf_t *perf, cairo_t *cr, int width, int height)
 
     cairo_perf_run (perf, "intersections-nz-curve-fill", random_curve_nz, NULL);
     cairo_perf_run (perf, "intersections-eo-curve-fill", random_curve_eo, NULL);
+
+    cairo_perf_run (perf, "intersections-comb-256-fill", comb_256, NULL);
+    cairo_perf_run (perf, "intersections-comb-1024-fill", comb_1024, NULL);
+    cairo_perf_run (perf, "intersections-comb-4096-fill", comb_4096, NULL);
 }
@@ -61,6 +61,49 @@ do_long_dashed_lines (cairo_t *cr, int width, int height, int loops)
     return cairo_perf_timer_elapsed ();
 }
 
+/* Wavy dashed lines, as for the isolines of a map, which unlike the
+ * horizontal lines above have to go through the general stroker. */
+static cairo_time_t
+do_long_dashed_curves (cairo_t *cr, int width, int height, int loops)
+{
+    double dash[2] = { 6.0, 3.0 };
+    int i;
+
+    cairo_save (cr);
+    cairo_set_source_rgb (cr, 1.0, 1.0, 1.0);
+    cairo_paint (cr);
+
+    cairo_set_source_rgb (cr, 1.0, 0.0, 0.0);
+    cairo_set_dash (cr, dash, 2, 0.0);
+
+    cairo_new_path (cr);
+    cairo_set_line_width (cr, 1.0);
+
+    for (i = 0; i < height; i += 8) {
+	double y0 = (double) i + 0.5;
+	double x;
+
+	cairo_move_to (cr, 0.0, y0);
+	for (x = 0; x < width; x += 32) {
+	    cairo_curve_to (cr,
+			    x + 10, y0 - 6,
+			    x + 22, y0 + 6,
+			    x + 32, y0);
+	}
+    }
+
+    cairo_perf_timer_start ();
+
+    while (loops--)
+	cairo_stroke_preserve (cr);
+
+    cairo_perf_timer_stop ();
+
+    cairo_restore (cr);
+
+    return cairo_perf_timer_elapsed ();
+}
+
 cairo_bool_t
 long_dashed_lines_enabled (cairo_perf_t *perf)
 {
@@ -71,4 +114,5 @@ void
 long_dashed_lines (cairo_perf_t *perf, cairo_t *cr, int width, int height)
 {
     cairo_perf_run (perf, "long-dashed-lines", do_long_dashed_lines, NULL);
+    cairo_perf_run (perf, "long-dashed-curves", do_long_dashed_curves, NULL);
 }
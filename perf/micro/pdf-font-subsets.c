@@ -0,0 +1,151 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-perf.h"
+
+#if CAIRO_HAS_PDF_SURFACE
+#include <cairo-pdf.h>
+
+/*
+ * Writing a PDF that uses many faces spends most of its time in
+ * cairo_surface_finish() building the subset of each font, so draw
+ * a page of every face we can find in several styles and time the
+ * whole document.
+ */
+
+static const char *families[] = {
+    "serif", "sans-serif", "monospace", "cursive", "fantasy",
+    "DejaVu Serif", "DejaVu Sans", "DejaVu Sans Mono",
+    "Liberation Serif", "Liberation Sans", "Liberation Mono",
+    "Nimbus Roman", "Nimbus Sans", "Nimbus Mono PS",
+    "FreeSerif", "FreeSans", "FreeMono",
+    "Noto Serif", "Noto Sans", "Noto Sans Mono",
+};
+
+#define NUM_FAMILIES (sizeof (families) / sizeof (families[0]))
+#define FIRST_CHAR 0x20
+#define LAST_CHAR 0x17f
+
+static cairo_status_t
+null_write (void *closure, const unsigned char *data, unsigned int length)
+{
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static int
+encode_utf8 (unsigned int ucs4, char *utf8)
+{
+    if (ucs4 < 0x80) {
+	utf8[0] = ucs4;
+	return 1;
+    }
+
+    utf8[0] = 0xc0 | (ucs4 >> 6);
+    utf8[1] = 0x80 | (ucs4 & 0x3f);
+    return 2;
+}
+
+static void
+draw_faces (cairo_t *cr, const char *text)
+{
+    unsigned int i;
+    int style;
+
+    for (i = 0; i < NUM_FAMILIES; i++) {
+	for (style = 0; style < 4; style++) {
+	    cairo_select_font_face (cr, families[i],
+				    style & 1 ? CAIRO_FONT_SLANT_ITALIC : CAIRO_FONT_SLANT_NORMAL,
+				    style & 2 ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+	    cairo_move_to (cr, 0, 10 * (4 * i + style + 1));
+	    cairo_show_text (cr, text);
+	}
+    }
+}
+
+static cairo_time_t
+_pdf_font_subsets (int width, int height, int loops, int num_threads)
+{
+    char text[2 * (LAST_CHAR - FIRST_CHAR + 1) + 1];
+    unsigned int c;
+    int len = 0;
+
+    for (c = FIRST_CHAR; c <= LAST_CHAR; c++)
+	len += encode_utf8 (c, text + len);
+    text[len] = '\0';
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	cairo_surface_t *surface;
+	cairo_t *cr2;
+
+	surface = cairo_pdf_surface_create_for_stream (null_write, NULL,
+						       width, height);
+	cairo_pdf_surface_set_compression_threads (surface, num_threads);
+	cr2 = cairo_create (surface);
+	cairo_set_font_size (cr2, 8);
+	draw_faces (cr2, text);
+	cairo_destroy (cr2);
+
+	cairo_surface_finish (surface);
+	cairo_surface_destroy (surface);
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_pdf_font_subsets (cairo_t *cr, int width, int height, int loops)
+{
+    return _pdf_font_subsets (width, height, loops, 1);
+}
+
+static cairo_time_t
+do_pdf_font_subsets_threaded (cairo_t *cr, int width, int height, int loops)
+{
+    return _pdf_font_subsets (width, height, loops, 0);
+}
+#endif
+
+cairo_bool_t
+pdf_font_subsets_enabled (cairo_perf_t *perf)
+{
+#if CAIRO_HAS_PDF_SURFACE
+    return cairo_perf_can_run (perf, "pdf-font-subsets", NULL);
+#else
+    return FALSE;
+#endif
+}
+
+void
+pdf_font_subsets (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+#if CAIRO_HAS_PDF_SURFACE
+    cairo_perf_run (perf, "pdf-font-subsets", do_pdf_font_subsets, NULL);
+    cairo_perf_run (perf, "pdf-font-subsets-threaded",
+		    do_pdf_font_subsets_threaded, NULL);
+#endif
+}
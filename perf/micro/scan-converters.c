@@ -0,0 +1,209 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Compare the tor and sparse scan converters on the same fill-heavy
+ * drawing as the fill, tiger and world-map tests.  The converter is
+ * chosen once from CAIRO_SCAN_CONVERTER, so each set of runs changes
+ * the environment and then resets cairo's static data.  That is only
+ * done for the image backend, where no other state depends upon it.
+ */
+
+#include "cairo-perf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../test/tiger.inc"
+
+typedef enum {
+    WM_NEW_PATH,
+    WM_MOVE_TO,
+    WM_LINE_TO,
+    WM_HLINE_TO,
+    WM_VLINE_TO,
+    WM_REL_LINE_TO,
+    WM_END
+} wm_type_t;
+
+typedef struct _wm_element {
+    wm_type_t type;
+    double x;
+    double y;
+} wm_element_t;
+
+#include "world-map.h"
+
+static char tor_env[] = "CAIRO_SCAN_CONVERTER=tor";
+static char sparse_env[] = "CAIRO_SCAN_CONVERTER=sparse";
+
+static cairo_time_t
+do_fill (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_new_sub_path (cr);
+    cairo_arc (cr, width/2.0, height/2.0, width/3.0, 0, 2 * M_PI);
+    cairo_new_sub_path (cr);
+    cairo_arc_negative (cr, width/2.0, height/2.0, width/4.0, 2 * M_PI, 0);
+
+    cairo_perf_timer_start ();
+
+    while (loops--)
+	cairo_fill_preserve (cr);
+
+    cairo_perf_timer_stop ();
+
+    cairo_new_path (cr);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_tiger (cairo_t *cr, int width, int height, int loops)
+{
+    unsigned int i;
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	cairo_save (cr);
+	cairo_translate (cr, width/2, height/2);
+	cairo_scale (cr, .85 * width/500, .85 * height/500);
+
+	for (i = 0; i < sizeof (tiger_commands)/sizeof(tiger_commands[0]);i++) {
+	    const struct command *cmd = &tiger_commands[i];
+	    switch (cmd->type) {
+	    case 'm':
+		cairo_move_to (cr, cmd->x0, cmd->y0);
+		break;
+	    case 'l':
+		cairo_line_to (cr, cmd->x0, cmd->y0);
+		break;
+	    case 'c':
+		cairo_curve_to (cr,
+				cmd->x0, cmd->y0,
+				cmd->x1, cmd->y1,
+				cmd->x2, cmd->y2);
+		break;
+	    case 'f':
+		cairo_set_source_rgba (cr,
+				       cmd->x0, cmd->y0, cmd->x1, cmd->y1);
+		cairo_fill (cr);
+		break;
+	    }
+	}
+	cairo_restore (cr);
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_world_map (cairo_t *cr, int width, int height, int loops)
+{
+    const wm_element_t *e;
+    double cx, cy;
+
+    cairo_scale (cr, width / 800., width / 800.);
+    cairo_set_source_rgb (cr, .75, .75, .75); /* silver */
+
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	e = &countries[0];
+	while (1) {
+	    switch (e->type) {
+	    case WM_NEW_PATH:
+	    case WM_END:
+		cairo_fill (cr);
+		cairo_move_to (cr, e->x, e->y);
+		break;
+	    case WM_MOVE_TO:
+		cairo_close_path (cr);
+		cairo_move_to (cr, e->x, e->y);
+		break;
+	    case WM_LINE_TO:
+		cairo_line_to (cr, e->x, e->y);
+		break;
+	    case WM_HLINE_TO:
+		cairo_get_current_point (cr, &cx, &cy);
+		cairo_line_to (cr, e->x, cy);
+		break;
+	    case WM_VLINE_TO:
+		cairo_get_current_point (cr, &cx, &cy);
+		cairo_line_to (cr, cx, e->y);
+		break;
+	    case WM_REL_LINE_TO:
+		cairo_rel_line_to (cr, e->x, e->y);
+		break;
+	    }
+	    if (e->type == WM_END)
+		break;
+	    e++;
+	}
+	cairo_new_path (cr);
+    }
+
+    cairo_perf_timer_stop ();
+
+    cairo_identity_matrix (cr);
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static void
+use_converter (char *env)
+{
+    putenv (env);
+    cairo_debug_reset_static_data ();
+}
+
+cairo_bool_t
+scan_converters_enabled (cairo_perf_t *perf)
+{
+    return cairo_perf_can_run (perf, "scan-converters", NULL);
+}
+
+void
+scan_converters (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+    const char *env;
+
+    if (cairo_surface_get_type (cairo_get_target (cr)) != CAIRO_SURFACE_TYPE_IMAGE)
+	return;
+
+    env = getenv ("CAIRO_SCAN_CONVERTER");
+
+    use_converter (tor_env);
+    cairo_perf_run (perf, "scan-converters-tor-fill", do_fill, NULL);
+    cairo_perf_run (perf, "scan-converters-tor-tiger", do_tiger, NULL);
+    cairo_perf_run (perf, "scan-converters-tor-world-map", do_world_map, NULL);
+
+    use_converter (sparse_env);
+    cairo_perf_run (perf, "scan-converters-sparse-fill", do_fill, NULL);
+    cairo_perf_run (perf, "scan-converters-sparse-tiger", do_tiger, NULL);
+    cairo_perf_run (perf, "scan-converters-sparse-world-map", do_world_map, NULL);
+
+    use_converter (env && strcmp (env, "sparse") == 0 ? sparse_env : tor_env);
+}
@@ -30,6 +30,16 @@
 #include <unistd.h>
 #endif
 
+#if CAIRO_HAS_PDF_SURFACE
+#include <cairo-pdf.h>
+#endif
+#if CAIRO_HAS_PS_SURFACE
+#include <cairo-ps.h>
+#endif
+#if CAIRO_HAS_SVG_SURFACE
+#include <cairo-svg.h>
+#endif
+
 typedef enum {
     WM_NEW_PATH,
     WM_MOVE_TO,
@@ -53,62 +63,101 @@ enum {
     FILL = 2,
 };
 
-static cairo_time_t
-do_world_map (cairo_t *cr, int width, int height, int loops, int mode)
+static void
+draw_world_map (cairo_t *cr, int mode)
 {
     const wm_element_t *e;
     double cx, cy;
 
+    cairo_set_source_rgb (cr, .68, .85, .90); /* lightblue */
+    cairo_rectangle (cr, 0, 0, 800, 400);
+    cairo_fill (cr);
+
+    e = &countries[0];
+    while (1) {
+	switch (e->type) {
+	case WM_NEW_PATH:
+	case WM_END:
+	    if (mode & FILL) {
+		cairo_set_source_rgb (cr, .75, .75, .75); /* silver */
+		cairo_fill_preserve (cr);
+	    }
+	    if (mode & STROKE) {
+		cairo_set_source_rgb (cr, .50, .50, .50); /* gray */
+		cairo_stroke (cr);
+	    }
+	    cairo_new_path (cr);
+	    cairo_move_to (cr, e->x, e->y);
+	    break;
+	case WM_MOVE_TO:
+	    cairo_close_path (cr);
+	    cairo_move_to (cr, e->x, e->y);
+	    break;
+	case WM_LINE_TO:
+	    cairo_line_to (cr, e->x, e->y);
+	    break;
+	case WM_HLINE_TO:
+	    cairo_get_current_point (cr, &cx, &cy);
+	    cairo_line_to (cr, e->x, cy);
+	    break;
+	case WM_VLINE_TO:
+	    cairo_get_current_point (cr, &cx, &cy);
+	    cairo_line_to (cr, cx, e->y);
+	    break;
+	case WM_REL_LINE_TO:
+	    cairo_rel_line_to (cr, e->x, e->y);
+	    break;
+	}
+	if (e->type == WM_END)
+	    break;
+	e++;
+    }
+
+    cairo_new_path (cr);
+}
+
+static cairo_time_t
+do_world_map (cairo_t *cr, int width, int height, int loops, int mode)
+{
     cairo_set_line_width (cr, 0.2);
 
     cairo_perf_timer_start ();
 
+    while (loops--)
+	draw_world_map (cr, mode);
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_status_t
+null_write (void *closure, const unsigned char *data, unsigned int length)
+{
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Writes the map to one of the vector surfaces, which is mostly a
+ * matter of printing every coordinate of every path. */
+static cairo_time_t
+do_world_map_export (int loops,
+		     cairo_surface_t *(*create) (cairo_write_func_t, void *,
+						 double, double))
+{
+    cairo_perf_timer_start ();
+
     while (loops--) {
-	cairo_set_source_rgb (cr, .68, .85, .90); /* lightblue */
-	cairo_rectangle (cr, 0, 0, 800, 400);
-	cairo_fill (cr);
-
-	e = &countries[0];
-	while (1) {
-	    switch (e->type) {
-	    case WM_NEW_PATH:
-	    case WM_END:
-		if (mode & FILL) {
-		    cairo_set_source_rgb (cr, .75, .75, .75); /* silver */
-		    cairo_fill_preserve (cr);
-		}
-		if (mode & STROKE) {
-		    cairo_set_source_rgb (cr, .50, .50, .50); /* gray */
-		    cairo_stroke (cr);
-		}
-		cairo_new_path (cr);
-		cairo_move_to (cr, e->x, e->y);
-		break;
-	    case WM_MOVE_TO:
-		cairo_close_path (cr);
-		cairo_move_to (cr, e->x, e->y);
-		break;
-	    case WM_LINE_TO:
-		cairo_line_to (cr, e->x, e->y);
-		break;
-	    case WM_HLINE_TO:
-		cairo_get_current_point (cr, &cx, &cy);
-		cairo_line_to (cr, e->x, cy);
-		break;
-	    case WM_VLINE_TO:
-		cairo_get_current_point (cr, &cx, &cy);
-		cairo_line_to (cr, cx, e->y);
-		break;
-	    case WM_REL_LINE_TO:
-		cairo_rel_line_to (cr, e->x, e->y);
-		break;
-	    }
-	    if (e->type == WM_END)
-		break;
-	    e++;
-	}
+	cairo_surface_t *surface;
+	cairo_t *cr;
+
+	surface = create (null_write, NULL, 800, 400);
+	cr = cairo_create (surface);
+	cairo_set_line_width (cr, 0.2);
+	draw_world_map (cr, FILL | STROKE);
+	cairo_destroy (cr);
 
-	cairo_new_path (cr);
+	cairo_surface_finish (surface);
+	cairo_surface_destroy (surface);
     }
 
     cairo_perf_timer_stop ();
@@ -116,6 +165,30 @@ do_world_map (cairo_t *cr, int width, int height, int loops, int mode)
     return cairo_perf_timer_elapsed ();
 }
 
+#if CAIRO_HAS_PDF_SURFACE
+static cairo_time_t
+do_world_map_pdf (cairo_t *cr, int width, int height, int loops)
+{
+    return do_world_map_export (loops, cairo_pdf_surface_create_for_stream);
+}
+#endif
+
+#if CAIRO_HAS_PS_SURFACE
+static cairo_time_t
+do_world_map_ps (cairo_t *cr, int width, int height, int loops)
+{
+    return do_world_map_export (loops, cairo_ps_surface_create_for_stream);
+}
+#endif
+
+#if CAIRO_HAS_SVG_SURFACE
+static cairo_time_t
+do_world_map_svg (cairo_t *cr, int width, int height, int loops)
+{
+    return do_world_map_export (loops, cairo_svg_surface_create_for_stream);
+}
+#endif
+
 static cairo_time_t
 do_world_map_stroke (cairo_t *cr, int width, int height, int loops)
 {
@@ -146,4 +219,13 @@ world_map (cairo_perf_t *perf, cairo_t *cr, int width, int height)
     cairo_perf_run (perf, "world-map-stroke", do_world_map_stroke, NULL);
     cairo_perf_run (perf, "world-map-fill", do_world_map_fill, NULL);
     cairo_perf_run (perf, "world-map", do_world_map_both, NULL);
+#if CAIRO_HAS_PDF_SURFACE
+    cairo_perf_run (perf, "world-map-pdf", do_world_map_pdf, NULL);
+#endif
+#if CAIRO_HAS_PS_SURFACE
+    cairo_perf_run (perf, "world-map-ps", do_world_map_ps, NULL);
+#endif
+#if CAIRO_HAS_SVG_SURFACE
+    cairo_perf_run (perf, "world-map-svg", do_world_map_svg, NULL);
+#endif
 }
@@ -40,6 +40,7 @@
 
 #include "cairo-error-private.h"
 #include "cairo-freelist-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-combsort-inline.h"
 #include "cairo-traps-private.h"
 
@@ -61,6 +62,7 @@ typedef struct _cairo_bo_intersect_point {
 
 typedef struct _cairo_bo_edge cairo_bo_edge_t;
 typedef struct _cairo_bo_trap cairo_bo_trap_t;
+typedef struct _cairo_bo_sweep_node cairo_bo_sweep_node_t;
 
 /* A deferred trapezoid of an edge */
 struct _cairo_bo_trap {
@@ -74,6 +76,7 @@ struct _cairo_bo_edge {
     cairo_bo_edge_t *next;
     cairo_bo_edge_t *colinear;
     cairo_bo_trap_t deferred_trap;
+    cairo_bo_sweep_node_t *node;
 };
 
 /* the parent is always given by index/2 */
@@ -120,11 +123,36 @@ typedef struct _cairo_bo_event_queue {
     cairo_bo_event_t **start_events;
 } cairo_bo_event_queue_t;
 
+/* Once the sweep line holds more than SWEEP_LINE_INDEX_THRESHOLD
+ * edges, a skip list is built over it so that new edges can be placed
+ * without long walks along the list. Each level of the skip list is a doubly
+ * linked list of nodes, and every node is attached to the edge at its
+ * position in the sweep line: swapping two adjacent edges only has to
+ * exchange their nodes, and removing an edge unlinks its node without
+ * a search.
+ */
+#define SWEEP_LINE_INDEX_THRESHOLD 128
+#define SWEEP_LINE_MAX_WALK 32
+#define SWEEP_LINE_MAX_LEVEL 12
+
+struct _cairo_bo_sweep_node {
+    cairo_bo_edge_t *edge;
+    int level;
+    cairo_bo_sweep_node_t *next[SWEEP_LINE_MAX_LEVEL];
+    cairo_bo_sweep_node_t *prev[SWEEP_LINE_MAX_LEVEL];
+};
+
 typedef struct _cairo_bo_sweep_line {
     cairo_bo_edge_t *head;
     cairo_bo_edge_t *stopped;
     int32_t current_y;
     cairo_bo_edge_t *current_edge;
+
+    int num_edges;
+    cairo_bool_t indexed;
+    cairo_bo_sweep_node_t index;
+    cairo_freepool_t pool;
+    uint32_t seed;
 } cairo_bo_sweep_line_t;
 
 #if DEBUG_TRAPS
@@ -1117,14 +1145,135 @@ _cairo_bo_sweep_line_init (cairo_bo_sweep_line_t *sweep_line)
     sweep_line->stopped = NULL;
     sweep_line->current_y = INT32_MIN;
     sweep_line->current_edge = NULL;
+
+    sweep_line->num_edges = 0;
+    sweep_line->indexed = FALSE;
+    memset (&sweep_line->index, 0, sizeof (sweep_line->index));
+    sweep_line->index.level = SWEEP_LINE_MAX_LEVEL;
+    _cairo_freepool_init (&sweep_line->pool, sizeof (cairo_bo_sweep_node_t));
+    sweep_line->seed = 0x12345678;
+}
+
+static void
+_cairo_bo_sweep_line_fini (cairo_bo_sweep_line_t *sweep_line)
+{
+    _cairo_freepool_fini (&sweep_line->pool);
+}
+
+/* Attach a node of random height to a newly inserted edge. A node
+ * occupies levels 1 and up of the skip list with probability 1/4 for
+ * each level, the sweep line itself being level 0, and is linked after
+ * the nearest node to the left at each of its levels. If we fail to
+ * allocate the node, the edge is simply left out of the index.
+ */
+static void
+_cairo_bo_sweep_line_link_node (cairo_bo_sweep_line_t	*sweep_line,
+				cairo_bo_edge_t		*edge)
+{
+    cairo_bo_sweep_node_t *node, *pos;
+    cairo_bo_edge_t *left;
+    uint32_t bits;
+    int level, n;
+
+    edge->node = NULL;
+
+    sweep_line->seed = sweep_line->seed * 1103515245 + 12345;
+    bits = sweep_line->seed >> 8;
+    for (level = 0; (bits & 3) == 0 && level < SWEEP_LINE_MAX_LEVEL; level++)
+	bits >>= 2;
+    if (level == 0)
+	return;
+
+    node = _cairo_freepool_alloc (&sweep_line->pool);
+    if (unlikely (node == NULL))
+	return;
+
+    node->edge = edge;
+    node->level = level;
+    edge->node = node;
+
+    left = edge->prev;
+    while (left != NULL && left->node == NULL)
+	left = left->prev;
+    pos = left != NULL ? left->node : &sweep_line->index;
+
+    for (n = 0; n < level; n++) {
+	while (pos->level <= n)
+	    pos = pos->prev[n-1];
+
+	node->prev[n] = pos;
+	node->next[n] = pos->next[n];
+	if (node->next[n] != NULL)
+	    node->next[n]->prev[n] = node;
+	pos->next[n] = node;
+    }
 }
 
+static void
+_cairo_bo_sweep_line_build_index (cairo_bo_sweep_line_t *sweep_line)
+{
+    cairo_bo_edge_t *edge;
+
+    for (edge = sweep_line->head; edge != NULL; edge = edge->next)
+	_cairo_bo_sweep_line_link_node (sweep_line, edge);
+
+    sweep_line->indexed = TRUE;
+}
+
+/* Locate the position of a new edge by descending the skip list from
+ * the top level, finishing with a short walk along the sweep line. */
+static void
+_cairo_bo_sweep_line_find (cairo_bo_sweep_line_t	*sweep_line,
+			   cairo_bo_edge_t		*edge,
+			   cairo_bo_edge_t		**prev_out,
+			   cairo_bo_edge_t		**next_out)
+{
+    cairo_bo_sweep_node_t *node = &sweep_line->index;
+    cairo_bo_edge_t *prev, *next;
+    int level;
+
+    for (level = SWEEP_LINE_MAX_LEVEL; level--; ) {
+	while (node->next[level] != NULL &&
+	       _cairo_bo_sweep_line_compare_edges (sweep_line,
+						   node->next[level]->edge,
+						   edge) < 0)
+	{
+	    node = node->next[level];
+	}
+    }
+
+    prev = node->edge;
+    next = prev != NULL ? prev->next : sweep_line->head;
+    while (next != NULL &&
+	   _cairo_bo_sweep_line_compare_edges (sweep_line, next, edge) < 0)
+    {
+	prev = next, next = prev->next;
+    }
+
+    *prev_out = prev;
+    *next_out = next;
+}
+
+/* New edges are placed by walking from the last one inserted, as
+ * they usually arrive in order along the sweep line. Once the index is
+ * built, a walk that runs for more than SWEEP_LINE_MAX_WALK edges is
+ * abandoned for a search of the skip list.
+ */
 static void
 _cairo_bo_sweep_line_insert (cairo_bo_sweep_line_t	*sweep_line,
 			     cairo_bo_edge_t		*edge)
 {
+    cairo_bo_edge_t *prev, *next;
+
+    if (! sweep_line->indexed &&
+	sweep_line->num_edges >= SWEEP_LINE_INDEX_THRESHOLD)
+    {
+	_cairo_bo_sweep_line_build_index (sweep_line);
+    }
+    sweep_line->num_edges++;
+
     if (sweep_line->current_edge != NULL) {
-	cairo_bo_edge_t *prev, *next;
+	int steps = sweep_line->indexed ? SWEEP_LINE_MAX_WALK : INT_MAX;
 	int cmp;
 
 	cmp = _cairo_bo_sweep_line_compare_edges (sweep_line,
@@ -1137,14 +1286,12 @@ _cairo_bo_sweep_line_insert (cairo_bo_sweep_line_t	*sweep_line,
 		   _cairo_bo_sweep_line_compare_edges (sweep_line,
 						       next, edge) < 0)
 	    {
+		if (--steps == 0) {
+		    _cairo_bo_sweep_line_find (sweep_line, edge, &prev, &next);
+		    break;
+		}
 		prev = next, next = prev->next;
 	    }
-
-	    prev->next = edge;
-	    edge->prev = prev;
-	    edge->next = next;
-	    if (next != NULL)
-		next->prev = edge;
 	} else if (cmp > 0) {
 	    next = sweep_line->current_edge;
 	    prev = next->prev;
@@ -1152,29 +1299,32 @@ _cairo_bo_sweep_line_insert (cairo_bo_sweep_line_t	*sweep_line,
 		   _cairo_bo_sweep_line_compare_edges (sweep_line,
 						       prev, edge) > 0)
 	    {
+		if (--steps == 0) {
+		    _cairo_bo_sweep_line_find (sweep_line, edge, &prev, &next);
+		    break;
+		}
 		next = prev, prev = next->prev;
 	    }
-
-	    next->prev = edge;
-	    edge->next = next;
-	    edge->prev = prev;
-	    if (prev != NULL)
-		prev->next = edge;
-	    else
-		sweep_line->head = edge;
 	} else {
 	    prev = sweep_line->current_edge;
-	    edge->prev = prev;
-	    edge->next = prev->next;
-	    if (prev->next != NULL)
-		prev->next->prev = edge;
-	    prev->next = edge;
+	    next = prev->next;
 	}
     } else {
-	sweep_line->head = edge;
-	edge->next = NULL;
+	prev = next = NULL;
     }
 
+    edge->prev = prev;
+    edge->next = next;
+    if (prev != NULL)
+	prev->next = edge;
+    else
+	sweep_line->head = edge;
+    if (next != NULL)
+	next->prev = edge;
+
+    if (sweep_line->indexed)
+	_cairo_bo_sweep_line_link_node (sweep_line, edge);
+
     sweep_line->current_edge = edge;
 }
 
@@ -1192,6 +1342,22 @@ _cairo_bo_sweep_line_delete (cairo_bo_sweep_line_t	*sweep_line,
 
     if (sweep_line->current_edge == edge)
 	sweep_line->current_edge = edge->prev ? edge->prev : edge->next;
+
+    if (edge->node != NULL) {
+	cairo_bo_sweep_node_t *node = edge->node;
+	int level;
+
+	for (level = 0; level < node->level; level++) {
+	    node->prev[level]->next[level] = node->next[level];
+	    if (node->next[level] != NULL)
+		node->next[level]->prev[level] = node->prev[level];
+	}
+
+	_cairo_freepool_free (&sweep_line->pool, node);
+	edge->node = NULL;
+    }
+
+    sweep_line->num_edges--;
 }
 
 static void
@@ -1212,6 +1378,18 @@ _cairo_bo_sweep_line_swap (cairo_bo_sweep_line_t	*sweep_line,
 
     right->prev = left->prev;
     left->prev = right;
+
+    /* The skip list nodes stay in place and swap their edges. */
+    if (left->node != NULL || right->node != NULL) {
+	cairo_bo_sweep_node_t *node = left->node;
+
+	left->node = right->node;
+	right->node = node;
+	if (left->node != NULL)
+	    left->node->edge = left;
+	if (right->node != NULL)
+	    right->node->edge = right;
+    }
 }
 
 #if DEBUG_PRINT_STATE
@@ -1671,6 +1849,7 @@ _cairo_bentley_ottmann_tessellate_bo_edges (cairo_bo_event_t   **start_events,
     status = traps->status;
  unwind:
     _cairo_bo_event_queue_fini (&event_queue);
+    _cairo_bo_sweep_line_fini (&sweep_line);
 
 #if DEBUG_EVENTS
     event_log ("\n");
@@ -1734,6 +1913,7 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
 	events[i].edge.prev = NULL;
 	events[i].edge.next = NULL;
 	events[i].edge.colinear = NULL;
+	events[i].edge.node = NULL;
 
 	if (event_y) {
 	    y = _cairo_fixed_integer_floor (events[i].point.y) - ymin;
@@ -1779,6 +1959,173 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t	 *traps,
     return status;
 }
 
+/* When the caller allows more than one thread, very large polygons are
+ * cut into horizontal slabs that are swept independently.  An edge
+ * crossing a slab boundary is shortened to each slab it spans, whilst
+ * keeping its line, so the slabs meet exactly and the only difference
+ * in the output is that trapezoids are split at the boundaries.  The
+ * boundaries are placed on whole pixel rows so that no sample row is
+ * divided between slabs.
+ */
+#define CAIRO_BO_SLAB_MIN_EDGES 4096
+#define CAIRO_BO_SLAB_BINS 1024
+
+typedef struct _cairo_bo_slab {
+    cairo_fixed_t top, bottom;
+    cairo_traps_t traps;
+    cairo_status_t status;
+} cairo_bo_slab_t;
+
+typedef struct _cairo_bo_slabs {
+    const cairo_polygon_t *polygon;
+    cairo_fill_rule_t fill_rule;
+    cairo_bo_slab_t *slabs;
+} cairo_bo_slabs_t;
+
+static void
+_cairo_bo_tessellate_slab (void *closure, int n)
+{
+    cairo_bo_slabs_t *info = closure;
+    cairo_bo_slab_t *slab = &info->slabs[n];
+    const cairo_polygon_t *polygon = info->polygon;
+    cairo_polygon_t clipped;
+    int i;
+
+    _cairo_polygon_init (&clipped, NULL, 0);
+    for (i = 0; i < polygon->num_edges; i++) {
+	const cairo_edge_t *edge = &polygon->edges[i];
+
+	if (edge->bottom <= slab->top || edge->top >= slab->bottom)
+	    continue;
+
+	_cairo_polygon_add_line (&clipped, &edge->line,
+				 MAX (edge->top, slab->top),
+				 MIN (edge->bottom, slab->bottom),
+				 edge->dir);
+    }
+
+    slab->status = clipped.status;
+    if (likely (slab->status == CAIRO_STATUS_SUCCESS)) {
+	slab->status =
+	    _cairo_bentley_ottmann_tessellate_polygon (&slab->traps,
+						       &clipped,
+						       info->fill_rule);
+    }
+
+    _cairo_polygon_fini (&clipped);
+}
+
+/* Choose the slab boundaries so that each slab starts roughly the same
+ * number of edges, returning the number of slabs actually used.
+ */
+static int
+_cairo_bo_slabs_init (const cairo_polygon_t *polygon,
+		      cairo_bo_slab_t *slabs,
+		      int num_slabs)
+{
+    int bins[CAIRO_BO_SLAB_BINS];
+    int ymin, ymax, rows, i, n, count, target;
+
+    ymin = INT_MAX;
+    ymax = INT_MIN;
+    for (i = 0; i < polygon->num_edges; i++) {
+	int top = _cairo_fixed_integer_floor (polygon->edges[i].top);
+	int bottom = _cairo_fixed_integer_ceil (polygon->edges[i].bottom);
+
+	if (top < ymin)
+	    ymin = top;
+	if (bottom > ymax)
+	    ymax = bottom;
+    }
+
+    rows = (ymax - ymin + CAIRO_BO_SLAB_BINS - 1) / CAIRO_BO_SLAB_BINS;
+    memset (bins, 0, sizeof (bins));
+    for (i = 0; i < polygon->num_edges; i++) {
+	int y = _cairo_fixed_integer_floor (polygon->edges[i].top);
+	bins[(y - ymin) / rows]++;
+    }
+
+    slabs[0].top = _cairo_fixed_from_int (ymin);
+    count = 0;
+    n = 0;
+    for (i = 0; i < CAIRO_BO_SLAB_BINS - 1 && n < num_slabs - 1; i++) {
+	count += bins[i];
+	target = (long long) (n + 1) * polygon->num_edges / num_slabs;
+	if (count >= target) {
+	    cairo_fixed_t y = _cairo_fixed_from_int (ymin + (i + 1) * rows);
+	    if (y >= _cairo_fixed_from_int (ymax))
+		break;
+
+	    slabs[n].bottom = y;
+	    slabs[++n].top = y;
+	}
+    }
+    slabs[n].bottom = _cairo_fixed_from_int (ymax);
+
+    return n + 1;
+}
+
+/* As _cairo_bentley_ottmann_tessellate_polygon(), but a polygon with
+ * enough edges is split between up to @num_threads slabs.
+ */
+cairo_status_t
+_cairo_bentley_ottmann_tessellate_polygon_threads (cairo_traps_t	 *traps,
+						   const cairo_polygon_t *polygon,
+						   cairo_fill_rule_t	  fill_rule,
+						   int			  num_threads)
+{
+    cairo_bo_slab_t stack_slabs[16];
+    cairo_bo_slabs_t info;
+    cairo_status_t status;
+    int num_slabs, n, i;
+
+    num_threads = MIN (num_threads,
+		       polygon->num_edges / CAIRO_BO_SLAB_MIN_EDGES);
+    num_threads = MIN (num_threads, ARRAY_LENGTH (stack_slabs));
+    if (num_threads <= 1)
+	return _cairo_bentley_ottmann_tessellate_polygon (traps,
+							  polygon,
+							  fill_rule);
+
+    num_slabs = _cairo_bo_slabs_init (polygon, stack_slabs, num_threads);
+    if (num_slabs <= 1)
+	return _cairo_bentley_ottmann_tessellate_polygon (traps,
+							  polygon,
+							  fill_rule);
+
+    for (n = 0; n < num_slabs; n++)
+	_cairo_traps_init (&stack_slabs[n].traps);
+
+    info.polygon = polygon;
+    info.fill_rule = fill_rule;
+    info.slabs = stack_slabs;
+    _cairo_parallel_for (num_slabs, num_slabs,
+			 _cairo_bo_tessellate_slab, &info);
+
+    status = CAIRO_STATUS_SUCCESS;
+    for (n = 0; n < num_slabs; n++) {
+	cairo_bo_slab_t *slab = &stack_slabs[n];
+
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = slab->status;
+
+	for (i = 0;
+	     status == CAIRO_STATUS_SUCCESS && i < slab->traps.num_traps;
+	     i++)
+	{
+	    cairo_trapezoid_t *t = &slab->traps.traps[i];
+
+	    _cairo_traps_add_trap (traps, t->top, t->bottom,
+				   &t->left, &t->right);
+	    status = traps->status;
+	}
+
+	_cairo_traps_fini (&slab->traps);
+    }
+
+    return status;
+}
+
 cairo_status_t
 _cairo_bentley_ottmann_tessellate_traps (cairo_traps_t *traps,
 					 cairo_fill_rule_t fill_rule)
@@ -92,8 +92,9 @@ typedef struct edge {
     struct quorem dxdy;
     struct quorem dxdy_full;
 
-    cairo_bool_t vertical;
-    unsigned int flags;
+    /* Packed together so that the edge stays within 88 bytes. */
+    uint16_t vertical;
+    uint16_t flags;
 
     int current_sign;
     struct run *runs;
@@ -137,6 +137,9 @@ cairo_private void
 _cairo_cache_remove (cairo_cache_t	 *cache,
 		     cairo_cache_entry_t *entry);
 
+cairo_private cairo_bool_t
+_cairo_cache_remove_random (cairo_cache_t *cache);
+
 cairo_private void
 _cairo_cache_foreach (cairo_cache_t		 *cache,
 		      cairo_cache_callback_func_t cache_callback,
@@ -210,7 +210,7 @@ _cairo_cache_lookup (cairo_cache_t	  *cache,
  * Return value: %TRUE if an entry was successfully removed.
  * %FALSE if there are no entries that can be removed.
  **/
-static cairo_bool_t
+cairo_bool_t
 _cairo_cache_remove_random (cairo_cache_t *cache)
 {
     cairo_cache_entry_t *entry;
@@ -336,3 +336,55 @@ _cairo_hash_bytes (unsigned long hash,
 	hash = ((hash << 5) + hash) + *bytes++;
     return hash;
 }
+
+#define DIGEST_PRIME_1 0x9e3779b185ebca87ULL
+#define DIGEST_PRIME_2 0xc2b2ae3d27d4eb4fULL
+
+static inline uint64_t
+_rotl64 (uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline void
+_cairo_hash_digest_mix (cairo_hash_digest_t *digest, uint64_t word)
+{
+    digest->h[0] = _rotl64 (digest->h[0] ^ (word * DIGEST_PRIME_2), 31) * DIGEST_PRIME_1;
+    digest->h[1] = (_rotl64 (digest->h[1], 27) + word) * DIGEST_PRIME_2 + DIGEST_PRIME_1;
+}
+
+void
+_cairo_hash_digest_init (cairo_hash_digest_t *digest)
+{
+    digest->h[0] = _CAIRO_HASH_INIT_VALUE;
+    digest->h[1] = DIGEST_PRIME_1;
+}
+
+/* Feeds @length bytes into @digest, eight at a time.  The same
+ * sequence of updates always yields the same digest, but splitting the
+ * data differently does not, so callers should always break up the data
+ * in the same way (e.g. one update per row of pixels).
+ */
+void
+_cairo_hash_digest_update (cairo_hash_digest_t *digest,
+			   const void *ptr,
+			   unsigned long length)
+{
+    const uint8_t *bytes = ptr;
+    uint64_t word;
+
+    _cairo_hash_digest_mix (digest, length);
+
+    while (length >= sizeof (word)) {
+	memcpy (&word, bytes, sizeof (word));
+	_cairo_hash_digest_mix (digest, word);
+	bytes += sizeof (word);
+	length -= sizeof (word);
+    }
+
+    if (length) {
+	word = 0;
+	memcpy (&word, bytes, length);
+	_cairo_hash_digest_mix (digest, word);
+    }
+}
@@ -294,6 +294,8 @@ struct cairo_traps_compositor {
 				 int				 dst_x,
 				 int				 dst_y,
 				 cairo_composite_glyphs_info_t  *info);
+
+    int (*renderer_threads) (void *surface);
 };
 
 cairo_private extern const cairo_compositor_t __cairo_no_compositor;
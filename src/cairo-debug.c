@@ -35,6 +35,8 @@
 
 #include "cairoint.h"
 #include "cairo-image-surface-private.h"
+#include "cairo-path-cache-private.h"
+#include "cairo-spans-compositor-private.h"
 
 /**
  * cairo_debug_reset_static_data:
@@ -84,8 +86,14 @@ cairo_debug_reset_static_data (void)
 
     _cairo_clip_reset_static_data ();
 
+    _cairo_path_cache_reset_static_data ();
+
     _cairo_image_reset_static_data ();
 
+    _cairo_image_compositor_reset_static_data ();
+
+    _cairo_spans_compositor_reset_static_data ();
+
 #if CAIRO_HAS_DRM_SURFACE
     _cairo_drm_device_reset_static_data ();
 #endif
@@ -44,6 +44,7 @@
 #include "cairo-error-private.h"
 #include "cairo-image-surface-private.h"
 #include "cairo-ft-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-pattern-private.h"
 
 #include <float.h>
@@ -147,6 +148,12 @@ typedef struct _cairo_ft_font_transform {
 
 typedef struct _cairo_ft_font_face cairo_ft_font_face_t;
 
+/* The most workers rasterising a batch of glyphs, and the most idle
+ * FreeType libraries kept for them, see
+ * _cairo_ft_scaled_glyphs_init_surfaces().
+ */
+#define FT_MAX_WORKER_FACES 8
+
 struct _cairo_ft_unscaled_font {
     cairo_unscaled_font_t base;
 
@@ -227,6 +234,10 @@ typedef struct _cairo_ft_unscaled_font_map {
     cairo_hash_table_t *hash_table;
     FT_Library ft_library;
     int num_open_faces;
+
+    /* idle libraries for the glyph workers */
+    FT_Library worker_libraries[FT_MAX_WORKER_FACES];
+    int num_worker_libraries;
 } cairo_ft_unscaled_font_map_t;
 
 static cairo_ft_unscaled_font_map_t *cairo_ft_unscaled_font_map = NULL;
@@ -279,6 +290,7 @@ _cairo_ft_unscaled_font_map_create (void)
 	goto FAIL;
 
     font_map->num_open_faces = 0;
+    font_map->num_worker_libraries = 0;
 
     cairo_ft_unscaled_font_map = font_map;
     return CAIRO_STATUS_SUCCESS;
@@ -324,6 +336,9 @@ _cairo_ft_unscaled_font_map_destroy (void)
 				   font_map);
 	assert (font_map->num_open_faces == 0);
 
+	while (font_map->num_worker_libraries)
+	    FT_Done_FreeType (font_map->worker_libraries[--font_map->num_worker_libraries]);
+
 	FT_Done_FreeType (font_map->ft_library);
 
 	_cairo_hash_table_destroy (font_map->hash_table);
@@ -2114,6 +2129,70 @@ _cairo_ft_scaled_glyph_vertical_layout_bearing_fix (void        *abstract_font,
     }
 }
 
+/* Loads a glyph into the face's glyph slot and applies any synthesis
+ * and layout fixups requested by the scaled font.
+ */
+static cairo_status_t
+_cairo_ft_scaled_glyph_load (cairo_ft_scaled_font_t *scaled_font,
+			     FT_Face		     face,
+			     unsigned long	     index,
+			     int		     load_flags,
+			     cairo_bool_t	     vertical_layout)
+{
+    FT_Error error;
+
+    error = FT_Load_Glyph (face, index, load_flags);
+    /* XXX ignoring all other errors for now.  They are not fatal, typically
+     * just a glyph-not-found. */
+    if (error == FT_Err_Out_Of_Memory)
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    /*
+     * synthesize glyphs if requested
+     */
+#if HAVE_FT_GLYPHSLOT_EMBOLDEN
+    if (scaled_font->ft_options.synth_flags & CAIRO_FT_SYNTHESIZE_BOLD)
+	FT_GlyphSlot_Embolden (face->glyph);
+#endif
+
+#if HAVE_FT_GLYPHSLOT_OBLIQUE
+    if (scaled_font->ft_options.synth_flags & CAIRO_FT_SYNTHESIZE_OBLIQUE)
+	FT_GlyphSlot_Oblique (face->glyph);
+#endif
+
+    if (vertical_layout)
+	_cairo_ft_scaled_glyph_vertical_layout_bearing_fix (scaled_font, face->glyph);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Renders the glyph loaded into the face's glyph slot.  This only
+ * reads the scale previously recorded in the unscaled font, so it may
+ * be used with a private FT_Face set to the same size.
+ */
+static cairo_status_t
+_cairo_ft_scaled_glyph_render (cairo_ft_scaled_font_t  *scaled_font,
+			       FT_Face			face,
+			       cairo_image_surface_t  **surface)
+{
+    cairo_ft_unscaled_font_t *unscaled = scaled_font->unscaled;
+    cairo_status_t status;
+
+    if (face->glyph->format == FT_GLYPH_FORMAT_OUTLINE)
+	return _render_glyph_outline (face, &scaled_font->ft_options.base,
+				      surface);
+
+    status = _render_glyph_bitmap (face, &scaled_font->ft_options.base,
+				   surface);
+    if (likely (status == CAIRO_STATUS_SUCCESS) && unscaled->have_shape) {
+	status = _transform_glyph_bitmap (&unscaled->current_shape, surface);
+	if (unlikely (status))
+	    cairo_surface_destroy (&(*surface)->base);
+    }
+
+    return status;
+}
+
 static cairo_int_status_t
 _cairo_ft_scaled_glyph_init (void			*abstract_font,
 			     cairo_scaled_glyph_t	*scaled_glyph,
@@ -2124,7 +2203,6 @@ _cairo_ft_scaled_glyph_init (void			*abstract_font,
     cairo_ft_unscaled_font_t *unscaled = scaled_font->unscaled;
     FT_GlyphSlot glyph;
     FT_Face face;
-    FT_Error error;
     int load_flags = scaled_font->ft_options.load_flags;
     FT_Glyph_Metrics *metrics;
     double x_factor, y_factor;
@@ -2156,34 +2234,14 @@ _cairo_ft_scaled_glyph_init (void			*abstract_font,
 	vertical_layout = TRUE;
     }
 
-    error = FT_Load_Glyph (face,
-			   _cairo_scaled_glyph_index(scaled_glyph),
-			   load_flags);
-    /* XXX ignoring all other errors for now.  They are not fatal, typically
-     * just a glyph-not-found. */
-    if (error == FT_Err_Out_Of_Memory) {
-	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    status = _cairo_ft_scaled_glyph_load (scaled_font, face,
+					  _cairo_scaled_glyph_index(scaled_glyph),
+					  load_flags, vertical_layout);
+    if (unlikely (status))
 	goto FAIL;
-    }
 
     glyph = face->glyph;
 
-    /*
-     * synthesize glyphs if requested
-     */
-#if HAVE_FT_GLYPHSLOT_EMBOLDEN
-    if (scaled_font->ft_options.synth_flags & CAIRO_FT_SYNTHESIZE_BOLD)
-	FT_GlyphSlot_Embolden (glyph);
-#endif
-
-#if HAVE_FT_GLYPHSLOT_OBLIQUE
-    if (scaled_font->ft_options.synth_flags & CAIRO_FT_SYNTHESIZE_OBLIQUE)
-	FT_GlyphSlot_Oblique (glyph);
-#endif
-
-    if (vertical_layout)
-	_cairo_ft_scaled_glyph_vertical_layout_bearing_fix (scaled_font, glyph);
-
     if (info & CAIRO_SCALED_GLYPH_INFO_METRICS) {
 
 	cairo_bool_t hint_metrics = scaled_font->base.options.hint_metrics != CAIRO_HINT_METRICS_OFF;
@@ -2284,21 +2342,7 @@ _cairo_ft_scaled_glyph_init (void			*abstract_font,
     if ((info & CAIRO_SCALED_GLYPH_INFO_SURFACE) != 0) {
 	cairo_image_surface_t	*surface;
 
-	if (glyph->format == FT_GLYPH_FORMAT_OUTLINE) {
-	    status = _render_glyph_outline (face, &scaled_font->ft_options.base,
-					    &surface);
-	} else {
-	    status = _render_glyph_bitmap (face, &scaled_font->ft_options.base,
-					   &surface);
-	    if (likely (status == CAIRO_STATUS_SUCCESS) &&
-		unscaled->have_shape)
-	    {
-		status = _transform_glyph_bitmap (&unscaled->current_shape,
-						  &surface);
-		if (unlikely (status))
-		    cairo_surface_destroy (&surface->base);
-	    }
-	}
+	status = _cairo_ft_scaled_glyph_render (scaled_font, face, &surface);
 	if (unlikely (status))
 	    goto FAIL;
 
@@ -2315,26 +2359,12 @@ _cairo_ft_scaled_glyph_init (void			*abstract_font,
 	 * so reload it. This will probably never occur though
 	 */
 	if ((info & CAIRO_SCALED_GLYPH_INFO_SURFACE) != 0) {
-	    error = FT_Load_Glyph (face,
-				   _cairo_scaled_glyph_index(scaled_glyph),
-				   load_flags | FT_LOAD_NO_BITMAP);
-	    /* XXX ignoring all other errors for now.  They are not fatal, typically
-	     * just a glyph-not-found. */
-	    if (error == FT_Err_Out_Of_Memory) {
-		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    status = _cairo_ft_scaled_glyph_load (scaled_font, face,
+						  _cairo_scaled_glyph_index(scaled_glyph),
+						  load_flags | FT_LOAD_NO_BITMAP,
+						  vertical_layout);
+	    if (unlikely (status))
 		goto FAIL;
-	    }
-#if HAVE_FT_GLYPHSLOT_EMBOLDEN
-	    if (scaled_font->ft_options.synth_flags & CAIRO_FT_SYNTHESIZE_BOLD)
-		FT_GlyphSlot_Embolden (glyph);
-#endif
-#if HAVE_FT_GLYPHSLOT_OBLIQUE
-	    if (scaled_font->ft_options.synth_flags & CAIRO_FT_SYNTHESIZE_OBLIQUE)
-		FT_GlyphSlot_Oblique (glyph);
-#endif
-	    if (vertical_layout)
-		_cairo_ft_scaled_glyph_vertical_layout_bearing_fix (scaled_font, glyph);
-
 	}
 	if (glyph->format == FT_GLYPH_FORMAT_OUTLINE)
 	    status = _decompose_glyph_outline (face, &scaled_font->ft_options.base,
@@ -2355,6 +2385,197 @@ _cairo_ft_scaled_glyph_init (void			*abstract_font,
     return status;
 }
 
+/* Rasterising a large run of new glyphs, such as the first page of
+ * CJK text, is dominated by FreeType.  An FT_Face may only be used by
+ * one thread at a time, so each worker opens a face of its own on the
+ * font file, with its own FT_Library, sets it to the scale already
+ * computed for the shared face and renders a contiguous slice of the
+ * glyphs.  The worker faces are closed again once the batch is done,
+ * so that they only briefly add to the MAX_OPEN_FACES kept open by the
+ * font map, but the libraries are kept by the font map for the next
+ * batch.  Faces supplied by the user are not batched, as a face of
+ * ours would not share the settings of the user's library.  Anything
+ * a worker fails to render is left for _cairo_ft_scaled_glyph_init().
+ */
+#define FT_GLYPHS_PER_WORKER 16
+
+typedef struct _cairo_ft_glyph_batch {
+    cairo_ft_scaled_font_t *scaled_font;
+    FT_Library libraries[FT_MAX_WORKER_FACES];
+    cairo_scaled_glyph_t **scaled_glyphs;
+    cairo_image_surface_t **surfaces;
+    int num_glyphs;
+    int num_tasks;
+    int load_flags;
+    cairo_bool_t vertical_layout;
+} cairo_ft_glyph_batch_t;
+
+/* Take the libraries for the workers from those kept by the font map;
+ * any that are missing are created by the workers themselves. */
+static void
+_cairo_ft_glyph_batch_get_libraries (cairo_ft_glyph_batch_t *batch)
+{
+    cairo_ft_unscaled_font_map_t *font_map;
+    int i;
+
+    memset (batch->libraries, 0, sizeof (batch->libraries));
+
+    font_map = _cairo_ft_unscaled_font_map_lock ();
+    if (font_map == NULL)
+	return;
+
+    for (i = 0; i < batch->num_tasks && font_map->num_worker_libraries; i++)
+	batch->libraries[i] = font_map->worker_libraries[--font_map->num_worker_libraries];
+
+    _cairo_ft_unscaled_font_map_unlock ();
+}
+
+static void
+_cairo_ft_glyph_batch_put_libraries (cairo_ft_glyph_batch_t *batch)
+{
+    cairo_ft_unscaled_font_map_t *font_map;
+    int i;
+
+    font_map = _cairo_ft_unscaled_font_map_lock ();
+    for (i = 0; i < batch->num_tasks; i++) {
+	if (batch->libraries[i] == NULL)
+	    continue;
+
+	if (font_map != NULL &&
+	    font_map->num_worker_libraries < FT_MAX_WORKER_FACES)
+	{
+	    font_map->worker_libraries[font_map->num_worker_libraries++] =
+		batch->libraries[i];
+	}
+	else
+	{
+	    FT_Done_FreeType (batch->libraries[i]);
+	}
+    }
+    if (font_map != NULL)
+	_cairo_ft_unscaled_font_map_unlock ();
+}
+
+static void
+_cairo_ft_glyph_batch_render (void *closure, int task)
+{
+    cairo_ft_glyph_batch_t *batch = closure;
+    cairo_ft_scaled_font_t *scaled_font = batch->scaled_font;
+    cairo_ft_unscaled_font_t *unscaled = scaled_font->unscaled;
+    FT_Matrix shape = unscaled->Current_Shape;
+    FT_Library *library = &batch->libraries[task];
+    FT_Face face;
+    int first, last, i;
+
+    first = (long) batch->num_glyphs * task / batch->num_tasks;
+    last = (long) batch->num_glyphs * (task + 1) / batch->num_tasks;
+
+    if (*library == NULL && FT_Init_FreeType (library) != FT_Err_Ok) {
+	*library = NULL;
+	return;
+    }
+
+    if (FT_New_Face (*library,
+		     unscaled->filename, unscaled->id,
+		     &face) != FT_Err_Ok)
+	return;
+
+    FT_Set_Transform (face, &shape, NULL);
+    if (FT_Set_Char_Size (face,
+			  unscaled->x_scale * 64.0 + .5,
+			  unscaled->y_scale * 64.0 + .5,
+			  0, 0) != FT_Err_Ok)
+    {
+	FT_Done_Face (face);
+	return;
+    }
+
+    for (i = first; i < last; i++) {
+	unsigned long index = _cairo_scaled_glyph_index (batch->scaled_glyphs[i]);
+	cairo_status_t status;
+
+	status = _cairo_ft_scaled_glyph_load (scaled_font, face, index,
+					      batch->load_flags,
+					      batch->vertical_layout);
+	if (likely (status == CAIRO_STATUS_SUCCESS))
+	    status = _cairo_ft_scaled_glyph_render (scaled_font, face,
+						    &batch->surfaces[i]);
+	if (unlikely (status))
+	    batch->surfaces[i] = NULL;
+    }
+
+    FT_Done_Face (face);
+}
+
+static cairo_int_status_t
+_cairo_ft_scaled_glyphs_init_surfaces (void			 *abstract_font,
+				       cairo_scaled_glyph_t	**scaled_glyphs,
+				       int			  num_glyphs,
+				       int			  num_threads)
+{
+    cairo_ft_scaled_font_t *scaled_font = abstract_font;
+    cairo_ft_unscaled_font_t *unscaled = scaled_font->unscaled;
+    cairo_ft_glyph_batch_t batch;
+    cairo_status_t status;
+    FT_Face face;
+    int i;
+
+    batch.num_tasks = MIN (num_threads, num_glyphs / FT_GLYPHS_PER_WORKER);
+    batch.num_tasks = MIN (batch.num_tasks, FT_MAX_WORKER_FACES);
+    if (batch.num_tasks < 2)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (unscaled->from_face)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    /* Holding the shared face keeps its scale, which the workers copy,
+     * fixed until they are done.
+     */
+    face = _cairo_ft_unscaled_font_lock_face (unscaled);
+    if (!face)
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    batch.surfaces = calloc (num_glyphs, sizeof (cairo_image_surface_t *));
+    if (unlikely (batch.surfaces == NULL)) {
+	_cairo_ft_unscaled_font_unlock_face (unscaled);
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    batch.scaled_font = scaled_font;
+    batch.scaled_glyphs = scaled_glyphs;
+    batch.num_glyphs = num_glyphs;
+
+    /* As _cairo_ft_scaled_glyph_init() would for INFO_SURFACE alone */
+    batch.load_flags = scaled_font->ft_options.load_flags;
+    batch.load_flags |= FT_LOAD_IGNORE_GLOBAL_ADVANCE_WIDTH;
+    batch.vertical_layout = FALSE;
+    if (batch.load_flags & FT_LOAD_VERTICAL_LAYOUT) {
+	batch.load_flags &= ~FT_LOAD_VERTICAL_LAYOUT;
+	batch.vertical_layout = TRUE;
+    }
+
+    status = _cairo_ft_unscaled_font_set_scale (unscaled,
+						&scaled_font->base.scale);
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	_cairo_ft_glyph_batch_get_libraries (&batch);
+	_cairo_parallel_for (batch.num_tasks, batch.num_tasks,
+			     _cairo_ft_glyph_batch_render, &batch);
+	_cairo_ft_glyph_batch_put_libraries (&batch);
+    }
+
+    _cairo_ft_unscaled_font_unlock_face (unscaled);
+
+    for (i = 0; i < num_glyphs; i++) {
+	if (batch.surfaces[i] != NULL)
+	    _cairo_scaled_glyph_set_surface (scaled_glyphs[i],
+					     &scaled_font->base,
+					     batch.surfaces[i]);
+    }
+
+    free (batch.surfaces);
+    return status;
+}
+
 static unsigned long
 _cairo_ft_ucs4_to_index (void	    *abstract_font,
 			 uint32_t    ucs4)
@@ -2603,7 +2824,8 @@ static const cairo_scaled_font_backend_t _cairo_ft_scaled_font_backend = {
     _cairo_ft_index_to_ucs4,
     _cairo_ft_is_synthetic,
     _cairo_index_to_glyph_name,
-    _cairo_ft_load_type1_data
+    _cairo_ft_load_type1_data,
+    _cairo_ft_scaled_glyphs_init_surfaces
 };
 
 /* #cairo_ft_font_face_t */
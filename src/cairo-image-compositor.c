@@ -48,6 +48,7 @@
 #include "cairo-compositor-private.h"
 #include "cairo-spans-compositor-private.h"
 
+#include "cairo-parallel-private.h"
 #include "cairo-region-private.h"
 #include "cairo-traps-private.h"
 #include "cairo-tristrip-private.h"
@@ -760,30 +761,187 @@ check_composite_glyphs (const cairo_composite_rectangles_t *extents,
 }
 
 #if HAS_PIXMAN_GLYPHS
-static pixman_glyph_cache_t *global_glyph_cache;
+/* The pixman glyph cache is not thread-safe, so rather than one global
+ * cache behind one lock we keep a cache per shard of scaled fonts.
+ * Compositing glyphs already holds the scaled font's own lock, so
+ * threads only contend here when drawing with the same font.
+ */
+#define GLYPH_CACHE_SHARDS 8
+
+/* pixman starts discarding glyphs by itself beyond 16384 per cache, which
+ * we cannot observe, so our own limit stays below that and is divided
+ * between the shards to keep the total of a single global cache. When a
+ * shard exceeds its limit, or its memory budget, its pixman cache is
+ * dropped wholesale and refilled. composite_glyphs() keeps using the
+ * cache whilst it drops the shard's mutex to render new glyphs, so whilst
+ * the cache is in use by any thread, dropping it is postponed until the
+ * last user has finished.
+ */
+#define GLYPH_CACHE_MAX_GLYPHS_PER_SHARD (16384 / GLYPH_CACHE_SHARDS)
+
+static struct glyph_cache_shard {
+    pixman_glyph_cache_t *cache;
+    cairo_mutex_t *mutex;
+    unsigned long max_bytes;
+    int frozen;
+    cairo_bool_t flush_pending;
+
+    unsigned long num_glyphs;
+    unsigned long bytes;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} global_glyph_cache[GLYPH_CACHE_SHARDS] = {
+#define GLYPH_CACHE_SHARD(n) \
+    { NULL, &_cairo_glyph_cache_mutex_##n, ULONG_MAX }
+    GLYPH_CACHE_SHARD (0),
+    GLYPH_CACHE_SHARD (1),
+    GLYPH_CACHE_SHARD (2),
+    GLYPH_CACHE_SHARD (3),
+    GLYPH_CACHE_SHARD (4),
+    GLYPH_CACHE_SHARD (5),
+    GLYPH_CACHE_SHARD (6),
+    GLYPH_CACHE_SHARD (7),
+#undef GLYPH_CACHE_SHARD
+};
+
+static inline struct glyph_cache_shard *
+get_glyph_cache_shard (cairo_scaled_font_t *scaled_font)
+{
+    return &global_glyph_cache[
+	_cairo_scaled_font_cache_shard (scaled_font, GLYPH_CACHE_SHARDS)];
+}
+
+static unsigned long
+glyph_surface_bytes (const cairo_image_surface_t *surface)
+{
+    return surface ? (unsigned long) surface->stride * surface->height : 0;
+}
+
+static void
+flush_glyph_cache (struct glyph_cache_shard *shard)
+{
+    if (shard->frozen) {
+	shard->flush_pending = TRUE;
+	return;
+    }
+
+    shard->flush_pending = FALSE;
+    if (shard->cache) {
+	pixman_glyph_cache_destroy (shard->cache);
+	shard->cache = NULL;
+    }
+
+    shard->evictions += shard->num_glyphs;
+    shard->num_glyphs = 0;
+    shard->bytes = 0;
+}
 
 static inline pixman_glyph_cache_t *
-get_glyph_cache (void)
+get_glyph_cache (struct glyph_cache_shard *shard)
 {
-    if (!global_glyph_cache)
-	global_glyph_cache = pixman_glyph_cache_create ();
+    if (shard->num_glyphs > GLYPH_CACHE_MAX_GLYPHS_PER_SHARD ||
+	shard->bytes > shard->max_bytes)
+	flush_glyph_cache (shard);
+
+    if (!shard->cache)
+	shard->cache = pixman_glyph_cache_create ();
+
+    return shard->cache;
+}
+
+static void
+freeze_glyph_cache (struct glyph_cache_shard *shard)
+{
+    pixman_glyph_cache_freeze (shard->cache);
+    shard->frozen++;
+}
 
-    return global_glyph_cache;
+static void
+thaw_glyph_cache (struct glyph_cache_shard *shard)
+{
+    pixman_glyph_cache_thaw (shard->cache);
+    if (--shard->frozen == 0 && shard->flush_pending)
+	flush_glyph_cache (shard);
 }
 
 void
 _cairo_image_scaled_glyph_fini (cairo_scaled_font_t *scaled_font,
 				cairo_scaled_glyph_t *scaled_glyph)
 {
-    CAIRO_MUTEX_LOCK (_cairo_glyph_cache_mutex);
+    struct glyph_cache_shard *shard = get_glyph_cache_shard (scaled_font);
+    void *index = (void *)_cairo_scaled_glyph_index (scaled_glyph);
+
+    CAIRO_MUTEX_LOCK (*shard->mutex);
+
+    if (shard->cache &&
+	pixman_glyph_cache_lookup (shard->cache, scaled_font, index))
+    {
+	unsigned long bytes = glyph_surface_bytes (scaled_glyph->surface);
 
-    if (global_glyph_cache) {
-	pixman_glyph_cache_remove (
-	    global_glyph_cache, scaled_font,
-	    (void *)_cairo_scaled_glyph_index (scaled_glyph));
+	pixman_glyph_cache_remove (shard->cache, scaled_font, index);
+	shard->num_glyphs--;
+	shard->bytes -= MIN (bytes, shard->bytes);
     }
 
-    CAIRO_MUTEX_UNLOCK (_cairo_glyph_cache_mutex);
+    CAIRO_MUTEX_UNLOCK (*shard->mutex);
+}
+
+void
+_cairo_image_glyph_cache_set_max_bytes (unsigned long max_bytes)
+{
+    int i;
+
+    if (max_bytes != ULONG_MAX)
+	max_bytes = (max_bytes + GLYPH_CACHE_SHARDS - 1) / GLYPH_CACHE_SHARDS;
+
+    for (i = 0; i < GLYPH_CACHE_SHARDS; i++) {
+	struct glyph_cache_shard *shard = &global_glyph_cache[i];
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	shard->max_bytes = max_bytes;
+	if (shard->bytes > max_bytes)
+	    flush_glyph_cache (shard);
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+    }
+}
+
+void
+_cairo_image_compositor_reset_static_data (void)
+{
+    int i;
+
+    for (i = 0; i < GLYPH_CACHE_SHARDS; i++) {
+	struct glyph_cache_shard *shard = &global_glyph_cache[i];
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	flush_glyph_cache (shard);
+	shard->hits = shard->misses = shard->evictions = 0;
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+    }
+}
+
+void
+_cairo_image_glyph_cache_get_statistics (cairo_font_cache_statistics_t *statistics)
+{
+    int i;
+
+    memset (statistics, 0, sizeof (cairo_font_cache_statistics_t));
+    for (i = 0; i < GLYPH_CACHE_SHARDS; i++) {
+	struct glyph_cache_shard *shard = &global_glyph_cache[i];
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	statistics->hits += shard->hits;
+	statistics->misses += shard->misses;
+	statistics->evictions += shard->evictions;
+	statistics->entries += shard->num_glyphs;
+	if (shard->max_bytes == ULONG_MAX || statistics->max_bytes == ULONG_MAX)
+	    statistics->max_bytes = ULONG_MAX;
+	else
+	    statistics->max_bytes += shard->max_bytes;
+	statistics->bytes += shard->bytes;
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+    }
 }
 
 static cairo_int_status_t
@@ -797,23 +955,38 @@ composite_glyphs (void				*_dst,
 		  cairo_composite_glyphs_info_t *info)
 {
     cairo_int_status_t status = CAIRO_INT_STATUS_SUCCESS;
+    struct glyph_cache_shard *shard;
     pixman_glyph_cache_t *glyph_cache;
     pixman_glyph_t pglyphs_stack[CAIRO_STACK_ARRAY_LENGTH (pixman_glyph_t)];
     pixman_glyph_t *pglyphs = pglyphs_stack;
     pixman_glyph_t *pg;
+    int num_threads;
     int i;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
 
-    CAIRO_MUTEX_LOCK (_cairo_glyph_cache_mutex);
+    /* Render any new glyphs concurrently before looking them up */
+    num_threads = to_image_surface (_dst)->num_threads;
+    if (num_threads > 1) {
+	num_threads = MIN (num_threads, _cairo_parallel_num_cpus ());
+	status = _cairo_scaled_font_prepare_glyph_surfaces (info->font,
+							    info->glyphs,
+							    info->num_glyphs,
+							    num_threads);
+	if (unlikely (status))
+	    return status;
+    }
+
+    shard = get_glyph_cache_shard (info->font);
+    CAIRO_MUTEX_LOCK (*shard->mutex);
 
-    glyph_cache = get_glyph_cache();
+    glyph_cache = get_glyph_cache (shard);
     if (unlikely (glyph_cache == NULL)) {
 	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 	goto out_unlock;
     }
 
-    pixman_glyph_cache_freeze (glyph_cache);
+    freeze_glyph_cache (shard);
 
     if (info->num_glyphs > ARRAY_LENGTH (pglyphs_stack)) {
 	pglyphs = _cairo_malloc_ab (info->num_glyphs, sizeof (pixman_glyph_t));
@@ -829,18 +1002,20 @@ composite_glyphs (void				*_dst,
 	const void *glyph;
 
 	glyph = pixman_glyph_cache_lookup (glyph_cache, info->font, (void *)index);
-	if (!glyph) {
+	if (glyph) {
+	    shard->hits++;
+	} else {
 	    cairo_scaled_glyph_t *scaled_glyph;
 	    cairo_image_surface_t *glyph_surface;
 
 	    /* This call can actually end up recursing, so we have to
 	     * drop the mutex around it.
 	     */
-	    CAIRO_MUTEX_UNLOCK (_cairo_glyph_cache_mutex);
+	    CAIRO_MUTEX_UNLOCK (*shard->mutex);
 	    status = _cairo_scaled_glyph_lookup (info->font, index,
 						 CAIRO_SCALED_GLYPH_INFO_SURFACE,
 						 &scaled_glyph);
-	    CAIRO_MUTEX_LOCK (_cairo_glyph_cache_mutex);
+	    CAIRO_MUTEX_LOCK (*shard->mutex);
 
 	    if (unlikely (status))
 		goto out_thaw;
@@ -854,6 +1029,10 @@ composite_glyphs (void				*_dst,
 		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 		goto out_thaw;
 	    }
+
+	    shard->misses++;
+	    shard->num_glyphs++;
+	    shard->bytes += glyph_surface_bytes (glyph_surface);
 	}
 
 	pg->x = _cairo_lround (info->glyphs[i].x);
@@ -886,13 +1065,13 @@ composite_glyphs (void				*_dst,
     }
 
 out_thaw:
-    pixman_glyph_cache_thaw (glyph_cache);
+    thaw_glyph_cache (shard);
 
     if (pglyphs != pglyphs_stack)
 	free(pglyphs);
 
 out_unlock:
-    CAIRO_MUTEX_UNLOCK (_cairo_glyph_cache_mutex);
+    CAIRO_MUTEX_UNLOCK (*shard->mutex);
     return status;
 }
 #else
@@ -902,6 +1081,22 @@ _cairo_image_scaled_glyph_fini (cairo_scaled_font_t *scaled_font,
 {
 }
 
+void
+_cairo_image_glyph_cache_set_max_bytes (unsigned long max_bytes)
+{
+}
+
+void
+_cairo_image_glyph_cache_get_statistics (cairo_font_cache_statistics_t *statistics)
+{
+    memset (statistics, 0, sizeof (cairo_font_cache_statistics_t));
+}
+
+void
+_cairo_image_compositor_reset_static_data (void)
+{
+}
+
 static cairo_int_status_t
 composite_one_glyph (void				*_dst,
 		     cairo_operator_t			 op,
@@ -1192,6 +1387,12 @@ check_composite (const cairo_composite_rectangles_t *extents)
     return CAIRO_STATUS_SUCCESS;
 }
 
+static int
+renderer_threads (void *surface)
+{
+    return ((cairo_image_surface_t *) surface)->num_threads;
+}
+
 const cairo_compositor_t *
 _cairo_image_traps_compositor_get (void)
 {
@@ -1218,6 +1419,7 @@ _cairo_image_traps_compositor_get (void)
 	compositor.composite_tristrip = composite_tristrip;
 	compositor.check_composite_glyphs = check_composite_glyphs;
 	compositor.composite_glyphs = composite_glyphs;
+	compositor.renderer_threads = renderer_threads;
     }
 
     return &compositor.base;
@@ -1534,6 +1736,20 @@ typedef struct _cairo_image_span_renderer {
 	    int src_stride;
 	    uint8_t *src_data;
 	} blit;
+	struct gradient {
+	    int stride;
+	    uint8_t *data;
+	    const uint32_t *lut;
+	    uint32_t alpha; /* forced into the unused byte of RGB24 */
+	    cairo_extend_t extend;
+	    cairo_bool_t radial;
+	    /* t(x, y) = tx*x + ty*y + t0 for linear gradients; for
+	     * concentric radial gradients, t = (|m(x, y)| - r1) * inv_dr.
+	     */
+	    double tx, ty, t0;
+	    cairo_matrix_t m;
+	    double r1, inv_dr;
+	} gradient;
 	struct composite {
 	    pixman_image_t *dst;
 	    int src_x, src_y;
@@ -2395,6 +2611,216 @@ _blit_xrgb32_lerp_spans (void *abstract_renderer, int y, int h,
     return CAIRO_STATUS_SUCCESS;
 }
 
+/* Simple linear and concentric radial gradients are evaluated directly
+ * into the destination from a table of premultiplied colours, rather
+ * than asking pixman to generate a source scanline for every span.
+ * The table is sampled at GRADIENT_LUT_SIZE evenly spaced offsets and
+ * adjacent entries are interpolated with 8 bits of precision, so the
+ * result may differ slightly from pixman's.  It is therefore only used
+ * if the pattern asks for CAIRO_FILTER_FAST, and gradients with stops
+ * closer together than a table step are left to pixman regardless.
+ */
+#define GRADIENT_LUT_SIZE 256
+COMPILE_TIME_ASSERT (SZ_BUF >= GRADIENT_LUT_SIZE * sizeof (uint32_t));
+
+static uint32_t
+_gradient_color_to_pixel (double a, double r, double g, double b)
+{
+    uint32_t pixel;
+
+    pixel  = (uint32_t) (a * 255. + .5) << 24;
+    pixel |= (uint32_t) (r * a * 255. + .5) << 16;
+    pixel |= (uint32_t) (g * a * 255. + .5) << 8;
+    pixel |= (uint32_t) (b * a * 255. + .5);
+    return pixel;
+}
+
+static cairo_bool_t
+_gradient_lut_init (uint32_t *lut, const cairo_gradient_pattern_t *gradient)
+{
+    const cairo_gradient_stop_t *stops = gradient->stops;
+    unsigned int n = gradient->n_stops;
+    unsigned int i, j;
+
+    if (n < 2)
+	return FALSE;
+
+    /* Hard or very tight transitions would be smeared by the table. */
+    for (j = 1; j < n; j++) {
+	if (stops[j].offset - stops[j-1].offset < 1. / (GRADIENT_LUT_SIZE - 1))
+	    return FALSE;
+    }
+
+    /* Interpolate the unpremultiplied colours as pixman does, and
+     * premultiply the result.
+     */
+    for (i = j = 0; i < GRADIENT_LUT_SIZE; i++) {
+	double t = i / (double) (GRADIENT_LUT_SIZE - 1);
+	const cairo_color_stop_t *c0, *c1;
+	double f;
+
+	while (j < n && stops[j].offset <= t)
+	    j++;
+
+	if (j == 0) {
+	    c0 = c1 = &stops[0].color;
+	    f = 0;
+	} else if (j == n) {
+	    c0 = c1 = &stops[n-1].color;
+	    f = 0;
+	} else {
+	    c0 = &stops[j-1].color;
+	    c1 = &stops[j].color;
+	    f = (t - stops[j-1].offset) / (stops[j].offset - stops[j-1].offset);
+	}
+
+	lut[i] = _gradient_color_to_pixel (c0->alpha + f * (c1->alpha - c0->alpha),
+					   c0->red   + f * (c1->red   - c0->red),
+					   c0->green + f * (c1->green - c0->green),
+					   c0->blue  + f * (c1->blue  - c0->blue));
+    }
+
+    return TRUE;
+}
+
+static inline uint32_t
+_gradient_pixel (const struct gradient *g, double t)
+{
+    int s, i, f;
+
+    switch (g->extend) {
+    case CAIRO_EXTEND_NONE:
+	if (t < 0. || t > 1.)
+	    return 0;
+	break;
+    case CAIRO_EXTEND_REPEAT:
+	t -= floor (t);
+	break;
+    case CAIRO_EXTEND_REFLECT:
+	t = fabs (t);
+	t -= 2 * floor (t * .5);
+	if (t > 1.)
+	    t = 2. - t;
+	break;
+    default:
+    case CAIRO_EXTEND_PAD:
+	if (t < 0.)
+	    t = 0.;
+	else if (t > 1.)
+	    t = 1.;
+	break;
+    }
+
+    s = t * ((GRADIENT_LUT_SIZE - 1) << 8);
+    i = s >> 8;
+    f = s & 0xff;
+    if (f == 0)
+	return g->lut[i];
+
+    return lerp8x4 (g->lut[i+1], f, g->lut[i]);
+}
+
+static void
+_gradient_xrgb32_lerp_row (const struct gradient *g,
+			   uint32_t *d, int x, int y, int len, uint8_t a)
+{
+    double px = x + .5, py = y + .5;
+
+    if (g->radial) {
+	double u = g->m.xx * px + g->m.xy * py + g->m.x0;
+	double v = g->m.yx * px + g->m.yy * py + g->m.y0;
+
+	while (len--) {
+	    uint32_t p = _gradient_pixel (g, (sqrt (u*u + v*v) - g->r1) * g->inv_dr) | g->alpha;
+	    *d = a == 0xff ? p : lerp8x4 (p, a, *d);
+	    d++;
+	    u += g->m.xx;
+	    v += g->m.yx;
+	}
+    } else {
+	double t = g->tx * px + g->ty * py + g->t0;
+
+	while (len--) {
+	    uint32_t p = _gradient_pixel (g, t) | g->alpha;
+	    *d = a == 0xff ? p : lerp8x4 (p, a, *d);
+	    d++;
+	    t += g->tx;
+	}
+    }
+}
+
+static cairo_status_t
+_gradient_xrgb32_lerp_spans (void *abstract_renderer, int y, int h,
+			     const cairo_half_open_span_t *spans, unsigned num_spans)
+{
+    cairo_image_span_renderer_t *r = abstract_renderer;
+
+    if (num_spans == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    do {
+	uint8_t a = mul8_8 (spans[0].coverage, r->bpp);
+	if (a) {
+	    int yy = y, hh = h;
+	    do {
+		uint32_t *d = (uint32_t *)(r->u.gradient.data + yy*r->u.gradient.stride + spans[0].x * 4);
+		_gradient_xrgb32_lerp_row (&r->u.gradient, d, spans[0].x, yy,
+					   spans[1].x - spans[0].x, a);
+		yy++;
+	    } while (--hh);
+	}
+	spans++;
+    } while (--num_spans > 1);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_bool_t
+_gradient_renderer_init (cairo_image_span_renderer_t *r,
+			 const cairo_gradient_pattern_union_t *gradient)
+{
+    struct gradient *g = &r->u.gradient;
+    const cairo_matrix_t *m = &gradient->base.base.matrix;
+
+    if (gradient->base.base.type == CAIRO_PATTERN_TYPE_LINEAR) {
+	double dx = gradient->linear.pd2.x - gradient->linear.pd1.x;
+	double dy = gradient->linear.pd2.y - gradient->linear.pd1.y;
+	double l2 = dx * dx + dy * dy;
+
+	if (l2 == 0.)
+	    return FALSE;
+
+	/* The pattern matrix maps device space onto the gradient. */
+	g->radial = FALSE;
+	g->tx = (m->xx * dx + m->yx * dy) / l2;
+	g->ty = (m->xy * dx + m->yy * dy) / l2;
+	g->t0 = ((m->x0 - gradient->linear.pd1.x) * dx +
+		 (m->y0 - gradient->linear.pd1.y) * dy) / l2;
+    } else {
+	const cairo_circle_double_t *c1 = &gradient->radial.cd1;
+	const cairo_circle_double_t *c2 = &gradient->radial.cd2;
+
+	if (c1->center.x != c2->center.x ||
+	    c1->center.y != c2->center.y ||
+	    c1->radius == c2->radius)
+	    return FALSE;
+
+	g->radial = TRUE;
+	g->m = *m;
+	g->m.x0 -= c1->center.x;
+	g->m.y0 -= c1->center.y;
+	g->r1 = c1->radius;
+	g->inv_dr = 1. / (c2->radius - c1->radius);
+    }
+
+    if (! _gradient_lut_init ((uint32_t *) r->_buf, &gradient->base))
+	return FALSE;
+
+    g->lut = (uint32_t *) r->_buf;
+    g->extend = gradient->base.base.extend;
+    return TRUE;
+}
+
 static cairo_status_t
 _inplace_spans (void *abstract_renderer,
 		int y, int h,
@@ -2821,6 +3247,22 @@ inplace_renderer_init (cairo_image_span_renderer_t	*r,
 	    r->u.blit.src_data = src->data + src->stride * ty + tx * 4;
 	    r->base.render_rows = _blit_xrgb32_lerp_spans;
 	}
+    } else if ((dst->format == CAIRO_FORMAT_ARGB32 || dst->format == CAIRO_FORMAT_RGB24) &&
+	       (composite->source_pattern.base.type == CAIRO_PATTERN_TYPE_LINEAR ||
+		composite->source_pattern.base.type == CAIRO_PATTERN_TYPE_RADIAL) &&
+	       composite->source_pattern.base.filter == CAIRO_FILTER_FAST &&
+	       (composite->op == CAIRO_OPERATOR_SOURCE ||
+		(composite->op == CAIRO_OPERATOR_OVER &&
+		 (dst->base.is_clear ||
+		  _cairo_pattern_is_opaque (&composite->source_pattern.base,
+					    &composite->source_sample_area)))))
+    {
+	if (_gradient_renderer_init (r, &composite->source_pattern.gradient)) {
+	    r->u.gradient.stride = dst->stride;
+	    r->u.gradient.data = dst->data;
+	    r->u.gradient.alpha = dst->format == CAIRO_FORMAT_RGB24 ? 0xff000000 : 0;
+	    r->base.render_rows = _gradient_xrgb32_lerp_spans;
+	}
     }
     if (r->base.render_rows == NULL) {
 	const cairo_pattern_t *src = &composite->source_pattern.base;
@@ -3081,6 +3523,7 @@ _cairo_image_spans_compositor_get (void)
 	//spans.check_span_renderer = check_span_renderer;
 	spans.renderer_init = span_renderer_init;
 	spans.renderer_fini = span_renderer_fini;
+	spans.renderer_threads = renderer_threads;
     }
 
     return &spans.base;
@@ -263,6 +263,155 @@ UNLOCK:
     return image;
 }
 
+/* Gradient images are cached much like solid colors, keyed on the
+ * stops, extend mode and geometry of the gradient. The pixman
+ * transform is part of the image, so it is compared separately when
+ * looking up an entry rather than being folded into the hash; the
+ * offset at which the image is sampled is not part of the key at all.
+ * The cached images are never modified once they have been inserted.
+ */
+typedef struct _cairo_image_gradient_key {
+    unsigned long hash;
+    cairo_pattern_type_t type;
+    cairo_extend_t extend;
+    pixman_point_fixed_t p1, p2;
+    pixman_fixed_t r1, r2;
+    unsigned int n_stops;
+    pixman_gradient_stop_t *stops;
+    cairo_bool_t has_transform;
+    pixman_transform_t transform;
+} cairo_image_gradient_key_t;
+
+#if PIXMAN_HAS_ATOMIC_OPS
+#define GRADIENT_CACHE_SIZE 32
+
+static struct {
+    cairo_image_gradient_key_t key;
+    pixman_image_t *image;
+    unsigned int last_used;
+} gradient_cache[GRADIENT_CACHE_SIZE];
+static int n_gradients_cached;
+static unsigned int gradient_cache_clock;
+static unsigned long gradient_cache_hits, gradient_cache_misses;
+
+static void
+_cairo_image_gradient_key_init_hash (cairo_image_gradient_key_t *key)
+{
+    int32_t geometry[8];
+    unsigned long hash;
+
+    geometry[0] = key->type;
+    geometry[1] = key->extend;
+    geometry[2] = key->p1.x;
+    geometry[3] = key->p1.y;
+    geometry[4] = key->p2.x;
+    geometry[5] = key->p2.y;
+    geometry[6] = key->r1;
+    geometry[7] = key->r2;
+
+    hash = _cairo_hash_bytes (_CAIRO_HASH_INIT_VALUE,
+			      geometry, sizeof (geometry));
+    key->hash = _cairo_hash_bytes (hash, key->stops,
+				   key->n_stops * sizeof (pixman_gradient_stop_t));
+}
+
+static cairo_bool_t
+_cairo_image_gradient_key_equal (const cairo_image_gradient_key_t *a,
+				 const cairo_image_gradient_key_t *b)
+{
+    if (a->hash != b->hash)
+	return FALSE;
+
+    if (a->type != b->type || a->extend != b->extend)
+	return FALSE;
+
+    if (a->p1.x != b->p1.x || a->p1.y != b->p1.y ||
+	a->p2.x != b->p2.x || a->p2.y != b->p2.y ||
+	a->r1 != b->r1 || a->r2 != b->r2)
+	return FALSE;
+
+    if (a->has_transform != b->has_transform)
+	return FALSE;
+
+    if (a->has_transform &&
+	memcmp (&a->transform, &b->transform, sizeof (pixman_transform_t)))
+	return FALSE;
+
+    return a->n_stops == b->n_stops &&
+	memcmp (a->stops, b->stops,
+		a->n_stops * sizeof (pixman_gradient_stop_t)) == 0;
+}
+
+static pixman_image_t *
+_cairo_image_gradient_cache_lookup (const cairo_image_gradient_key_t *key)
+{
+    pixman_image_t *image = NULL;
+    int i;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    for (i = 0; i < n_gradients_cached; i++) {
+	if (_cairo_image_gradient_key_equal (&gradient_cache[i].key, key)) {
+	    gradient_cache[i].last_used = ++gradient_cache_clock;
+	    image = pixman_image_ref (gradient_cache[i].image);
+	    break;
+	}
+    }
+    if (image != NULL)
+	gradient_cache_hits++;
+    else
+	gradient_cache_misses++;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+
+    return image;
+}
+
+static void
+_cairo_image_gradient_cache_insert (const cairo_image_gradient_key_t *key,
+				    pixman_image_t *image)
+{
+    pixman_gradient_stop_t *stops;
+    int i;
+
+    stops = _cairo_malloc_ab (key->n_stops, sizeof (pixman_gradient_stop_t));
+    if (unlikely (stops == NULL))
+	return;
+    memcpy (stops, key->stops, key->n_stops * sizeof (pixman_gradient_stop_t));
+
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    if (n_gradients_cached < ARRAY_LENGTH (gradient_cache)) {
+	i = n_gradients_cached++;
+    } else {
+	int j;
+
+	/* Evict the least recently used entry. */
+	for (i = 0, j = 1; j < n_gradients_cached; j++) {
+	    if (gradient_cache[j].last_used < gradient_cache[i].last_used)
+		i = j;
+	}
+	pixman_image_unref (gradient_cache[i].image);
+	free (gradient_cache[i].key.stops);
+    }
+    gradient_cache[i].key = *key;
+    gradient_cache[i].key.stops = stops;
+    gradient_cache[i].image = pixman_image_ref (image);
+    gradient_cache[i].last_used = ++gradient_cache_clock;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+}
+#endif
+
+void
+_cairo_image_gradient_cache_get_statistics (unsigned long *hits,
+					    unsigned long *misses)
+{
+#if PIXMAN_HAS_ATOMIC_OPS
+    CAIRO_MUTEX_LOCK (_cairo_image_gradient_cache_mutex);
+    *hits = gradient_cache_hits;
+    *misses = gradient_cache_misses;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_gradient_cache_mutex);
+#else
+    *hits = *misses = 0;
+#endif
+}
 
 void
 _cairo_image_reset_static_data (void)
@@ -271,6 +420,13 @@ _cairo_image_reset_static_data (void)
     while (n_cached)
 	pixman_image_unref (cache[--n_cached].image);
 
+    while (n_gradients_cached) {
+	n_gradients_cached--;
+	pixman_image_unref (gradient_cache[n_gradients_cached].image);
+	free (gradient_cache[n_gradients_cached].key.stops);
+    }
+    gradient_cache_hits = gradient_cache_misses = 0;
+
     if (__pixman_transparent_image) {
 	pixman_image_unref (__pixman_transparent_image);
 	__pixman_transparent_image = NULL;
@@ -288,18 +444,48 @@ _cairo_image_reset_static_data (void)
 #endif
 }
 
+/* Rewrite transform and offset so that the transform takes the point
+ * (x, y) as its origin, in which pixman's rounding of the transform is
+ * corrected. The translation is then the position of that point in
+ * pattern space, so the same image serves a gradient moved by whole
+ * pixels along with what it is drawn upon. Every pixel is sampled
+ * exactly as before, since moving the origin by whole pixels adds exact
+ * multiples of the linear part to the translation.
+ */
+static void
+_pixman_transform_move_origin (pixman_transform_t *transform,
+			       int x, int y,
+			       int *ix, int *iy)
+{
+    int64_t tx, ty;
+
+    tx = transform->matrix[0][2] +
+	 (int64_t) transform->matrix[0][0] * x +
+	 (int64_t) transform->matrix[0][1] * y;
+    ty = transform->matrix[1][2] +
+	 (int64_t) transform->matrix[1][0] * x +
+	 (int64_t) transform->matrix[1][1] * y;
+    if (tx != (pixman_fixed_t) tx || ty != (pixman_fixed_t) ty)
+	return;
+
+    transform->matrix[0][2] = tx;
+    transform->matrix[1][2] = ty;
+    *ix -= x;
+    *iy -= y;
+}
+
 static pixman_image_t *
 _pixman_image_for_gradient (const cairo_gradient_pattern_t *pattern,
 			    const cairo_rectangle_int_t *extents,
 			    int *ix, int *iy)
 {
-    pixman_image_t	  *pixman_image;
+    pixman_image_t	  *pixman_image = NULL;
     pixman_gradient_stop_t pixman_stops_static[2];
     pixman_gradient_stop_t *pixman_stops = pixman_stops_static;
-    pixman_transform_t      pixman_transform;
+    cairo_image_gradient_key_t key;
     cairo_matrix_t matrix;
     cairo_circle_double_t extremes[2];
-    pixman_point_fixed_t p1, p2;
+    double xc, yc;
     unsigned int i;
     cairo_int_status_t status;
 
@@ -322,44 +508,65 @@ _pixman_image_for_gradient (const cairo_gradient_pattern_t *pattern,
 
     _cairo_gradient_pattern_fit_to_range (pattern, PIXMAN_MAX_INT >> 1, &matrix, extremes);
 
-    p1.x = _cairo_fixed_16_16_from_double (extremes[0].center.x);
-    p1.y = _cairo_fixed_16_16_from_double (extremes[0].center.y);
-    p2.x = _cairo_fixed_16_16_from_double (extremes[1].center.x);
-    p2.y = _cairo_fixed_16_16_from_double (extremes[1].center.y);
+    key.type = pattern->base.type;
+    key.extend = pattern->base.extend;
+    key.stops = pixman_stops;
+    key.n_stops = pattern->n_stops;
 
+    key.p1.x = _cairo_fixed_16_16_from_double (extremes[0].center.x);
+    key.p1.y = _cairo_fixed_16_16_from_double (extremes[0].center.y);
+    key.p2.x = _cairo_fixed_16_16_from_double (extremes[1].center.x);
+    key.p2.y = _cairo_fixed_16_16_from_double (extremes[1].center.y);
     if (pattern->base.type == CAIRO_PATTERN_TYPE_LINEAR) {
-	pixman_image = pixman_image_create_linear_gradient (&p1, &p2,
-							    pixman_stops,
-							    pattern->n_stops);
+	key.r1 = key.r2 = 0;
     } else {
-	pixman_fixed_t r1, r2;
+	key.r1 = _cairo_fixed_16_16_from_double (extremes[0].radius);
+	key.r2 = _cairo_fixed_16_16_from_double (extremes[1].radius);
+    }
 
-	r1   = _cairo_fixed_16_16_from_double (extremes[0].radius);
-	r2   = _cairo_fixed_16_16_from_double (extremes[1].radius);
+    *ix = *iy = 0;
+    xc = extents->x + extents->width/2.;
+    yc = extents->y + extents->height/2.;
+    status = _cairo_matrix_to_pixman_matrix_offset (&matrix, pattern->base.filter,
+						    xc, yc,
+						    &key.transform, ix, iy);
+    if (status == CAIRO_INT_STATUS_NOTHING_TO_DO) {
+	key.has_transform = FALSE;
+	memset (&key.transform, 0, sizeof (key.transform));
+    } else if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	key.has_transform = TRUE;
+	_pixman_transform_move_origin (&key.transform, floor (xc), floor (yc),
+				       ix, iy);
+    } else
+	goto done;
 
-	pixman_image = pixman_image_create_radial_gradient (&p1, &p2, r1, r2,
+#if PIXMAN_HAS_ATOMIC_OPS
+    _cairo_image_gradient_key_init_hash (&key);
+    pixman_image = _cairo_image_gradient_cache_lookup (&key);
+    if (pixman_image != NULL)
+	goto done;
+#endif
+
+    if (pattern->base.type == CAIRO_PATTERN_TYPE_LINEAR) {
+	pixman_image = pixman_image_create_linear_gradient (&key.p1, &key.p2,
+							    pixman_stops,
+							    pattern->n_stops);
+    } else {
+	pixman_image = pixman_image_create_radial_gradient (&key.p1, &key.p2,
+							    key.r1, key.r2,
 							    pixman_stops,
 							    pattern->n_stops);
     }
 
-    if (pixman_stops != pixman_stops_static)
-	free (pixman_stops);
-
     if (unlikely (pixman_image == NULL))
-	return NULL;
+	goto done;
 
-    *ix = *iy = 0;
-    status = _cairo_matrix_to_pixman_matrix_offset (&matrix, pattern->base.filter,
-						    extents->x + extents->width/2.,
-						    extents->y + extents->height/2.,
-						    &pixman_transform, ix, iy);
-    if (status != CAIRO_INT_STATUS_NOTHING_TO_DO) {
-	if (unlikely (status != CAIRO_INT_STATUS_SUCCESS) ||
-	    ! pixman_image_set_transform (pixman_image, &pixman_transform))
-	{
-	    pixman_image_unref (pixman_image);
-	    return NULL;
-	}
+    if (key.has_transform &&
+	! pixman_image_set_transform (pixman_image, &key.transform))
+    {
+	pixman_image_unref (pixman_image);
+	pixman_image = NULL;
+	goto done;
     }
 
     {
@@ -384,6 +591,14 @@ _pixman_image_for_gradient (const cairo_gradient_pattern_t *pattern,
 	pixman_image_set_repeat (pixman_image, pixman_repeat);
     }
 
+#if PIXMAN_HAS_ATOMIC_OPS
+    _cairo_image_gradient_cache_insert (&key, pixman_image);
+#endif
+
+done:
+    if (pixman_stops != pixman_stops_static)
+	free (pixman_stops);
+
     return pixman_image;
 }
 
@@ -834,6 +1049,13 @@ _pixman_image_for_surface (cairo_image_surface_t *dst,
 
 	type = source->base.backend->type;
 	if (type == CAIRO_SURFACE_TYPE_IMAGE) {
+	    if (source->recording != NULL &&
+		unlikely (_cairo_image_surface_flush_deferred (source)))
+	    {
+		cairo_surface_destroy (defer_free);
+		return NULL;
+	    }
+
 	    if (extend != CAIRO_EXTEND_NONE &&
 		sample->x >= 0 &&
 		sample->y >= 0 &&
@@ -898,6 +1120,9 @@ _pixman_image_for_surface (cairo_image_surface_t *dst,
 
 	    sub = (cairo_surface_subsurface_t *) source;
 	    source = (cairo_image_surface_t *) sub->target;
+	    if (source->recording != NULL &&
+		unlikely (_cairo_image_surface_flush_deferred (source)))
+		return NULL;
 
 	    if (sample->x >= 0 &&
 		sample->y >= 0 &&
@@ -74,7 +74,14 @@ struct _cairo_image_surface {
     int stride;
     int depth;
 
+    int num_threads;
+
+    /* Drawing commands queued whilst in deferred mode, see
+     * cairo_image_surface_set_deferred(). */
+    cairo_surface_t *recording;
+
     unsigned owns_data : 1;
+    unsigned deferred : 1;
     unsigned transparency : 2;
     unsigned color : 2;
 };
@@ -201,9 +208,16 @@ _cairo_image_source_create_for_pattern (cairo_surface_t *dst,
 cairo_private cairo_status_t
 _cairo_image_surface_finish (void *abstract_surface);
 
+cairo_private cairo_status_t
+_cairo_image_surface_flush_deferred (cairo_image_surface_t *surface);
+
 cairo_private pixman_image_t *
 _pixman_image_for_color (const cairo_color_t *cairo_color);
 
+cairo_private void
+_cairo_image_gradient_cache_get_statistics (unsigned long *hits,
+					    unsigned long *misses);
+
 cairo_private pixman_image_t *
 _pixman_image_for_pattern (cairo_image_surface_t *dst,
 			   const cairo_pattern_t *pattern,
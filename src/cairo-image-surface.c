@@ -39,6 +39,7 @@
 
 #include "cairoint.h"
 
+#include "cairo-array-private.h"
 #include "cairo-boxes-private.h"
 #include "cairo-clip-private.h"
 #include "cairo-composite-rectangles-private.h"
@@ -47,6 +48,7 @@
 #include "cairo-error-private.h"
 #include "cairo-image-surface-inline.h"
 #include "cairo-paginated-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-pattern-private.h"
 #include "cairo-recording-surface-private.h"
 #include "cairo-region-private.h"
@@ -161,6 +163,9 @@ _cairo_image_surface_init (cairo_image_surface_t *surface,
     surface->height = pixman_image_get_height (pixman_image);
     surface->stride = pixman_image_get_stride (pixman_image);
     surface->depth = pixman_image_get_depth (pixman_image);
+    surface->num_threads = 1;
+    surface->recording = NULL;
+    surface->deferred = FALSE;
 
     surface->base.is_clear = surface->width == 0 || surface->height == 0;
 
@@ -559,6 +564,14 @@ cairo_image_surface_get_data (cairo_surface_t *surface)
 	return NULL;
     }
 
+    if (image_surface->recording != NULL) {
+	cairo_status_t status;
+
+	status = _cairo_image_surface_flush_deferred (image_surface);
+	if (unlikely (status))
+	    _cairo_surface_set_error (surface, status);
+    }
+
     return image_surface->data;
 }
 slim_hidden_def (cairo_image_surface_get_data);
@@ -663,6 +676,142 @@ cairo_image_surface_get_stride (cairo_surface_t *surface)
 }
 slim_hidden_def (cairo_image_surface_get_stride);
 
+/**
+ * cairo_image_surface_set_render_threads:
+ * @surface: a #cairo_image_surface_t
+ * @num_threads: the maximum number of threads to use, or 0 for one
+ * per available processor
+ *
+ * Allow cairo to rasterize large fills and strokes upon @surface using
+ * up to @num_threads threads, each rendering an independent horizontal
+ * band of the destination. Where a very large polygon has to be
+ * tessellated into trapezoids first, the tessellation is divided into
+ * horizontal slabs in the same way. The result is identical to
+ * rendering with a single thread, which remains the default.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_image_surface_set_render_threads (cairo_surface_t *surface,
+					int		 num_threads)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (unlikely (surface->status))
+	return;
+
+    if (unlikely (surface->finished)) {
+	_cairo_surface_set_error (surface, _cairo_error (CAIRO_STATUS_SURFACE_FINISHED));
+	return;
+    }
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_surface_set_error (surface,
+				  _cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH));
+	return;
+    }
+
+    if (num_threads <= 0)
+	num_threads = _cairo_parallel_num_cpus ();
+
+    image_surface->num_threads = num_threads;
+}
+
+/**
+ * cairo_image_surface_get_render_threads:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Get the number of threads cairo may use to render upon @surface, see
+ * cairo_image_surface_set_render_threads().
+ *
+ * Return value: the maximum number of rendering threads (or 0 if
+ * @surface is not an image surface).
+ *
+ * Since: 1.14
+ **/
+int
+cairo_image_surface_get_render_threads (cairo_surface_t *surface)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return 0;
+    }
+
+    return image_surface->num_threads;
+}
+
+/**
+ * cairo_image_surface_set_deferred:
+ * @surface: a #cairo_image_surface_t
+ * @deferred: whether drawing upon @surface should be deferred
+ *
+ * In deferred mode, drawing operations upon @surface are queued rather
+ * than rasterized immediately. The queue is executed when the contents
+ * of @surface are next required, for example upon cairo_surface_flush()
+ * or when @surface is used as a source, and for scenes consisting of
+ * many small primitives the commands are then replayed one cache-sized
+ * tile of the destination at a time.
+ *
+ * Disabling deferred mode executes any commands still pending.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_image_surface_set_deferred (cairo_surface_t *surface,
+				  cairo_bool_t	   deferred)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+    cairo_status_t status;
+
+    if (unlikely (surface->status))
+	return;
+
+    if (unlikely (surface->finished)) {
+	_cairo_surface_set_error (surface, _cairo_error (CAIRO_STATUS_SURFACE_FINISHED));
+	return;
+    }
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_surface_set_error (surface,
+				  _cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH));
+	return;
+    }
+
+    image_surface->deferred = deferred != FALSE;
+    if (! deferred) {
+	status = _cairo_image_surface_flush_deferred (image_surface);
+	if (unlikely (status))
+	    _cairo_surface_set_error (surface, status);
+    }
+}
+
+/**
+ * cairo_image_surface_get_deferred:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Query whether drawing upon @surface is deferred, see
+ * cairo_image_surface_set_deferred().
+ *
+ * Return value: %TRUE if drawing is deferred, %FALSE otherwise (or if
+ * @surface is not an image surface).
+ *
+ * Since: 1.14
+ **/
+cairo_bool_t
+cairo_image_surface_get_deferred (cairo_surface_t *surface)
+{
+    cairo_image_surface_t *image_surface = (cairo_image_surface_t *) surface;
+
+    if (! _cairo_surface_is_image (surface)) {
+	_cairo_error_throw (CAIRO_STATUS_SURFACE_TYPE_MISMATCH);
+	return FALSE;
+    }
+
+    return image_surface->deferred;
+}
+
     cairo_format_t
 _cairo_format_from_content (cairo_content_t content)
 {
@@ -752,6 +901,11 @@ _cairo_image_surface_snapshot (void *abstract_surface)
 {
     cairo_image_surface_t *image = abstract_surface;
     cairo_image_surface_t *clone;
+    cairo_status_t status;
+
+    status = _cairo_image_surface_flush_deferred (image);
+    if (unlikely (status))
+	return _cairo_surface_create_in_error (status);
 
     /* If we own the image, we can simply steal the memory for the snapshot */
     if (image->owns_data && image->base._finishing) {
@@ -800,8 +954,13 @@ _cairo_image_surface_map_to_image (void *abstract_other,
 {
     cairo_image_surface_t *other = abstract_other;
     cairo_surface_t *surface;
+    cairo_status_t status;
     uint8_t *data;
 
+    status = _cairo_image_surface_flush_deferred (other);
+    if (unlikely (status))
+	return _cairo_image_surface_create_in_error (status);
+
     data = other->data;
     data += extents->y * other->stride;
     data += extents->x * PIXMAN_FORMAT_BPP (other->pixman_format)/ 8;
@@ -832,6 +991,11 @@ _cairo_image_surface_finish (void *abstract_surface)
 {
     cairo_image_surface_t *surface = abstract_surface;
 
+    if (surface->recording) {
+	cairo_surface_destroy (surface->recording);
+	surface->recording = NULL;
+    }
+
     if (surface->pixman_image) {
 	pixman_image_unref (surface->pixman_image);
 	surface->pixman_image = NULL;
@@ -879,7 +1043,7 @@ _cairo_image_surface_acquire_source_image (void                    *abstract_sur
     *image_out = abstract_surface;
     *image_extra = NULL;
 
-    return CAIRO_STATUS_SUCCESS;
+    return _cairo_image_surface_flush_deferred (abstract_surface);
 }
 
 void
@@ -889,6 +1053,241 @@ _cairo_image_surface_release_source_image (void                   *abstract_surf
 {
 }
 
+/* Deferred rendering: whilst deferred, the drawing commands are
+ * captured by a recording surface covering the image. When the pixels
+ * are next required the recording is replayed, and if it consists of
+ * many small commands they are gathered by tile, so that the destination
+ * pixels remain in cache whilst they are being composited.
+ *
+ * Only commands that lie within a single tile are reordered, as they
+ * cannot touch the pixels of any other tile. Each is replayed whole with
+ * its own clip, exactly as it would be drawn directly; clipping the
+ * geometry to the tile instead would move the edges crossing the tile
+ * boundaries. A command spanning several tiles is replayed in order after
+ * all the commands before it, and before any of those after it.
+ */
+#define DEFERRED_TILE_SIZE 128
+#define DEFERRED_MIN_COMMANDS 16
+
+static cairo_bool_t
+_pattern_references_surface (const cairo_pattern_t *pattern,
+			     cairo_image_surface_t *surface)
+{
+    cairo_surface_t *source;
+
+    if (pattern == NULL || pattern->type != CAIRO_PATTERN_TYPE_SURFACE)
+	return FALSE;
+
+    source = ((const cairo_surface_pattern_t *) pattern)->surface;
+    if (source->backend->source != NULL)
+	source = _cairo_surface_get_source (source, NULL);
+
+    return source == &surface->base;
+}
+
+static cairo_int_status_t
+_cairo_image_surface_defer (cairo_image_surface_t *surface,
+			    const cairo_pattern_t *source,
+			    const cairo_pattern_t *mask)
+{
+    cairo_surface_t *recording;
+    cairo_rectangle_t extents;
+
+    if (! surface->deferred)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    /* Reading from ourselves requires the pending commands to land first */
+    if (_pattern_references_surface (source, surface) ||
+	_pattern_references_surface (mask, surface))
+    {
+	cairo_status_t status;
+
+	status = _cairo_image_surface_flush_deferred (surface);
+	if (unlikely (status))
+	    return status;
+
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+    }
+
+    if (surface->recording != NULL)
+	return CAIRO_INT_STATUS_SUCCESS;
+
+    extents.x = extents.y = 0;
+    extents.width = surface->width;
+    extents.height = surface->height;
+    recording = cairo_recording_surface_create (surface->base.content,
+						&extents);
+    if (unlikely (recording->status)) {
+	cairo_surface_destroy (recording);
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+    }
+
+    /* The recording is layered upon our existing contents */
+    recording->is_clear = FALSE;
+
+    surface->recording = recording;
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
+static cairo_bool_t
+_cairo_image_surface_deferred_use_tiles (cairo_image_surface_t *surface,
+					 cairo_recording_surface_t *recording)
+{
+    cairo_command_t **elements;
+    unsigned long area;
+    int i, num_elements;
+
+    if (surface->width <= DEFERRED_TILE_SIZE &&
+	surface->height <= DEFERRED_TILE_SIZE)
+	return FALSE;
+
+    num_elements = recording->commands.num_elements;
+    if (num_elements < DEFERRED_MIN_COMMANDS)
+	return FALSE;
+
+    /* Large commands span several tiles and so are replayed in order,
+     * gathering the few remaining ones by tile would gain nothing.
+     */
+    area = 0;
+    elements = _cairo_array_index (&recording->commands, 0);
+    for (i = 0; i < num_elements; i++) {
+	const cairo_rectangle_int_t *r = &elements[i]->header.extents;
+	area += (unsigned long) r->width * r->height;
+    }
+
+    return area / num_elements <= DEFERRED_TILE_SIZE * DEFERRED_TILE_SIZE / 4;
+}
+
+static int
+_cairo_image_surface_deferred_tile (cairo_image_surface_t *surface,
+				    const cairo_rectangle_int_t *r)
+{
+    int tiles_x = (surface->width + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE;
+    int x1, y1, x2, y2;
+
+    x1 = MAX (r->x, 0) / DEFERRED_TILE_SIZE;
+    y1 = MAX (r->y, 0) / DEFERRED_TILE_SIZE;
+    x2 = MAX (r->x + r->width - 1, 0) / DEFERRED_TILE_SIZE;
+    y2 = MAX (r->y + r->height - 1, 0) / DEFERRED_TILE_SIZE;
+    if (x1 != x2 || y1 != y2)
+	return -1;
+
+    return y1 * tiles_x + x1;
+}
+
+static cairo_status_t
+_cairo_image_surface_replay_tiles (cairo_image_surface_t *surface,
+				   cairo_recording_surface_t *recording)
+{
+    cairo_command_t **elements;
+    cairo_status_t status;
+    int *tile, *next, *first;
+    int num_tiles, num_elements;
+    int i, j, k, n;
+
+    num_tiles = ((surface->width + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE) *
+		((surface->height + DEFERRED_TILE_SIZE - 1) / DEFERRED_TILE_SIZE);
+    num_elements = recording->commands.num_elements;
+
+    tile = _cairo_malloc_ab (2 * num_elements + num_tiles, sizeof (int));
+    if (unlikely (tile == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    next = tile + num_elements;
+    first = next + num_elements;
+
+    elements = _cairo_array_index (&recording->commands, 0);
+    for (i = 0; i < num_elements; i++)
+	tile[i] = _cairo_image_surface_deferred_tile (surface,
+						      &elements[i]->header.extents);
+    for (i = 0; i < num_tiles; i++)
+	first[i] = -1;
+
+    status = CAIRO_STATUS_SUCCESS;
+    for (i = 0; i < num_elements; i = j) {
+	if (tile[i] < 0) {
+	    status = _cairo_recording_surface_replay_one (recording, i,
+							  &surface->base);
+	    if (unlikely (status))
+		break;
+
+	    j = i + 1;
+	    continue;
+	}
+
+	/* Gather the run of tile-local commands by tile, keeping their order */
+	for (j = i; j < num_elements && tile[j] >= 0; j++)
+	    ;
+	for (k = j; k-- > i; ) {
+	    next[k] = first[tile[k]];
+	    first[tile[k]] = k;
+	}
+
+	for (k = i; k < j; k++) {
+	    for (n = first[tile[k]]; n >= 0; n = next[n]) {
+		status = _cairo_recording_surface_replay_one (recording, n,
+							      &surface->base);
+		if (unlikely (status))
+		    goto done;
+	    }
+	    first[tile[k]] = -1;
+	}
+    }
+
+done:
+    free (tile);
+    return status;
+}
+
+cairo_status_t
+_cairo_image_surface_flush_deferred (cairo_image_surface_t *surface)
+{
+    cairo_recording_surface_t *recording;
+    cairo_matrix_t device_transform, device_transform_inverse;
+    cairo_status_t status;
+    cairo_bool_t deferred;
+
+    recording = (cairo_recording_surface_t *) surface->recording;
+    if (recording == NULL)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* Detach the queue so that the commands are drawn, not requeued */
+    surface->recording = NULL;
+    deferred = surface->deferred;
+    surface->deferred = FALSE;
+
+    /* The commands were captured in device space, so the replay must
+     * not apply our device transform a second time.
+     */
+    device_transform = surface->base.device_transform;
+    device_transform_inverse = surface->base.device_transform_inverse;
+    cairo_matrix_init_identity (&surface->base.device_transform);
+    cairo_matrix_init_identity (&surface->base.device_transform_inverse);
+
+    if (_cairo_image_surface_deferred_use_tiles (surface, recording)) {
+	status = _cairo_image_surface_replay_tiles (surface, recording);
+    } else {
+	status = _cairo_recording_surface_replay (&recording->base,
+						  &surface->base);
+    }
+
+    surface->base.device_transform = device_transform;
+    surface->base.device_transform_inverse = device_transform_inverse;
+    surface->deferred = deferred;
+
+    cairo_surface_destroy (&recording->base);
+    return status;
+}
+
+static cairo_status_t
+_cairo_image_surface_flush (void *abstract_surface,
+			    unsigned flags)
+{
+    if (flags)
+	return CAIRO_STATUS_SUCCESS;
+
+    return _cairo_image_surface_flush_deferred (abstract_surface);
+}
+
 /* high level image interface */
 cairo_bool_t
 _cairo_image_surface_get_extents (void			  *abstract_surface,
@@ -911,10 +1310,26 @@ _cairo_image_surface_paint (void			*abstract_surface,
 			    const cairo_clip_t		*clip)
 {
     cairo_image_surface_t *surface = abstract_surface;
+    cairo_int_status_t status;
 
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    if (op == CAIRO_OPERATOR_CLEAR && clip == NULL) {
+	/* Nothing pending can survive being cleared */
+	if (surface->recording) {
+	    cairo_surface_destroy (surface->recording);
+	    surface->recording = NULL;
+	}
+    } else {
+	status = _cairo_image_surface_defer (surface, source, NULL);
+	if (status == CAIRO_INT_STATUS_SUCCESS)
+	    return _cairo_surface_paint (surface->recording,
+					 op, source, clip);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+    }
+
     return _cairo_compositor_paint (surface->compositor,
 				    &surface->base, op, source, clip);
 }
@@ -927,10 +1342,18 @@ _cairo_image_surface_mask (void				*abstract_surface,
 			   const cairo_clip_t		*clip)
 {
     cairo_image_surface_t *surface = abstract_surface;
+    cairo_int_status_t status;
 
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    status = _cairo_image_surface_defer (surface, source, mask);
+    if (status == CAIRO_INT_STATUS_SUCCESS)
+	return _cairo_surface_mask (surface->recording,
+				    op, source, mask, clip);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
     return _cairo_compositor_mask (surface->compositor,
 				   &surface->base, op, source, mask, clip);
 }
@@ -948,10 +1371,20 @@ _cairo_image_surface_stroke (void			*abstract_surface,
 			     const cairo_clip_t		*clip)
 {
     cairo_image_surface_t *surface = abstract_surface;
+    cairo_int_status_t status;
 
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    status = _cairo_image_surface_defer (surface, source, NULL);
+    if (status == CAIRO_INT_STATUS_SUCCESS)
+	return _cairo_surface_stroke (surface->recording,
+				      op, source, path,
+				      style, ctm, ctm_inverse,
+				      tolerance, antialias, clip);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
     return _cairo_compositor_stroke (surface->compositor, &surface->base,
 				     op, source, path,
 				     style, ctm, ctm_inverse,
@@ -969,10 +1402,20 @@ _cairo_image_surface_fill (void				*abstract_surface,
 			   const cairo_clip_t		*clip)
 {
     cairo_image_surface_t *surface = abstract_surface;
+    cairo_int_status_t status;
 
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    status = _cairo_image_surface_defer (surface, source, NULL);
+    if (status == CAIRO_INT_STATUS_SUCCESS)
+	return _cairo_surface_fill (surface->recording,
+				    op, source, path,
+				    fill_rule, tolerance, antialias,
+				    clip);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
     return _cairo_compositor_fill (surface->compositor, &surface->base,
 				   op, source, path,
 				   fill_rule, tolerance, antialias,
@@ -989,10 +1432,23 @@ _cairo_image_surface_glyphs (void			*abstract_surface,
 			     const cairo_clip_t		*clip)
 {
     cairo_image_surface_t *surface = abstract_surface;
+    cairo_int_status_t status;
 
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    status = _cairo_image_surface_defer (surface, source, NULL);
+    if (status == CAIRO_INT_STATUS_SUCCESS)
+	return _cairo_surface_show_text_glyphs (surface->recording,
+						op, source,
+						NULL, 0,
+						glyphs, num_glyphs,
+						NULL, 0, 0,
+						scaled_font,
+						clip);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
     return _cairo_compositor_glyphs (surface->compositor, &surface->base,
 				     op, source,
 				     glyphs, num_glyphs, scaled_font,
@@ -1031,7 +1487,7 @@ const cairo_surface_backend_t _cairo_image_surface_backend = {
     _cairo_image_surface_get_extents,
     _cairo_image_surface_get_font_options,
 
-    NULL, /* flush */
+    _cairo_image_surface_flush,
     NULL,
 
     _cairo_image_surface_paint,
@@ -1140,7 +1596,7 @@ cleanup_image:
 cleanup_mem:
     free (mem);
 cleanup:
-    return (cairo_image_surface_t *) _cairo_surface_create_in_error (status);
+    return _cairo_image_surface_create_in_error (status);
 }
 
 cairo_image_transparency_t
@@ -39,13 +39,34 @@
 CAIRO_MUTEX_DECLARE (_cairo_pattern_solid_surface_cache_lock)
 
 CAIRO_MUTEX_DECLARE (_cairo_image_solid_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_gradient_cache_mutex)
 
 CAIRO_MUTEX_DECLARE (_cairo_toy_font_face_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_intern_string_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_scaled_font_map_mutex)
-CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_scaled_font_error_mutex)
-CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_path_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_scan_converter_mutex)
+
+/* one per shard of the scaled glyph page cache */
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_0)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_1)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_2)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_3)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_4)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_5)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_6)
+CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex_7)
+
+/* one per shard of the pixman glyph cache */
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_0)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_1)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_2)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_3)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_4)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_5)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_6)
+CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex_7)
 
 #if CAIRO_HAS_FT_FONT
 CAIRO_MUTEX_DECLARE (_cairo_ft_unscaled_font_map_mutex)
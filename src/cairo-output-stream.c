@@ -292,6 +292,131 @@ _cairo_output_stream_write_hex_string (cairo_output_stream_t *stream,
     }
 }
 
+/* The largest value _cairo_dtostr_fixed() will scale a number to, so
+ * that the product carries enough bits below the binary point to
+ * tell on which side of a rounding tie it lies.
+ */
+#define DTOSTR_FIXED_MAX 1099511627776.0 /* 2^40 */
+#define DTOSTR_FIXED_TIE_EPSILON 1e-3
+
+/* The space _cairo_dtostr_fast() needs in its buffer */
+#define DTOSTR_FAST_SIZE 32
+
+static const double dtostr_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+/* Print @d rounded to @decimal_digits digits after the decimal point
+ * with trailing zeros trimmed, exactly as snprintf() with "%.*f"
+ * followed by the trimming in _cairo_dtostr() would.  The number is
+ * scaled and rounded in integer arithmetic, which is many times
+ * faster than going through the C library.  Returns the length of
+ * the string written to @buffer, or -1 if the number is too large or
+ * too close to a rounding tie for the scaled product to be trusted,
+ * in which case the caller should fall back to snprintf().  @buffer
+ * must have room for at least %DTOSTR_FAST_SIZE characters.
+ */
+static int
+_cairo_dtostr_fixed (char *buffer, double d, int decimal_digits)
+{
+    char digits[24];
+    double scaled, rounded;
+    uint64_t n, frac_scale;
+    char *p = buffer;
+    int i, len;
+
+    if (decimal_digits < 0 ||
+	decimal_digits >= (int) ARRAY_LENGTH (dtostr_pow10))
+	return -1;
+
+    scaled = fabs (d) * dtostr_pow10[decimal_digits];
+    if (! (scaled < DTOSTR_FIXED_MAX))
+	return -1;
+
+    rounded = floor (scaled + 0.5);
+    if (fabs (scaled - rounded) > 0.5 - DTOSTR_FIXED_TIE_EPSILON)
+	return -1;
+
+    /* Like printf, keep the sign of negative numbers that round to 0 */
+    if (d < 0)
+	*p++ = '-';
+
+    n = rounded;
+    frac_scale = dtostr_pow10[decimal_digits];
+
+    len = 0;
+    i = decimal_digits;
+    if (i > 0) {
+	uint64_t frac = n % frac_scale;
+
+	/* Trailing zeros of the fraction are never printed */
+	while (i > 0 && frac % 10 == 0) {
+	    frac /= 10;
+	    i--;
+	}
+	if (i > 0) {
+	    while (i--) {
+		digits[len++] = '0' + frac % 10;
+		frac /= 10;
+	    }
+	    digits[len++] = '.';
+	}
+    }
+
+    n /= frac_scale;
+    do {
+	digits[len++] = '0' + n % 10;
+	n /= 10;
+    } while (n);
+
+    while (len)
+	*p++ = digits[--len];
+    *p = '\0';
+
+    return p - buffer;
+}
+
+/* The same as _cairo_dtostr() for all the numbers that can be
+ * printed by _cairo_dtostr_fixed(), which in practice is everything
+ * but huge and tiny numbers.  Returns the length of the string, or -1
+ * if the number needs to be printed by _cairo_dtostr().
+ */
+static int
+_cairo_dtostr_fast (char *buffer, double d, cairo_bool_t limited_precision)
+{
+    int num_zeros;
+
+    if (limited_precision)
+	return _cairo_dtostr_fixed (buffer, d, FIXED_POINT_DECIMAL_DIGITS);
+
+    if (fabs (d) >= 0.1)
+	return _cairo_dtostr_fixed (buffer, d, SIGNIFICANT_DIGITS_AFTER_DECIMAL);
+
+    if (d == 0.0) {
+	buffer[0] = '0';
+	buffer[1] = '\0';
+	return 1;
+    }
+
+    if (fabs (d) < 1e-10)
+	return -1;
+
+    /* The number of zeros after the decimal point as counted by
+     * _cairo_dtostr(), unless the number is so close to a power of
+     * ten that rounding it to 18 digits could carry into the next
+     * digit. */
+    num_zeros = 1;
+    while (fabs (d) * dtostr_pow10[num_zeros + 1] < 1.0)
+	num_zeros++;
+    if (fabs (d) * dtostr_pow10[num_zeros + 1] < 1.0 + 1e-6 ||
+	fabs (d) * dtostr_pow10[num_zeros] > 1.0 - 1e-6)
+	return -1;
+
+    return _cairo_dtostr_fixed (buffer, d,
+				num_zeros + SIGNIFICANT_DIGITS_AFTER_DECIMAL);
+}
+
 /* Format a double in a locale independent way and trim trailing
  * zeros.  Based on code from Alex Larson <alexl@redhat.com>.
  * http://mail.gnome.org/archives/gtk-devel-list/2001-October/msg00087.html
@@ -314,6 +439,9 @@ _cairo_dtostr (char *buffer, size_t size, double d, cairo_bool_t limited_precisi
     if (d == 0.0)
 	d = 0.0;
 
+    if (_cairo_dtostr_fast (buffer, d, limited_precision) >= 0)
+	return;
+
     locale_data = localeconv ();
     decimal_point = locale_data->decimal_point;
     decimal_point_len = strlen (decimal_point);
@@ -427,6 +555,34 @@ _cairo_output_stream_vprintf (cairo_output_stream_t *stream,
 	start = f;
 	f++;
 
+	/* Doubles that the fast formatter can handle are written
+	 * straight into the buffer, so a run of coordinates is passed
+	 * on to the stream in one write rather than one per number. */
+	if (*f == 'f' || *f == 'g') {
+	    double d = va_arg (ap, double);
+	    int len;
+
+	    if (p + DTOSTR_FAST_SIZE > buffer + sizeof (buffer)) {
+		_cairo_output_stream_write (stream, buffer, p - buffer);
+		p = buffer;
+	    }
+
+	    /* Omit the minus sign from negative zero. */
+	    if (d == 0.0)
+		d = 0.0;
+
+	    len = _cairo_dtostr_fast (p, d, *f == 'g');
+	    if (len < 0) {
+		_cairo_output_stream_write (stream, buffer, p - buffer);
+		_cairo_dtostr (buffer, sizeof buffer, d, *f == 'g');
+		len = strlen (buffer);
+		p = buffer;
+	    }
+	    p += len;
+	    f++;
+	    continue;
+	}
+
 	if (*f == '0')
 	    f++;
 
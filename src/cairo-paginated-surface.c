@@ -50,6 +50,7 @@
 #include "cairo-analysis-surface-private.h"
 #include "cairo-error-private.h"
 #include "cairo-image-surface-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-surface-subsurface-inline.h"
 
 static const cairo_surface_backend_t cairo_paginated_surface_backend;
@@ -289,37 +290,39 @@ _cairo_paginated_surface_release_source_image (void	  *abstract_surface,
     cairo_surface_destroy (&image->base);
 }
 
-static cairo_int_status_t
-_paint_fallback_image (cairo_paginated_surface_t *surface,
-		       cairo_rectangle_int_t     *rect)
+static cairo_surface_t *
+_create_fallback_image (cairo_paginated_surface_t *surface,
+			const cairo_rectangle_int_t *rect)
 {
     double x_scale = surface->base.x_fallback_resolution / surface->target->x_resolution;
     double y_scale = surface->base.y_fallback_resolution / surface->target->y_resolution;
-    int x, y, width, height;
-    cairo_status_t status;
     cairo_surface_t *image;
-    cairo_surface_pattern_t pattern;
-    cairo_clip_t *clip;
 
-    x = rect->x;
-    y = rect->y;
-    width = rect->width;
-    height = rect->height;
     image = _cairo_paginated_surface_create_image_surface (surface,
-							   ceil (width  * x_scale),
-							   ceil (height * y_scale));
+							   ceil (rect->width  * x_scale),
+							   ceil (rect->height * y_scale));
     _cairo_surface_set_device_scale (image, x_scale, y_scale);
     /* set_device_offset just sets the x0/y0 components of the matrix;
      * so we have to do the scaling manually. */
-    cairo_surface_set_device_offset (image, -x*x_scale, -y*y_scale);
+    cairo_surface_set_device_offset (image, -rect->x*x_scale, -rect->y*y_scale);
 
-    status = _cairo_recording_surface_replay (surface->recording_surface, image);
-    if (unlikely (status))
-	goto CLEANUP_IMAGE;
+    return image;
+}
+
+static cairo_int_status_t
+_paint_fallback_image_to_target (cairo_paginated_surface_t *surface,
+				 const cairo_rectangle_int_t *rect,
+				 cairo_surface_t *image)
+{
+    double x_scale = surface->base.x_fallback_resolution / surface->target->x_resolution;
+    double y_scale = surface->base.y_fallback_resolution / surface->target->y_resolution;
+    cairo_status_t status;
+    cairo_surface_pattern_t pattern;
+    cairo_clip_t *clip;
 
     _cairo_pattern_init_for_surface (&pattern, image);
     cairo_matrix_init (&pattern.base.matrix,
-		       x_scale, 0, 0, y_scale, -x*x_scale, -y*y_scale);
+		       x_scale, 0, 0, y_scale, -rect->x*x_scale, -rect->y*y_scale);
     /* the fallback should be rendered at native resolution, so disable
      * filtering (if possible) to avoid introducing potential artifacts. */
     pattern.base.filter = CAIRO_FILTER_NEAREST;
@@ -331,12 +334,115 @@ _paint_fallback_image (cairo_paginated_surface_t *surface,
     _cairo_clip_destroy (clip);
     _cairo_pattern_fini (&pattern.base);
 
-CLEANUP_IMAGE:
+    return status;
+}
+
+static cairo_int_status_t
+_paint_fallback_image (cairo_paginated_surface_t *surface,
+		       cairo_rectangle_int_t     *rect)
+{
+    cairo_status_t status;
+    cairo_surface_t *image;
+
+    image = _create_fallback_image (surface, rect);
+
+    status = _cairo_recording_surface_replay (surface->recording_surface, image);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = _paint_fallback_image_to_target (surface, rect, image);
+
     cairo_surface_destroy (image);
 
     return status;
 }
 
+typedef struct _cairo_paginated_fallback {
+    cairo_rectangle_int_t rect;
+    cairo_surface_t *image;
+    cairo_status_t status;
+} cairo_paginated_fallback_t;
+
+typedef struct _cairo_paginated_fallback_batch {
+    cairo_surface_t *recording_surface;
+    cairo_paginated_fallback_t *fallbacks;
+} cairo_paginated_fallback_batch_t;
+
+static void
+_replay_fallback_image (void *closure, int task)
+{
+    cairo_paginated_fallback_batch_t *batch = closure;
+    cairo_paginated_fallback_t *fallback = &batch->fallbacks[task];
+
+    fallback->status =
+	_cairo_recording_surface_replay_concurrent (batch->recording_surface,
+						    fallback->image);
+}
+
+/* The fallback regions do not overlap, so if the surface allows more
+ * than one fallback thread the images for them are rendered a few at a
+ * time on a pool of threads, each replaying just the commands that
+ * touch its region.  They are then painted onto the target one after
+ * the other, in the same order as before.
+ */
+static cairo_int_status_t
+_paint_fallback_images (cairo_paginated_surface_t *surface,
+			cairo_region_t		  *region)
+{
+    cairo_paginated_fallback_batch_t batch;
+    cairo_int_status_t status = CAIRO_INT_STATUS_SUCCESS;
+    int num_rects, num_threads, i, j, n;
+
+    num_rects = cairo_region_num_rectangles (region);
+    num_threads = MIN (surface->base.fallback_threads, num_rects);
+    if (num_threads < 2 ||
+	! _cairo_recording_surface_prepare_concurrent_replay (surface->recording_surface))
+    {
+	for (i = 0; i < num_rects; i++) {
+	    cairo_rectangle_int_t rect;
+
+	    cairo_region_get_rectangle (region, i, &rect);
+	    status = _paint_fallback_image (surface, &rect);
+	    if (unlikely (status))
+		break;
+	}
+
+	return status;
+    }
+
+    batch.recording_surface = surface->recording_surface;
+    batch.fallbacks = _cairo_malloc_ab (num_threads,
+					sizeof (cairo_paginated_fallback_t));
+    if (unlikely (batch.fallbacks == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    for (i = 0; i < num_rects && status == CAIRO_INT_STATUS_SUCCESS; i += n) {
+	n = MIN (num_threads, num_rects - i);
+	for (j = 0; j < n; j++) {
+	    cairo_paginated_fallback_t *fallback = &batch.fallbacks[j];
+
+	    cairo_region_get_rectangle (region, i + j, &fallback->rect);
+	    fallback->image = _create_fallback_image (surface, &fallback->rect);
+	}
+
+	_cairo_parallel_for (n, n, _replay_fallback_image, &batch);
+
+	for (j = 0; j < n; j++) {
+	    cairo_paginated_fallback_t *fallback = &batch.fallbacks[j];
+
+	    if (status == CAIRO_INT_STATUS_SUCCESS)
+		status = fallback->status;
+	    if (status == CAIRO_INT_STATUS_SUCCESS)
+		status = _paint_fallback_image_to_target (surface,
+							  &fallback->rect,
+							  fallback->image);
+	    cairo_surface_destroy (fallback->image);
+	}
+    }
+
+    free (batch.fallbacks);
+
+    return status;
+}
+
 static cairo_int_status_t
 _paint_page (cairo_paginated_surface_t *surface)
 {
@@ -432,22 +538,14 @@ _paint_page (cairo_paginated_surface_t *surface)
 
     if (has_finegrained_fallback) {
         cairo_region_t *region;
-        int num_rects, i;
 
 	surface->backend->set_paginated_mode (surface->target,
 		                              CAIRO_PAGINATED_MODE_FALLBACK);
 
 	region = _cairo_analysis_surface_get_unsupported (analysis);
-
-	num_rects = cairo_region_num_rectangles (region);
-	for (i = 0; i < num_rects; i++) {
-	    cairo_rectangle_int_t rect;
-
-	    cairo_region_get_rectangle (region, i, &rect);
-	    status = _paint_fallback_image (surface, &rect);
-	    if (unlikely (status))
-		goto FAIL;
-	}
+	status = _paint_fallback_images (surface, region);
+	if (unlikely (status))
+	    goto FAIL;
     }
 
   FAIL:
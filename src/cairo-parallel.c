@@ -0,0 +1,157 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is University of Southern
+ * California.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-parallel-private.h"
+
+#if CAIRO_HAS_WORKER_THREADS
+#include <pthread.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define MAX_THREADS 64
+
+typedef struct _cairo_parallel {
+    pthread_mutex_t mutex;
+    int next_task;
+    int num_tasks;
+    cairo_parallel_func_t func;
+    void *closure;
+} cairo_parallel_t;
+
+static int
+_cairo_parallel_next_task (cairo_parallel_t *parallel)
+{
+    int task;
+
+    pthread_mutex_lock (&parallel->mutex);
+    task = parallel->next_task;
+    if (task < parallel->num_tasks)
+	parallel->next_task++;
+    pthread_mutex_unlock (&parallel->mutex);
+
+    return task;
+}
+
+static void *
+_cairo_parallel_worker (void *closure)
+{
+    cairo_parallel_t *parallel = closure;
+    int task;
+
+    while ((task = _cairo_parallel_next_task (parallel)) < parallel->num_tasks)
+	parallel->func (parallel->closure, task);
+
+    return NULL;
+}
+
+int
+_cairo_parallel_num_cpus (void)
+{
+#if defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+    if (n > MAX_THREADS)
+	n = MAX_THREADS;
+    if (n > 1)
+	return n;
+#endif
+    return 1;
+}
+
+void
+_cairo_parallel_for (int			 num_threads,
+		     int			 num_tasks,
+		     cairo_parallel_func_t	 func,
+		     void			*closure)
+{
+    pthread_t threads[MAX_THREADS];
+    cairo_parallel_t parallel;
+    int n, i;
+
+    if (num_threads > num_tasks)
+	num_threads = num_tasks;
+    if (num_threads > MAX_THREADS)
+	num_threads = MAX_THREADS;
+
+    if (num_threads <= 1) {
+	for (i = 0; i < num_tasks; i++)
+	    func (closure, i);
+	return;
+    }
+
+    pthread_mutex_init (&parallel.mutex, NULL);
+    parallel.next_task = 0;
+    parallel.num_tasks = num_tasks;
+    parallel.func = func;
+    parallel.closure = closure;
+
+    /* The calling thread is the first worker; should we fail to
+     * spawn any of the others it just ends up doing more of the work.
+     */
+    for (n = 0; n < num_threads - 1; n++) {
+	if (pthread_create (&threads[n], NULL,
+			    _cairo_parallel_worker, &parallel))
+	    break;
+    }
+
+    _cairo_parallel_worker (&parallel);
+
+    for (i = 0; i < n; i++)
+	pthread_join (threads[i], NULL);
+
+    pthread_mutex_destroy (&parallel.mutex);
+}
+
+#else
+
+int
+_cairo_parallel_num_cpus (void)
+{
+    return 1;
+}
+
+void
+_cairo_parallel_for (int			 num_threads,
+		     int			 num_tasks,
+		     cairo_parallel_func_t	 func,
+		     void			*closure)
+{
+    int i;
+
+    for (i = 0; i < num_tasks; i++)
+	func (closure, i);
+}
+
+#endif
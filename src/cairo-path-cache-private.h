@@ -0,0 +1,87 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is University of Southern
+ * California.
+ */
+
+#ifndef CAIRO_PATH_CACHE_PRIVATE_H
+#define CAIRO_PATH_CACHE_PRIVATE_H
+
+#include "cairo-error-private.h"
+#include "cairo-types-private.h"
+
+CAIRO_BEGIN_DECLS
+
+/* The path cache remembers the polygons generated for paths that are
+ * drawn repeatedly, such as icons and symbols redrawn every frame.
+ * Fills are keyed on the shape of the path relative to its first
+ * point, so a cached polygon is reused (suitably offset) when the same
+ * path is drawn at a different position.  Strokes are keyed on the
+ * path itself, along with the stroke style, the CTM and the limits of
+ * the polygon.  The cache is bounded by the total size of its entries.
+ *
+ * A path is only admitted once it has been seen before, so shapes
+ * that are drawn just once do not pay for the copy.
+ */
+
+typedef cairo_status_t
+(*cairo_path_cache_fill_func_t) (const cairo_path_fixed_t	*path,
+				 double				 tolerance,
+				 cairo_polygon_t		*polygon);
+
+cairo_private cairo_int_status_t
+_cairo_path_cache_fill_to_polygon (const cairo_path_fixed_t	*path,
+				   double			 tolerance,
+				   cairo_path_cache_fill_func_t	 fill,
+				   cairo_polygon_t		*polygon);
+
+typedef cairo_status_t
+(*cairo_path_cache_stroke_func_t) (const cairo_path_fixed_t	*path,
+				   const cairo_stroke_style_t	*style,
+				   const cairo_matrix_t		*ctm,
+				   const cairo_matrix_t		*ctm_inverse,
+				   double			 tolerance,
+				   cairo_polygon_t		*polygon);
+
+cairo_private cairo_int_status_t
+_cairo_path_cache_stroke_to_polygon (const cairo_path_fixed_t	 *path,
+				     const cairo_stroke_style_t	 *style,
+				     const cairo_matrix_t	 *ctm,
+				     const cairo_matrix_t	 *ctm_inverse,
+				     double			  tolerance,
+				     cairo_path_cache_stroke_func_t stroke,
+				     cairo_polygon_t		 *polygon);
+
+cairo_private void
+_cairo_path_cache_reset_static_data (void);
+
+CAIRO_END_DECLS
+
+#endif /* CAIRO_PATH_CACHE_PRIVATE_H */
@@ -0,0 +1,538 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is University of Southern
+ * California.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-cache-private.h"
+#include "cairo-list-inline.h"
+#include "cairo-path-cache-private.h"
+#include "cairo-path-fixed-private.h"
+
+#define CAIRO_PATH_CACHE_MAX_SIZE (16 << 20)
+#define CAIRO_PATH_CACHE_MAX_ENTRY_SIZE (CAIRO_PATH_CACHE_MAX_SIZE / 2)
+#define CAIRO_PATH_CACHE_MAX_DASHES 16
+#define CAIRO_PATH_CACHE_NUM_SEEN 256
+#define CAIRO_PATH_CACHE_MIN_STROKE_POINTS 16
+
+enum {
+    CAIRO_PATH_CACHE_FILL,
+    CAIRO_PATH_CACHE_STROKE,
+};
+
+typedef struct _cairo_path_cache_fill_params {
+    int type;
+    double tolerance;
+} cairo_path_cache_fill_params_t;
+
+typedef struct _cairo_path_cache_stroke_params {
+    int type;
+    double tolerance;
+    double xx, yx, xy, yy;
+    double line_width;
+    double miter_limit;
+    double dash_offset;
+    int line_cap;
+    int line_join;
+    int num_dashes;
+    double dash[CAIRO_PATH_CACHE_MAX_DASHES];
+    cairo_box_t limit;
+} cairo_path_cache_stroke_params_t;
+
+typedef struct _cairo_path_cache_entry {
+    cairo_cache_entry_t base;
+
+    int num_ops;
+    int num_points;
+    int params_size;
+
+    /* A lookup key refers to the path being drawn, whereas a cached
+     * entry holds its own copy of the ops, of the points relative
+     * to the origin and of the parameters used to generate the polygon.
+     */
+    const cairo_path_fixed_t *path;
+    cairo_point_t origin;
+    cairo_path_op_t *ops;
+    cairo_point_t *points;
+    const void *params;
+
+    /* also relative to the origin */
+    cairo_edge_t *edges;
+    int num_edges;
+} cairo_path_cache_entry_t;
+
+static cairo_cache_t *_cairo_path_cache;
+static unsigned long _cairo_path_cache_seen[CAIRO_PATH_CACHE_NUM_SEEN];
+static unsigned long _cairo_path_cache_too_large[CAIRO_PATH_CACHE_NUM_SEEN];
+
+static unsigned long
+_cairo_path_cache_entry_size (const cairo_path_cache_entry_t *key,
+			      int num_edges)
+{
+    return sizeof (cairo_path_cache_entry_t) +
+	   num_edges * sizeof (cairo_edge_t) +
+	   key->num_points * sizeof (cairo_point_t) +
+	   key->params_size +
+	   key->num_ops * sizeof (cairo_path_op_t);
+}
+
+/* With @relative, the key is taken relative to the first point of the
+ * path so that the same shape drawn elsewhere shares the entry.  Paths
+ * too long for even their copy to fit in an entry are refused before
+ * they are hashed.
+ */
+static cairo_bool_t
+_cairo_path_cache_init_key (cairo_path_cache_entry_t *key,
+			    const cairo_path_fixed_t *path,
+			    cairo_bool_t relative,
+			    const void *params,
+			    int params_size)
+{
+    const cairo_path_buf_t *buf;
+    cairo_point_t relative_points[64];
+    unsigned long hash;
+    int i, j, n;
+
+    buf = cairo_path_head (path);
+    if (buf->num_ops == 0 || buf->op[0] != CAIRO_PATH_OP_MOVE_TO)
+	return FALSE;
+
+    key->path = path;
+    if (relative) {
+	key->origin = buf->points[0];
+    } else {
+	key->origin.x = 0;
+	key->origin.y = 0;
+    }
+    key->params = params;
+    key->params_size = params_size;
+
+    key->num_ops = key->num_points = 0;
+    cairo_path_foreach_buf_start (buf, path) {
+	key->num_ops += buf->num_ops;
+	key->num_points += buf->num_points;
+    } cairo_path_foreach_buf_end (buf, path);
+
+    if (_cairo_path_cache_entry_size (key, 0) > CAIRO_PATH_CACHE_MAX_ENTRY_SIZE)
+	return FALSE;
+
+    hash = _CAIRO_HASH_INIT_VALUE;
+    cairo_path_foreach_buf_start (buf, path) {
+	hash = _cairo_hash_bytes (hash, buf->op,
+				  buf->num_ops * sizeof (buf->op[0]));
+    } cairo_path_foreach_buf_end (buf, path);
+
+    cairo_path_foreach_buf_start (buf, path) {
+	for (i = 0; i < buf->num_points; i += n) {
+	    n = MIN (buf->num_points - i, ARRAY_LENGTH (relative_points));
+	    for (j = 0; j < n; j++) {
+		relative_points[j].x = buf->points[i+j].x - key->origin.x;
+		relative_points[j].y = buf->points[i+j].y - key->origin.y;
+	    }
+	    hash = _cairo_hash_bytes (hash, relative_points,
+				      n * sizeof (relative_points[0]));
+	}
+    } cairo_path_foreach_buf_end (buf, path);
+
+    hash = _cairo_hash_bytes (hash, &key->num_ops, sizeof (key->num_ops));
+    hash = _cairo_hash_bytes (hash, &key->num_points, sizeof (key->num_points));
+    hash = _cairo_hash_bytes (hash, params, params_size);
+
+    key->base.hash = hash;
+    return TRUE;
+}
+
+static cairo_bool_t
+_cairo_path_cache_keys_equal (const void *key_a, const void *key_b)
+{
+    const cairo_path_cache_entry_t *a = key_a;
+    const cairo_path_cache_entry_t *b = key_b;
+    const cairo_path_buf_t *buf;
+    const cairo_path_op_t *ops;
+    const cairo_point_t *points;
+    int i;
+
+    if (a->num_ops != b->num_ops ||
+	a->num_points != b->num_points ||
+	a->params_size != b->params_size ||
+	memcmp (a->params, b->params, a->params_size))
+    {
+	return FALSE;
+    }
+
+    ops = b->ops;
+    points = b->points;
+    cairo_path_foreach_buf_start (buf, a->path) {
+	if (memcmp (buf->op, ops, buf->num_ops * sizeof (buf->op[0])))
+	    return FALSE;
+	ops += buf->num_ops;
+
+	for (i = 0; i < buf->num_points; i++) {
+	    if (buf->points[i].x - a->origin.x != points[i].x ||
+		buf->points[i].y - a->origin.y != points[i].y)
+	    {
+		return FALSE;
+	    }
+	}
+	points += buf->num_points;
+    } cairo_path_foreach_buf_end (buf, a->path);
+
+    return TRUE;
+}
+
+static cairo_path_cache_entry_t *
+_cairo_path_cache_entry_create (const cairo_path_cache_entry_t *key,
+				const cairo_polygon_t *polygon)
+{
+    cairo_path_cache_entry_t *entry;
+    const cairo_path_buf_t *buf;
+    unsigned long size;
+    int i;
+
+    size = _cairo_path_cache_entry_size (key, polygon->num_edges);
+    entry = malloc (size);
+    if (unlikely (entry == NULL))
+	return NULL;
+
+    *entry = *key;
+    entry->base.size = size;
+    entry->path = NULL;
+
+    entry->edges = (cairo_edge_t *) (entry + 1);
+    entry->num_edges = polygon->num_edges;
+    for (i = 0; i < polygon->num_edges; i++) {
+	cairo_edge_t *e = &entry->edges[i];
+
+	*e = polygon->edges[i];
+	e->line.p1.x -= key->origin.x;
+	e->line.p1.y -= key->origin.y;
+	e->line.p2.x -= key->origin.x;
+	e->line.p2.y -= key->origin.y;
+	e->top -= key->origin.y;
+	e->bottom -= key->origin.y;
+    }
+
+    entry->points = (cairo_point_t *) (entry->edges + entry->num_edges);
+    entry->params = entry->points + entry->num_points;
+    memcpy ((void *) entry->params, key->params, key->params_size);
+    entry->ops = (cairo_path_op_t *) entry->params + entry->params_size;
+
+    entry->num_points = entry->num_ops = 0;
+    cairo_path_foreach_buf_start (buf, key->path) {
+	memcpy (entry->ops + entry->num_ops, buf->op,
+		buf->num_ops * sizeof (buf->op[0]));
+	entry->num_ops += buf->num_ops;
+
+	for (i = 0; i < buf->num_points; i++) {
+	    cairo_point_t *p = &entry->points[entry->num_points++];
+
+	    p->x = buf->points[i].x - key->origin.x;
+	    p->y = buf->points[i].y - key->origin.y;
+	}
+    } cairo_path_foreach_buf_end (buf, key->path);
+
+    return entry;
+}
+
+static cairo_bool_t
+_cairo_path_cache_get (void)
+{
+    if (_cairo_path_cache == NULL) {
+	_cairo_path_cache = malloc (sizeof (cairo_cache_t));
+	if (unlikely (_cairo_path_cache == NULL))
+	    return FALSE;
+
+	if (_cairo_cache_init (_cairo_path_cache,
+			       _cairo_path_cache_keys_equal,
+			       NULL,
+			       free,
+			       CAIRO_PATH_CACHE_MAX_SIZE))
+	{
+	    free (_cairo_path_cache);
+	    _cairo_path_cache = NULL;
+	    return FALSE;
+	}
+    }
+
+    return TRUE;
+}
+
+/* Adds the cached edges for @key to @polygon if there are any.
+ * Otherwise returns %CAIRO_INT_STATUS_UNSUPPORTED, and sets @admit if
+ * the path has been seen before and should now be cached.  A path whose
+ * polygon was found to be too large for an entry is not admitted again.
+ */
+static cairo_int_status_t
+_cairo_path_cache_lookup (cairo_path_cache_entry_t *key,
+			  cairo_polygon_t *polygon,
+			  cairo_bool_t *admit)
+{
+    cairo_path_cache_entry_t *entry;
+    cairo_int_status_t status;
+    unsigned int slot;
+
+    CAIRO_MUTEX_LOCK (_cairo_path_cache_mutex);
+
+    if (_cairo_path_cache != NULL) {
+	entry = _cairo_cache_lookup (_cairo_path_cache, &key->base);
+	if (entry != NULL) {
+	    status = _cairo_polygon_add_edges (polygon,
+					       entry->edges, entry->num_edges,
+					       key->origin.x, key->origin.y);
+	    CAIRO_MUTEX_UNLOCK (_cairo_path_cache_mutex);
+	    return status;
+	}
+    }
+
+    slot = key->base.hash % CAIRO_PATH_CACHE_NUM_SEEN;
+    *admit = _cairo_path_cache_seen[slot] == key->base.hash &&
+	     _cairo_path_cache_too_large[slot] != key->base.hash;
+    _cairo_path_cache_seen[slot] = key->base.hash;
+
+    CAIRO_MUTEX_UNLOCK (_cairo_path_cache_mutex);
+
+    return CAIRO_INT_STATUS_UNSUPPORTED;
+}
+
+static void
+_cairo_path_cache_insert (cairo_path_cache_entry_t *key,
+			  const cairo_polygon_t *polygon)
+{
+    cairo_path_cache_entry_t *entry;
+
+    if (_cairo_path_cache_entry_size (key, polygon->num_edges) >
+	CAIRO_PATH_CACHE_MAX_ENTRY_SIZE)
+    {
+	CAIRO_MUTEX_LOCK (_cairo_path_cache_mutex);
+	_cairo_path_cache_too_large[key->base.hash % CAIRO_PATH_CACHE_NUM_SEEN] =
+	    key->base.hash;
+	CAIRO_MUTEX_UNLOCK (_cairo_path_cache_mutex);
+	return;
+    }
+
+    entry = _cairo_path_cache_entry_create (key, polygon);
+    if (entry == NULL)
+	return;
+
+    CAIRO_MUTEX_LOCK (_cairo_path_cache_mutex);
+
+    /* another thread may have beaten us to it */
+    if (! _cairo_path_cache_get () ||
+	_cairo_cache_lookup (_cairo_path_cache, &key->base) != NULL ||
+	_cairo_cache_insert (_cairo_path_cache, &entry->base))
+    {
+	free (entry);
+    }
+
+    CAIRO_MUTEX_UNLOCK (_cairo_path_cache_mutex);
+}
+
+/**
+ * _cairo_path_cache_fill_to_polygon:
+ * @path: the path to fill
+ * @tolerance: the flattening tolerance
+ * @fill: the function that generates the polygon on a cache miss
+ * @polygon: the polygon to add the edges to
+ *
+ * Adds the edges for filling @path to @polygon, reusing the edges
+ * from a previous fill of the same shape if possible.
+ *
+ * Return value: %CAIRO_INT_STATUS_UNSUPPORTED if the path is not
+ * cached, in which case the caller must generate the polygon itself.
+ **/
+cairo_int_status_t
+_cairo_path_cache_fill_to_polygon (const cairo_path_fixed_t	*path,
+				   double			 tolerance,
+				   cairo_path_cache_fill_func_t	 fill,
+				   cairo_polygon_t		*polygon)
+{
+    cairo_path_cache_fill_params_t params;
+    cairo_path_cache_entry_t key;
+    cairo_polygon_t flat;
+    cairo_int_status_t status;
+    cairo_bool_t admit;
+
+    /* only flattening curves is expensive enough to be worth saving */
+    if (! path->has_curve_to)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    memset (&params, 0, sizeof (params));
+    params.type = CAIRO_PATH_CACHE_FILL;
+    params.tolerance = tolerance;
+
+    if (! _cairo_path_cache_init_key (&key, path, TRUE,
+				      &params, sizeof (params)))
+    {
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+    }
+
+    status = _cairo_path_cache_lookup (&key, polygon, &admit);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED || ! admit)
+	return status;
+
+    /* The cached polygon must not depend upon the clip, so generate
+     * it without limits and clip it afterwards.
+     */
+    _cairo_polygon_init (&flat, NULL, 0);
+    status = fill (path, tolerance, &flat);
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	_cairo_path_cache_insert (&key, &flat);
+	status = _cairo_polygon_add_edges (polygon,
+					   flat.edges, flat.num_edges,
+					   0, 0);
+    }
+    _cairo_polygon_fini (&flat);
+
+    return status;
+}
+
+/**
+ * _cairo_path_cache_stroke_to_polygon:
+ * @path: the path to stroke
+ * @style: the stroke style
+ * @ctm: the transformation of the pen
+ * @ctm_inverse: the inverse of @ctm
+ * @tolerance: the flattening tolerance
+ * @stroke: the function that generates the polygon on a cache miss
+ * @polygon: the polygon to add the edges to
+ *
+ * Adds the edges of the outline of @path to @polygon, reusing the
+ * edges from a previous stroke of the same path if possible.
+ *
+ * Unlike for fills, the stroker computes the miters of joins from
+ * the position of the path in floating point, so the cached outline is
+ * only reused for the path at exactly the same position.  It is also
+ * specific to the limits of @polygon, a single box at most.
+ *
+ * Return value: %CAIRO_INT_STATUS_UNSUPPORTED if the path is not
+ * cached, in which case the caller must generate the polygon itself.
+ **/
+cairo_int_status_t
+_cairo_path_cache_stroke_to_polygon (const cairo_path_fixed_t	 *path,
+				     const cairo_stroke_style_t	 *style,
+				     const cairo_matrix_t	 *ctm,
+				     const cairo_matrix_t	 *ctm_inverse,
+				     double			  tolerance,
+				     cairo_path_cache_stroke_func_t stroke,
+				     cairo_polygon_t		 *polygon)
+{
+    cairo_path_cache_stroke_params_t params;
+    cairo_path_cache_entry_t key;
+    cairo_polygon_t outline;
+    cairo_int_status_t status;
+    cairo_bool_t admit;
+    unsigned int n;
+
+    /* A few straight solid lines without round joins or caps are
+     * stroked about as quickly as their outline could be looked up.
+     */
+    if (! path->has_curve_to &&
+	style->num_dashes == 0 &&
+	style->line_join != CAIRO_LINE_JOIN_ROUND &&
+	style->line_cap != CAIRO_LINE_CAP_ROUND)
+    {
+	const cairo_path_buf_t *buf = cairo_path_head (path);
+
+	if (cairo_path_buf_next (buf) == buf &&
+	    buf->num_points < CAIRO_PATH_CACHE_MIN_STROKE_POINTS)
+	{
+	    return CAIRO_INT_STATUS_UNSUPPORTED;
+	}
+    }
+
+    if (style->num_dashes > CAIRO_PATH_CACHE_MAX_DASHES)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (polygon->num_limits > 1)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    /* zero the padding as well, as the parameters are compared bytewise */
+    memset (&params, 0, sizeof (params));
+    params.type = CAIRO_PATH_CACHE_STROKE;
+    params.tolerance = tolerance;
+    params.xx = ctm->xx;
+    params.yx = ctm->yx;
+    params.xy = ctm->xy;
+    params.yy = ctm->yy;
+    params.line_width = style->line_width;
+    params.miter_limit = style->miter_limit;
+    params.dash_offset = style->dash_offset;
+    params.line_cap = style->line_cap;
+    params.line_join = style->line_join;
+    params.num_dashes = style->num_dashes;
+    for (n = 0; n < style->num_dashes; n++)
+	params.dash[n] = style->dash[n];
+    if (polygon->num_limits)
+	params.limit = polygon->limit;
+
+    if (! _cairo_path_cache_init_key (&key, path, FALSE,
+				      &params, sizeof (params)))
+    {
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+    }
+
+    status = _cairo_path_cache_lookup (&key, polygon, &admit);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED || ! admit)
+	return status;
+
+    /* Generate the outline within the same limits, so that the stroker
+     * can still skip whatever lies well outside them.
+     */
+    _cairo_polygon_init (&outline, polygon->limits, polygon->num_limits);
+    status = stroke (path, style, ctm, ctm_inverse, tolerance, &outline);
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	_cairo_path_cache_insert (&key, &outline);
+	status = _cairo_polygon_add_edges (polygon,
+					   outline.edges, outline.num_edges,
+					   0, 0);
+    }
+    _cairo_polygon_fini (&outline);
+
+    return status;
+}
+
+void
+_cairo_path_cache_reset_static_data (void)
+{
+    CAIRO_MUTEX_LOCK (_cairo_path_cache_mutex);
+
+    if (_cairo_path_cache != NULL) {
+	_cairo_cache_fini (_cairo_path_cache);
+	free (_cairo_path_cache);
+	_cairo_path_cache = NULL;
+    }
+
+    memset (_cairo_path_cache_seen, 0, sizeof (_cairo_path_cache_seen));
+    memset (_cairo_path_cache_too_large, 0, sizeof (_cairo_path_cache_too_large));
+
+    CAIRO_MUTEX_UNLOCK (_cairo_path_cache_mutex);
+}
@@ -38,6 +38,7 @@
 #include "cairoint.h"
 #include "cairo-boxes-private.h"
 #include "cairo-error-private.h"
+#include "cairo-path-cache-private.h"
 #include "cairo-path-fixed-private.h"
 #include "cairo-region-private.h"
 #include "cairo-traps-private.h"
@@ -122,10 +123,10 @@ _cairo_filler_curve_to (void		*closure,
     return _cairo_spline_decompose (&spline, filler->tolerance);
 }
 
-cairo_status_t
-_cairo_path_fixed_fill_to_polygon (const cairo_path_fixed_t *path,
-				   double tolerance,
-				   cairo_polygon_t *polygon)
+static cairo_status_t
+_cairo_path_fixed_flatten_to_polygon (const cairo_path_fixed_t *path,
+				      double tolerance,
+				      cairo_polygon_t *polygon)
 {
     cairo_filler_t filler;
     cairo_status_t status;
@@ -156,6 +157,22 @@ _cairo_path_fixed_fill_to_polygon (const cairo_path_fixed_t *path,
     return _cairo_filler_close (&filler);
 }
 
+cairo_status_t
+_cairo_path_fixed_fill_to_polygon (const cairo_path_fixed_t *path,
+				   double tolerance,
+				   cairo_polygon_t *polygon)
+{
+    cairo_int_status_t status;
+
+    status = _cairo_path_cache_fill_to_polygon (path, tolerance,
+						_cairo_path_fixed_flatten_to_polygon,
+						polygon);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
+    return _cairo_path_fixed_flatten_to_polygon (path, tolerance, polygon);
+}
+
 typedef struct cairo_filler_rectilinear_aligned {
     cairo_polygon_t *polygon;
 
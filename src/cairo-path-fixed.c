@@ -1032,6 +1032,30 @@ _cairo_path_fixed_transform_point (cairo_point_t *p,
     p->y = _cairo_fixed_from_double (dy);
 }
 
+/* Transform a whole buffer of points at once.  The matrix is loaded
+ * just once and the loop carries no dependencies, so that the
+ * compiler is free to vectorize it; the arithmetic is the same as
+ * that of cairo_matrix_transform_point().
+ */
+static void
+_cairo_path_buf_transform_points (cairo_point_t *points,
+				  unsigned int num_points,
+				  const cairo_matrix_t *matrix)
+{
+    const double xx = matrix->xx, yx = matrix->yx;
+    const double xy = matrix->xy, yy = matrix->yy;
+    const double x0 = matrix->x0, y0 = matrix->y0;
+    unsigned int i;
+
+    for (i = 0; i < num_points; i++) {
+	double x = _cairo_fixed_to_double (points[i].x);
+	double y = _cairo_fixed_to_double (points[i].y);
+
+	points[i].x = _cairo_fixed_from_double ((xx * x + xy * y) + x0);
+	points[i].y = _cairo_fixed_from_double ((yx * x + yy * y) + y0);
+    }
+}
+
 /**
  * _cairo_path_fixed_transform:
  * @path: a #cairo_path_fixed_t to be transformed
@@ -1073,10 +1097,9 @@ _cairo_path_fixed_transform (cairo_path_fixed_t	*path,
     _cairo_box_set (&path->extents, &point, &point);
 
     cairo_path_foreach_buf_start (buf, path) {
-	for (i = 0; i < buf->num_points; i++) {
-	    _cairo_path_fixed_transform_point (&buf->points[i], matrix);
+	_cairo_path_buf_transform_points (buf->points, buf->num_points, matrix);
+	for (i = 0; i < buf->num_points; i++)
 	    _cairo_box_add_point (&path->extents, &buf->points[i]);
-	}
     } cairo_path_foreach_buf_end (buf, path);
 
     if (path->has_curve_to) {
@@ -45,6 +45,7 @@
 #include "cairo-contour-inline.h"
 #include "cairo-contour-private.h"
 #include "cairo-error-private.h"
+#include "cairo-path-cache-private.h"
 #include "cairo-path-fixed-private.h"
 #include "cairo-slope-private.h"
 
@@ -1251,13 +1252,13 @@ close_path (void *closure)
     return CAIRO_STATUS_SUCCESS;
 }
 
-cairo_status_t
-_cairo_path_fixed_stroke_to_polygon (const cairo_path_fixed_t	*path,
-				     const cairo_stroke_style_t	*style,
-				     const cairo_matrix_t	*ctm,
-				     const cairo_matrix_t	*ctm_inverse,
-				     double		 tolerance,
-				     cairo_polygon_t *polygon)
+static cairo_status_t
+_cairo_path_fixed_stroke_outline_to_polygon (const cairo_path_fixed_t	*path,
+					     const cairo_stroke_style_t	*style,
+					     const cairo_matrix_t	*ctm,
+					     const cairo_matrix_t	*ctm_inverse,
+					     double		 tolerance,
+					     cairo_polygon_t *polygon)
 {
     struct stroker stroker;
     cairo_status_t status;
@@ -1372,3 +1373,27 @@ _cairo_path_fixed_stroke_to_polygon (const cairo_path_fixed_t	*path,
 
     return status;
 }
+
+cairo_status_t
+_cairo_path_fixed_stroke_to_polygon (const cairo_path_fixed_t	*path,
+				     const cairo_stroke_style_t	*style,
+				     const cairo_matrix_t	*ctm,
+				     const cairo_matrix_t	*ctm_inverse,
+				     double		 tolerance,
+				     cairo_polygon_t *polygon)
+{
+    cairo_int_status_t status;
+
+    status = _cairo_path_cache_stroke_to_polygon (path, style,
+						  ctm, ctm_inverse,
+						  tolerance,
+						  _cairo_path_fixed_stroke_outline_to_polygon,
+						  polygon);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	return status;
+
+    return _cairo_path_fixed_stroke_outline_to_polygon (path, style,
+							ctm, ctm_inverse,
+							tolerance,
+							polygon);
+}
@@ -2043,6 +2043,10 @@ cairo_pattern_get_matrix (cairo_pattern_t *pattern, cairo_matrix_t *matrix)
  * Sets the filter to be used for resizing when using this pattern.
  * See #cairo_filter_t for details on each filter.
  *
+ * Gradients are not resized, but the image backend may take
+ * %CAIRO_FILTER_FAST on a gradient as permission to trade a little
+ * precision in its colors for speed.
+ *
  * * Note that you might want to control filtering even when you do not
  * have an explicit #cairo_pattern_t object, (for example when using
  * cairo_set_source_surface()). In these cases, it is convenient to
@@ -115,6 +115,10 @@ _cairo_pdf_operators_set_stream (cairo_pdf_operators_t 	 *pdf_operators,
 				 cairo_output_stream_t   *stream);
 
 
+cairo_private void
+_cairo_pdf_operators_set_font_subsets (cairo_pdf_operators_t	   *pdf_operators,
+				       cairo_scaled_font_subsets_t *font_subsets);
+
 cairo_private void
 _cairo_pdf_operators_set_cairo_to_pdf_matrix (cairo_pdf_operators_t *pdf_operators,
 					      cairo_matrix_t 	    *cairo_to_pdf);
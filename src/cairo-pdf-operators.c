@@ -97,6 +97,15 @@ _cairo_pdf_operators_set_stream (cairo_pdf_operators_t	 *pdf_operators,
     pdf_operators->has_line_style = FALSE;
 }
 
+/* Subsequent glyphs are mapped into @font_subsets, used when the
+ * previous subsets have already been written out. */
+void
+_cairo_pdf_operators_set_font_subsets (cairo_pdf_operators_t	   *pdf_operators,
+				       cairo_scaled_font_subsets_t *font_subsets)
+{
+    pdf_operators->font_subsets = font_subsets;
+}
+
 void
 _cairo_pdf_operators_set_cairo_to_pdf_matrix (cairo_pdf_operators_t *pdf_operators,
 					      cairo_matrix_t	    *cairo_to_pdf)
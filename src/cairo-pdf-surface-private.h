@@ -78,6 +78,17 @@ typedef struct _cairo_pdf_source_surface_entry {
     cairo_rectangle_int_t extents;
 } cairo_pdf_source_surface_entry_t;
 
+/* Looks up images by their contents, so that a surface drawn again
+ * under a different surface id can reuse the image already written. */
+typedef struct _cairo_pdf_source_digest_entry {
+    cairo_hash_entry_t base;
+    cairo_hash_digest_t digest;
+    cairo_bool_t interpolate;
+    cairo_bool_t stencil_mask;
+    cairo_rectangle_int_t extents;
+    cairo_pdf_source_surface_entry_t *surface_entry;
+} cairo_pdf_source_digest_entry_t;
+
 typedef struct _cairo_pdf_source_surface {
     cairo_pattern_type_t type;
     cairo_surface_t *surface;
@@ -147,6 +158,14 @@ struct _cairo_pdf_surface {
     cairo_array_t page_patterns;
     cairo_array_t page_surfaces;
     cairo_hash_table_t *all_surfaces;
+    cairo_bool_t deduplicate_images;
+    cairo_hash_table_t *surface_digests;
+
+    /* In streaming mode everything buffered for a page is written out
+     * when it is shown, and the font subsets once they grow too large,
+     * so that memory use does not grow with the number of pages. */
+    cairo_bool_t streaming;
+    unsigned long peak_memory;
     cairo_array_t smask_groups;
     cairo_array_t knockout_group;
 
@@ -171,9 +190,34 @@ struct _cairo_pdf_surface {
 	cairo_pdf_resource_t length;
 	long start_offset;
 	cairo_bool_t compressed;
+	cairo_bool_t deferred;
 	cairo_output_stream_t *old_output;
     } pdf_stream;
 
+    /* Compressed streams may be deflated by a pool of threads.  Each
+     * queued stream is followed by a memory buffer that collects the
+     * output up to the next stream, and the whole queue is written to
+     * deferred_output once it has been compressed.
+     */
+    int compress_threads;
+    cairo_output_stream_t *deferred_output;
+    cairo_array_t deflate_jobs;
+    cairo_array_t segment_offsets;
+    unsigned long deflate_pending_size;
+
+    /* Non-stream objects may instead be collected in a memory buffer
+     * and written out in batches as PDF 1.5 object streams.
+     */
+    cairo_bool_t use_object_streams;
+    struct {
+	cairo_bool_t active;
+	cairo_bool_t used;
+	cairo_pdf_resource_t   resource;
+	cairo_output_stream_t *stream;
+	cairo_output_stream_t *old_output;
+	cairo_array_t objects;
+    } object_stream;
+
     struct {
 	cairo_bool_t active;
 	cairo_output_stream_t *stream;
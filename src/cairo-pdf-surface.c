@@ -57,6 +57,7 @@
 #include "cairo-recording-surface-private.h"
 #include "cairo-output-stream-private.h"
 #include "cairo-paginated-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-scaled-font-subsets-private.h"
 #include "cairo-surface-clipper-private.h"
 #include "cairo-surface-snapshot-inline.h"
@@ -169,8 +170,30 @@ static const char *_cairo_pdf_supported_mime_types[] =
 
 typedef struct _cairo_pdf_object {
     long offset;
+    int segment; /* if non-zero, offset is relative to this deferred segment */
+    int object_stream; /* if non-zero, offset is the index in this object stream */
 } cairo_pdf_object_t;
 
+typedef struct _cairo_pdf_object_stream_entry {
+    int id;
+    long offset;
+} cairo_pdf_object_stream_entry_t;
+
+/* The number of objects packed into each object stream */
+#define OBJECT_STREAM_SIZE 100
+
+typedef struct _cairo_pdf_deflate_job {
+    cairo_output_stream_t *data;	/* uncompressed stream contents */
+    cairo_output_stream_t *compressed;
+    cairo_output_stream_t *tail;	/* output following the stream */
+    cairo_pdf_resource_t length;
+    int segment;
+    cairo_status_t status;
+} cairo_pdf_deflate_job_t;
+
+/* Queued streams are compressed once this much data is waiting */
+#define DEFLATE_BATCH_SIZE (16 * 1024 * 1024)
+
 typedef struct _cairo_pdf_font {
     unsigned int font_id;
     unsigned int subset_id;
@@ -230,12 +253,21 @@ _cairo_pdf_surface_write_catalog (cairo_pdf_surface_t *surface);
 static long
 _cairo_pdf_surface_write_xref (cairo_pdf_surface_t *surface);
 
+static cairo_status_t
+_cairo_pdf_surface_write_xref_stream (cairo_pdf_surface_t  *surface,
+				      cairo_pdf_resource_t  catalog,
+				      cairo_pdf_resource_t  info,
+				      long                 *offset);
+
 static cairo_status_t
 _cairo_pdf_surface_write_page (cairo_pdf_surface_t *surface);
 
 static cairo_status_t
 _cairo_pdf_surface_emit_font_subsets (cairo_pdf_surface_t *surface);
 
+static void
+_cairo_pdf_surface_update_peak_memory (cairo_pdf_surface_t *surface);
+
 static cairo_bool_t
 _cairo_pdf_source_surface_equal (const void *key_a, const void *key_b);
 
@@ -250,6 +282,10 @@ _cairo_pdf_surface_new_object (cairo_pdf_surface_t *surface)
     cairo_pdf_object_t object;
 
     object.offset = _cairo_output_stream_get_position (surface->output);
+    object.segment = 0;
+    object.object_stream = 0;
+    if (surface->deferred_output != NULL)
+	object.segment = _cairo_array_num_elements (&surface->segment_offsets);
 
     status = _cairo_array_append (&surface->objects, &object);
     if (unlikely (status)) {
@@ -271,6 +307,10 @@ _cairo_pdf_surface_update_object (cairo_pdf_surface_t	*surface,
 
     object = _cairo_array_index (&surface->objects, resource.id - 1);
     object->offset = _cairo_output_stream_get_position (surface->output);
+    object->segment = 0;
+    object->object_stream = 0;
+    if (surface->deferred_output != NULL)
+	object->segment = _cairo_array_num_elements (&surface->segment_offsets);
 }
 
 static void
@@ -354,6 +394,21 @@ _cairo_pdf_surface_create_for_stream_internal (cairo_output_stream_t	*output,
     surface->height = height;
     cairo_matrix_init (&surface->cairo_to_pdf, 1, 0, 0, -1, 0, height);
 
+    surface->compress_threads = 1;
+    surface->deferred_output = NULL;
+    surface->deflate_pending_size = 0;
+    _cairo_array_init (&surface->deflate_jobs, sizeof (cairo_pdf_deflate_job_t));
+    _cairo_array_init (&surface->segment_offsets, sizeof (long));
+
+    surface->use_object_streams = FALSE;
+    surface->object_stream.active = FALSE;
+    surface->object_stream.used = FALSE;
+    surface->object_stream.resource.id = 0;
+    surface->object_stream.stream = NULL;
+    surface->object_stream.old_output = NULL;
+    _cairo_array_init (&surface->object_stream.objects,
+		       sizeof (cairo_pdf_object_stream_entry_t));
+
     _cairo_array_init (&surface->objects, sizeof (cairo_pdf_object_t));
     _cairo_array_init (&surface->pages, sizeof (cairo_pdf_resource_t));
     _cairo_array_init (&surface->rgb_linear_functions, sizeof (cairo_pdf_rgb_linear_function_t));
@@ -369,6 +424,10 @@ _cairo_pdf_surface_create_for_stream_internal (cairo_output_stream_t	*output,
 	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 	goto BAIL0;
     }
+    surface->deduplicate_images = FALSE;
+    surface->surface_digests = NULL;
+    surface->streaming = FALSE;
+    surface->peak_memory = 0;
 
     _cairo_pdf_group_resources_init (&surface->resources);
 
@@ -390,6 +449,7 @@ _cairo_pdf_surface_create_for_stream_internal (cairo_output_stream_t	*output,
     surface->pdf_version = CAIRO_PDF_VERSION_1_5;
     surface->compress_content = TRUE;
     surface->pdf_stream.active = FALSE;
+    surface->pdf_stream.deferred = FALSE;
     surface->pdf_stream.old_output = NULL;
     surface->group_stream.active = FALSE;
     surface->group_stream.stream = NULL;
@@ -683,6 +743,157 @@ cairo_pdf_surface_set_size (cairo_surface_t	*surface,
 	status = _cairo_surface_set_error (surface, status);
 }
 
+/**
+ * cairo_pdf_surface_set_compression_threads:
+ * @surface: a PDF #cairo_surface_t
+ * @num_threads: the maximum number of threads to use, or 0 for one
+ * per available processor
+ *
+ * Allow cairo to compress the image and content streams of @surface
+ * using up to @num_threads threads. Compressed streams are then queued
+ * while drawing continues and are deflated together, in parallel, once
+ * enough data is waiting or the surface is finished. The document
+ * written is identical to that produced with a single thread, which
+ * remains the default, but is delivered to the output in larger bursts.
+ * The same threads are used to subset the embedded fonts when the
+ * surface is finished.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_compression_threads (cairo_surface_t	*surface,
+					   int			 num_threads)
+{
+    cairo_pdf_surface_t *pdf_surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (surface, &pdf_surface))
+	return;
+
+    if (num_threads <= 0)
+	num_threads = _cairo_parallel_num_cpus ();
+
+    pdf_surface->compress_threads = num_threads;
+}
+
+/**
+ * cairo_pdf_surface_set_deduplicate_images:
+ * @surface: a PDF #cairo_surface_t
+ * @deduplicate: %TRUE to write each distinct image only once
+ *
+ * Images are normally shared between uses only when they are drawn
+ * from the same #cairo_surface_t or carry the same
+ * %CAIRO_MIME_TYPE_UNIQUE_ID. With deduplication enabled, the contents
+ * of other images (their JPEG or JPEG 2000 data if attached, otherwise
+ * their pixels) are hashed as they are added, and an image identical
+ * to one already in the document refers to that copy instead of being
+ * written again. This costs a pass over the data of each new image.
+ * The default is %FALSE.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_deduplicate_images (cairo_surface_t	*surface,
+					  cairo_bool_t		 deduplicate)
+{
+    cairo_pdf_surface_t *pdf_surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (surface, &pdf_surface))
+	return;
+
+    pdf_surface->deduplicate_images = deduplicate;
+}
+
+/**
+ * cairo_pdf_surface_set_streaming:
+ * @surface: a PDF #cairo_surface_t
+ * @streaming: %TRUE to write out each page as soon as it is shown
+ *
+ * In streaming mode the memory used by @surface stays bounded however
+ * many pages are drawn. Everything buffered for a page, including
+ * streams queued by cairo_pdf_surface_set_compression_threads() and
+ * pending object streams, is written out and the output flushed as
+ * soon as the page is shown. Fonts are normally embedded once, with
+ * the glyphs used by the whole document, when the surface is
+ * finished; in streaming mode, once the glyphs in use exceed an
+ * internal limit the fonts are embedded with the glyphs used so far,
+ * and later pages start new subsets. This can make the document
+ * larger, as a font may then be embedded several times.
+ *
+ * The default is %FALSE. See cairo_pdf_surface_get_peak_memory().
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_streaming (cairo_surface_t	*surface,
+				 cairo_bool_t		 streaming)
+{
+    cairo_pdf_surface_t *pdf_surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (surface, &pdf_surface))
+	return;
+
+    pdf_surface->streaming = streaming;
+}
+
+/**
+ * cairo_pdf_surface_get_peak_memory:
+ * @surface: a PDF #cairo_surface_t
+ *
+ * Reports the largest amount of memory @surface has held for the
+ * document so far, such as the object table, font subsets and output
+ * waiting to be compressed or written. It is sampled as each page is
+ * shown and when the surface is finished, and does not include the
+ * recording of the page being drawn or the fonts and images passed in
+ * by the application.
+ *
+ * Return value: an estimate of the peak memory use, in bytes, or 0 if
+ * @surface is not a PDF surface.
+ *
+ * Since: 1.14
+ **/
+unsigned long
+cairo_pdf_surface_get_peak_memory (cairo_surface_t *surface)
+{
+    cairo_pdf_surface_t *pdf_surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (surface, &pdf_surface))
+	return 0;
+
+    return pdf_surface->peak_memory;
+}
+
+/**
+ * cairo_pdf_surface_set_object_streams:
+ * @surface: a PDF #cairo_surface_t
+ * @use_object_streams: %TRUE to pack objects into object streams
+ *
+ * Controls whether the dictionaries and arrays written to @surface,
+ * such as pages, font descriptors, patterns and graphics states, are
+ * packed together into compressed object streams, with a
+ * cross-reference stream in place of the cross-reference table and
+ * trailer. This typically makes documents with many pages or fonts
+ * considerably smaller, but requires a PDF 1.5 reader, so it has no
+ * effect if the surface has been restricted to an earlier version
+ * with cairo_pdf_surface_restrict_to_version(). The default is
+ * %FALSE.
+ *
+ * This function should be called before any drawing operations
+ * are performed on the surface.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_pdf_surface_set_object_streams (cairo_surface_t	*surface,
+				      cairo_bool_t	 use_object_streams)
+{
+    cairo_pdf_surface_t *pdf_surface = NULL; /* hide compiler warning */
+
+    if (! _extract_pdf_surface (surface, &pdf_surface))
+	return;
+
+    pdf_surface->use_object_streams = use_object_streams;
+}
+
 static void
 _cairo_pdf_surface_clear (cairo_pdf_surface_t *surface)
 {
@@ -1102,6 +1313,21 @@ _cairo_pdf_source_surface_equal (const void *key_a, const void *key_b)
     return (a->id == b->id);
 }
 
+static cairo_bool_t
+_cairo_pdf_source_digest_equal (const void *key_a, const void *key_b)
+{
+    const cairo_pdf_source_digest_entry_t *a = key_a;
+    const cairo_pdf_source_digest_entry_t *b = key_b;
+
+    return a->interpolate == b->interpolate &&
+	   a->stencil_mask == b->stencil_mask &&
+	   a->extents.x == b->extents.x &&
+	   a->extents.y == b->extents.y &&
+	   a->extents.width == b->extents.width &&
+	   a->extents.height == b->extents.height &&
+	   _cairo_hash_digest_equal (&a->digest, &b->digest);
+}
+
 static void
 _cairo_pdf_source_surface_init_key (cairo_pdf_source_surface_entry_t *key)
 {
@@ -1113,6 +1339,47 @@ _cairo_pdf_source_surface_init_key (cairo_pdf_source_surface_entry_t *key)
     }
 }
 
+static cairo_status_t
+_cairo_pdf_surface_lookup_source_digest (cairo_pdf_surface_t		   *surface,
+					 cairo_surface_t		   *source,
+					 cairo_bool_t			    interpolate,
+					 cairo_bool_t			    stencil_mask,
+					 const cairo_rectangle_int_t	   *extents,
+					 cairo_pdf_source_digest_entry_t   *key,
+					 cairo_bool_t			   *has_digest,
+					 cairo_pdf_source_digest_entry_t  **entry)
+{
+    cairo_int_status_t status;
+
+    *has_digest = FALSE;
+    *entry = NULL;
+
+    status = _cairo_surface_get_content_digest (source,
+						_cairo_pdf_supported_mime_types,
+						&key->digest);
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED)
+	return CAIRO_STATUS_SUCCESS;
+    if (unlikely (status))
+	return status;
+
+    if (surface->surface_digests == NULL) {
+	surface->surface_digests = _cairo_hash_table_create (_cairo_pdf_source_digest_equal);
+	if (unlikely (surface->surface_digests == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    key->base.hash = _cairo_hash_digest_to_hash (&key->digest);
+    key->interpolate = interpolate;
+    key->stencil_mask = stencil_mask;
+    key->extents = *extents;
+    key->surface_entry = NULL;
+
+    *has_digest = TRUE;
+    *entry = _cairo_hash_table_lookup (surface->surface_digests, &key->base);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 static cairo_int_status_t
 _cairo_pdf_surface_acquire_source_image_from_pattern (cairo_pdf_surface_t          *surface,
 						      const cairo_pattern_t        *pattern,
@@ -1297,7 +1564,9 @@ _get_source_surface_size (cairo_surface_t         *source,
  * a PDF resource to reference the image. A hash table of all images
  * in the PDF files (keyed by CAIRO_MIME_TYPE_UNIQUE_ID or surface
  * unique_id) to ensure surfaces with the same id are only written
- * once to the PDF file.
+ * once to the PDF file. If image deduplication is enabled, surfaces
+ * without a CAIRO_MIME_TYPE_UNIQUE_ID are also matched by a digest of
+ * their contents, so that copies of an image are only written once.
  *
  * Only one of @source_pattern or @source_surface is to be
  * specified. Set the other to NULL.
@@ -1319,9 +1588,12 @@ _cairo_pdf_surface_add_source_surface (cairo_pdf_surface_t	    *surface,
     cairo_pdf_source_surface_t src_surface;
     cairo_pdf_source_surface_entry_t surface_key;
     cairo_pdf_source_surface_entry_t *surface_entry;
+    cairo_pdf_source_digest_entry_t digest_key;
+    cairo_pdf_source_digest_entry_t *digest_entry = NULL;
+    cairo_bool_t has_digest = FALSE;
     cairo_status_t status;
     cairo_bool_t interpolate;
-    unsigned char *unique_id;
+    unsigned char *unique_id = NULL;
     unsigned long unique_id_length = 0;
     cairo_image_surface_t *image;
     void *image_extra;
@@ -1390,6 +1662,22 @@ _cairo_pdf_surface_add_source_surface (cairo_pdf_surface_t	    *surface,
 	    unique_id = NULL;
 	    unique_id_length = 0;
 	}
+
+	if (surface->deduplicate_images &&
+	    unique_id == NULL &&
+	    ! (source_pattern && source_pattern->type == CAIRO_PATTERN_TYPE_RASTER_SOURCE))
+	{
+	    status = _cairo_pdf_surface_lookup_source_digest (surface,
+							      source_surface,
+							      interpolate,
+							      stencil_mask,
+							      source_extents,
+							      &digest_key,
+							      &has_digest,
+							      &digest_entry);
+	    if (unlikely (status))
+		goto release_source;
+	}
     }
 
 release_source:
@@ -1415,6 +1703,19 @@ release_source:
     surface_entry->extents = *source_extents;
     _cairo_pdf_source_surface_init_key (surface_entry);
 
+    if (digest_entry != NULL) {
+	/* The same image has already been added under another id;
+	 * remember this id too but do not write the image again. */
+	surface_entry->surface_res = digest_entry->surface_entry->surface_res;
+	status = _cairo_hash_table_insert (surface->all_surfaces,
+					   &surface_entry->base);
+	if (unlikely (status))
+	    goto fail2;
+
+	*surface_res = surface_entry->surface_res;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
     src_surface.hash_entry = surface_entry;
     if (source_pattern && source_pattern->type == CAIRO_PATTERN_TYPE_RASTER_SOURCE) {
 	src_surface.type = CAIRO_PATTERN_TYPE_RASTER_SOURCE;
@@ -1446,6 +1747,19 @@ release_source:
 
     *surface_res = surface_entry->surface_res;
 
+    if (has_digest) {
+	digest_entry = malloc (sizeof (cairo_pdf_source_digest_entry_t));
+	if (unlikely (digest_entry == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	*digest_entry = digest_key;
+	digest_entry->surface_entry = surface_entry;
+	status = _cairo_hash_table_insert (surface->surface_digests,
+					   &digest_entry->base);
+	if (unlikely (status))
+	    free (digest_entry);
+    }
+
     return status;
 
 fail3:
@@ -1577,6 +1891,105 @@ _cairo_pdf_surface_add_pdf_pattern (cairo_pdf_surface_t		*surface,
 							  gstate_res);
 }
 
+static void
+_cairo_pdf_deflate_job_run (void *closure, int n)
+{
+    cairo_pdf_deflate_job_t *job = (cairo_pdf_deflate_job_t *) closure + n;
+    cairo_output_stream_t *deflate;
+
+    job->compressed = _cairo_memory_stream_create ();
+    deflate = _cairo_deflate_stream_create (job->compressed);
+    _cairo_memory_stream_copy (job->data, deflate);
+    job->status = _cairo_output_stream_destroy (deflate);
+}
+
+static void
+_cairo_pdf_deflate_job_fini (cairo_pdf_deflate_job_t *job)
+{
+    cairo_status_t status_ignored;
+
+    if (job->data != NULL)
+	status_ignored = _cairo_output_stream_destroy (job->data);
+    if (job->compressed != NULL)
+	status_ignored = _cairo_output_stream_destroy (job->compressed);
+    if (job->tail != NULL)
+	status_ignored = _cairo_output_stream_destroy (job->tail);
+}
+
+/* Compress every queued stream, using the pool of threads, and write
+ * them out in order.  Each is laid out exactly as if it had been
+ * deflated inline by _cairo_pdf_surface_close_stream(), and the
+ * segment that follows it is placed straight after its /Length
+ * object, so the document is identical to one written serially.
+ */
+static cairo_status_t
+_cairo_pdf_surface_flush_deflate_jobs (cairo_pdf_surface_t *surface)
+{
+    cairo_output_stream_t *output = surface->deferred_output;
+    cairo_pdf_deflate_job_t *jobs;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    int num_jobs, i;
+
+    /* The queue can only be written out between streams */
+    if (output == NULL ||
+	surface->pdf_stream.active ||
+	surface->group_stream.active)
+	return CAIRO_STATUS_SUCCESS;
+
+    _cairo_pdf_surface_update_peak_memory (surface);
+
+    jobs = _cairo_array_index (&surface->deflate_jobs, 0);
+    num_jobs = _cairo_array_num_elements (&surface->deflate_jobs);
+
+    _cairo_parallel_for (surface->compress_threads, num_jobs,
+			 _cairo_pdf_deflate_job_run, jobs);
+
+    for (i = 0; i < num_jobs; i++) {
+	cairo_pdf_deflate_job_t *job = &jobs[i];
+	cairo_pdf_object_t *object;
+	long start, length;
+
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = job->status;
+
+	start = _cairo_output_stream_get_position (output);
+	_cairo_memory_stream_copy (job->compressed, output);
+	length = _cairo_output_stream_get_position (output) - start;
+	_cairo_output_stream_printf (output,
+				     "\n"
+				     "endstream\n"
+				     "endobj\n");
+
+	object = _cairo_array_index (&surface->objects, job->length.id - 1);
+	object->offset = _cairo_output_stream_get_position (output);
+	object->segment = 0;
+	object->object_stream = 0;
+	_cairo_output_stream_printf (output,
+				     "%d 0 obj\n"
+				     "   %ld\n"
+				     "endobj\n",
+				     job->length.id,
+				     length);
+
+	*(long *) _cairo_array_index (&surface->segment_offsets, job->segment - 1) =
+	    _cairo_output_stream_get_position (output);
+	_cairo_memory_stream_copy (job->tail, output);
+
+	_cairo_pdf_deflate_job_fini (job);
+    }
+    _cairo_array_truncate (&surface->deflate_jobs, 0);
+    surface->deflate_pending_size = 0;
+
+    surface->deferred_output = NULL;
+    surface->output = output;
+    _cairo_pdf_operators_set_stream (&surface->pdf_operators, surface->output);
+
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = _cairo_output_stream_get_status (surface->output);
+
+    return status;
+}
+
 static cairo_status_t
 _cairo_pdf_surface_open_stream (cairo_pdf_surface_t	*surface,
 				cairo_pdf_resource_t    *resource,
@@ -1587,6 +2000,7 @@ _cairo_pdf_surface_open_stream (cairo_pdf_surface_t	*surface,
     va_list ap;
     cairo_pdf_resource_t self, length;
     cairo_output_stream_t *output = NULL;
+    cairo_bool_t deferred;
 
     if (resource) {
 	self = *resource;
@@ -1601,7 +2015,33 @@ _cairo_pdf_surface_open_stream (cairo_pdf_surface_t	*surface,
     if (length.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
-    if (compressed) {
+    /* Streams written into a group are copied out later and cannot be
+     * deferred.
+     */
+    deferred = compressed &&
+	surface->compress_threads > 1 &&
+	! surface->group_stream.active;
+    if (deferred) {
+	cairo_pdf_deflate_job_t job;
+	cairo_status_t status;
+
+	job.data = _cairo_memory_stream_create ();
+	job.compressed = NULL;
+	job.tail = NULL;
+	job.length = length;
+	job.segment = 0;
+	job.status = CAIRO_STATUS_SUCCESS;
+	if (_cairo_output_stream_get_status (job.data))
+	    return _cairo_output_stream_destroy (job.data);
+
+	status = _cairo_array_append (&surface->deflate_jobs, &job);
+	if (unlikely (status)) {
+	    _cairo_pdf_deflate_job_fini (&job);
+	    return status;
+	}
+
+	output = job.data;
+    } else if (compressed) {
 	output = _cairo_deflate_stream_create (surface->output);
 	if (_cairo_output_stream_get_status (output))
 	    return _cairo_output_stream_destroy (output);
@@ -1611,6 +2051,7 @@ _cairo_pdf_surface_open_stream (cairo_pdf_surface_t	*surface,
     surface->pdf_stream.self = self;
     surface->pdf_stream.length = length;
     surface->pdf_stream.compressed = compressed;
+    surface->pdf_stream.deferred = deferred;
     surface->current_pattern_is_solid_color = FALSE;
     surface->current_operator = CAIRO_OPERATOR_OVER;
     _cairo_pdf_operators_reset (&surface->pdf_operators);
@@ -1649,7 +2090,7 @@ _cairo_pdf_surface_open_stream (cairo_pdf_surface_t	*surface,
 static cairo_status_t
 _cairo_pdf_surface_close_stream (cairo_pdf_surface_t *surface)
 {
-    cairo_status_t status;
+    cairo_status_t status, status2;
     long length;
 
     if (! surface->pdf_stream.active)
@@ -1657,9 +2098,46 @@ _cairo_pdf_surface_close_stream (cairo_pdf_surface_t *surface)
 
     status = _cairo_pdf_operators_flush (&surface->pdf_operators);
 
-    if (surface->pdf_stream.compressed) {
-	cairo_status_t status2;
+    if (surface->pdf_stream.deferred) {
+	cairo_pdf_deflate_job_t *job;
+	cairo_output_stream_t *tail;
+	long segment = -1;
+
+	/* The stream is finished off once it has been compressed; in the
+	 * meantime everything that follows goes into a new segment.
+	 */
+	surface->pdf_stream.active = FALSE;
+
+	job = _cairo_array_index (&surface->deflate_jobs,
+				  _cairo_array_num_elements (&surface->deflate_jobs) - 1);
+	surface->deflate_pending_size += _cairo_memory_stream_length (job->data);
+
+	tail = _cairo_memory_stream_create ();
+	status2 = _cairo_array_append (&surface->segment_offsets, &segment);
+	if (unlikely (status2))
+	    tail = _cairo_output_stream_create_in_error (status2);
+	job->tail = tail;
+	job->segment = _cairo_array_num_elements (&surface->segment_offsets);
+
+	if (surface->deferred_output == NULL)
+	    surface->deferred_output = surface->pdf_stream.old_output;
+	surface->output = tail;
+	_cairo_pdf_operators_set_stream (&surface->pdf_operators, surface->output);
+	surface->pdf_stream.old_output = NULL;
+
+	if (likely (status == CAIRO_STATUS_SUCCESS))
+	    status = _cairo_output_stream_get_status (tail);
+
+	if (surface->deflate_pending_size >= DEFLATE_BATCH_SIZE) {
+	    status2 = _cairo_pdf_surface_flush_deflate_jobs (surface);
+	    if (likely (status == CAIRO_STATUS_SUCCESS))
+		status = status2;
+	}
+
+	return status;
+    }
 
+    if (surface->pdf_stream.compressed) {
 	status2 = _cairo_output_stream_destroy (surface->output);
 	if (likely (status == CAIRO_STATUS_SUCCESS))
 	    status = status2;
@@ -1693,6 +2171,147 @@ _cairo_pdf_surface_close_stream (cairo_pdf_surface_t *surface)
     return status;
 }
 
+/* With object streams enabled, each non-stream object is written into
+ * a memory buffer and a batch of them is later emitted as a single
+ * compressed /ObjStm stream.  Objects must not be nested and must be
+ * written between streams.
+ */
+static void
+_cairo_pdf_surface_object_begin (cairo_pdf_surface_t  *surface,
+				 cairo_pdf_resource_t  resource)
+{
+    cairo_pdf_object_stream_entry_t entry;
+    cairo_pdf_object_t *object;
+
+    assert (! surface->object_stream.active);
+
+    if (! surface->use_object_streams ||
+	surface->pdf_version < CAIRO_PDF_VERSION_1_5)
+	goto DIRECT;
+
+    if (surface->object_stream.stream == NULL) {
+	surface->object_stream.stream = _cairo_memory_stream_create ();
+	if (_cairo_output_stream_get_status (surface->object_stream.stream)) {
+	    cairo_status_t status_ignored;
+
+	    status_ignored = _cairo_output_stream_destroy (surface->object_stream.stream);
+	    surface->object_stream.stream = NULL;
+	    goto DIRECT;
+	}
+    }
+
+    if (surface->object_stream.resource.id == 0) {
+	surface->object_stream.resource = _cairo_pdf_surface_new_object (surface);
+	if (surface->object_stream.resource.id == 0)
+	    goto DIRECT;
+    }
+
+    entry.id = resource.id;
+    entry.offset = _cairo_memory_stream_length (surface->object_stream.stream);
+    if (_cairo_array_append (&surface->object_stream.objects, &entry))
+	goto DIRECT;
+
+    object = _cairo_array_index (&surface->objects, resource.id - 1);
+    object->offset = _cairo_array_num_elements (&surface->object_stream.objects) - 1;
+    object->segment = 0;
+    object->object_stream = surface->object_stream.resource.id;
+
+    surface->object_stream.active = TRUE;
+    surface->object_stream.used = TRUE;
+    surface->object_stream.old_output = surface->output;
+    surface->output = surface->object_stream.stream;
+    return;
+
+DIRECT:
+    /* Should we fail to queue the object, it is simply written out
+     * in full instead.
+     */
+    _cairo_pdf_surface_update_object (surface, resource);
+    _cairo_output_stream_printf (surface->output,
+				 "%d 0 obj\n",
+				 resource.id);
+}
+
+static cairo_status_t
+_cairo_pdf_surface_emit_object_stream (cairo_pdf_surface_t *surface)
+{
+    cairo_pdf_object_stream_entry_t *entries;
+    cairo_output_stream_t *header;
+    cairo_status_t status, status2;
+    int num_objects, i;
+
+    num_objects = _cairo_array_num_elements (&surface->object_stream.objects);
+    if (num_objects == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    header = _cairo_memory_stream_create ();
+    entries = _cairo_array_index (&surface->object_stream.objects, 0);
+    for (i = 0; i < num_objects; i++) {
+	_cairo_output_stream_printf (header,
+				     "%d %ld\n",
+				     entries[i].id,
+				     entries[i].offset);
+    }
+    status = _cairo_output_stream_get_status (header);
+    if (unlikely (status))
+	goto BAIL;
+
+    status = _cairo_pdf_surface_open_stream (surface,
+					     &surface->object_stream.resource,
+					     TRUE,
+					     "   /Type /ObjStm\n"
+					     "   /N %d\n"
+					     "   /First %d\n",
+					     num_objects,
+					     _cairo_memory_stream_length (header));
+    if (unlikely (status))
+	goto BAIL;
+
+    _cairo_memory_stream_copy (header, surface->output);
+    _cairo_memory_stream_copy (surface->object_stream.stream, surface->output);
+    status = _cairo_pdf_surface_close_stream (surface);
+
+BAIL:
+    status2 = _cairo_output_stream_destroy (header);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = status2;
+
+    status2 = _cairo_output_stream_destroy (surface->object_stream.stream);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = status2;
+
+    surface->object_stream.stream = NULL;
+    surface->object_stream.resource.id = 0;
+    _cairo_array_truncate (&surface->object_stream.objects, 0);
+
+    return status;
+}
+
+static void
+_cairo_pdf_surface_object_end (cairo_pdf_surface_t *surface)
+{
+    cairo_status_t status, status_ignored;
+
+    if (! surface->object_stream.active) {
+	_cairo_output_stream_printf (surface->output,
+				     "endobj\n");
+	return;
+    }
+
+    surface->output = surface->object_stream.old_output;
+    surface->object_stream.old_output = NULL;
+    surface->object_stream.active = FALSE;
+
+    if (_cairo_array_num_elements (&surface->object_stream.objects) >= OBJECT_STREAM_SIZE &&
+	! surface->pdf_stream.active &&
+	! surface->group_stream.active)
+    {
+	status = _cairo_pdf_surface_emit_object_stream (surface);
+	if (unlikely (status))
+	    status_ignored = _cairo_surface_set_error (&surface->base, status);
+    }
+}
+
 static void
 _cairo_pdf_surface_write_memory_stream (cairo_pdf_surface_t         *surface,
 					cairo_output_stream_t       *mem_stream,
@@ -1913,13 +2532,9 @@ _cairo_pdf_surface_close_content_stream (cairo_pdf_surface_t *surface)
     if (unlikely (status))
 	return status;
 
-    _cairo_pdf_surface_update_object (surface, surface->content_resources);
-    _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n",
-				 surface->content_resources.id);
+    _cairo_pdf_surface_object_begin (surface, surface->content_resources);
     _cairo_pdf_surface_emit_group_resources (surface, &surface->resources);
-    _cairo_output_stream_printf (surface->output,
-				 "endobj\n");
+    _cairo_pdf_surface_object_end (surface);
 
     return _cairo_output_stream_get_status (surface->output);
 }
@@ -1936,14 +2551,26 @@ _cairo_pdf_source_surface_entry_pluck (void *entry, void *closure)
     free (surface_entry);
 }
 
-static cairo_status_t
-_cairo_pdf_surface_finish (void *abstract_surface)
+static void
+_cairo_pdf_source_digest_entry_pluck (void *entry, void *closure)
+{
+    cairo_pdf_source_digest_entry_t *digest_entry = entry;
+    cairo_hash_table_t *digests = closure;
+
+    _cairo_hash_table_remove (digests, &digest_entry->base);
+    free (digest_entry);
+}
+
+static cairo_status_t
+_cairo_pdf_surface_finish (void *abstract_surface)
 {
     cairo_pdf_surface_t *surface = abstract_surface;
     long offset;
     cairo_pdf_resource_t info, catalog;
     cairo_status_t status, status2;
 
+    _cairo_pdf_surface_update_peak_memory (surface);
+
     status = surface->base.status;
     if (status == CAIRO_STATUS_SUCCESS)
 	status = _cairo_pdf_surface_emit_font_subsets (surface);
@@ -1958,17 +2585,34 @@ _cairo_pdf_surface_finish (void *abstract_surface)
     if (catalog.id == 0 && status == CAIRO_STATUS_SUCCESS)
 	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
-    offset = _cairo_pdf_surface_write_xref (surface);
+    status2 = _cairo_pdf_surface_emit_object_stream (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = status2;
 
-    _cairo_output_stream_printf (surface->output,
-				 "trailer\n"
-				 "<< /Size %d\n"
-				 "   /Root %d 0 R\n"
-				 "   /Info %d 0 R\n"
-				 ">>\n",
-				 surface->next_available_resource.id,
-				 catalog.id,
-				 info.id);
+    status2 = _cairo_pdf_surface_flush_deflate_jobs (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = status2;
+
+    if (surface->object_stream.used) {
+	/* Compressed objects can only be located by a cross-reference
+	 * stream, which also takes the place of the trailer. */
+	status2 = _cairo_pdf_surface_write_xref_stream (surface, catalog, info,
+							&offset);
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = status2;
+    } else {
+	offset = _cairo_pdf_surface_write_xref (surface);
+
+	_cairo_output_stream_printf (surface->output,
+				     "trailer\n"
+				     "<< /Size %d\n"
+				     "   /Root %d 0 R\n"
+				     "   /Info %d 0 R\n"
+				     ">>\n",
+				     surface->next_available_resource.id,
+				     catalog.id,
+				     info.id);
+    }
 
     _cairo_output_stream_printf (surface->output,
 				 "startxref\n"
@@ -2000,8 +2644,24 @@ _cairo_pdf_surface_finish (void *abstract_surface)
     }
     if (surface->pdf_stream.active)
 	surface->output = surface->pdf_stream.old_output;
-    if (surface->group_stream.active)
+    if (surface->group_stream.active) {
 	surface->output = surface->group_stream.old_output;
+	surface->group_stream.active = FALSE;
+    }
+    if (surface->object_stream.active) {
+	surface->output = surface->object_stream.old_output;
+	surface->object_stream.active = FALSE;
+    }
+    if (surface->object_stream.stream != NULL) {
+	status2 = _cairo_output_stream_destroy (surface->object_stream.stream);
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = status2;
+    }
+
+    /* write out any streams still waiting to be compressed */
+    status2 = _cairo_pdf_surface_flush_deflate_jobs (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = status2;
 
     /* and finish the pdf surface */
     status2 = _cairo_output_stream_destroy (surface->output);
@@ -2012,6 +2672,9 @@ _cairo_pdf_surface_finish (void *abstract_surface)
     _cairo_pdf_group_resources_fini (&surface->resources);
 
     _cairo_array_fini (&surface->objects);
+    _cairo_array_fini (&surface->deflate_jobs);
+    _cairo_array_fini (&surface->segment_offsets);
+    _cairo_array_fini (&surface->object_stream.objects);
     _cairo_array_fini (&surface->pages);
     _cairo_array_fini (&surface->rgb_linear_functions);
     _cairo_array_fini (&surface->alpha_linear_functions);
@@ -2021,6 +2684,12 @@ _cairo_pdf_surface_finish (void *abstract_surface)
 			       _cairo_pdf_source_surface_entry_pluck,
 			       surface->all_surfaces);
     _cairo_hash_table_destroy (surface->all_surfaces);
+    if (surface->surface_digests != NULL) {
+	_cairo_hash_table_foreach (surface->surface_digests,
+				   _cairo_pdf_source_digest_entry_pluck,
+				   surface->surface_digests);
+	_cairo_hash_table_destroy (surface->surface_digests);
+    }
     _cairo_array_fini (&surface->smask_groups);
     _cairo_array_fini (&surface->fonts);
     _cairo_array_fini (&surface->knockout_group);
@@ -3000,22 +3669,21 @@ cairo_pdf_surface_emit_rgb_linear_function (cairo_pdf_surface_t    *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 2\n"
 				 "   /Domain [ 0 1 ]\n"
 				 "   /C0 [ %f %f %f ]\n"
 				 "   /C1 [ %f %f %f ]\n"
 				 "   /N 1\n"
-				 ">>\n"
-				 "endobj\n",
-				 res.id,
+				 ">>\n",
                                  stop1->color[0],
                                  stop1->color[1],
                                  stop1->color[2],
                                  stop2->color[0],
                                  stop2->color[1],
                                  stop2->color[2]);
+    _cairo_pdf_surface_object_end (surface);
 
     elem.resource = res;
     memcpy (&elem.color1[0], &stop1->color[0], sizeof (double)*3);
@@ -3053,18 +3721,17 @@ cairo_pdf_surface_emit_alpha_linear_function (cairo_pdf_surface_t    *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 2\n"
 				 "   /Domain [ 0 1 ]\n"
 				 "   /C0 [ %f ]\n"
 				 "   /C1 [ %f ]\n"
 				 "   /N 1\n"
-				 ">>\n"
-				 "endobj\n",
-				 res.id,
+				 ">>\n",
                                  stop1->color[3],
                                  stop2->color[3]);
+    _cairo_pdf_surface_object_end (surface);
 
     elem.resource = res;
     elem.alpha1 = stop1->color[3];
@@ -3111,11 +3778,10 @@ _cairo_pdf_surface_emit_stitched_colorgradient (cairo_pdf_surface_t    *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 3\n"
 				 "   /Domain [ %f %f ]\n",
-				 res.id,
                                  stops[0].offset,
                                  stops[n_stops - 1].offset);
 
@@ -3144,8 +3810,8 @@ _cairo_pdf_surface_emit_stitched_colorgradient (cairo_pdf_surface_t    *surface,
 				 "]\n");
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     *function = res;
 
@@ -3325,11 +3991,10 @@ _cairo_pdf_surface_emit_repeating_function (cairo_pdf_surface_t      *surface,
     if (res.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /FunctionType 3\n"
 				 "   /Domain [ %d %d ]\n",
-				 res.id,
                                  begin,
                                  end);
 
@@ -3364,8 +4029,8 @@ _cairo_pdf_surface_emit_repeating_function (cairo_pdf_surface_t      *surface,
 				 "]\n");
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     *function = res;
 
@@ -3469,30 +4134,27 @@ cairo_pdf_surface_emit_transparency_group (cairo_pdf_surface_t  *surface,
     if (smask_resource.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, smask_resource);
     _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n"
                                  "<< /Type /Mask\n"
                                  "   /S /Luminosity\n"
                                  "   /G %d 0 R\n"
-                                 ">>\n"
-                                 "endobj\n",
-                                 smask_resource.id,
+                                 ">>\n",
                                  surface->pdf_stream.self.id);
+    _cairo_pdf_surface_object_end (surface);
 
     /* Create GState which uses the transparency group as an SMask. */
-    _cairo_pdf_surface_update_object (surface, gstate_resource);
 
+    _cairo_pdf_surface_object_begin (surface, gstate_resource);
     _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n"
                                  "<< /Type /ExtGState\n"
                                  "   /SMask %d 0 R\n"
                                  "   /ca 1\n"
                                  "   /CA 1\n"
                                  "   /AIS false\n"
-                                 ">>\n"
-                                 "endobj\n",
-                                 gstate_resource.id,
+                                 ">>\n",
                                  smask_resource.id);
+    _cairo_pdf_surface_object_end (surface);
 
     return _cairo_output_stream_get_status (surface->output);
 }
@@ -3508,9 +4170,7 @@ _cairo_pdf_surface_output_gradient (cairo_pdf_surface_t        *surface,
 				    const char                 *colorspace,
 				    cairo_pdf_resource_t        color_function)
 {
-    _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n",
-				 pattern_resource.id);
+    _cairo_pdf_surface_object_begin (surface, pattern_resource);
 
     if (!pdf_pattern->is_shading) {
 	_cairo_output_stream_printf (surface->output,
@@ -3565,8 +4225,7 @@ _cairo_pdf_surface_output_gradient (cairo_pdf_surface_t        *surface,
 				     ">>\n");
     }
 
-    _cairo_output_stream_printf (surface->output,
-				     "endobj\n");
+    _cairo_pdf_surface_object_end (surface);
 }
 
 static cairo_status_t
@@ -3683,7 +4342,6 @@ _cairo_pdf_surface_emit_gradient (cairo_pdf_surface_t    *surface,
 	domain[1] = 1.0;
     }
 
-    _cairo_pdf_surface_update_object (surface, pdf_pattern->pattern_res);
     _cairo_pdf_surface_output_gradient (surface, pdf_pattern,
 					pdf_pattern->pattern_res,
 					&pat_to_pdf, &start, &end, domain,
@@ -3773,20 +4431,18 @@ _cairo_pdf_surface_emit_mesh_pattern (cairo_pdf_surface_t    *surface,
 
     _cairo_pdf_shading_fini (&shading);
 
-    _cairo_pdf_surface_update_object (surface, pdf_pattern->pattern_res);
+    _cairo_pdf_surface_object_begin (surface, pdf_pattern->pattern_res);
     _cairo_output_stream_printf (surface->output,
-                                 "%d 0 obj\n"
                                  "<< /Type /Pattern\n"
                                  "   /PatternType 2\n"
                                  "   /Matrix [ %f %f %f %f %f %f ]\n"
                                  "   /Shading %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 pdf_pattern->pattern_res.id,
+				 ">>\n",
                                  pat_to_pdf.xx, pat_to_pdf.yx,
                                  pat_to_pdf.xy, pat_to_pdf.yy,
                                  pat_to_pdf.x0, pat_to_pdf.y0,
 				 res.id);
+    _cairo_pdf_surface_object_end (surface);
 
     if (pdf_pattern->gstate_res.id != 0) {
 	cairo_pdf_resource_t mask_resource;
@@ -3835,19 +4491,18 @@ _cairo_pdf_surface_emit_mesh_pattern (cairo_pdf_surface_t    *surface,
 	if (unlikely (mask_resource.id == 0))
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+	_cairo_pdf_surface_object_begin (surface, mask_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Pattern\n"
 				     "   /PatternType 2\n"
 				     "   /Matrix [ %f %f %f %f %f %f ]\n"
 				     "   /Shading %d 0 R\n"
-				     ">>\n"
-				     "endobj\n",
-				     mask_resource.id,
+				     ">>\n",
 				     pat_to_pdf.xx, pat_to_pdf.yx,
 				     pat_to_pdf.xy, pat_to_pdf.yy,
 				     pat_to_pdf.x0, pat_to_pdf.y0,
 				     res.id);
+	_cairo_pdf_surface_object_end (surface);
 
 	status = cairo_pdf_surface_emit_transparency_group (surface,
 							    pdf_pattern,
@@ -4249,6 +4904,74 @@ _cairo_pdf_surface_unselect_pattern (cairo_pdf_surface_t *surface)
     return CAIRO_STATUS_SUCCESS;
 }
 
+/* In streaming mode, the font subsets are written out and restarted
+ * after any page that takes them over this size. */
+#define STREAMING_FONT_SUBSETS_SIZE (1 << 20)
+
+static void
+_cairo_pdf_surface_update_peak_memory (cairo_pdf_surface_t *surface)
+{
+    unsigned long size;
+
+    size = sizeof (cairo_pdf_surface_t);
+    size += _cairo_array_num_elements (&surface->objects) * sizeof (cairo_pdf_object_t);
+    size += _cairo_array_num_elements (&surface->pages) * sizeof (cairo_pdf_resource_t);
+    size += _cairo_array_num_elements (&surface->fonts) * sizeof (cairo_pdf_font_t);
+    size += _cairo_array_num_elements (&surface->rgb_linear_functions) *
+	    sizeof (cairo_pdf_rgb_linear_function_t);
+    size += _cairo_array_num_elements (&surface->alpha_linear_functions) *
+	    sizeof (cairo_pdf_alpha_linear_function_t);
+    size += _cairo_array_num_elements (&surface->page_patterns) * sizeof (cairo_pdf_pattern_t);
+    size += _cairo_array_num_elements (&surface->page_surfaces) * sizeof (cairo_pdf_source_surface_t);
+    size += _cairo_array_num_elements (&surface->smask_groups) * sizeof (cairo_pdf_smask_group_t);
+    size += surface->deflate_pending_size;
+
+    if (surface->object_stream.stream != NULL)
+	size += _cairo_memory_stream_length (surface->object_stream.stream);
+    if (surface->group_stream.mem_stream != NULL)
+	size += _cairo_memory_stream_length (surface->group_stream.mem_stream);
+    if (surface->font_subsets != NULL)
+	size += _cairo_scaled_font_subsets_get_size (surface->font_subsets);
+
+    if (size > surface->peak_memory)
+	surface->peak_memory = size;
+}
+
+/* Writes out everything still buffered once a page has been shown in
+ * streaming mode. */
+static cairo_int_status_t
+_cairo_pdf_surface_flush_page (cairo_pdf_surface_t *surface)
+{
+    cairo_int_status_t status;
+
+    if (_cairo_scaled_font_subsets_get_size (surface->font_subsets) > STREAMING_FONT_SUBSETS_SIZE) {
+	/* Later pages use a fresh set of subsets, so the fonts
+	 * are embedded again if they are used again. */
+	status = _cairo_pdf_surface_emit_font_subsets (surface);
+	if (unlikely (status))
+	    return status;
+
+	_cairo_array_truncate (&surface->fonts, 0);
+	surface->font_subsets = _cairo_scaled_font_subsets_create_composite ();
+	if (unlikely (surface->font_subsets == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	_cairo_scaled_font_subsets_enable_latin_subset (surface->font_subsets, TRUE);
+	_cairo_pdf_operators_set_font_subsets (&surface->pdf_operators,
+					       surface->font_subsets);
+    }
+
+    status = _cairo_pdf_surface_emit_object_stream (surface);
+    if (unlikely (status))
+	return status;
+
+    status = _cairo_pdf_surface_flush_deflate_jobs (surface);
+    if (unlikely (status))
+	return status;
+
+    return _cairo_output_stream_flush (surface->output);
+}
+
 static cairo_int_status_t
 _cairo_pdf_surface_show_page (void *abstract_surface)
 {
@@ -4265,8 +4988,12 @@ _cairo_pdf_surface_show_page (void *abstract_surface)
     if (unlikely (status))
 	return status;
 
+    _cairo_pdf_surface_update_peak_memory (surface);
     _cairo_pdf_surface_clear (surface);
 
+    if (surface->streaming)
+	return _cairo_pdf_surface_flush_page (surface);
+
     return CAIRO_STATUS_SUCCESS;
 }
 
@@ -4310,15 +5037,14 @@ _cairo_pdf_surface_write_info (cairo_pdf_surface_t *surface)
     if (info.id == 0)
 	return info;
 
+    _cairo_pdf_surface_object_begin (surface, info);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Creator (cairo %s (http://cairographics.org))\n"
 				 "   /Producer (cairo %s (http://cairographics.org))\n"
-				 ">>\n"
-				 "endobj\n",
-				 info.id,
+				 ">>\n",
                                  cairo_version_string (),
                                  cairo_version_string ());
+    _cairo_pdf_surface_object_end (surface);
 
     return info;
 }
@@ -4329,12 +5055,10 @@ _cairo_pdf_surface_write_pages (cairo_pdf_surface_t *surface)
     cairo_pdf_resource_t page;
     int num_pages, i;
 
-    _cairo_pdf_surface_update_object (surface, surface->pages_resource);
+    _cairo_pdf_surface_object_begin (surface, surface->pages_resource);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Pages\n"
-				 "   /Kids [ ",
-				 surface->pages_resource.id);
+				 "   /Kids [ ");
 
     num_pages = _cairo_array_num_elements (&surface->pages);
     for (i = 0; i < num_pages; i++) {
@@ -4349,8 +5073,8 @@ _cairo_pdf_surface_write_pages (cairo_pdf_surface_t *surface)
     /* TODO: Figure out which other defaults to be inherited by /Page
      * objects. */
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 }
 
 static cairo_status_t
@@ -4684,11 +5408,10 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
     if (descriptor.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, descriptor);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /FontDescriptor\n"
 				 "   /FontName /%s+%s\n",
-				 descriptor.id,
 				 tag,
 				 subset->ps_name);
 
@@ -4715,8 +5438,7 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				 "   /StemV 80\n"
 				 "   /StemH 80\n"
 				 "   /FontFile3 %u 0 R\n"
-				 ">>\n"
-				 "endobj\n",
+				 ">>\n",
 				 (long)(subset->x_min*PDF_UNITS_PER_EM),
 				 (long)(subset->y_min*PDF_UNITS_PER_EM),
 				 (long)(subset->x_max*PDF_UNITS_PER_EM),
@@ -4725,6 +5447,7 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				 (long)(subset->descent*PDF_UNITS_PER_EM),
 				 (long)(subset->y_max*PDF_UNITS_PER_EM),
 				 stream.id);
+    _cairo_pdf_surface_object_end (surface);
 
     if (font_subset->is_latin) {
 	/* find last glyph used */
@@ -4733,9 +5456,8 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 		break;
 
 	last_glyph = i;
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /Type1\n"
 				     "   /BaseFont /%s+%s\n"
@@ -4744,7 +5466,6 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /Encoding /WinAnsiEncoding\n"
 				     "   /Widths [",
-				     subset_resource.id,
 				     tag,
 				     subset->ps_name,
 				     last_glyph,
@@ -4770,15 +5491,15 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     } else {
 	cidfont_dict = _cairo_pdf_surface_new_object (surface);
 	if (cidfont_dict.id == 0)
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+	_cairo_pdf_surface_object_begin (surface, cidfont_dict);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /CIDFontType0\n"
 				     "   /BaseFont /%s+%s\n"
@@ -4789,7 +5510,6 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 				     "   >>\n"
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /W [0 [",
-				     cidfont_dict.id,
 				     tag,
 				     subset->ps_name,
 				     descriptor.id);
@@ -4801,18 +5521,16 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 
 	_cairo_output_stream_printf (surface->output,
 				     " ]]\n"
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
 
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /Type0\n"
 				     "   /BaseFont /%s+%s\n"
 				     "   /Encoding /Identity-H\n"
 				     "   /DescendantFonts [ %d 0 R]\n",
-				     subset_resource.id,
 				     tag,
 				     subset->ps_name,
 				     cidfont_dict.id);
@@ -4823,8 +5541,8 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     }
 
     font.font_id = font_subset->font_id;
@@ -4941,8 +5659,8 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
     if (descriptor.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, descriptor);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /FontDescriptor\n"
 				 "   /FontName /%s+%s\n"
 				 "   /Flags 4\n"
@@ -4954,9 +5672,7 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
 				 "   /StemV 80\n"
 				 "   /StemH 80\n"
 				 "   /FontFile %u 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 descriptor.id,
+				 ">>\n",
 				 tag,
 				 subset->base_font,
 				 (long)(subset->x_min*PDF_UNITS_PER_EM),
@@ -4967,17 +5683,16 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
 				 (long)(subset->descent*PDF_UNITS_PER_EM),
 				 (long)(subset->y_max*PDF_UNITS_PER_EM),
 				 stream.id);
+    _cairo_pdf_surface_object_end (surface);
 
-    _cairo_pdf_surface_update_object (surface, subset_resource);
+    _cairo_pdf_surface_object_begin (surface, subset_resource);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Font\n"
 				 "   /Subtype /Type1\n"
 				 "   /BaseFont /%s+%s\n"
 				 "   /FirstChar %d\n"
 				 "   /LastChar %d\n"
 				 "   /FontDescriptor %d 0 R\n",
-				 subset_resource.id,
 				 tag,
 				 subset->base_font,
 				 font_subset->is_latin ? 32 : 0,
@@ -5015,8 +5730,8 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
                                      to_unicode_stream.id);
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     font.font_id = font_subset->font_id;
     font.subset_id = font_subset->subset_id;
@@ -5073,14 +5788,14 @@ _cairo_pdf_surface_emit_type1_fallback_font (cairo_pdf_surface_t	*surface,
 }
 
 static cairo_status_t
-_cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
-					      cairo_scaled_font_subset_t	*font_subset)
+_cairo_pdf_surface_emit_truetype_font (cairo_pdf_surface_t		*surface,
+				       cairo_scaled_font_subset_t	*font_subset,
+				       cairo_truetype_subset_t		*subset)
 {
     cairo_pdf_resource_t stream, descriptor, cidfont_dict;
     cairo_pdf_resource_t subset_resource, to_unicode_stream;
     cairo_status_t status;
     cairo_pdf_font_t font;
-    cairo_truetype_subset_t subset;
     unsigned int i, last_glyph;
     char tag[10];
 
@@ -5090,57 +5805,44 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
     if (subset_resource.id == 0)
 	return CAIRO_STATUS_SUCCESS;
 
-    status = _cairo_truetype_subset_init_pdf (&subset, font_subset);
-    if (unlikely (status))
-	return status;
-
-    _create_font_subset_tag (font_subset, subset.ps_name, tag);
+    _create_font_subset_tag (font_subset, subset->ps_name, tag);
 
     status = _cairo_pdf_surface_open_stream (surface,
 					     NULL,
 					     TRUE,
 					     "   /Length1 %lu\n",
-					     subset.data_length);
-    if (unlikely (status)) {
-	_cairo_truetype_subset_fini (&subset);
+					     subset->data_length);
+    if (unlikely (status))
 	return status;
-    }
 
     stream = surface->pdf_stream.self;
     _cairo_output_stream_write (surface->output,
-				subset.data, subset.data_length);
+				subset->data, subset->data_length);
     status = _cairo_pdf_surface_close_stream (surface);
-    if (unlikely (status)) {
-	_cairo_truetype_subset_fini (&subset);
+    if (unlikely (status))
 	return status;
-    }
 
     status = _cairo_pdf_surface_emit_to_unicode_stream (surface,
 	                                                font_subset,
 							&to_unicode_stream);
-    if (_cairo_status_is_error (status)) {
-	_cairo_truetype_subset_fini (&subset);
+    if (_cairo_status_is_error (status))
 	return status;
-    }
 
     descriptor = _cairo_pdf_surface_new_object (surface);
-    if (descriptor.id == 0) {
-	_cairo_truetype_subset_fini (&subset);
+    if (descriptor.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-    }
 
+    _cairo_pdf_surface_object_begin (surface, descriptor);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /FontDescriptor\n"
 				 "   /FontName /%s+%s\n",
-				 descriptor.id,
 				 tag,
-				 subset.ps_name);
+				 subset->ps_name);
 
-    if (subset.family_name_utf8) {
+    if (subset->family_name_utf8) {
 	char *pdf_str;
 
-	status = _utf8_to_pdf_string (subset.family_name_utf8, &pdf_str);
+	status = _utf8_to_pdf_string (subset->family_name_utf8, &pdf_str);
 	if (unlikely (status))
 	    return status;
 
@@ -5160,17 +5862,17 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				 "   /StemV 80\n"
 				 "   /StemH 80\n"
 				 "   /FontFile2 %u 0 R\n"
-				 ">>\n"
-				 "endobj\n",
+				 ">>\n",
 				 font_subset->is_latin ? 32 : 4,
-				 (long)(subset.x_min*PDF_UNITS_PER_EM),
-				 (long)(subset.y_min*PDF_UNITS_PER_EM),
-                                 (long)(subset.x_max*PDF_UNITS_PER_EM),
-				 (long)(subset.y_max*PDF_UNITS_PER_EM),
-				 (long)(subset.ascent*PDF_UNITS_PER_EM),
-				 (long)(subset.descent*PDF_UNITS_PER_EM),
-				 (long)(subset.y_max*PDF_UNITS_PER_EM),
+				 (long)(subset->x_min*PDF_UNITS_PER_EM),
+				 (long)(subset->y_min*PDF_UNITS_PER_EM),
+                                 (long)(subset->x_max*PDF_UNITS_PER_EM),
+				 (long)(subset->y_max*PDF_UNITS_PER_EM),
+				 (long)(subset->ascent*PDF_UNITS_PER_EM),
+				 (long)(subset->descent*PDF_UNITS_PER_EM),
+				 (long)(subset->y_max*PDF_UNITS_PER_EM),
 				 stream.id);
+    _cairo_pdf_surface_object_end (surface);
 
     if (font_subset->is_latin) {
 	/* find last glyph used */
@@ -5179,9 +5881,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 		break;
 
 	last_glyph = i;
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /TrueType\n"
 				     "   /BaseFont /%s+%s\n"
@@ -5190,9 +5891,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /Encoding /WinAnsiEncoding\n"
 				     "   /Widths [",
-				     subset_resource.id,
 				     tag,
-				     subset.ps_name,
+				     subset->ps_name,
 				     last_glyph,
 				     descriptor.id);
 
@@ -5201,7 +5901,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 	    if (glyph > 0) {
 		_cairo_output_stream_printf (surface->output,
 					     " %ld",
-					     (long)(subset.widths[glyph]*PDF_UNITS_PER_EM));
+					     (long)(subset->widths[glyph]*PDF_UNITS_PER_EM));
 	    } else {
 		_cairo_output_stream_printf (surface->output, " 0");
 	    }
@@ -5216,17 +5916,15 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     } else {
 	cidfont_dict = _cairo_pdf_surface_new_object (surface);
-	if (cidfont_dict.id == 0) {
-	    _cairo_truetype_subset_fini (&subset);
+	if (cidfont_dict.id == 0)
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-	}
 
+	_cairo_pdf_surface_object_begin (surface, cidfont_dict);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /CIDFontType2\n"
 				     "   /BaseFont /%s+%s\n"
@@ -5237,32 +5935,29 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   >>\n"
 				     "   /FontDescriptor %d 0 R\n"
 				     "   /W [0 [",
-				     cidfont_dict.id,
 				     tag,
-				     subset.ps_name,
+				     subset->ps_name,
 				     descriptor.id);
 
 	for (i = 0; i < font_subset->num_glyphs; i++)
 	    _cairo_output_stream_printf (surface->output,
 					 " %ld",
-					 (long)(subset.widths[i]*PDF_UNITS_PER_EM));
+					 (long)(subset->widths[i]*PDF_UNITS_PER_EM));
 
 	_cairo_output_stream_printf (surface->output,
 				     " ]]\n"
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
 
-	_cairo_pdf_surface_update_object (surface, subset_resource);
+	_cairo_pdf_surface_object_begin (surface, subset_resource);
 	_cairo_output_stream_printf (surface->output,
-				     "%d 0 obj\n"
 				     "<< /Type /Font\n"
 				     "   /Subtype /Type0\n"
 				     "   /BaseFont /%s+%s\n"
 				     "   /Encoding /Identity-H\n"
 				     "   /DescendantFonts [ %d 0 R]\n",
-				     subset_resource.id,
 				     tag,
-				     subset.ps_name,
+				     subset->ps_name,
 				     cidfont_dict.id);
 
 	if (to_unicode_stream.id != 0)
@@ -5271,17 +5966,35 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 					 to_unicode_stream.id);
 
 	_cairo_output_stream_printf (surface->output,
-				     ">>\n"
-				     "endobj\n");
+				     ">>\n");
+	_cairo_pdf_surface_object_end (surface);
     }
 
     font.font_id = font_subset->font_id;
     font.subset_id = font_subset->subset_id;
     font.subset_resource = subset_resource;
-    status = _cairo_array_append (&surface->fonts, &font);
+    return _cairo_array_append (&surface->fonts, &font);
+}
 
-    _cairo_truetype_subset_fini (&subset);
+static cairo_status_t
+_cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
+					      cairo_scaled_font_subset_t	*font_subset)
+{
+    cairo_status_t status;
+    cairo_truetype_subset_t subset;
+
+    if (_cairo_pdf_surface_get_font_resource (surface,
+					      font_subset->font_id,
+					      font_subset->subset_id).id == 0)
+	return CAIRO_STATUS_SUCCESS;
 
+    status = _cairo_truetype_subset_init_pdf (&subset, font_subset);
+    if (unlikely (status))
+	return status;
+
+    status = _cairo_pdf_surface_emit_truetype_font (surface, font_subset, &subset);
+
+    _cairo_truetype_subset_fini (&subset);
     return status;
 }
 
@@ -5463,17 +6176,17 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     }
 
+    _cairo_pdf_surface_object_begin (surface, encoding);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Encoding\n"
-				 "   /Differences [0", encoding.id);
+				 "   /Differences [0");
     for (i = 0; i < font_subset->num_glyphs; i++)
 	_cairo_output_stream_printf (surface->output,
 				     " /%d", i);
     _cairo_output_stream_printf (surface->output,
 				 "]\n"
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     char_procs = _cairo_pdf_surface_new_object (surface);
     if (char_procs.id == 0) {
@@ -5482,16 +6195,16 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     }
 
+    _cairo_pdf_surface_object_begin (surface, char_procs);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
-				 "<<\n", char_procs.id);
+				 "<<\n");
     for (i = 0; i < font_subset->num_glyphs; i++)
 	_cairo_output_stream_printf (surface->output,
 				     " /%d %d 0 R\n",
 				     i, glyphs[i].id);
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     free (glyphs);
 
@@ -5503,9 +6216,8 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 	return status;
     }
 
-    _cairo_pdf_surface_update_object (surface, subset_resource);
+    _cairo_pdf_surface_object_begin (surface, subset_resource);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Font\n"
 				 "   /Subtype /Type3\n"
 				 "   /FontBBox [%f %f %f %f]\n"
@@ -5514,7 +6226,6 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
 				 "   /CharProcs %d 0 R\n"
 				 "   /FirstChar 0\n"
 				 "   /LastChar %d\n",
-				 subset_resource.id,
 				 _cairo_fixed_to_double (font_bbox.p1.x),
 				 - _cairo_fixed_to_double (font_bbox.p2.y),
 				 _cairo_fixed_to_double (font_bbox.p2.x),
@@ -5541,8 +6252,8 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
                                      to_unicode_stream.id);
 
     _cairo_output_stream_printf (surface->output,
-				 ">>\n"
-				 "endobj\n");
+				 ">>\n");
+    _cairo_pdf_surface_object_end (surface);
 
     font.font_id = font_subset->font_id;
     font.subset_id = font_subset->subset_id;
@@ -5550,24 +6261,235 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
     return _cairo_array_append (&surface->fonts, &font);
 }
 
+/* When more than one compression thread is allowed, the subsetters
+ * for fonts that can be embedded as they are are run for all the font
+ * subsets at once on a pool of threads before any of them is written,
+ * as for a document with many faces they can take far longer than
+ * writing the result.  Only FreeType fonts are subset in parallel as
+ * the other font backends do not lock the font data the subsetters
+ * read.  The fallback fonts are still built while they are written as
+ * they render glyphs.
+ */
+typedef enum _cairo_pdf_font_subset_type {
+    CAIRO_PDF_FONT_SUBSET_NONE,
+    CAIRO_PDF_FONT_SUBSET_CFF,
+    CAIRO_PDF_FONT_SUBSET_TRUETYPE,
+    CAIRO_PDF_FONT_SUBSET_TYPE1
+} cairo_pdf_font_subset_type_t;
+
+typedef struct _cairo_pdf_font_subset_job {
+    cairo_bool_t prepared;
+    cairo_scaled_font_subset_t font_subset;
+    cairo_pdf_font_subset_type_t type;
+    cairo_int_status_t status;
+    cairo_cff_subset_t cff;
+    cairo_truetype_subset_t truetype;
+    cairo_type1_subset_t type1;
+} cairo_pdf_font_subset_job_t;
+
+typedef struct _cairo_pdf_font_subset_jobs {
+    cairo_pdf_surface_t *surface;
+    cairo_array_t jobs;
+    unsigned int num_prepared;
+    unsigned int next;
+} cairo_pdf_font_subset_jobs_t;
+
+static cairo_int_status_t
+_cairo_pdf_surface_collect_unscaled_font_subset (cairo_scaled_font_subset_t *font_subset,
+						 void			    *closure)
+{
+    cairo_pdf_font_subset_jobs_t *jobs = closure;
+    cairo_pdf_font_subset_job_t job;
+    cairo_status_t status;
+
+    memset (&job, 0, sizeof (job));
+    job.prepared =
+	font_subset->scaled_font->backend->type == CAIRO_FONT_TYPE_FT &&
+	_cairo_pdf_surface_get_font_resource (jobs->surface,
+					      font_subset->font_id,
+					      font_subset->subset_id).id != 0;
+    if (job.prepared) {
+	status = _cairo_scaled_font_subset_copy (&job.font_subset, font_subset);
+	if (unlikely (status))
+	    return status;
+    }
+
+    status = _cairo_array_append (&jobs->jobs, &job);
+    if (unlikely (status)) {
+	if (job.prepared)
+	    _cairo_scaled_font_subset_fini_copy (&job.font_subset);
+	return status;
+    }
+
+    if (job.prepared)
+	jobs->num_prepared++;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_pdf_font_subset_job_run (void *closure, int task)
+{
+    cairo_pdf_font_subset_jobs_t *jobs = closure;
+    cairo_pdf_font_subset_job_t *job;
+    cairo_scaled_font_subset_t *font_subset;
+    cairo_int_status_t status;
+    char name[64];
+
+    job = _cairo_array_index (&jobs->jobs, task);
+    if (! job->prepared)
+	return;
+
+    font_subset = &job->font_subset;
+    snprintf (name, sizeof name, "CairoFont-%d-%d",
+	      font_subset->font_id, font_subset->subset_id);
+
+    /* The same order as _cairo_pdf_surface_emit_unscaled_font_subset() */
+    job->type = CAIRO_PDF_FONT_SUBSET_CFF;
+    status = _cairo_cff_subset_init (&job->cff, name, font_subset);
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
+	job->type = CAIRO_PDF_FONT_SUBSET_TRUETYPE;
+	status = _cairo_truetype_subset_init_pdf (&job->truetype, font_subset);
+    }
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED &&
+	! (font_subset->is_composite && ! font_subset->is_latin))
+    {
+	job->type = CAIRO_PDF_FONT_SUBSET_TYPE1;
+	status = _cairo_type1_subset_init (&job->type1, name, font_subset, FALSE);
+    }
+
+    if (status)
+	job->type = CAIRO_PDF_FONT_SUBSET_NONE;
+    job->status = status;
+}
+
+static void
+_cairo_pdf_font_subset_jobs_fini (cairo_pdf_font_subset_jobs_t *jobs)
+{
+    cairo_pdf_font_subset_job_t *job;
+    unsigned int i, num_jobs;
+
+    num_jobs = _cairo_array_num_elements (&jobs->jobs);
+    for (i = 0; i < num_jobs; i++) {
+	job = _cairo_array_index (&jobs->jobs, i);
+	if (! job->prepared)
+	    continue;
+
+	switch (job->type) {
+	case CAIRO_PDF_FONT_SUBSET_CFF:
+	    _cairo_cff_subset_fini (&job->cff);
+	    break;
+	case CAIRO_PDF_FONT_SUBSET_TRUETYPE:
+	    _cairo_truetype_subset_fini (&job->truetype);
+	    break;
+	case CAIRO_PDF_FONT_SUBSET_TYPE1:
+	    _cairo_type1_subset_fini (&job->type1);
+	    break;
+	case CAIRO_PDF_FONT_SUBSET_NONE:
+	    break;
+	}
+	_cairo_scaled_font_subset_fini_copy (&job->font_subset);
+    }
+    _cairo_array_fini (&jobs->jobs);
+}
+
+static cairo_status_t
+_cairo_pdf_surface_prepare_font_subsets (cairo_pdf_surface_t	      *surface,
+					 cairo_pdf_font_subset_jobs_t *jobs)
+{
+    cairo_status_t status;
+    int num_threads;
+
+    jobs->surface = surface;
+    _cairo_array_init (&jobs->jobs, sizeof (cairo_pdf_font_subset_job_t));
+    jobs->num_prepared = 0;
+    jobs->next = 0;
+
+    num_threads = surface->compress_threads;
+    if (num_threads < 2)
+	return CAIRO_STATUS_SUCCESS;
+
+    status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
+							  _cairo_pdf_surface_collect_unscaled_font_subset,
+							  jobs);
+    if (unlikely (status))
+	return status;
+
+    if (jobs->num_prepared < 2) {
+	/* Not worth the threads, subset everything while writing it */
+	_cairo_pdf_font_subset_jobs_fini (jobs);
+	_cairo_array_init (&jobs->jobs, sizeof (cairo_pdf_font_subset_job_t));
+	jobs->num_prepared = 0;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    if ((unsigned int) num_threads > jobs->num_prepared)
+	num_threads = jobs->num_prepared;
+
+    _cairo_parallel_for (num_threads,
+			 _cairo_array_num_elements (&jobs->jobs),
+			 _cairo_pdf_font_subset_job_run,
+			 jobs);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_int_status_t
+_cairo_pdf_surface_emit_prepared_font_subset (cairo_pdf_surface_t	  *surface,
+					      cairo_scaled_font_subset_t  *font_subset,
+					      cairo_pdf_font_subset_job_t *job)
+{
+    /* Both walks visit the subsets in the same order */
+    assert (job->font_subset.font_id == font_subset->font_id);
+    assert (job->font_subset.subset_id == font_subset->subset_id);
+
+    if (job->status)
+	return job->status;
+
+    switch (job->type) {
+    case CAIRO_PDF_FONT_SUBSET_CFF:
+	return _cairo_pdf_surface_emit_cff_font (surface, font_subset, &job->cff);
+    case CAIRO_PDF_FONT_SUBSET_TRUETYPE:
+	return _cairo_pdf_surface_emit_truetype_font (surface, font_subset, &job->truetype);
+    case CAIRO_PDF_FONT_SUBSET_TYPE1:
+	return _cairo_pdf_surface_emit_type1_font (surface, font_subset, &job->type1);
+    case CAIRO_PDF_FONT_SUBSET_NONE:
+	break;
+    }
+
+    ASSERT_NOT_REACHED;
+    return CAIRO_INT_STATUS_UNSUPPORTED;
+}
+
 static cairo_int_status_t
 _cairo_pdf_surface_emit_unscaled_font_subset (cairo_scaled_font_subset_t *font_subset,
                                               void			 *closure)
 {
-    cairo_pdf_surface_t *surface = closure;
+    cairo_pdf_font_subset_jobs_t *jobs = closure;
+    cairo_pdf_surface_t *surface = jobs->surface;
+    cairo_pdf_font_subset_job_t *job = NULL;
     cairo_int_status_t status;
 
-    status = _cairo_pdf_surface_emit_cff_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+    if (jobs->next < _cairo_array_num_elements (&jobs->jobs))
+	job = _cairo_array_index (&jobs->jobs, jobs->next++);
 
-    status = _cairo_pdf_surface_emit_truetype_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+    if (job != NULL && job->prepared) {
+	status = _cairo_pdf_surface_emit_prepared_font_subset (surface, font_subset, job);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+    } else {
+	status = _cairo_pdf_surface_emit_cff_font_subset (surface, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
 
-    status = _cairo_pdf_surface_emit_type1_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+	status = _cairo_pdf_surface_emit_truetype_font_subset (surface, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+
+	status = _cairo_pdf_surface_emit_type1_font_subset (surface, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+    }
 
     status = _cairo_pdf_surface_emit_cff_fallback_font (surface, font_subset);
     if (status != CAIRO_INT_STATUS_UNSUPPORTED)
@@ -5599,6 +6521,7 @@ _cairo_pdf_surface_emit_scaled_font_subset (cairo_scaled_font_subset_t *font_sub
 static cairo_status_t
 _cairo_pdf_surface_emit_font_subsets (cairo_pdf_surface_t *surface)
 {
+    cairo_pdf_font_subset_jobs_t jobs;
     cairo_status_t status;
 
     status = _cairo_scaled_font_subsets_foreach_user (surface->font_subsets,
@@ -5607,9 +6530,13 @@ _cairo_pdf_surface_emit_font_subsets (cairo_pdf_surface_t *surface)
     if (unlikely (status))
 	goto BAIL;
 
-    status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
-                                                          _cairo_pdf_surface_emit_unscaled_font_subset,
-                                                          surface);
+    status = _cairo_pdf_surface_prepare_font_subsets (surface, &jobs);
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
+							      _cairo_pdf_surface_emit_unscaled_font_subset,
+							      &jobs);
+    }
+    _cairo_pdf_font_subset_jobs_fini (&jobs);
     if (unlikely (status))
 	goto BAIL;
 
@@ -5639,14 +6566,13 @@ _cairo_pdf_surface_write_catalog (cairo_pdf_surface_t *surface)
     if (catalog.id == 0)
 	return catalog;
 
+    _cairo_pdf_surface_object_begin (surface, catalog);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Catalog\n"
 				 "   /Pages %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 catalog.id,
+				 ">>\n",
 				 surface->pages_resource.id);
+    _cairo_pdf_surface_object_end (surface);
 
     return catalog;
 }
@@ -5670,8 +6596,15 @@ _cairo_pdf_surface_write_xref (cairo_pdf_surface_t *surface)
     _cairo_output_stream_printf (surface->output,
 				 "0000000000 65535 f \n");
     for (i = 0; i < num_objects; i++) {
+	long object_offset;
+
 	object = _cairo_array_index (&surface->objects, i);
-	snprintf (buffer, sizeof buffer, "%010ld", object->offset);
+	object_offset = object->offset;
+	if (object->segment) {
+	    object_offset += *(long *) _cairo_array_index (&surface->segment_offsets,
+							   object->segment - 1);
+	}
+	snprintf (buffer, sizeof buffer, "%010ld", object_offset);
 	_cairo_output_stream_printf (surface->output,
 				     "%s 00000 n \n", buffer);
     }
@@ -5679,6 +6612,116 @@ _cairo_pdf_surface_write_xref (cairo_pdf_surface_t *surface)
     return offset;
 }
 
+static void
+_cairo_pdf_write_xref_field (cairo_output_stream_t *stream,
+			     unsigned long          value,
+			     int                    width)
+{
+    unsigned char buf[sizeof (unsigned long)];
+    int i;
+
+    for (i = width - 1; i >= 0; i--) {
+	buf[i] = value & 0xff;
+	value >>= 8;
+    }
+    _cairo_output_stream_write (stream, buf, width);
+}
+
+/* Writes the PDF 1.5 cross-reference stream, which also carries the
+ * trailer dictionary.  Each entry has a one byte type, followed by
+ * either the byte offset of an uncompressed object or the number of
+ * the object stream holding a compressed object, and then its
+ * generation or index within that stream.
+ */
+static cairo_status_t
+_cairo_pdf_surface_write_xref_stream (cairo_pdf_surface_t  *surface,
+				      cairo_pdf_resource_t  catalog,
+				      cairo_pdf_resource_t  info,
+				      long                 *offset)
+{
+    cairo_pdf_resource_t xref;
+    cairo_pdf_object_t *object;
+    cairo_output_stream_t *data, *compressed;
+    cairo_status_t status;
+    unsigned long max_value, value;
+    int num_objects, width, i;
+
+    *offset = _cairo_output_stream_get_position (surface->output);
+
+    xref = _cairo_pdf_surface_new_object (surface);
+    if (xref.id == 0)
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    num_objects = _cairo_array_num_elements (&surface->objects);
+
+    max_value = *offset;
+    for (i = 0; i < num_objects; i++) {
+	object = _cairo_array_index (&surface->objects, i);
+	if (object->object_stream && (unsigned long) object->object_stream > max_value)
+	    max_value = object->object_stream;
+    }
+    width = 1;
+    while (width < (int) sizeof (unsigned long) && (max_value >> (8 * width)) != 0)
+	width++;
+
+    compressed = _cairo_memory_stream_create ();
+    data = _cairo_deflate_stream_create (compressed);
+
+    _cairo_pdf_write_xref_field (data, 0, 1);
+    _cairo_pdf_write_xref_field (data, 0, width);
+    _cairo_pdf_write_xref_field (data, 0xffff, 2);
+    for (i = 0; i < num_objects; i++) {
+	object = _cairo_array_index (&surface->objects, i);
+	if (object->object_stream) {
+	    _cairo_pdf_write_xref_field (data, 2, 1);
+	    _cairo_pdf_write_xref_field (data, object->object_stream, width);
+	    _cairo_pdf_write_xref_field (data, object->offset, 2);
+	} else {
+	    value = object->offset;
+	    if (object->segment) {
+		value += *(long *) _cairo_array_index (&surface->segment_offsets,
+						       object->segment - 1);
+	    }
+	    _cairo_pdf_write_xref_field (data, 1, 1);
+	    _cairo_pdf_write_xref_field (data, value, width);
+	    _cairo_pdf_write_xref_field (data, 0, 2);
+	}
+    }
+
+    status = _cairo_output_stream_destroy (data);
+    if (unlikely (status)) {
+	cairo_status_t status_ignored;
+
+	status_ignored = _cairo_output_stream_destroy (compressed);
+	return status;
+    }
+
+    _cairo_output_stream_printf (surface->output,
+				 "%d 0 obj\n"
+				 "<< /Type /XRef\n"
+				 "   /Size %d\n"
+				 "   /W [1 %d 2]\n"
+				 "   /Root %d 0 R\n"
+				 "   /Info %d 0 R\n"
+				 "   /Filter /FlateDecode\n"
+				 "   /Length %d\n"
+				 ">>\n"
+				 "stream\n",
+				 xref.id,
+				 num_objects + 1,
+				 width,
+				 catalog.id,
+				 info.id,
+				 _cairo_memory_stream_length (compressed));
+    _cairo_memory_stream_copy (compressed, surface->output);
+    _cairo_output_stream_printf (surface->output,
+				 "\n"
+				 "endstream\n"
+				 "endobj\n");
+
+    return _cairo_output_stream_destroy (compressed);
+}
+
 static cairo_status_t
 _cairo_pdf_surface_write_mask_group (cairo_pdf_surface_t	*surface,
 				     cairo_pdf_smask_group_t	*group)
@@ -5840,29 +6883,26 @@ _cairo_pdf_surface_write_mask_group (cairo_pdf_surface_t	*surface,
     if (smask.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, smask);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Mask\n"
 				 "   /S /Alpha\n"
 				 "   /G %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 smask.id,
+				 ">>\n",
 				 mask_group.id);
+    _cairo_pdf_surface_object_end (surface);
 
     /* Create a GState that uses the smask */
-    _cairo_pdf_surface_update_object (surface, group->group_res);
+    _cairo_pdf_surface_object_begin (surface, group->group_res);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /ExtGState\n"
 				 "   /SMask %d 0 R\n"
 				 "   /ca 1\n"
 				 "   /CA 1\n"
 				 "   /AIS false\n"
-				 ">>\n"
-				 "endobj\n",
-				 group->group_res.id,
+				 ">>\n",
 				 smask.id);
+    _cairo_pdf_surface_object_end (surface);
 
     return _cairo_output_stream_get_status (surface->output);
 }
@@ -6057,8 +7097,8 @@ _cairo_pdf_surface_write_page (cairo_pdf_surface_t *surface)
     if (page.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
+    _cairo_pdf_surface_object_begin (surface, page);
     _cairo_output_stream_printf (surface->output,
-				 "%d 0 obj\n"
 				 "<< /Type /Page\n"
 				 "   /Parent %d 0 R\n"
 				 "   /MediaBox [ 0 0 %f %f ]\n"
@@ -6070,14 +7110,13 @@ _cairo_pdf_surface_write_page (cairo_pdf_surface_t *surface)
 				 "      /CS /DeviceRGB\n"
 				 "   >>\n"
 				 "   /Resources %d 0 R\n"
-				 ">>\n"
-				 "endobj\n",
-				 page.id,
+				 ">>\n",
 				 surface->pages_resource.id,
 				 surface->width,
 				 surface->height,
 				 surface->content.id,
 				 surface->content_resources.id);
+    _cairo_pdf_surface_object_end (surface);
 
     status = _cairo_array_append (&surface->pages, &page);
     if (unlikely (status))
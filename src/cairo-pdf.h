@@ -85,6 +85,25 @@ cairo_pdf_surface_set_size (cairo_surface_t	*surface,
 			    double		 width_in_points,
 			    double		 height_in_points);
 
+cairo_public void
+cairo_pdf_surface_set_compression_threads (cairo_surface_t	*surface,
+					   int			 num_threads);
+
+cairo_public void
+cairo_pdf_surface_set_object_streams (cairo_surface_t	*surface,
+				      cairo_bool_t	 use_object_streams);
+
+cairo_public void
+cairo_pdf_surface_set_deduplicate_images (cairo_surface_t	*surface,
+					  cairo_bool_t		 deduplicate);
+
+cairo_public void
+cairo_pdf_surface_set_streaming (cairo_surface_t	*surface,
+				 cairo_bool_t		 streaming);
+
+cairo_public unsigned long
+cairo_pdf_surface_get_peak_memory (cairo_surface_t	*surface);
+
 CAIRO_END_DECLS
 
 #else  /* CAIRO_HAS_PDF_SURFACE */
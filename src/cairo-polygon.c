@@ -581,6 +581,50 @@ _cairo_polygon_add_contour (cairo_polygon_t *polygon,
     return polygon->status;
 }
 
+/* Append a copy of edges from another, unclipped, polygon offset by
+ * (dx, dy) in fixed point, clipping them to our limits as they are added.
+ */
+cairo_status_t
+_cairo_polygon_add_edges (cairo_polygon_t *polygon,
+			  const cairo_edge_t *edges,
+			  int num_edges,
+			  cairo_fixed_t dx,
+			  cairo_fixed_t dy)
+{
+    int n;
+
+    while (polygon->num_edges + num_edges > polygon->edges_size) {
+	if (! _cairo_polygon_grow (polygon))
+	    return polygon->status;
+    }
+
+    for (n = 0; n < num_edges; n++) {
+	const cairo_edge_t *e = &edges[n];
+	cairo_point_t p1, p2;
+	int top, bottom;
+
+	p1.x = e->line.p1.x + dx;
+	p1.y = e->line.p1.y + dy;
+	p2.x = e->line.p2.x + dx;
+	p2.y = e->line.p2.y + dy;
+	top = e->top + dy;
+	bottom = e->bottom + dy;
+
+	if (polygon->num_limits) {
+	    if (bottom <= polygon->limit.p1.y)
+		continue;
+
+	    if (top >= polygon->limit.p2.y)
+		continue;
+
+	    _add_clipped_edge (polygon, &p1, &p2, top, bottom, e->dir);
+	} else
+	    _add_edge (polygon, &p1, &p2, top, bottom, e->dir);
+    }
+
+    return polygon->status;
+}
+
 void
 _cairo_polygon_translate (cairo_polygon_t *polygon, int dx, int dy)
 {
@@ -72,6 +72,15 @@ typedef struct cairo_ps_surface {
 
     cairo_bool_t use_string_datasource;
 
+    /* Image data shared by identical images, written in the setup */
+    cairo_bool_t deduplicate_images;
+    cairo_hash_table_t *image_data;
+    cairo_array_t image_data_list;
+
+    /* Threads used to build the font subsets, see
+     * cairo_ps_surface_set_font_subset_threads() */
+    int font_subset_threads;
+
     cairo_bool_t current_pattern_is_solid_color;
     cairo_color_t current_color;
 
@@ -70,6 +70,7 @@
 #include "cairo-list-inline.h"
 #include "cairo-scaled-font-subsets-private.h"
 #include "cairo-paginated-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-recording-surface-private.h"
 #include "cairo-surface-clipper-private.h"
 #include "cairo-surface-snapshot-inline.h"
@@ -149,6 +150,15 @@ static const char *_cairo_ps_supported_mime_types[] =
     NULL
 };
 
+/* The compressed samples of an image that are written once in the
+ * document setup and referred to by every identical image. */
+typedef struct _cairo_ps_image_data {
+    cairo_hash_entry_t base;
+    cairo_hash_digest_t digest;
+    int id;
+    cairo_output_stream_t *stream;
+} cairo_ps_image_data_t;
+
 typedef struct _cairo_page_standard_media {
     const char *name;
     int width;
@@ -183,6 +193,27 @@ typedef struct _cairo_page_media {
     cairo_list_t link;
 } cairo_page_media_t;
 
+/* The shared image data is defined once in the document setup, and
+ * referenced from every page that draws the image. */
+static void
+_cairo_ps_surface_emit_image_data (cairo_ps_surface_t *surface)
+{
+    cairo_ps_image_data_t *image_data;
+    int i, num_images;
+
+    num_images = _cairo_array_num_elements (&surface->image_data_list);
+    for (i = 0; i < num_images; i++) {
+	image_data = *(cairo_ps_image_data_t **) _cairo_array_index (&surface->image_data_list, i);
+
+	_cairo_output_stream_printf (surface->final_stream,
+				     "/CairoImageData%d [\n",
+				     image_data->id);
+	_cairo_memory_stream_copy (image_data->stream, surface->final_stream);
+	_cairo_output_stream_printf (surface->final_stream,
+				     "] def\n");
+    }
+}
+
 static void
 _cairo_ps_surface_emit_header (cairo_ps_surface_t *surface)
 {
@@ -341,7 +372,7 @@ _cairo_ps_surface_emit_header (cairo_ps_surface_t *surface)
 				 "%%%%EndProlog\n");
 
     num_comments = _cairo_array_num_elements (&surface->dsc_setup_comments);
-    if (num_comments) {
+    if (num_comments || _cairo_array_num_elements (&surface->image_data_list)) {
 	_cairo_output_stream_printf (surface->final_stream,
 				     "%%%%BeginSetup\n");
 
@@ -353,11 +384,30 @@ _cairo_ps_surface_emit_header (cairo_ps_surface_t *surface)
 	    comments[i] = NULL;
 	}
 
+	_cairo_ps_surface_emit_image_data (surface);
+
 	_cairo_output_stream_printf (surface->final_stream,
 				     "%%%%EndSetup\n");
     }
 }
 
+static void
+_cairo_ps_surface_emit_type1_font (cairo_ps_surface_t	*surface,
+				   cairo_type1_subset_t	*subset)
+{
+    int length;
+
+    /* FIXME: Figure out document structure convention for fonts */
+
+#if DEBUG_PS
+    _cairo_output_stream_printf (surface->final_stream,
+				 "%% _cairo_ps_surface_emit_type1_font_subset\n");
+#endif
+
+    length = subset->header_length + subset->data_length + subset->trailer_length;
+    _cairo_output_stream_write (surface->final_stream, subset->data, length);
+}
+
 static cairo_status_t
 _cairo_ps_surface_emit_type1_font_subset (cairo_ps_surface_t		*surface,
 					  cairo_scaled_font_subset_t	*font_subset)
@@ -366,7 +416,6 @@ _cairo_ps_surface_emit_type1_font_subset (cairo_ps_surface_t		*surface,
 {
     cairo_type1_subset_t subset;
     cairo_status_t status;
-    int length;
     char name[64];
 
     snprintf (name, sizeof name, "f-%d-%d",
@@ -375,15 +424,7 @@ _cairo_ps_surface_emit_type1_font_subset (cairo_ps_surface_t		*surface,
     if (unlikely (status))
 	return status;
 
-    /* FIXME: Figure out document structure convention for fonts */
-
-#if DEBUG_PS
-    _cairo_output_stream_printf (surface->final_stream,
-				 "%% _cairo_ps_surface_emit_type1_font_subset\n");
-#endif
-
-    length = subset.header_length + subset.data_length + subset.trailer_length;
-    _cairo_output_stream_write (surface->final_stream, subset.data, length);
+    _cairo_ps_surface_emit_type1_font (surface, &subset);
 
     _cairo_type1_subset_fini (&subset);
 
@@ -421,20 +462,13 @@ _cairo_ps_surface_emit_type1_font_fallback (cairo_ps_surface_t		*surface,
     return CAIRO_STATUS_SUCCESS;
 }
 
-static cairo_status_t
-_cairo_ps_surface_emit_truetype_font_subset (cairo_ps_surface_t		*surface,
-					     cairo_scaled_font_subset_t	*font_subset)
-
-
+static void
+_cairo_ps_surface_emit_truetype_font (cairo_ps_surface_t		*surface,
+				      cairo_scaled_font_subset_t	*font_subset,
+				      cairo_truetype_subset_t		*subset)
 {
-    cairo_truetype_subset_t subset;
-    cairo_status_t status;
     unsigned int i, begin, end;
 
-    status = _cairo_truetype_subset_init_ps (&subset, font_subset);
-    if (unlikely (status))
-	return status;
-
     /* FIXME: Figure out document structure convention for fonts */
 
 #if DEBUG_PS
@@ -451,7 +485,7 @@ _cairo_ps_surface_emit_truetype_font_subset (cairo_ps_surface_t		*surface,
 				 "/FontBBox [ 0 0 0 0 ] def\n"
 				 "/Encoding 256 array def\n"
 				 "0 1 255 { Encoding exch /.notdef put } for\n",
-				 subset.ps_name);
+				 subset->ps_name);
 
     /* FIXME: Figure out how subset->x_max etc maps to the /FontBBox */
 
@@ -504,18 +538,18 @@ _cairo_ps_surface_emit_truetype_font_subset (cairo_ps_surface_t		*surface,
 				 "/sfnts [\n");
     begin = 0;
     end = 0;
-    for (i = 0; i < subset.num_string_offsets; i++) {
-        end = subset.string_offsets[i];
+    for (i = 0; i < subset->num_string_offsets; i++) {
+        end = subset->string_offsets[i];
         _cairo_output_stream_printf (surface->final_stream,"<");
         _cairo_output_stream_write_hex_string (surface->final_stream,
-                                               subset.data + begin, end - begin);
+                                               subset->data + begin, end - begin);
         _cairo_output_stream_printf (surface->final_stream,"00>\n");
         begin = end;
     }
-    if (subset.data_length > end) {
+    if (subset->data_length > end) {
         _cairo_output_stream_printf (surface->final_stream,"<");
         _cairo_output_stream_write_hex_string (surface->final_stream,
-                                               subset.data + end, subset.data_length - end);
+                                               subset->data + end, subset->data_length - end);
         _cairo_output_stream_printf (surface->final_stream,"00>\n");
     }
 
@@ -524,6 +558,22 @@ _cairo_ps_surface_emit_truetype_font_subset (cairo_ps_surface_t		*surface,
 				 "/f-%d-%d currentdict end definefont pop\n",
 				 font_subset->font_id,
 				 font_subset->subset_id);
+}
+
+static cairo_status_t
+_cairo_ps_surface_emit_truetype_font_subset (cairo_ps_surface_t		*surface,
+					     cairo_scaled_font_subset_t	*font_subset)
+
+
+{
+    cairo_truetype_subset_t subset;
+    cairo_status_t status;
+
+    status = _cairo_truetype_subset_init_ps (&subset, font_subset);
+    if (unlikely (status))
+	return status;
+
+    _cairo_ps_surface_emit_truetype_font (surface, font_subset, &subset);
 
     _cairo_truetype_subset_fini (&subset);
 
@@ -704,24 +754,199 @@ _cairo_ps_surface_emit_type3_font_subset (cairo_ps_surface_t		*surface,
     return CAIRO_STATUS_SUCCESS;
 }
 
+/* As in the PDF surface, when cairo_ps_surface_set_font_subset_threads()
+ * allows it the Type 1 and TrueType subsets of FreeType fonts are all
+ * built on a pool of threads before any of them is written out.
+ */
+typedef enum _cairo_ps_font_subset_type {
+    CAIRO_PS_FONT_SUBSET_NONE,
+    CAIRO_PS_FONT_SUBSET_TYPE1,
+    CAIRO_PS_FONT_SUBSET_TRUETYPE
+} cairo_ps_font_subset_type_t;
+
+typedef struct _cairo_ps_font_subset_job {
+    cairo_bool_t prepared;
+    cairo_scaled_font_subset_t font_subset;
+    cairo_ps_font_subset_type_t type;
+    cairo_int_status_t status;
+    cairo_type1_subset_t type1;
+    cairo_truetype_subset_t truetype;
+} cairo_ps_font_subset_job_t;
+
+typedef struct _cairo_ps_font_subset_jobs {
+    cairo_ps_surface_t *surface;
+    cairo_array_t jobs;
+    unsigned int num_prepared;
+    unsigned int next;
+} cairo_ps_font_subset_jobs_t;
+
+static cairo_int_status_t
+_cairo_ps_surface_collect_unscaled_font_subset (cairo_scaled_font_subset_t *font_subset,
+						void			   *closure)
+{
+    cairo_ps_font_subset_jobs_t *jobs = closure;
+    cairo_ps_font_subset_job_t job;
+    cairo_status_t status;
+
+    memset (&job, 0, sizeof (job));
+    job.prepared = font_subset->scaled_font->backend->type == CAIRO_FONT_TYPE_FT;
+    if (job.prepared) {
+	status = _cairo_scaled_font_subset_copy (&job.font_subset, font_subset);
+	if (unlikely (status))
+	    return status;
+    }
+
+    status = _cairo_array_append (&jobs->jobs, &job);
+    if (unlikely (status)) {
+	if (job.prepared)
+	    _cairo_scaled_font_subset_fini_copy (&job.font_subset);
+	return status;
+    }
+
+    if (job.prepared)
+	jobs->num_prepared++;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_ps_font_subset_job_run (void *closure, int task)
+{
+    cairo_ps_font_subset_jobs_t *jobs = closure;
+    cairo_ps_font_subset_job_t *job;
+    cairo_int_status_t status;
+    char name[64];
+
+    job = _cairo_array_index (&jobs->jobs, task);
+    if (! job->prepared)
+	return;
+
+    snprintf (name, sizeof name, "f-%d-%d",
+	      job->font_subset.font_id, job->font_subset.subset_id);
+
+    /* The same order as _cairo_ps_surface_emit_unscaled_font_subset() */
+    job->type = CAIRO_PS_FONT_SUBSET_TYPE1;
+    status = _cairo_type1_subset_init (&job->type1, name, &job->font_subset, TRUE);
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
+	job->type = CAIRO_PS_FONT_SUBSET_TRUETYPE;
+	status = _cairo_truetype_subset_init_ps (&job->truetype, &job->font_subset);
+    }
+
+    if (status)
+	job->type = CAIRO_PS_FONT_SUBSET_NONE;
+    job->status = status;
+}
+
+static void
+_cairo_ps_font_subset_jobs_fini (cairo_ps_font_subset_jobs_t *jobs)
+{
+    cairo_ps_font_subset_job_t *job;
+    unsigned int i, num_jobs;
+
+    num_jobs = _cairo_array_num_elements (&jobs->jobs);
+    for (i = 0; i < num_jobs; i++) {
+	job = _cairo_array_index (&jobs->jobs, i);
+	if (! job->prepared)
+	    continue;
+
+	switch (job->type) {
+	case CAIRO_PS_FONT_SUBSET_TYPE1:
+	    _cairo_type1_subset_fini (&job->type1);
+	    break;
+	case CAIRO_PS_FONT_SUBSET_TRUETYPE:
+	    _cairo_truetype_subset_fini (&job->truetype);
+	    break;
+	case CAIRO_PS_FONT_SUBSET_NONE:
+	    break;
+	}
+	_cairo_scaled_font_subset_fini_copy (&job->font_subset);
+    }
+    _cairo_array_fini (&jobs->jobs);
+}
+
+static cairo_status_t
+_cairo_ps_surface_prepare_font_subsets (cairo_ps_surface_t	    *surface,
+					cairo_ps_font_subset_jobs_t *jobs)
+{
+    cairo_status_t status;
+    int num_threads;
+
+    jobs->surface = surface;
+    _cairo_array_init (&jobs->jobs, sizeof (cairo_ps_font_subset_job_t));
+    jobs->num_prepared = 0;
+    jobs->next = 0;
+
+    num_threads = surface->font_subset_threads;
+    if (num_threads < 2)
+	return CAIRO_STATUS_SUCCESS;
+
+    status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
+							  _cairo_ps_surface_collect_unscaled_font_subset,
+							  jobs);
+    if (unlikely (status))
+	return status;
+
+    if (jobs->num_prepared < 2) {
+	_cairo_ps_font_subset_jobs_fini (jobs);
+	_cairo_array_init (&jobs->jobs, sizeof (cairo_ps_font_subset_job_t));
+	jobs->num_prepared = 0;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    if ((unsigned int) num_threads > jobs->num_prepared)
+	num_threads = jobs->num_prepared;
+
+    _cairo_parallel_for (num_threads,
+			 _cairo_array_num_elements (&jobs->jobs),
+			 _cairo_ps_font_subset_job_run,
+			 jobs);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 static cairo_int_status_t
 _cairo_ps_surface_emit_unscaled_font_subset (cairo_scaled_font_subset_t	*font_subset,
 				            void			*closure)
 {
-    cairo_ps_surface_t *surface = closure;
+    cairo_ps_font_subset_jobs_t *jobs = closure;
+    cairo_ps_surface_t *surface = jobs->surface;
+    cairo_ps_font_subset_job_t *job = NULL;
     cairo_int_status_t status;
 
+    if (jobs->next < _cairo_array_num_elements (&jobs->jobs))
+	job = _cairo_array_index (&jobs->jobs, jobs->next++);
+
     status = _cairo_scaled_font_subset_create_glyph_names (font_subset);
     if (_cairo_int_status_is_error (status))
 	return status;
 
-    status = _cairo_ps_surface_emit_type1_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+    if (job != NULL && job->prepared) {
+	/* Both walks visit the subsets in the same order */
+	assert (job->font_subset.font_id == font_subset->font_id);
+	assert (job->font_subset.subset_id == font_subset->subset_id);
 
-    status = _cairo_ps_surface_emit_truetype_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+	if (_cairo_int_status_is_error (job->status))
+	    return job->status;
+
+	switch (job->type) {
+	case CAIRO_PS_FONT_SUBSET_TYPE1:
+	    _cairo_ps_surface_emit_type1_font (surface, &job->type1);
+	    return CAIRO_STATUS_SUCCESS;
+	case CAIRO_PS_FONT_SUBSET_TRUETYPE:
+	    _cairo_ps_surface_emit_truetype_font (surface, font_subset, &job->truetype);
+	    return CAIRO_STATUS_SUCCESS;
+	case CAIRO_PS_FONT_SUBSET_NONE:
+	    break;
+	}
+    } else {
+	status = _cairo_ps_surface_emit_type1_font_subset (surface, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+
+	status = _cairo_ps_surface_emit_truetype_font_subset (surface, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+    }
 
     status = _cairo_ps_surface_emit_type1_font_fallback (surface, font_subset);
     if (status != CAIRO_INT_STATUS_UNSUPPORTED)
@@ -753,6 +978,7 @@ _cairo_ps_surface_emit_scaled_font_subset (cairo_scaled_font_subset_t *font_subs
 static cairo_status_t
 _cairo_ps_surface_emit_font_subsets (cairo_ps_surface_t *surface)
 {
+    cairo_ps_font_subset_jobs_t jobs;
     cairo_status_t status;
 
 #if DEBUG_PS
@@ -766,9 +992,13 @@ _cairo_ps_surface_emit_font_subsets (cairo_ps_surface_t *surface)
     if (unlikely (status))
 	return status;
 
-    status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
-                                                          _cairo_ps_surface_emit_unscaled_font_subset,
-                                                          surface);
+    status = _cairo_ps_surface_prepare_font_subsets (surface, &jobs);
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
+							      _cairo_ps_surface_emit_unscaled_font_subset,
+							      &jobs);
+    }
+    _cairo_ps_font_subset_jobs_fini (&jobs);
     if (unlikely (status))
 	return status;
 
@@ -1008,6 +1238,10 @@ _cairo_ps_surface_create_for_stream_internal (cairo_output_stream_t *stream,
     surface->content = CAIRO_CONTENT_COLOR_ALPHA;
     surface->use_string_datasource = FALSE;
     surface->current_pattern_is_solid_color = FALSE;
+    surface->deduplicate_images = FALSE;
+    surface->font_subset_threads = 1;
+    surface->image_data = NULL;
+    _cairo_array_init (&surface->image_data_list, sizeof (cairo_ps_image_data_t *));
 
     surface->page_bbox.x = 0;
     surface->page_bbox.y = 0;
@@ -1319,6 +1553,61 @@ cairo_ps_surface_get_eps (cairo_surface_t	*surface)
     return ps_surface->eps;
 }
 
+/**
+ * cairo_ps_surface_set_deduplicate_images:
+ * @surface: a PostScript #cairo_surface_t
+ * @deduplicate: %TRUE to write the data of identical images only once
+ *
+ * Every use of an image is normally written out in full. With
+ * deduplication enabled, the compressed samples of each image are
+ * instead stored once in the document setup, keyed by a digest of the
+ * samples, and each use of an identical image refers to that copy.
+ * The stored data is kept in memory until the surface is finished.
+ * The default is %FALSE.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_ps_surface_set_deduplicate_images (cairo_surface_t	*surface,
+					 cairo_bool_t		 deduplicate)
+{
+    cairo_ps_surface_t *ps_surface = NULL;
+
+    if (! _extract_ps_surface (surface, TRUE, &ps_surface))
+	return;
+
+    ps_surface->deduplicate_images = deduplicate;
+}
+
+/**
+ * cairo_ps_surface_set_font_subset_threads:
+ * @surface: a PostScript #cairo_surface_t
+ * @num_threads: the maximum number of threads to use, or 0 for one
+ * per available processor
+ *
+ * Allow cairo to build the subsets of the fonts embedded in @surface
+ * using up to @num_threads threads when the surface is finished,
+ * rather than one after another as each is written. This only helps
+ * documents using many font faces. The document written is identical
+ * to that produced with a single thread, which remains the default.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_ps_surface_set_font_subset_threads (cairo_surface_t	*surface,
+					  int			 num_threads)
+{
+    cairo_ps_surface_t *ps_surface = NULL;
+
+    if (! _extract_ps_surface (surface, TRUE, &ps_surface))
+	return;
+
+    if (num_threads <= 0)
+	num_threads = _cairo_parallel_num_cpus ();
+
+    ps_surface->font_subset_threads = num_threads;
+}
+
 /**
  * cairo_ps_surface_set_size:
  * @surface: a PostScript #cairo_surface_t
@@ -1550,7 +1839,7 @@ _cairo_ps_surface_finish (void *abstract_surface)
 {
     cairo_status_t status, status2;
     cairo_ps_surface_t *surface = abstract_surface;
-    int i, num_comments;
+    int i, num_comments, num_images;
     char **comments;
 
     status = surface->base.status;
@@ -1572,6 +1861,21 @@ _cairo_ps_surface_finish (void *abstract_surface)
 CLEANUP:
     _cairo_scaled_font_subsets_destroy (surface->font_subsets);
 
+    num_images = _cairo_array_num_elements (&surface->image_data_list);
+    for (i = 0; i < num_images; i++) {
+	cairo_ps_image_data_t *image_data;
+
+	image_data = *(cairo_ps_image_data_t **) _cairo_array_index (&surface->image_data_list, i);
+	_cairo_hash_table_remove (surface->image_data, &image_data->base);
+	status2 = _cairo_output_stream_destroy (image_data->stream);
+	if (status == CAIRO_STATUS_SUCCESS)
+	    status = status2;
+	free (image_data);
+    }
+    _cairo_array_fini (&surface->image_data_list);
+    if (surface->image_data != NULL)
+	_cairo_hash_table_destroy (surface->image_data);
+
     status2 = _cairo_output_stream_destroy (surface->stream);
     if (status == CAIRO_STATUS_SUCCESS)
 	status = status2;
@@ -2372,6 +2676,84 @@ _cairo_ps_surface_emit_base85_string (cairo_ps_surface_t    *surface,
     return status;
 }
 
+static cairo_bool_t
+_cairo_ps_image_data_equal (const void *key_a, const void *key_b)
+{
+    const cairo_ps_image_data_t *a = key_a;
+    const cairo_ps_image_data_t *b = key_b;
+
+    return _cairo_hash_digest_equal (&a->digest, &b->digest);
+}
+
+/* Returns in @id the number of the shared copy of @data, adding it to
+ * the setup the first time it is seen. */
+static cairo_status_t
+_cairo_ps_surface_add_image_data (cairo_ps_surface_t	*surface,
+				  const unsigned char	*data,
+				  unsigned long		 length,
+				  cairo_ps_compress_t	 compress,
+				  int			*id)
+{
+    cairo_ps_image_data_t key, *image_data;
+    cairo_output_stream_t *old_stream;
+    cairo_status_t status, status_ignored;
+
+    if (surface->image_data == NULL) {
+	surface->image_data = _cairo_hash_table_create (_cairo_ps_image_data_equal);
+	if (unlikely (surface->image_data == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    _cairo_hash_digest_init (&key.digest);
+    _cairo_hash_digest_update (&key.digest, &compress, sizeof (compress));
+    _cairo_hash_digest_update (&key.digest, data, length);
+    key.base.hash = _cairo_hash_digest_to_hash (&key.digest);
+
+    image_data = _cairo_hash_table_lookup (surface->image_data, &key.base);
+    if (image_data != NULL) {
+	*id = image_data->id;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    image_data = malloc (sizeof (cairo_ps_image_data_t));
+    if (unlikely (image_data == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    *image_data = key;
+    image_data->id = _cairo_array_num_elements (&surface->image_data_list) + 1;
+    image_data->stream = _cairo_memory_stream_create ();
+
+    old_stream = surface->stream;
+    surface->stream = image_data->stream;
+    status = _cairo_ps_surface_emit_base85_string (surface,
+						   data,
+						   length,
+						   compress,
+						   TRUE);
+    surface->stream = old_stream;
+    if (unlikely (status))
+	goto FAIL;
+
+    status = _cairo_array_append (&surface->image_data_list, &image_data);
+    if (unlikely (status))
+	goto FAIL;
+
+    status = _cairo_hash_table_insert (surface->image_data, &image_data->base);
+    if (unlikely (status)) {
+	_cairo_array_truncate (&surface->image_data_list,
+			       _cairo_array_num_elements (&surface->image_data_list) - 1);
+	goto FAIL;
+    }
+
+    *id = image_data->id;
+    return CAIRO_STATUS_SUCCESS;
+
+FAIL:
+    status_ignored = _cairo_output_stream_destroy (image_data->stream);
+    free (image_data);
+    return status;
+}
+
 static cairo_status_t
 _cairo_ps_surface_emit_image (cairo_ps_surface_t    *surface,
 			      cairo_image_surface_t *image_surf,
@@ -2394,6 +2776,8 @@ _cairo_ps_surface_emit_image (cairo_ps_surface_t    *surface,
     cairo_ps_compress_t compress;
     const char *compress_filter;
     cairo_image_surface_t *image;
+    cairo_bool_t use_string_datasource;
+    int image_data_id = 0;
 
     if (image_surf->base.status)
 	return image_surf->base.status;
@@ -2607,7 +2991,23 @@ _cairo_ps_surface_emit_image (cairo_ps_surface_t    *surface,
 	surface->ps_level_used = CAIRO_PS_LEVEL_3;
     }
 
-    if (surface->use_string_datasource) {
+    if (surface->deduplicate_images) {
+	status = _cairo_ps_surface_add_image_data (surface,
+						   data,
+						   data_size,
+						   compress,
+						   &image_data_id);
+	if (unlikely (status))
+	    goto bail2;
+    }
+    use_string_datasource = surface->use_string_datasource || image_data_id;
+
+    if (image_data_id) {
+	_cairo_output_stream_printf (surface->stream,
+				     "/CairoImageData CairoImageData%d def\n"
+				     "/CairoImageDataIndex 0 def\n",
+				     image_data_id);
+    } else if (surface->use_string_datasource) {
 	/* Emit the image data as a base85-encoded string which will
 	 * be used as the data source for the image operator later. */
 	_cairo_output_stream_printf (surface->stream,
@@ -2648,7 +3048,7 @@ _cairo_ps_surface_emit_image (cairo_ps_surface_t    *surface,
 				     color == CAIRO_IMAGE_IS_MONOCHROME ? 1 : 8,
 				     color == CAIRO_IMAGE_IS_COLOR ? "0 1 0 1 0 1" : "0 1");
 
-	if (surface->use_string_datasource) {
+	if (use_string_datasource) {
 	    _cairo_output_stream_printf (surface->stream,
 					 "    /DataSource {\n"
 					 "      CairoImageData CairoImageDataIndex get\n"
@@ -2702,7 +3102,7 @@ _cairo_ps_surface_emit_image (cairo_ps_surface_t    *surface,
 				     interpolate,
 				     color == CAIRO_IMAGE_IS_MONOCHROME ? 1 : 8,
 				     stencil_mask ? "1 0" : color == CAIRO_IMAGE_IS_COLOR ? "0 1 0 1 0 1" : "0 1");
-	if (surface->use_string_datasource) {
+	if (use_string_datasource) {
 	    _cairo_output_stream_printf (surface->stream,
 					 "  /DataSource {\n"
 					 "    CairoImageData CairoImageDataIndex get\n"
@@ -2727,7 +3127,7 @@ _cairo_ps_surface_emit_image (cairo_ps_surface_t    *surface,
 				     stencil_mask ? "imagemask" : "image");
     }
 
-    if (!surface->use_string_datasource) {
+    if (!use_string_datasource) {
 	/* Emit the image data as a base85-encoded string which will
 	 * be used as the data source for the image operator. */
 	status = _cairo_ps_surface_emit_base85_string (surface,
@@ -92,6 +92,14 @@ cairo_ps_surface_set_eps (cairo_surface_t	*surface,
 cairo_public cairo_bool_t
 cairo_ps_surface_get_eps (cairo_surface_t	*surface);
 
+cairo_public void
+cairo_ps_surface_set_deduplicate_images (cairo_surface_t	*surface,
+					 cairo_bool_t		 deduplicate);
+
+cairo_public void
+cairo_ps_surface_set_font_subset_threads (cairo_surface_t	*surface,
+					  int			 num_threads);
+
 cairo_public void
 cairo_ps_surface_set_size (cairo_surface_t	*surface,
 			   double		 width_in_points,
@@ -174,6 +174,13 @@ _cairo_recording_surface_replay_region (cairo_surface_t			*surface,
 					cairo_surface_t			*target,
 					cairo_recording_region_type_t	region);
 
+cairo_private cairo_bool_t
+_cairo_recording_surface_prepare_concurrent_replay (cairo_surface_t *surface);
+
+cairo_private cairo_status_t
+_cairo_recording_surface_replay_concurrent (cairo_surface_t *surface,
+					    cairo_surface_t *target);
+
 cairo_private cairo_status_t
 _cairo_recording_surface_get_bbox (cairo_recording_surface_t *recording,
 				   cairo_box_t *bbox,
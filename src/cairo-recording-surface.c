@@ -85,8 +85,10 @@
 #include "cairo-composite-rectangles-private.h"
 #include "cairo-default-context-private.h"
 #include "cairo-error-private.h"
+#include "cairo-image-surface-inline.h"
 #include "cairo-image-surface-private.h"
 #include "cairo-recording-surface-inline.h"
+#include "cairo-surface-snapshot-inline.h"
 #include "cairo-surface-wrapper-private.h"
 #include "cairo-traps-private.h"
 
@@ -1581,7 +1583,8 @@ _cairo_recording_surface_get_path (cairo_surface_t    *abstract_surface,
 
 static int
 _cairo_recording_surface_get_visible_commands (cairo_recording_surface_t *surface,
-					       const cairo_rectangle_int_t *extents)
+					       const cairo_rectangle_int_t *extents,
+					       int *visible)
 {
     int num_visible, *indices;
     cairo_box_t box;
@@ -1591,15 +1594,64 @@ _cairo_recording_surface_get_visible_commands (cairo_recording_surface_t *surfac
     if (surface->bbtree.chain == INVALID_CHAIN)
 	_cairo_recording_surface_create_bbtree (surface);
 
-    indices = surface->indices;
+    indices = visible;
     bbtree_foreach_mark_visible (&surface->bbtree, &box, &indices);
-    num_visible = indices - surface->indices;
+    num_visible = indices - visible;
     if (num_visible > 1)
-	sort_indices (surface->indices, num_visible);
+	sort_indices (visible, num_visible);
 
     return num_visible;
 }
 
+/* Whether @surface is only ever read, so that it can be used as a
+ * source from several threads at once.  Acquiring an image with
+ * deferred drawing still pending would first land that drawing.
+ */
+static cairo_bool_t
+_surface_is_concurrent_safe (cairo_surface_t *surface)
+{
+    if (surface->type != CAIRO_SURFACE_TYPE_IMAGE)
+	return FALSE;
+
+    return ! _cairo_surface_is_image (surface) ||
+	((cairo_image_surface_t *) surface)->recording == NULL;
+}
+
+/* Whether replaying @pattern only ever reads it, so that it can be
+ * used from several threads at once.  Recording surfaces are replayed
+ * in turn, and raster sources call back into the application.
+ */
+static cairo_bool_t
+_pattern_is_concurrent_safe (const cairo_pattern_t *pattern)
+{
+    cairo_surface_t *source;
+    cairo_bool_t is_safe;
+
+    switch (pattern->type) {
+    case CAIRO_PATTERN_TYPE_SOLID:
+    case CAIRO_PATTERN_TYPE_LINEAR:
+    case CAIRO_PATTERN_TYPE_RADIAL:
+    case CAIRO_PATTERN_TYPE_MESH:
+	return TRUE;
+
+    case CAIRO_PATTERN_TYPE_SURFACE:
+	source = ((const cairo_surface_pattern_t *) pattern)->surface;
+	if (! _cairo_surface_is_snapshot (source))
+	    return _surface_is_concurrent_safe (source);
+
+	source = _cairo_surface_snapshot_get_target (source);
+	is_safe = _surface_is_concurrent_safe (source);
+	cairo_surface_destroy (source);
+	return is_safe;
+
+    case CAIRO_PATTERN_TYPE_RASTER_SOURCE:
+	return FALSE;
+    }
+
+    ASSERT_NOT_REACHED;
+    return FALSE;
+}
+
 static cairo_status_t
 _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 					  const cairo_rectangle_int_t *surface_extents,
@@ -1607,7 +1659,8 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 					  cairo_surface_t	     *target,
 					  const cairo_clip_t *target_clip,
 					  cairo_recording_replay_type_t type,
-					  cairo_recording_region_type_t region)
+					  cairo_recording_region_type_t region,
+					  int *visible)
 {
     cairo_surface_wrapper_t wrapper;
     cairo_command_t **elements;
@@ -1652,13 +1705,16 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
     num_elements = surface->commands.num_elements;
     elements = _cairo_array_index (&surface->commands, 0);
     if (extents.width < r->width || extents.height < r->height) {
+	if (visible == NULL)
+	    visible = surface->indices;
 	num_elements =
-	    _cairo_recording_surface_get_visible_commands (surface, &extents);
+	    _cairo_recording_surface_get_visible_commands (surface, &extents,
+							   visible);
 	use_indices = num_elements != surface->commands.num_elements;
     }
 
     for (i = 0; i < num_elements; i++) {
-	cairo_command_t *command = elements[use_indices ? surface->indices[i] : i];
+	cairo_command_t *command = elements[use_indices ? visible[i] : i];
 
 	if (! replay_all && command->header.region != region)
 	    continue;
@@ -1894,7 +1950,8 @@ _cairo_recording_surface_replay (cairo_surface_t *surface,
     return _cairo_recording_surface_replay_internal ((cairo_recording_surface_t *) surface, NULL, NULL,
 						     target, NULL,
 						     CAIRO_RECORDING_REPLAY,
-						     CAIRO_RECORDING_REGION_ALL);
+						     CAIRO_RECORDING_REGION_ALL,
+						     NULL);
 }
 
 cairo_status_t
@@ -1906,7 +1963,8 @@ _cairo_recording_surface_replay_with_clip (cairo_surface_t *surface,
     return _cairo_recording_surface_replay_internal ((cairo_recording_surface_t *) surface, NULL, surface_transform,
 						     target, target_clip,
 						     CAIRO_RECORDING_REPLAY,
-						     CAIRO_RECORDING_REGION_ALL);
+						     CAIRO_RECORDING_REGION_ALL,
+						     NULL);
 }
 
 /* Replay recording to surface. When the return status of each operation is
@@ -1922,7 +1980,8 @@ _cairo_recording_surface_replay_and_create_regions (cairo_surface_t *surface,
     return _cairo_recording_surface_replay_internal ((cairo_recording_surface_t *) surface, NULL, NULL,
 						     target, NULL,
 						     CAIRO_RECORDING_CREATE_REGIONS,
-						     CAIRO_RECORDING_REGION_ALL);
+						     CAIRO_RECORDING_REGION_ALL,
+						     NULL);
 }
 
 cairo_status_t
@@ -1935,7 +1994,108 @@ _cairo_recording_surface_replay_region (cairo_surface_t          *surface,
 						     surface_extents, NULL,
 						     target, NULL,
 						     CAIRO_RECORDING_REPLAY,
-						     region);
+						     region,
+						     NULL);
+}
+
+/**
+ * _cairo_recording_surface_prepare_concurrent_replay:
+ * @surface: the #cairo_recording_surface_t
+ *
+ * Checks whether _cairo_recording_surface_replay_concurrent() may be
+ * called for @surface from several threads at once, and builds the
+ * tree of command extents that it would otherwise build on demand.
+ * This is the case if every pattern the recording uses is only read
+ * while it is replayed; the targets must of course be distinct.
+ *
+ * Return value: %TRUE if @surface may be replayed concurrently.
+ **/
+cairo_bool_t
+_cairo_recording_surface_prepare_concurrent_replay (cairo_surface_t *abstract_surface)
+{
+    cairo_recording_surface_t *surface = (cairo_recording_surface_t *) abstract_surface;
+    cairo_command_t **elements;
+    int i, num_elements;
+
+    if (unlikely (surface->base.status))
+	return FALSE;
+
+    num_elements = surface->commands.num_elements;
+    elements = _cairo_array_index (&surface->commands, 0);
+    for (i = 0; i < num_elements; i++) {
+	cairo_command_t *command = elements[i];
+
+	switch (command->header.type) {
+	case CAIRO_COMMAND_PAINT:
+	    if (! _pattern_is_concurrent_safe (&command->paint.source.base))
+		return FALSE;
+	    break;
+	case CAIRO_COMMAND_MASK:
+	    if (! _pattern_is_concurrent_safe (&command->mask.source.base) ||
+		! _pattern_is_concurrent_safe (&command->mask.mask.base))
+		return FALSE;
+	    break;
+	case CAIRO_COMMAND_STROKE:
+	    if (! _pattern_is_concurrent_safe (&command->stroke.source.base))
+		return FALSE;
+	    break;
+	case CAIRO_COMMAND_FILL:
+	    if (! _pattern_is_concurrent_safe (&command->fill.source.base))
+		return FALSE;
+	    break;
+	case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	    if (! _pattern_is_concurrent_safe (&command->show_text_glyphs.source.base))
+		return FALSE;
+	    /* user fonts render their glyphs by calling the application */
+	    if (cairo_scaled_font_get_type (command->show_text_glyphs.scaled_font) ==
+		CAIRO_FONT_TYPE_USER)
+		return FALSE;
+	    break;
+	default:
+	    ASSERT_NOT_REACHED;
+	}
+    }
+
+    if (num_elements > 0 && surface->bbtree.chain == INVALID_CHAIN) {
+	if (unlikely (_cairo_recording_surface_create_bbtree (surface)))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * _cairo_recording_surface_replay_concurrent:
+ * @surface: a #cairo_recording_surface_t
+ * @target: a target #cairo_surface_t onto which to replay the operations
+ *
+ * As _cairo_recording_surface_replay(), but without touching any
+ * state of @surface, so that once
+ * _cairo_recording_surface_prepare_concurrent_replay() has returned
+ * %TRUE several threads may replay @surface at the same time.  Only
+ * the commands that intersect the extents of @target are replayed.
+ **/
+cairo_status_t
+_cairo_recording_surface_replay_concurrent (cairo_surface_t *abstract_surface,
+					    cairo_surface_t *target)
+{
+    cairo_recording_surface_t *surface = (cairo_recording_surface_t *) abstract_surface;
+    cairo_status_t status;
+    int *visible;
+
+    visible = _cairo_malloc_ab (MAX (surface->commands.num_elements, 1),
+				sizeof (int));
+    if (unlikely (visible == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    status = _cairo_recording_surface_replay_internal (surface, NULL, NULL,
+						       target, NULL,
+						       CAIRO_RECORDING_REPLAY,
+						       CAIRO_RECORDING_REGION_ALL,
+						       visible);
+    free (visible);
+
+    return status;
 }
 
 static cairo_status_t
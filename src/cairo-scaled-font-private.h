@@ -113,6 +113,9 @@ struct _cairo_scaled_font {
     cairo_list_t glyph_pages;
     cairo_bool_t cache_frozen;
     cairo_bool_t global_cache_frozen;
+    /* glyph lookups not yet added to the global statistics */
+    unsigned int glyph_cache_hits;
+    unsigned int glyph_cache_misses;
 
     cairo_list_t dev_privates;
 
@@ -178,6 +181,20 @@ _cairo_scaled_glyph_attach_private (cairo_scaled_glyph_t *scaled_glyph,
 						    cairo_scaled_glyph_t *,
 						    cairo_scaled_font_t *));
 
+/* The global glyph caches are split into shards, chosen by the scaled
+ * font, so that threads drawing with different fonts do not contend on
+ * a single lock. All the glyphs of a font live in the same shard.
+ */
+static inline unsigned int
+_cairo_scaled_font_cache_shard (const cairo_scaled_font_t *scaled_font,
+				unsigned int num_shards)
+{
+    unsigned long p = (unsigned long) (uintptr_t) scaled_font >> 4;
+
+    p ^= (p >> 7) ^ (p >> 13);
+    return p % num_shards;
+}
+
 CAIRO_END_DECLS
 
 #endif /* CAIRO_SCALED_FONT_PRIVATE_H */
@@ -125,6 +125,17 @@ _cairo_scaled_font_subsets_create_composite (void);
 cairo_private void
 _cairo_scaled_font_subsets_destroy (cairo_scaled_font_subsets_t *font_subsets);
 
+/**
+ * _cairo_scaled_font_subsets_get_size:
+ * @font_subsets: a #cairo_scaled_font_subsets_t object
+ *
+ * Returns an estimate, in bytes, of the memory used to track the
+ * fonts and glyphs mapped into @font_subsets so far. This does not
+ * include the scaled fonts themselves.
+ **/
+cairo_private unsigned long
+_cairo_scaled_font_subsets_get_size (cairo_scaled_font_subsets_t *font_subsets);
+
 /**
  * _cairo_scaled_font_subsets_enable_latin_subset:
  * @font_subsets: a #cairo_scaled_font_subsets_t object to be destroyed
@@ -329,6 +340,34 @@ _cairo_scaled_font_subsets_foreach_user (cairo_scaled_font_subsets_t		  *font_su
 					 cairo_scaled_font_subset_callback_func_t  font_subset_callback,
 					 void					  *closure);
 
+/**
+ * _cairo_scaled_font_subset_copy:
+ * @copy: the subset to initialize
+ * @subset: a subset passed to a #cairo_scaled_font_subset_callback_func_t
+ *
+ * Copies @subset so that it can be used once the callback it was
+ * passed to has returned, for instance to build the font program on
+ * another thread. The copy shares the scaled font and the utf8
+ * strings of @subset, so it must not outlive the font subsets it
+ * came from, and it has no glyph names. Release it with
+ * _cairo_scaled_font_subset_fini_copy().
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if successful, or
+ * %CAIRO_STATUS_NO_MEMORY.
+ **/
+cairo_private cairo_status_t
+_cairo_scaled_font_subset_copy (cairo_scaled_font_subset_t	   *copy,
+				const cairo_scaled_font_subset_t   *subset);
+
+/**
+ * _cairo_scaled_font_subset_fini_copy:
+ * @copy: a subset initialized by _cairo_scaled_font_subset_copy()
+ *
+ * Frees the arrays of @copy.
+ **/
+cairo_private void
+_cairo_scaled_font_subset_fini_copy (cairo_scaled_font_subset_t *copy);
+
 /**
  * _cairo_scaled_font_subset_create_glyph_names:
  * @font_subsets: a #cairo_scaled_font_subsets_t
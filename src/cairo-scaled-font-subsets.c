@@ -100,6 +100,7 @@ struct _cairo_scaled_font_subsets {
     cairo_sub_font_t *scaled_sub_fonts_list_end;
 
     int num_sub_fonts;
+    int num_glyphs;
 };
 
 typedef struct _cairo_sub_font_glyph {
@@ -571,6 +572,7 @@ _cairo_sub_font_add_glyph (cairo_sub_font_t	   *sub_font,
     }
 
     (*num_glyphs_in_subset_ptr)++;
+    sub_font->parent->num_glyphs++;
     if (sub_font->is_scaled) {
 	if (*num_glyphs_in_subset_ptr > sub_font->parent->max_glyphs_per_scaled_subset_used)
 	    sub_font->parent->max_glyphs_per_scaled_subset_used = *num_glyphs_in_subset_ptr;
@@ -773,6 +775,7 @@ _cairo_scaled_font_subsets_create_internal (cairo_subsets_type_t type)
     subsets->max_glyphs_per_unscaled_subset_used = 0;
     subsets->max_glyphs_per_scaled_subset_used = 0;
     subsets->num_sub_fonts = 0;
+    subsets->num_glyphs = 0;
 
     subsets->unscaled_sub_fonts = _cairo_hash_table_create (_cairo_sub_fonts_equal);
     if (! subsets->unscaled_sub_fonts) {
@@ -824,6 +827,14 @@ _cairo_scaled_font_subsets_destroy (cairo_scaled_font_subsets_t *subsets)
     free (subsets);
 }
 
+unsigned long
+_cairo_scaled_font_subsets_get_size (cairo_scaled_font_subsets_t *subsets)
+{
+    return sizeof (cairo_scaled_font_subsets_t) +
+	   subsets->num_sub_fonts * sizeof (cairo_sub_font_t) +
+	   subsets->num_glyphs * sizeof (cairo_sub_font_glyph_t);
+}
+
 void
 _cairo_scaled_font_subsets_enable_latin_subset (cairo_scaled_font_subsets_t *font_subsets,
 						cairo_bool_t                 use_latin)
@@ -1145,6 +1156,65 @@ create_string_entry (char *s, cairo_string_entry_t **entry)
     return CAIRO_STATUS_SUCCESS;
 }
 
+cairo_status_t
+_cairo_scaled_font_subset_copy (cairo_scaled_font_subset_t	   *copy,
+				const cairo_scaled_font_subset_t   *subset)
+{
+    unsigned int n = subset->num_glyphs;
+
+    *copy = *subset;
+    copy->utf8 = NULL;
+    copy->glyph_names = NULL;
+    copy->to_latin_char = NULL;
+    copy->latin_to_subset_glyph_index = NULL;
+
+    copy->glyphs = _cairo_malloc_ab (n, sizeof (unsigned long));
+    if (unlikely (copy->glyphs == NULL))
+	goto FAIL;
+    memcpy (copy->glyphs, subset->glyphs, n * sizeof (unsigned long));
+
+    /* the strings themselves belong to the font subsets */
+    copy->utf8 = _cairo_malloc_ab (n, sizeof (char *));
+    if (unlikely (copy->utf8 == NULL))
+	goto FAIL;
+    memcpy (copy->utf8, subset->utf8, n * sizeof (char *));
+
+    if (subset->to_latin_char != NULL) {
+	copy->to_latin_char = _cairo_malloc_ab (n, sizeof (int));
+	if (unlikely (copy->to_latin_char == NULL))
+	    goto FAIL;
+	memcpy (copy->to_latin_char, subset->to_latin_char, n * sizeof (int));
+    }
+
+    if (subset->latin_to_subset_glyph_index != NULL) {
+	copy->latin_to_subset_glyph_index = _cairo_malloc_ab (256, sizeof (unsigned long));
+	if (unlikely (copy->latin_to_subset_glyph_index == NULL))
+	    goto FAIL;
+	memcpy (copy->latin_to_subset_glyph_index,
+		subset->latin_to_subset_glyph_index,
+		256 * sizeof (unsigned long));
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+
+FAIL:
+    _cairo_scaled_font_subset_fini_copy (copy);
+    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+}
+
+void
+_cairo_scaled_font_subset_fini_copy (cairo_scaled_font_subset_t *copy)
+{
+    free (copy->glyphs);
+    free (copy->utf8);
+    free (copy->to_latin_char);
+    free (copy->latin_to_subset_glyph_index);
+    copy->glyphs = NULL;
+    copy->utf8 = NULL;
+    copy->to_latin_char = NULL;
+    copy->latin_to_subset_glyph_index = NULL;
+}
+
 static void
 _pluck_entry (void *entry, void *closure)
 {
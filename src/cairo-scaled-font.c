@@ -78,9 +78,59 @@ _cairo_scaled_font_compute_hash (cairo_scaled_font_t *scaled_font);
  * global pool and ameliorates the memory allocation pressure.
  */
 
-/* XXX: This number is arbitrary---we've never done any measurement of this. */
+/* XXX: This number is arbitrary---we've never done any measurement of this.
+ * A memory budget may be set in addition with cairo_font_cache_set_max_bytes().
+ */
 #define MAX_GLYPH_PAGES_CACHED 512
-static cairo_cache_t cairo_scaled_glyph_page_cache;
+
+/* The global pool is split into shards, each with its own lock, so that
+ * threads rasterising glyphs for different fonts do not serialise on a
+ * single mutex. The shards share a single budget: the pages held by all
+ * of them are counted in _cairo_scaled_glyph_pages_cached, and whilst
+ * that is over MAX_GLYPH_PAGES_CACHED pages are evicted from one shard
+ * after another, so a single busy font may still use the whole pool.
+ */
+#define GLYPH_PAGE_CACHE_SHARDS 8
+
+static cairo_atomic_int_t _cairo_scaled_glyph_pages_cached;
+
+/* Flush a font's glyph hit counts into its shard at least this often. */
+#define GLYPH_CACHE_STATISTICS_BATCH 256
+
+typedef struct _cairo_scaled_glyph_page_cache {
+    cairo_cache_t cache;
+    cairo_mutex_t *mutex;
+    unsigned long max_bytes;
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long bytes;
+} cairo_scaled_glyph_page_cache_t;
+
+#define GLYPH_PAGE_CACHE_SHARD(n) \
+    { { NULL }, &_cairo_scaled_glyph_page_cache_mutex_##n, \
+      ULONG_MAX, 0, 0, 0, 0 }
+
+static cairo_scaled_glyph_page_cache_t
+cairo_scaled_glyph_page_cache[GLYPH_PAGE_CACHE_SHARDS] = {
+    GLYPH_PAGE_CACHE_SHARD (0),
+    GLYPH_PAGE_CACHE_SHARD (1),
+    GLYPH_PAGE_CACHE_SHARD (2),
+    GLYPH_PAGE_CACHE_SHARD (3),
+    GLYPH_PAGE_CACHE_SHARD (4),
+    GLYPH_PAGE_CACHE_SHARD (5),
+    GLYPH_PAGE_CACHE_SHARD (6),
+    GLYPH_PAGE_CACHE_SHARD (7),
+};
+#undef GLYPH_PAGE_CACHE_SHARD
+
+static inline cairo_scaled_glyph_page_cache_t *
+_cairo_scaled_glyph_page_cache_for_font (const cairo_scaled_font_t *scaled_font)
+{
+    return &cairo_scaled_glyph_page_cache[
+	_cairo_scaled_font_cache_shard (scaled_font, GLYPH_PAGE_CACHE_SHARDS)];
+}
 
 #define CAIRO_SCALED_GLYPH_PAGE_SIZE 32
 struct _cairo_scaled_glyph_page {
@@ -92,6 +142,78 @@ struct _cairo_scaled_glyph_page {
     cairo_scaled_glyph_t glyphs[CAIRO_SCALED_GLYPH_PAGE_SIZE];
 };
 
+/* The memory attributed to a glyph in the cache statistics: only the
+ * rendered image is counted, outlines and recordings are not.
+ */
+static unsigned long
+_cairo_scaled_glyph_bytes (const cairo_scaled_glyph_t *scaled_glyph)
+{
+    const cairo_image_surface_t *image = scaled_glyph->surface;
+
+    if (image == NULL)
+	return 0;
+
+    return (unsigned long) image->stride * image->height;
+}
+
+/* Discard pages until the shard is within its memory budget. The caller
+ * holds the shard's mutex; pages of scaled fonts in use are kept.
+ */
+static void
+_cairo_scaled_glyph_page_cache_trim (cairo_scaled_glyph_page_cache_t *shard)
+{
+    if (shard->cache.hash_table == NULL)
+	return;
+
+    while (shard->bytes > shard->max_bytes &&
+	   shard->cache.freeze_count == 0 &&
+	   _cairo_cache_remove_random (&shard->cache))
+    {
+	shard->evictions++;
+    }
+}
+
+/* Evict pages, starting with those of @first and then moving on to the
+ * other shards, until no more than MAX_GLYPH_PAGES_CACHED are held in
+ * total. The caller must not hold any shard's mutex, only one of which is
+ * taken at a time.
+ */
+static void
+_cairo_scaled_glyph_page_cache_balance (cairo_scaled_glyph_page_cache_t *first)
+{
+    unsigned int n, i;
+
+    n = first - cairo_scaled_glyph_page_cache;
+    for (i = 0; i < GLYPH_PAGE_CACHE_SHARDS; i++) {
+	cairo_scaled_glyph_page_cache_t *shard;
+
+	if (_cairo_atomic_int_get (&_cairo_scaled_glyph_pages_cached) <= MAX_GLYPH_PAGES_CACHED)
+	    return;
+
+	shard = &cairo_scaled_glyph_page_cache[(n + i) % GLYPH_PAGE_CACHE_SHARDS];
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	if (shard->cache.hash_table != NULL) {
+	    while (shard->cache.freeze_count == 0 &&
+		   _cairo_atomic_int_get (&_cairo_scaled_glyph_pages_cached) > MAX_GLYPH_PAGES_CACHED &&
+		   _cairo_cache_remove_random (&shard->cache))
+	    {
+		shard->evictions++;
+	    }
+	}
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+    }
+}
+
+static void
+_cairo_scaled_glyph_page_cache_flush_statistics (cairo_scaled_glyph_page_cache_t *shard,
+						 cairo_scaled_font_t *scaled_font)
+{
+    shard->hits += scaled_font->glyph_cache_hits;
+    shard->misses += scaled_font->glyph_cache_misses;
+    scaled_font->glyph_cache_hits = 0;
+    scaled_font->glyph_cache_misses = 0;
+}
+
 /*
  *  Notes:
  *
@@ -253,6 +375,8 @@ static const cairo_scaled_font_t _cairo_scaled_font_nil = {
     { NULL, NULL },		/* pages */
     FALSE,			/* cache_frozen */
     FALSE,			/* global_cache_frozen */
+    0,				/* glyph_cache_hits */
+    0,				/* glyph_cache_misses */
     { NULL, NULL },		/* privates */
     NULL			/* backend */
 };
@@ -348,20 +472,31 @@ slim_hidden_def (cairo_scaled_font_status);
  * cairo_scaled_font_reference() and cairo_scaled_font_destroy().
  */
 
-/* This defines the size of the holdover array ... that is, the number
- * of scaled fonts we keep around even when not otherwise referenced
+/* This defines the default size of the holdover array ... that is, the
+ * number of scaled fonts we keep around even when not otherwise
+ * referenced. It may be changed with cairo_font_cache_set_max_bytes(),
+ * counting sizeof (cairo_scaled_font_t) bytes for each holdover.
  */
 #define CAIRO_SCALED_FONT_MAX_HOLDOVERS 256
 
 typedef struct _cairo_scaled_font_map {
     cairo_scaled_font_t *mru_scaled_font;
     cairo_hash_table_t *hash_table;
-    cairo_scaled_font_t *holdovers[CAIRO_SCALED_FONT_MAX_HOLDOVERS];
+    cairo_scaled_font_t **holdovers;
     int num_holdovers;
+    int holdovers_size;
 } cairo_scaled_font_map_t;
 
 static cairo_scaled_font_map_t *cairo_scaled_font_map;
 
+/* The following are protected by _cairo_scaled_font_map_mutex. */
+static int cairo_scaled_font_max_holdovers = CAIRO_SCALED_FONT_MAX_HOLDOVERS;
+static unsigned long cairo_scaled_font_map_max_bytes =
+    CAIRO_SCALED_FONT_MAX_HOLDOVERS * sizeof (cairo_scaled_font_t);
+static unsigned long cairo_scaled_font_map_hits;
+static unsigned long cairo_scaled_font_map_misses;
+static unsigned long cairo_scaled_font_map_evictions;
+
 static int
 _cairo_scaled_font_keys_equal (const void *abstract_key_a, const void *abstract_key_b);
 
@@ -382,7 +517,9 @@ _cairo_scaled_font_map_lock (void)
 	if (unlikely (cairo_scaled_font_map->hash_table == NULL))
 	    goto CLEANUP_SCALED_FONT_MAP;
 
+	cairo_scaled_font_map->holdovers = NULL;
 	cairo_scaled_font_map->num_holdovers = 0;
+	cairo_scaled_font_map->holdovers_size = 0;
     }
 
     return cairo_scaled_font_map;
@@ -443,6 +580,7 @@ _cairo_scaled_font_map_destroy (void)
 
     _cairo_hash_table_destroy (font_map->hash_table);
 
+    free (font_map->holdovers);
     free (cairo_scaled_font_map);
     cairo_scaled_font_map = NULL;
 
@@ -456,15 +594,24 @@ _cairo_scaled_glyph_page_destroy (cairo_scaled_font_t *scaled_font,
 {
     unsigned int n;
 
+    cairo_scaled_glyph_page_cache_t *shard;
+    unsigned long bytes = sizeof (cairo_scaled_glyph_page_t);
+
     assert (!scaled_font->cache_frozen);
     assert (!scaled_font->global_cache_frozen);
 
     for (n = 0; n < page->num_glyphs; n++) {
+	bytes += _cairo_scaled_glyph_bytes (&page->glyphs[n]);
 	_cairo_hash_table_remove (scaled_font->glyphs,
 				  &page->glyphs[n].hash_entry);
 	_cairo_scaled_glyph_fini (scaled_font, &page->glyphs[n]);
     }
 
+    /* the caller holds the shard's mutex */
+    shard = _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+    shard->bytes -= MIN (bytes, shard->bytes);
+    _cairo_atomic_int_dec (&_cairo_scaled_glyph_pages_cached);
+
     cairo_list_del (&page->link);
     free (page);
 }
@@ -768,6 +915,8 @@ _cairo_scaled_font_init (cairo_scaled_font_t               *scaled_font,
     cairo_list_init (&scaled_font->glyph_pages);
     scaled_font->cache_frozen = FALSE;
     scaled_font->global_cache_frozen = FALSE;
+    scaled_font->glyph_cache_hits = 0;
+    scaled_font->glyph_cache_misses = 0;
 
     scaled_font->holdover = FALSE;
     scaled_font->finished = FALSE;
@@ -805,10 +954,27 @@ _cairo_scaled_font_thaw_cache (cairo_scaled_font_t *scaled_font)
     assert (scaled_font->cache_frozen);
 
     if (scaled_font->global_cache_frozen) {
-	CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-	_cairo_cache_thaw (&cairo_scaled_glyph_page_cache);
-	CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+	cairo_scaled_glyph_page_cache_t *shard =
+	    _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+
+	unsigned long pages;
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	_cairo_scaled_glyph_page_cache_flush_statistics (shard, scaled_font);
+	pages = shard->cache.size;
+	_cairo_cache_thaw (&shard->cache);
+	shard->evictions += pages - shard->cache.size;
+	_cairo_scaled_glyph_page_cache_trim (shard);
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+	_cairo_scaled_glyph_page_cache_balance (shard);
 	scaled_font->global_cache_frozen = FALSE;
+    } else if (scaled_font->glyph_cache_hits >= GLYPH_CACHE_STATISTICS_BATCH) {
+	cairo_scaled_glyph_page_cache_t *shard =
+	    _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	_cairo_scaled_glyph_page_cache_flush_statistics (shard, scaled_font);
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
     }
 
     scaled_font->cache_frozen = FALSE;
@@ -818,23 +984,27 @@ _cairo_scaled_font_thaw_cache (cairo_scaled_font_t *scaled_font)
 void
 _cairo_scaled_font_reset_cache (cairo_scaled_font_t *scaled_font)
 {
+    cairo_scaled_glyph_page_cache_t *shard;
+
     CAIRO_MUTEX_LOCK (scaled_font->mutex);
     assert (! scaled_font->cache_frozen);
     assert (! scaled_font->global_cache_frozen);
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    shard = _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+    CAIRO_MUTEX_LOCK (*shard->mutex);
+    _cairo_scaled_glyph_page_cache_flush_statistics (shard, scaled_font);
     while (! cairo_list_is_empty (&scaled_font->glyph_pages)) {
 	cairo_scaled_glyph_page_t *page =
 	    cairo_list_first_entry (&scaled_font->glyph_pages,
 				    cairo_scaled_glyph_page_t,
 				    link);
 
-	cairo_scaled_glyph_page_cache.size -= page->cache_entry.size;
-	_cairo_hash_table_remove (cairo_scaled_glyph_page_cache.hash_table,
+	shard->cache.size -= page->cache_entry.size;
+	_cairo_hash_table_remove (shard->cache.hash_table,
 				  (cairo_hash_entry_t *) &page->cache_entry);
 
 	_cairo_scaled_glyph_page_destroy (scaled_font, page);
     }
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    CAIRO_MUTEX_UNLOCK (*shard->mutex);
     CAIRO_MUTEX_UNLOCK (scaled_font->mutex);
 }
 
@@ -1086,6 +1256,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 		}
 
 		scaled_font->holdover = FALSE;
+		cairo_scaled_font_map_hits++;
 	    }
 
 	    /* reset any error status */
@@ -1121,6 +1292,7 @@ cairo_scaled_font_create (cairo_font_face_t          *font_face,
 
 
     /* Otherwise create it and insert it into the hash table. */
+    cairo_scaled_font_map_misses++;
     if (font_face->backend->get_implementation != NULL) {
 	font_face = font_face->backend->get_implementation (font_face,
 							    font_matrix,
@@ -1237,6 +1409,13 @@ void
 _cairo_scaled_font_reset_static_data (void)
 {
     int status;
+    unsigned int i;
+
+    CAIRO_MUTEX_LOCK (_cairo_scaled_font_map_mutex);
+    cairo_scaled_font_map_hits = 0;
+    cairo_scaled_font_map_misses = 0;
+    cairo_scaled_font_map_evictions = 0;
+    CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_map_mutex);
 
     CAIRO_MUTEX_LOCK (_cairo_scaled_font_error_mutex);
     for (status = CAIRO_STATUS_SUCCESS;
@@ -1248,12 +1427,17 @@ _cairo_scaled_font_reset_static_data (void)
     }
     CAIRO_MUTEX_UNLOCK (_cairo_scaled_font_error_mutex);
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-    if (cairo_scaled_glyph_page_cache.hash_table != NULL) {
-	_cairo_cache_fini (&cairo_scaled_glyph_page_cache);
-	cairo_scaled_glyph_page_cache.hash_table = NULL;
+    for (i = 0; i < GLYPH_PAGE_CACHE_SHARDS; i++) {
+	cairo_scaled_glyph_page_cache_t *shard = &cairo_scaled_glyph_page_cache[i];
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	if (shard->cache.hash_table != NULL) {
+	    _cairo_cache_fini (&shard->cache);
+	    shard->cache.hash_table = NULL;
+	}
+	shard->hits = shard->misses = shard->evictions = shard->bytes = 0;
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
     }
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
 }
 
 /**
@@ -1336,7 +1520,35 @@ cairo_scaled_font_destroy (cairo_scaled_font_t *scaled_font)
 	     * destroy the least-recently-used holdover.
 	     */
 
-	    if (font_map->num_holdovers == CAIRO_SCALED_FONT_MAX_HOLDOVERS) {
+	    if (font_map->num_holdovers == font_map->holdovers_size &&
+		font_map->holdovers_size < cairo_scaled_font_max_holdovers)
+	    {
+		cairo_scaled_font_t **holdovers;
+		int size;
+
+		size = MAX (16, 2 * font_map->holdovers_size);
+		size = MIN (size, cairo_scaled_font_max_holdovers);
+		holdovers = _cairo_realloc_ab (font_map->holdovers,
+					       size, sizeof (cairo_scaled_font_t *));
+		if (holdovers != NULL) {
+		    font_map->holdovers = holdovers;
+		    font_map->holdovers_size = size;
+		}
+	    }
+
+	    /* No room for holdovers at all, so destroy it immediately. */
+	    if (cairo_scaled_font_max_holdovers == 0 ||
+		font_map->holdovers_size == 0)
+	    {
+		_cairo_hash_table_remove (font_map->hash_table,
+					  &scaled_font->hash_entry);
+		lru = scaled_font;
+		goto unlock;
+	    }
+
+	    if (font_map->num_holdovers >= font_map->holdovers_size ||
+		font_map->num_holdovers >= cairo_scaled_font_max_holdovers)
+	    {
 		lru = font_map->holdovers[0];
 		assert (! CAIRO_REFERENCE_COUNT_HAS_REFERENCE (&lru->ref_count));
 
@@ -1347,6 +1559,7 @@ cairo_scaled_font_destroy (cairo_scaled_font_t *scaled_font)
 		memmove (&font_map->holdovers[0],
 			 &font_map->holdovers[1],
 			 font_map->num_holdovers * sizeof (cairo_scaled_font_t*));
+		cairo_scaled_font_map_evictions++;
 	    }
 
 	    font_map->holdovers[font_map->num_holdovers++] = scaled_font;
@@ -2832,6 +3045,7 @@ static cairo_status_t
 _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
 				   cairo_scaled_glyph_t **scaled_glyph)
 {
+    cairo_scaled_glyph_page_cache_t *shard;
     cairo_scaled_glyph_page_t *page;
     cairo_status_t status;
 
@@ -2856,28 +3070,32 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
     page->cache_entry.size = 1; /* XXX occupancy weighting? */
     page->num_glyphs = 0;
 
-    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    shard = _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+    CAIRO_MUTEX_LOCK (*shard->mutex);
     if (scaled_font->global_cache_frozen == FALSE) {
-	if (unlikely (cairo_scaled_glyph_page_cache.hash_table == NULL)) {
-	    status = _cairo_cache_init (&cairo_scaled_glyph_page_cache,
+	if (unlikely (shard->cache.hash_table == NULL)) {
+	    status = _cairo_cache_init (&shard->cache,
 					NULL,
 					_cairo_scaled_glyph_page_can_remove,
 					_cairo_scaled_glyph_page_pluck,
 					MAX_GLYPH_PAGES_CACHED);
 	    if (unlikely (status)) {
-		CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+		CAIRO_MUTEX_UNLOCK (*shard->mutex);
 		free (page);
 		return status;
 	    }
 	}
 
-	_cairo_cache_freeze (&cairo_scaled_glyph_page_cache);
+	_cairo_cache_freeze (&shard->cache);
 	scaled_font->global_cache_frozen = TRUE;
     }
 
-    status = _cairo_cache_insert (&cairo_scaled_glyph_page_cache,
-				  &page->cache_entry);
-    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+    status = _cairo_cache_insert (&shard->cache, &page->cache_entry);
+    if (likely (status == CAIRO_STATUS_SUCCESS)) {
+	shard->bytes += sizeof (cairo_scaled_glyph_page_t);
+	_cairo_atomic_int_inc (&_cairo_scaled_glyph_pages_cached);
+    }
+    CAIRO_MUTEX_UNLOCK (*shard->mutex);
     if (unlikely (status)) {
 	free (page);
 	return status;
@@ -2889,6 +3107,24 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
     return CAIRO_STATUS_SUCCESS;
 }
 
+static void
+_cairo_scaled_glyph_page_cache_add_bytes (cairo_scaled_font_t *scaled_font,
+					  long bytes)
+{
+    cairo_scaled_glyph_page_cache_t *shard;
+
+    if (bytes == 0)
+	return;
+
+    shard = _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+    CAIRO_MUTEX_LOCK (*shard->mutex);
+    if (bytes < 0)
+	shard->bytes -= MIN ((unsigned long) -bytes, shard->bytes);
+    else
+	shard->bytes += bytes;
+    CAIRO_MUTEX_UNLOCK (*shard->mutex);
+}
+
 static void
 _cairo_scaled_font_free_last_glyph (cairo_scaled_font_t *scaled_font,
 			           cairo_scaled_glyph_t *scaled_glyph)
@@ -2904,10 +3140,12 @@ _cairo_scaled_font_free_last_glyph (cairo_scaled_font_t *scaled_font,
     _cairo_scaled_glyph_fini (scaled_font, scaled_glyph);
 
     if (--page->num_glyphs == 0) {
-	CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
-	_cairo_cache_remove (&cairo_scaled_glyph_page_cache,
-		             &page->cache_entry);
-	CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+	cairo_scaled_glyph_page_cache_t *shard =
+	    _cairo_scaled_glyph_page_cache_for_font (scaled_font);
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	_cairo_cache_remove (&shard->cache, &page->cache_entry);
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
     }
 }
 
@@ -2989,6 +3227,12 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
 	    _cairo_scaled_font_free_last_glyph (scaled_font, scaled_glyph);
 	    goto err;
 	}
+
+	scaled_font->glyph_cache_misses++;
+	_cairo_scaled_glyph_page_cache_add_bytes (scaled_font,
+						  _cairo_scaled_glyph_bytes (scaled_glyph));
+    } else if ((info & ~scaled_glyph->has_info) == 0) {
+	scaled_font->glyph_cache_hits++;
     }
 
     /*
@@ -2997,9 +3241,14 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
      */
     need_info = info & ~scaled_glyph->has_info;
     if (need_info) {
+	long bytes = _cairo_scaled_glyph_bytes (scaled_glyph);
+
+	scaled_font->glyph_cache_misses++;
 	status = scaled_font->backend->scaled_glyph_init (scaled_font,
 							  scaled_glyph,
 							  need_info);
+	bytes = (long) _cairo_scaled_glyph_bytes (scaled_glyph) - bytes;
+	_cairo_scaled_glyph_page_cache_add_bytes (scaled_font, bytes);
 	if (unlikely (status))
 	    goto err;
 
@@ -3021,6 +3270,135 @@ err:
     return status;
 }
 
+/* Below this many new glyphs it is cheaper to render them one by one
+ * than to hand them to the backend as a batch.
+ */
+#define MIN_GLYPH_SURFACE_BATCH 32
+
+static int
+_scaled_glyph_ptr_compare (const void *a, const void *b)
+{
+    const cairo_scaled_glyph_t *glyph_a = *(const cairo_scaled_glyph_t **) a;
+    const cairo_scaled_glyph_t *glyph_b = *(const cairo_scaled_glyph_t **) b;
+
+    return (glyph_a > glyph_b) - (glyph_a < glyph_b);
+}
+
+/**
+ * _cairo_scaled_font_prepare_glyph_surfaces:
+ * @scaled_font: a #cairo_scaled_font_t
+ * @glyphs: the glyphs about to be drawn
+ * @num_glyphs: the number of glyphs
+ * @num_threads: the maximum number of threads the backend may use
+ *
+ * Ensures, where the font backend is able to, that the images of all
+ * of @glyphs are rendered before they are looked up individually with
+ * _cairo_scaled_glyph_lookup(). Glyphs missing from the cache are
+ * collected and given to the backend in one batch, which may render
+ * them concurrently.  This is purely an optimisation: any glyph that
+ * is not prepared here is rendered by the normal lookup.
+ *
+ * As with _cairo_scaled_glyph_lookup(), the scaled font must be locked
+ * and its cache frozen.
+ *
+ * Returns: %CAIRO_STATUS_SUCCESS or an error status if the scaled font
+ * has entered an error state.
+ **/
+cairo_int_status_t
+_cairo_scaled_font_prepare_glyph_surfaces (cairo_scaled_font_t *scaled_font,
+					   const cairo_glyph_t *glyphs,
+					   int num_glyphs,
+					   int num_threads)
+{
+    cairo_scaled_glyph_t *stack_glyphs[CAIRO_STACK_ARRAY_LENGTH (cairo_scaled_glyph_t *)];
+    cairo_scaled_glyph_t **pending = stack_glyphs;
+    cairo_int_status_t status = CAIRO_INT_STATUS_SUCCESS;
+    int num_pending, i, j;
+    long bytes;
+
+    if (scaled_font->backend->scaled_glyphs_init_surfaces == NULL ||
+	num_threads <= 1 || num_glyphs < MIN_GLYPH_SURFACE_BATCH)
+	return CAIRO_INT_STATUS_SUCCESS;
+
+    if (unlikely (scaled_font->status))
+	return scaled_font->status;
+
+    assert (CAIRO_MUTEX_IS_LOCKED(scaled_font->mutex));
+    assert (scaled_font->cache_frozen);
+
+    if (num_glyphs > ARRAY_LENGTH (stack_glyphs)) {
+	pending = _cairo_malloc_ab (num_glyphs, sizeof (cairo_scaled_glyph_t *));
+	if (unlikely (pending == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    num_pending = 0;
+    for (i = 0; i < num_glyphs; i++) {
+	cairo_scaled_glyph_t *scaled_glyph;
+	unsigned long index = glyphs[i].index;
+
+	scaled_glyph = _cairo_hash_table_lookup (scaled_font->glyphs,
+						 (cairo_hash_entry_t *) &index);
+	if (scaled_glyph != NULL &&
+	    scaled_glyph->has_info & CAIRO_SCALED_GLYPH_INFO_SURFACE)
+	    continue;
+
+	/* Only the metrics are loaded here, which is cheap compared to
+	 * rendering; the surface is left for the backend to batch.
+	 */
+	status = _cairo_scaled_glyph_lookup (scaled_font, index,
+					     CAIRO_SCALED_GLYPH_INFO_METRICS,
+					     &scaled_glyph);
+	if (unlikely (status))
+	    goto out;
+
+	if ((scaled_glyph->has_info & CAIRO_SCALED_GLYPH_INFO_SURFACE) == 0)
+	    pending[num_pending++] = scaled_glyph;
+    }
+
+    if (num_pending < MIN_GLYPH_SURFACE_BATCH)
+	goto out;
+
+    /* A run of text will usually repeat glyphs, and each must be
+     * rendered only once.
+     */
+    qsort (pending, num_pending, sizeof (cairo_scaled_glyph_t *),
+	   _scaled_glyph_ptr_compare);
+    for (i = j = 1; i < num_pending; i++) {
+	if (pending[i] != pending[j - 1])
+	    pending[j++] = pending[i];
+    }
+    num_pending = j;
+
+    if (num_pending < MIN_GLYPH_SURFACE_BATCH)
+	goto out;
+
+    status = scaled_font->backend->scaled_glyphs_init_surfaces (scaled_font,
+								pending,
+								num_pending,
+								num_threads);
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED)
+	status = CAIRO_INT_STATUS_SUCCESS;
+
+    bytes = 0;
+    for (i = 0; i < num_pending; i++)
+	bytes += _cairo_scaled_glyph_bytes (pending[i]);
+    _cairo_scaled_glyph_page_cache_add_bytes (scaled_font, bytes);
+
+    if (unlikely (status))
+	status = _cairo_scaled_font_set_error (scaled_font, status);
+
+out:
+    if (pending != stack_glyphs)
+	free (pending);
+
+    /* Let the individual lookups report glyphs without metrics. */
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED)
+	status = CAIRO_INT_STATUS_SUCCESS;
+
+    return status;
+}
+
 double
 _cairo_scaled_font_get_max_scale (cairo_scaled_font_t *scaled_font)
 {
@@ -3152,3 +3530,186 @@ cairo_scaled_font_get_font_options (cairo_scaled_font_t		*scaled_font,
     _cairo_font_options_init_copy (options, &scaled_font->options);
 }
 slim_hidden_def (cairo_scaled_font_get_font_options);
+
+static cairo_status_t
+_cairo_scaled_font_map_set_max_bytes (unsigned long max_bytes)
+{
+    cairo_scaled_font_map_t *font_map;
+
+    font_map = _cairo_scaled_font_map_lock ();
+    if (unlikely (font_map == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    cairo_scaled_font_map_max_bytes = max_bytes;
+    cairo_scaled_font_max_holdovers =
+	MIN (max_bytes / sizeof (cairo_scaled_font_t), INT_MAX);
+
+    /* Expire the least-recently-used holdovers that no longer fit,
+     * releasing the lock whilst each one is destroyed.
+     */
+    while (font_map->num_holdovers > cairo_scaled_font_max_holdovers) {
+	cairo_scaled_font_t *lru = font_map->holdovers[0];
+
+	assert (! CAIRO_REFERENCE_COUNT_HAS_REFERENCE (&lru->ref_count));
+	_cairo_hash_table_remove (font_map->hash_table, &lru->hash_entry);
+
+	font_map->num_holdovers--;
+	memmove (&font_map->holdovers[0],
+		 &font_map->holdovers[1],
+		 font_map->num_holdovers * sizeof (cairo_scaled_font_t*));
+	cairo_scaled_font_map_evictions++;
+
+	_cairo_scaled_font_map_unlock ();
+	_cairo_scaled_font_fini_internal (lru);
+	free (lru);
+
+	font_map = _cairo_scaled_font_map_lock ();
+	if (unlikely (font_map == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    _cairo_scaled_font_map_unlock ();
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_scaled_font_map_get_statistics (cairo_font_cache_statistics_t *statistics)
+{
+    cairo_scaled_font_map_t *font_map;
+
+    font_map = _cairo_scaled_font_map_lock ();
+    if (unlikely (font_map == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    statistics->hits = cairo_scaled_font_map_hits;
+    statistics->misses = cairo_scaled_font_map_misses;
+    statistics->evictions = cairo_scaled_font_map_evictions;
+    statistics->entries = font_map->num_holdovers;
+    statistics->max_bytes = cairo_scaled_font_map_max_bytes;
+    /* The glyphs of the holdovers are accounted to the glyph pages. */
+    statistics->bytes = font_map->num_holdovers * sizeof (cairo_scaled_font_t);
+
+    _cairo_scaled_font_map_unlock ();
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_scaled_glyph_page_cache_set_max_bytes (unsigned long max_bytes)
+{
+    unsigned int i;
+
+    if (max_bytes != ULONG_MAX)
+	max_bytes = (max_bytes + GLYPH_PAGE_CACHE_SHARDS - 1) / GLYPH_PAGE_CACHE_SHARDS;
+
+    for (i = 0; i < GLYPH_PAGE_CACHE_SHARDS; i++) {
+	cairo_scaled_glyph_page_cache_t *shard = &cairo_scaled_glyph_page_cache[i];
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	shard->max_bytes = max_bytes;
+	_cairo_scaled_glyph_page_cache_trim (shard);
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+    }
+}
+
+static void
+_cairo_scaled_glyph_page_cache_get_statistics (cairo_font_cache_statistics_t *statistics)
+{
+    unsigned int i;
+
+    memset (statistics, 0, sizeof (cairo_font_cache_statistics_t));
+    for (i = 0; i < GLYPH_PAGE_CACHE_SHARDS; i++) {
+	cairo_scaled_glyph_page_cache_t *shard = &cairo_scaled_glyph_page_cache[i];
+
+	CAIRO_MUTEX_LOCK (*shard->mutex);
+	statistics->hits += shard->hits;
+	statistics->misses += shard->misses;
+	statistics->evictions += shard->evictions;
+	if (shard->cache.hash_table != NULL)
+	    statistics->entries += shard->cache.size;
+	if (shard->max_bytes == ULONG_MAX || statistics->max_bytes == ULONG_MAX)
+	    statistics->max_bytes = ULONG_MAX;
+	else
+	    statistics->max_bytes += shard->max_bytes;
+	statistics->bytes += shard->bytes;
+	CAIRO_MUTEX_UNLOCK (*shard->mutex);
+    }
+}
+
+/**
+ * cairo_font_cache_set_max_bytes:
+ * @cache: the font cache to configure
+ * @max_bytes: the memory budget for @cache, in bytes
+ *
+ * Sets the memory budget of one of the global caches cairo keeps for
+ * text, counted as described for #cairo_font_cache_t. Lowering the
+ * budget discards entries that no longer fit, except for those
+ * currently in use, which are discarded once they are released. A
+ * budget of 0 disables caching of unreferenced scaled fonts, and
+ * limits the other caches to the glyphs in use. The glyph caches
+ * also keep their built-in limit on the number of glyphs, so
+ * %ULONG_MAX, their default budget, restores the default behaviour.
+ *
+ * The glyph caches are partitioned internally between scaled fonts,
+ * with the budget shared evenly between the partitions, so a single
+ * scaled font may only use a fraction of it.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS, %CAIRO_STATUS_INVALID_INDEX if
+ * @cache is not a known cache, or %CAIRO_STATUS_NO_MEMORY.
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_font_cache_set_max_bytes (cairo_font_cache_t cache,
+				unsigned long      max_bytes)
+{
+    switch (cache) {
+    case CAIRO_FONT_CACHE_SCALED_FONTS:
+	return _cairo_scaled_font_map_set_max_bytes (max_bytes);
+    case CAIRO_FONT_CACHE_GLYPH_PAGES:
+	_cairo_scaled_glyph_page_cache_set_max_bytes (max_bytes);
+	return CAIRO_STATUS_SUCCESS;
+    case CAIRO_FONT_CACHE_IMAGE_GLYPHS:
+	_cairo_image_glyph_cache_set_max_bytes (max_bytes);
+	return CAIRO_STATUS_SUCCESS;
+    default:
+	return _cairo_error (CAIRO_STATUS_INVALID_INDEX);
+    }
+}
+
+/**
+ * cairo_font_cache_get_statistics:
+ * @cache: the font cache to query
+ * @statistics: return location for the counters of @cache
+ *
+ * Reports how one of the global caches cairo keeps for text has been
+ * used, together with its current size and budget. The counters are
+ * gathered without stopping other threads, so they are approximate
+ * while text is being drawn concurrently, and glyph lookups are
+ * counted in batches.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS, %CAIRO_STATUS_NULL_POINTER if
+ * @statistics is %NULL, %CAIRO_STATUS_INVALID_INDEX if @cache is not a
+ * known cache, or %CAIRO_STATUS_NO_MEMORY.
+ *
+ * Since: 1.14
+ **/
+cairo_status_t
+cairo_font_cache_get_statistics (cairo_font_cache_t             cache,
+				 cairo_font_cache_statistics_t *statistics)
+{
+    if (statistics == NULL)
+	return _cairo_error (CAIRO_STATUS_NULL_POINTER);
+
+    switch (cache) {
+    case CAIRO_FONT_CACHE_SCALED_FONTS:
+	return _cairo_scaled_font_map_get_statistics (statistics);
+    case CAIRO_FONT_CACHE_GLYPH_PAGES:
+	_cairo_scaled_glyph_page_cache_get_statistics (statistics);
+	return CAIRO_STATUS_SUCCESS;
+    case CAIRO_FONT_CACHE_IMAGE_GLYPHS:
+	_cairo_image_glyph_cache_get_statistics (statistics);
+	return CAIRO_STATUS_SUCCESS;
+    default:
+	return _cairo_error (CAIRO_STATUS_INVALID_INDEX);
+    }
+}
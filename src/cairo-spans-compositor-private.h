@@ -100,12 +100,19 @@ struct cairo_spans_compositor {
 
     void (*renderer_fini) (cairo_abstract_span_renderer_t *renderer,
 			   cairo_int_status_t status);
+
+    /* optional: the number of threads across which independent
+     * horizontal bands of the surface may be rendered concurrently */
+    int (*renderer_threads) (void *surface);
 };
 
 cairo_private void
 _cairo_spans_compositor_init (cairo_spans_compositor_t *compositor,
 			      const cairo_compositor_t  *delegate);
 
+cairo_private void
+_cairo_spans_compositor_reset_static_data (void);
+
 CAIRO_END_DECLS
 
 #endif /* CAIRO_SPANS_COMPOSITOR_PRIVATE_H */
@@ -46,6 +46,7 @@
 #include "cairo-clip-private.h"
 #include "cairo-image-surface-private.h"
 #include "cairo-paginated-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-pattern-inline.h"
 #include "cairo-region-private.h"
 #include "cairo-recording-surface-inline.h"
@@ -737,6 +738,223 @@ cleanup_converter:
     return status;
 }
 
+/* The sparse scan converter computes the same coverage as tor using
+ * flat arrays instead of linked cells; it may be selected for the
+ * antialiased paths by setting CAIRO_SCAN_CONVERTER=sparse in the
+ * environment.  Like CAIRO_DEBUG_TRAPS this is a debugging switch,
+ * for testing and comparing the converters, and not part of the API.
+ * The environment is read once, under a lock, and read again after
+ * cairo_debug_reset_static_data().
+ */
+static cairo_atomic_int_t _cairo_sparse_scan_converter_selected = -1;
+
+static cairo_bool_t
+_sparse_scan_converter_enabled (void)
+{
+    int enabled;
+
+    enabled = _cairo_atomic_int_get (&_cairo_sparse_scan_converter_selected);
+    if (likely (enabled >= 0))
+	return enabled;
+
+    CAIRO_MUTEX_LOCK (_cairo_scan_converter_mutex);
+    enabled = _cairo_sparse_scan_converter_selected;
+    if (enabled < 0) {
+	const char *env = getenv ("CAIRO_SCAN_CONVERTER");
+	enabled = env && strcmp (env, "sparse") == 0;
+	_cairo_sparse_scan_converter_selected = enabled;
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_scan_converter_mutex);
+
+    return enabled;
+}
+
+void
+_cairo_spans_compositor_reset_static_data (void)
+{
+    CAIRO_MUTEX_LOCK (_cairo_scan_converter_mutex);
+    _cairo_sparse_scan_converter_selected = -1;
+    CAIRO_MUTEX_UNLOCK (_cairo_scan_converter_mutex);
+}
+
+static cairo_int_status_t
+create_scan_converter (const cairo_rectangle_int_t	*r,
+		       const cairo_polygon_t		*polygon,
+		       cairo_fill_rule_t		 fill_rule,
+		       cairo_antialias_t		 antialias,
+		       cairo_bool_t			 continued,
+		       cairo_scan_converter_t		**converter_out)
+{
+    cairo_scan_converter_t *converter;
+
+    if (_sparse_scan_converter_enabled ()) {
+	converter = _cairo_sparse_scan_converter_create (r->x, r->y,
+							 r->x + r->width,
+							 r->y + r->height,
+							 fill_rule, antialias);
+	*converter_out = converter;
+	if (unlikely (converter->status))
+	    return converter->status;
+
+	return _cairo_sparse_scan_converter_add_polygon (converter, polygon);
+    }
+
+    if (continued) {
+	converter = _cairo_tor_scan_converter_create_band (r->x, r->y,
+							   r->x + r->width,
+							   r->y + r->height,
+							   fill_rule, antialias);
+    } else {
+	converter = _cairo_tor_scan_converter_create (r->x, r->y,
+						      r->x + r->width,
+						      r->y + r->height,
+						      fill_rule, antialias);
+    }
+    *converter_out = converter;
+    if (unlikely (converter->status))
+	return converter->status;
+
+    return _cairo_tor_scan_converter_add_polygon (converter, polygon);
+}
+
+/* Large polygons may be split into horizontal bands, each with its
+ * own scan converter and span renderer, and rendered concurrently.
+ * Every band but the first continues the polygon from the band above,
+ * and its scan converter treats the edges clipped by its top exactly
+ * as if they had been stepped down to it, so the result is identical
+ * to converting the whole polygon at once.
+ */
+#define MIN_BAND_HEIGHT 64
+#define MIN_BANDED_AREA (512*512)
+
+struct composite_band {
+    cairo_composite_rectangles_t extents;
+    cairo_abstract_span_renderer_t renderer;
+    cairo_int_status_t status;
+};
+
+typedef struct {
+    const cairo_spans_compositor_t *compositor;
+    const cairo_polygon_t *polygon;
+    cairo_fill_rule_t fill_rule;
+    cairo_antialias_t antialias;
+    struct composite_band *bands;
+} composite_bands_info_t;
+
+static void
+composite_band (void *closure, int n)
+{
+    composite_bands_info_t *info = closure;
+    struct composite_band *band = &info->bands[n];
+    const cairo_rectangle_int_t *r = &band->extents.unbounded;
+    cairo_scan_converter_t *converter;
+    cairo_int_status_t status;
+
+    status = create_scan_converter (r, info->polygon,
+				    info->fill_rule, info->antialias,
+				    n > 0, &converter);
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	status = converter->generate (converter, &band->renderer.base);
+    converter->destroy (converter);
+
+    info->compositor->renderer_fini (&band->renderer, status);
+    band->status = status;
+}
+
+static int
+composite_num_bands (const cairo_spans_compositor_t	*compositor,
+		     const cairo_composite_rectangles_t *extents,
+		     cairo_antialias_t			 antialias)
+{
+    const cairo_rectangle_int_t *r = &extents->unbounded;
+    int num_threads, num_bands;
+
+    if (compositor->renderer_threads == NULL)
+	return 1;
+
+    if (antialias == CAIRO_ANTIALIAS_FAST || antialias == CAIRO_ANTIALIAS_NONE)
+	return 1;
+
+    if (r->height < 2 * MIN_BAND_HEIGHT ||
+	(int64_t) r->width * r->height < MIN_BANDED_AREA)
+	return 1;
+
+    num_threads = compositor->renderer_threads (extents->surface);
+    if (num_threads <= 1)
+	return 1;
+
+    /* Oversubscribe a little to even out the load between bands. */
+    num_bands = 4 * num_threads;
+    if (num_bands > r->height / MIN_BAND_HEIGHT)
+	num_bands = r->height / MIN_BAND_HEIGHT;
+
+    return num_bands;
+}
+
+static cairo_int_status_t
+composite_polygon_bands (const cairo_spans_compositor_t	*compositor,
+			 cairo_composite_rectangles_t	*extents,
+			 cairo_polygon_t		*polygon,
+			 cairo_fill_rule_t		 fill_rule,
+			 cairo_antialias_t		 antialias,
+			 int				 num_bands)
+{
+    const cairo_rectangle_int_t *r = &extents->unbounded;
+    composite_bands_info_t info;
+    struct composite_band *bands;
+    cairo_int_status_t status;
+    int n;
+
+    TRACE ((stderr, "%s - num_bands=%d\n", __FUNCTION__, num_bands));
+
+    bands = _cairo_malloc_ab (num_bands, sizeof (struct composite_band));
+    if (unlikely (bands == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    /* Acquiring the source is not thread-safe, so each band's renderer
+     * is prepared up front and only the rasterisation is deferred. */
+    status = CAIRO_INT_STATUS_SUCCESS;
+    for (n = 0; n < num_bands; n++) {
+	struct composite_band *band = &bands[n];
+	int y1 = r->y + r->height * n / num_bands;
+	int y2 = r->y + r->height * (n + 1) / num_bands;
+
+	band->extents = *extents;
+	band->extents.unbounded.y = y1;
+	band->extents.unbounded.height = y2 - y1;
+	if (! _cairo_rectangle_intersect (&band->extents.bounded,
+					  &band->extents.unbounded))
+	    band->extents.bounded = band->extents.unbounded;
+
+	status = compositor->renderer_init (&band->renderer, &band->extents,
+					    antialias, FALSE);
+	if (unlikely (status)) {
+	    while (n--)
+		compositor->renderer_fini (&bands[n].renderer, status);
+	    free (bands);
+	    return status;
+	}
+    }
+
+    info.compositor = compositor;
+    info.polygon = polygon;
+    info.fill_rule = fill_rule;
+    info.antialias = antialias;
+    info.bands = bands;
+    _cairo_parallel_for (compositor->renderer_threads (extents->surface),
+			 num_bands, composite_band, &info);
+
+    for (n = 0; n < num_bands; n++) {
+	if (bands[n].status) {
+	    status = bands[n].status;
+	    break;
+	}
+    }
+
+    free (bands);
+    return status;
+}
+
 static cairo_int_status_t
 composite_polygon (const cairo_spans_compositor_t	*compositor,
 		   cairo_composite_rectangles_t		 *extents,
@@ -748,6 +966,7 @@ composite_polygon (const cairo_spans_compositor_t	*compositor,
     cairo_scan_converter_t *converter;
     cairo_bool_t needs_clip;
     cairo_int_status_t status;
+    int num_bands;
 
     if (extents->is_bounded)
 	needs_clip = extents->clip->path != NULL;
@@ -763,6 +982,11 @@ composite_polygon (const cairo_spans_compositor_t	*compositor,
     } else {
 	const cairo_rectangle_int_t *r = &extents->unbounded;
 
+	num_bands = composite_num_bands (compositor, extents, antialias);
+	if (num_bands > 1)
+	    return composite_polygon_bands (compositor, extents, polygon,
+					    fill_rule, antialias, num_bands);
+
 	if (antialias == CAIRO_ANTIALIAS_FAST) {
 	    converter = _cairo_tor22_scan_converter_create (r->x, r->y,
 							    r->x + r->width,
@@ -776,11 +1000,8 @@ composite_polygon (const cairo_spans_compositor_t	*compositor,
 							   fill_rule);
 	    status = _cairo_mono_scan_converter_add_polygon (converter, polygon);
 	} else {
-	    converter = _cairo_tor_scan_converter_create (r->x, r->y,
-							  r->x + r->width,
-							  r->y + r->height,
-							  fill_rule, antialias);
-	    status = _cairo_tor_scan_converter_add_polygon (converter, polygon);
+	    status = create_scan_converter (r, polygon, fill_rule, antialias,
+					    FALSE, &converter);
 	}
     }
     if (unlikely (status))
@@ -90,6 +90,13 @@ _cairo_tor_scan_converter_create (int			xmin,
 				  int			ymax,
 				  cairo_fill_rule_t	fill_rule,
 				  cairo_antialias_t	antialias);
+cairo_private cairo_scan_converter_t *
+_cairo_tor_scan_converter_create_band (int			xmin,
+				       int			ymin,
+				       int			xmax,
+				       int			ymax,
+				       cairo_fill_rule_t	fill_rule,
+				       cairo_antialias_t	antialias);
 cairo_private cairo_status_t
 _cairo_tor_scan_converter_add_polygon (void		*converter,
 				       const cairo_polygon_t *polygon);
@@ -115,6 +122,17 @@ cairo_private cairo_status_t
 _cairo_mono_scan_converter_add_polygon (void		*converter,
 					const cairo_polygon_t *polygon);
 
+cairo_private cairo_scan_converter_t *
+_cairo_sparse_scan_converter_create (int			xmin,
+				     int			ymin,
+				     int			xmax,
+				     int			ymax,
+				     cairo_fill_rule_t		fill_rule,
+				     cairo_antialias_t		antialias);
+cairo_private cairo_status_t
+_cairo_sparse_scan_converter_add_polygon (void		*converter,
+					  const cairo_polygon_t *polygon);
+
 cairo_private cairo_scan_converter_t *
 _cairo_clip_tor_scan_converter_create (cairo_clip_t *clip,
 				       cairo_polygon_t *polygon,
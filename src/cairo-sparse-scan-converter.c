@@ -0,0 +1,1076 @@
+/* cairo - a vector graphics library with display and print output
+ *
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is University of Southern
+ * California.
+ */
+
+/* A sparse-scanline scan converter.
+ *
+ * This computes exactly the same coverage as the tor scan converter
+ * (the same 256x15 sampling grid, the same edge stepping and the same
+ * analytic area computation for rows without intersections), but it
+ * keeps all of its state in flat arrays rather than in pools of
+ * linked nodes:
+ *
+ *   - the edges are stored in a single array and bucket sorted by their
+ *     starting row before rendering, so there is no per-row linked
+ *     bucket list to chase;
+ *
+ *   - the active edges are an array of pointers kept sorted by x,
+ *     new edges being merged in and the list being re-sorted by an
+ *     insertion pass after each subsample row;
+ *
+ *   - the coverage cells are two arrays spanning the width of the clip,
+ *     together with a list of the cells touched on the current row.
+ *     The touched list is sorted (or rebuilt by scanning the marks if
+ *     the row is crowded) just before the row is blitted.
+ *
+ * Memory is only allocated when the converter is created and when the
+ * polygon is added, so errors are reported by status and no jmp_buf is
+ * required.
+ */
+
+#include "cairoint.h"
+#include "cairo-spans-private.h"
+#include "cairo-error-private.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* The sampling grid: GRID_X subsamples per pixel horizontally and
+ * GRID_Y subsample rows per pixel row, as for tor. */
+#define GRID_X_BITS CAIRO_FIXED_FRAC_BITS
+#define GRID_X (1 << GRID_X_BITS)
+#define GRID_Y 15
+
+#define GRID_X_TO_INT_FRAC(x, i, f) do {	\
+    (f) = (x) & (GRID_X - 1);			\
+    (i) = (x) >> GRID_X_BITS;			\
+} while (0)
+
+#define INPUT_TO_GRID_Y(in, out) do {		\
+    long long tmp__ = (long long) GRID_Y * (in);	\
+    tmp__ >>= CAIRO_FIXED_FRAC_BITS;		\
+    (out) = tmp__;				\
+} while (0)
+
+/* A grid area is a real in [0,1] scaled by 2*GRID_X*GRID_Y. */
+#define GRID_XY (2*GRID_X*GRID_Y)
+#if GRID_XY == 2*256*15
+#  define GRID_AREA_TO_ALPHA(c)  (((c) + ((c)<<4) + 256) >> 9)
+#else
+#  define GRID_AREA_TO_ALPHA(c)  (((c)*255 + GRID_XY/2) / GRID_XY)
+#endif
+#define GRID_AREA_TO_A1(A)  ((GRID_AREA_TO_ALPHA (A) > 127) ? 255 : 0)
+
+/* Rows with more touched cells than width/SPARSE_SCAN_RATIO are
+ * gathered by scanning the cell marks rather than by sorting. */
+#define SPARSE_SCAN_RATIO 16
+
+struct quorem {
+    int32_t quo;
+    int32_t rem;
+};
+
+struct edge {
+    /* Current x coordinate, with the remainder biased by -dy. */
+    struct quorem x;
+
+    /* Advance of x per subsample row and per full row. */
+    struct quorem dxdy;
+    struct quorem dxdy_full;
+
+    /* The first subsample row of the edge and the number of
+     * subsample rows left to step. */
+    int32_t ytop;
+    int32_t height_left;
+
+    /* The pixel row the edge starts on; as with tor, an edge that
+     * begins above the clip starts on the first subsample row. */
+    int32_t row;
+
+    int32_t dy;
+    int32_t dir;
+    int32_t vertical;
+};
+
+typedef struct _cairo_sparse_scan_converter {
+    cairo_scan_converter_t base;
+
+    cairo_fill_rule_t fill_rule;
+    cairo_antialias_t antialias;
+
+    /* Clip box, in pixels and in grid units. */
+    int xmin, xmax, ymin, ymax;
+    int width, height;
+    int32_t grid_ymin, grid_ymax;
+
+    struct edge *edges;
+    int num_edges;
+    int size_edges;
+
+    /* The edges sorted by starting row; row_start[r] indexes the
+     * first edge starting on row r. */
+    struct edge **sorted;
+    int *row_start;
+
+    /* Active edges sorted by x, and scratch space for merging. */
+    struct edge **active;
+    struct edge **scratch;
+    int num_active;
+
+    /* Coverage cells for [xmin, xmax). */
+    int16_t *covered_height;
+    int16_t *uncovered_area;
+    uint8_t *marks;
+    int32_t *touched;
+    int32_t *touched_tmp;
+    int num_touched;
+    int16_t cover_left;
+    cairo_bool_t row_has_cells;
+
+    cairo_half_open_span_t *spans;
+    cairo_half_open_span_t spans_embedded[64];
+} cairo_sparse_scan_converter_t;
+
+/* Compute the floored division a/b. Assumes / and % perform symmetric
+ * division. */
+inline static struct quorem
+floored_divrem (int a, int b)
+{
+    struct quorem qr;
+    qr.quo = a/b;
+    qr.rem = a%b;
+    if ((a^b)<0 && qr.rem) {
+	qr.quo -= 1;
+	qr.rem += b;
+    }
+    return qr;
+}
+
+/* Compute the floored division (x*a)/b. Assumes / and % perform symmetric
+ * division. */
+static struct quorem
+floored_muldivrem (int x, int a, int b)
+{
+    struct quorem qr;
+    long long xa = (long long)x*a;
+    qr.quo = xa/b;
+    qr.rem = xa%b;
+    if ((xa>=0) != (b>=0) && qr.rem) {
+	qr.quo -= 1;
+	qr.rem += b;
+    }
+    return qr;
+}
+
+static int32_t
+int_to_grid_scaled (int i, int scale)
+{
+    /* Clamp to max/min representable scaled number. */
+    if (i >= 0) {
+	if (i >= INT_MAX/scale)
+	    i = INT_MAX/scale;
+    } else {
+	if (i <= INT_MIN/scale)
+	    i = INT_MIN/scale;
+    }
+    return i*scale;
+}
+
+/* Cells */
+
+inline static void
+add_cell (cairo_sparse_scan_converter_t *self, int ix, int area, int height)
+{
+    unsigned x = ix - self->xmin;
+
+    self->row_has_cells = TRUE;
+    if (x >= (unsigned) self->width) {
+	/* Only the cover of cells to the left of the clip matters. */
+	if (ix < self->xmin)
+	    self->cover_left += height;
+	return;
+    }
+
+    if (! self->marks[x]) {
+	self->marks[x] = 1;
+	self->touched[self->num_touched++] = x;
+    }
+    self->uncovered_area[x] += area;
+    self->covered_height[x] += height;
+}
+
+/* Add a subpixel span covering [x1, x2) to the coverage cells. */
+inline static void
+add_subspan (cairo_sparse_scan_converter_t *self, int32_t x1, int32_t x2)
+{
+    int ix1, fx1;
+    int ix2, fx2;
+
+    if (x1 == x2)
+	return;
+
+    GRID_X_TO_INT_FRAC (x1, ix1, fx1);
+    GRID_X_TO_INT_FRAC (x2, ix2, fx2);
+
+    if (ix1 != ix2) {
+	add_cell (self, ix1, 2*fx1, 1);
+	add_cell (self, ix2, -2*fx2, -1);
+    } else
+	add_cell (self, ix1, 2*(fx1-fx2), 0);
+}
+
+/* Add the coverage of an edge crossing a full pixel row, stepping the
+ * edge to the next row. */
+static void
+render_edge (cairo_sparse_scan_converter_t *self, struct edge *edge, int sign)
+{
+    struct quorem x1, x2, y;
+    int32_t y1, y2, dx, dy;
+    int ix1, ix2, fx1, fx2;
+
+    x1 = x2 = edge->x;
+    if (! edge->vertical) {
+	x2.quo += edge->dxdy_full.quo;
+	x2.rem += edge->dxdy_full.rem;
+	if (x2.rem >= 0) {
+	    ++x2.quo;
+	    x2.rem -= edge->dy;
+	}
+
+	edge->x = x2;
+    }
+
+    GRID_X_TO_INT_FRAC (x1.quo, ix1, fx1);
+    GRID_X_TO_INT_FRAC (x2.quo, ix2, fx2);
+
+    /* Edge is entirely within a column? */
+    if (ix1 == ix2) {
+	add_cell (self, ix1, sign*(fx1 + fx2)*GRID_Y, sign*GRID_Y);
+	return;
+    }
+
+    /* Orient the edge left-to-right. */
+    dx = x2.quo - x1.quo;
+    if (dx >= 0) {
+	y1 = 0;
+	y2 = GRID_Y;
+    } else {
+	int tmp;
+	tmp = ix1; ix1 = ix2; ix2 = tmp;
+	tmp = fx1; fx1 = fx2; fx2 = tmp;
+	dx = -dx;
+	sign = -sign;
+	y1 = GRID_Y;
+	y2 = 0;
+    }
+    dy = y2 - y1;
+
+    /* Add coverage for all pixels [ix1,ix2] on this row crossed
+     * by the edge. */
+    y = floored_divrem ((GRID_X - fx1)*dy, dx);
+    add_cell (self, ix1, sign*y.quo*(GRID_X + fx1), sign*y.quo);
+    y.quo += y1;
+
+    if (ix1+1 < ix2) {
+	struct quorem dydx_full = floored_divrem (GRID_X*dy, dx);
+
+	while (++ix1 != ix2) {
+	    int32_t y_skip = dydx_full.quo;
+	    y.rem += dydx_full.rem;
+	    if (y.rem >= dx) {
+		++y_skip;
+		y.rem -= dx;
+	    }
+
+	    y.quo += y_skip;
+
+	    y_skip *= sign;
+	    add_cell (self, ix1, y_skip*GRID_X, y_skip);
+	}
+    }
+
+    add_cell (self, ix2, sign*(y2 - y.quo)*fx2, sign*(y2 - y.quo));
+}
+
+/* Return the touched cells of the row in increasing order. */
+static const int32_t *
+sort_touched (cairo_sparse_scan_converter_t *self)
+{
+    int32_t *src = self->touched, *dst = self->touched_tmp;
+    int n = self->num_touched;
+    int i, j, shift;
+
+    if (n <= 32) {
+	for (i = 1; i < n; i++) {
+	    int32_t x = src[i];
+	    for (j = i; j && src[j-1] > x; j--)
+		src[j] = src[j-1];
+	    src[j] = x;
+	}
+	return src;
+    }
+
+    if (n > self->width / SPARSE_SCAN_RATIO) {
+	for (i = j = 0; j < n; i++) {
+	    if (self->marks[i])
+		src[j++] = i;
+	}
+	return src;
+    }
+
+    /* Least significant digit radix sort, a byte at a time. */
+    for (shift = 0; (self->width - 1) >> shift; shift += 8) {
+	int count[256];
+	int32_t *tmp;
+
+	memset (count, 0, sizeof (count));
+	for (i = 0; i < n; i++)
+	    count[(src[i] >> shift) & 255]++;
+	for (i = j = 0; i < 256; i++) {
+	    int c = count[i];
+	    count[i] = j;
+	    j += c;
+	}
+	for (i = 0; i < n; i++)
+	    dst[count[(src[i] >> shift) & 255]++] = src[i];
+
+	tmp = src; src = dst; dst = tmp;
+    }
+
+    return src;
+}
+
+static void
+reset_cells (cairo_sparse_scan_converter_t *self, const int32_t *cells)
+{
+    int i;
+
+    for (i = 0; i < self->num_touched; i++) {
+	int32_t x = cells[i];
+	self->covered_height[x] = 0;
+	self->uncovered_area[x] = 0;
+	self->marks[x] = 0;
+    }
+
+    self->num_touched = 0;
+    self->cover_left = 0;
+    self->row_has_cells = FALSE;
+}
+
+static cairo_status_t
+blit_a8 (cairo_sparse_scan_converter_t *self,
+	 const int32_t *cells,
+	 cairo_span_renderer_t *renderer,
+	 int y, int height)
+{
+    cairo_half_open_span_t *spans = self->spans;
+    int xmin = self->xmin, xmax = self->xmax;
+    int prev_x = xmin, last_x = -1;
+    int16_t cover, last_cover = 0;
+    unsigned num_spans = 0;
+    int i;
+
+    cover = self->cover_left * GRID_X*2;
+
+    /* Form the spans from the coverages and areas. */
+    for (i = 0; i < self->num_touched; i++) {
+	int x = xmin + cells[i];
+	int16_t area;
+
+	if (x > prev_x && cover != last_cover) {
+	    spans[num_spans].x = prev_x;
+	    spans[num_spans].coverage = GRID_AREA_TO_ALPHA (cover);
+	    last_cover = cover;
+	    last_x = prev_x;
+	    ++num_spans;
+	}
+
+	cover += self->covered_height[cells[i]]*GRID_X*2;
+	area = cover - self->uncovered_area[cells[i]];
+
+	if (area != last_cover) {
+	    spans[num_spans].x = x;
+	    spans[num_spans].coverage = GRID_AREA_TO_ALPHA (area);
+	    last_cover = area;
+	    last_x = x;
+	    ++num_spans;
+	}
+
+	prev_x = x+1;
+    }
+
+    if (prev_x <= xmax && cover != last_cover) {
+	spans[num_spans].x = prev_x;
+	spans[num_spans].coverage = GRID_AREA_TO_ALPHA (cover);
+	last_cover = cover;
+	last_x = prev_x;
+	++num_spans;
+    }
+
+    if (last_x < xmax && last_cover) {
+	spans[num_spans].x = xmax;
+	spans[num_spans].coverage = 0;
+	++num_spans;
+    }
+
+    return renderer->render_rows (renderer, y, height, spans, num_spans);
+}
+
+static cairo_status_t
+blit_a1 (cairo_sparse_scan_converter_t *self,
+	 const int32_t *cells,
+	 cairo_span_renderer_t *renderer,
+	 int y, int height)
+{
+    cairo_half_open_span_t *spans = self->spans;
+    int xmin = self->xmin, xmax = self->xmax;
+    int prev_x = xmin, last_x = -1;
+    int16_t cover;
+    uint8_t coverage, last_cover = 0;
+    unsigned num_spans = 0;
+    int i;
+
+    cover = self->cover_left * GRID_X*2;
+
+    /* Form the spans from the coverages and areas. */
+    for (i = 0; i < self->num_touched; i++) {
+	int x = xmin + cells[i];
+	int16_t area;
+
+	coverage = GRID_AREA_TO_A1 (cover);
+	if (x > prev_x && coverage != last_cover) {
+	    last_x = spans[num_spans].x = prev_x;
+	    last_cover = spans[num_spans].coverage = coverage;
+	    ++num_spans;
+	}
+
+	cover += self->covered_height[cells[i]]*GRID_X*2;
+	area = cover - self->uncovered_area[cells[i]];
+
+	coverage = GRID_AREA_TO_A1 (area);
+	if (coverage != last_cover) {
+	    last_x = spans[num_spans].x = x;
+	    last_cover = spans[num_spans].coverage = coverage;
+	    ++num_spans;
+	}
+
+	prev_x = x+1;
+    }
+
+    coverage = GRID_AREA_TO_A1 (cover);
+    if (prev_x <= xmax && coverage != last_cover) {
+	last_x = spans[num_spans].x = prev_x;
+	last_cover = spans[num_spans].coverage = coverage;
+	++num_spans;
+    }
+
+    if (last_x < xmax && last_cover) {
+	spans[num_spans].x = xmax;
+	spans[num_spans].coverage = 0;
+	++num_spans;
+    }
+
+    if (num_spans == 1)
+	return CAIRO_STATUS_SUCCESS;
+
+    return renderer->render_rows (renderer, y, height, spans, num_spans);
+}
+
+static cairo_status_t
+blit_row (cairo_sparse_scan_converter_t *self,
+	  cairo_span_renderer_t *renderer,
+	  int y, int height)
+{
+    const int32_t *cells;
+    cairo_status_t status;
+
+    if (! self->row_has_cells)
+	return CAIRO_STATUS_SUCCESS;
+
+    cells = sort_touched (self);
+    if (self->antialias != CAIRO_ANTIALIAS_NONE)
+	status = blit_a8 (self, cells, renderer, y, height);
+    else
+	status = blit_a1 (self, cells, renderer, y, height);
+    reset_cells (self, cells);
+
+    return status;
+}
+
+/* Edges */
+
+/* Stable merge sort of an array of edges by x. */
+static void
+sort_edges (struct edge **edges, int n, struct edge **tmp)
+{
+    int i, j, k, mid;
+
+    if (n <= 8) {
+	for (i = 1; i < n; i++) {
+	    struct edge *e = edges[i];
+	    for (j = i; j && edges[j-1]->x.quo > e->x.quo; j--)
+		edges[j] = edges[j-1];
+	    edges[j] = e;
+	}
+	return;
+    }
+
+    mid = n / 2;
+    sort_edges (edges, mid, tmp);
+    sort_edges (edges + mid, n - mid, tmp);
+    if (edges[mid-1]->x.quo <= edges[mid]->x.quo)
+	return;
+
+    memcpy (tmp, edges, mid * sizeof (struct edge *));
+    for (i = 0, j = mid, k = 0; i < mid; k++) {
+	if (j < n && edges[j]->x.quo < tmp[i]->x.quo)
+	    edges[k] = edges[j++];
+	else
+	    edges[k] = tmp[i++];
+    }
+}
+
+/* Merge a run of edges sorted by x into the active list. */
+static void
+active_merge (cairo_sparse_scan_converter_t *self,
+	      struct edge **edges, int n)
+{
+    struct edge **active = self->active;
+    struct edge **out = self->scratch;
+    int num_active = self->num_active;
+    int i, j, k;
+
+    if (n == 0)
+	return;
+
+    for (i = j = k = 0; i < num_active && j < n; k++) {
+	if (edges[j]->x.quo < active[i]->x.quo)
+	    out[k] = edges[j++];
+	else
+	    out[k] = active[i++];
+    }
+    while (i < num_active)
+	out[k++] = active[i++];
+    while (j < n)
+	out[k++] = edges[j++];
+
+    self->scratch = active;
+    self->active = out;
+    self->num_active = k;
+}
+
+/* Test if the active edges can be safely advanced by a full row
+ * without intersections or any edges ending, returning the minimum
+ * height left of the edges in *min_height_out. */
+static cairo_bool_t
+can_do_full_row (cairo_sparse_scan_converter_t *self,
+		 int32_t *min_height_out,
+		 cairo_bool_t *is_vertical_out)
+{
+    int32_t min_height = INT_MAX;
+    int prev_x = INT_MIN;
+    cairo_bool_t is_vertical = TRUE;
+    cairo_bool_t in_order = TRUE;
+    int i;
+
+    for (i = 0; i < self->num_active; i++) {
+	const struct edge *e = self->active[i];
+	struct quorem x = e->x;
+
+	if (e->height_left < min_height)
+	    min_height = e->height_left;
+	is_vertical &= e->vertical;
+
+	if (! e->vertical) {
+	    x.quo += e->dxdy_full.quo;
+	    x.rem += e->dxdy_full.rem;
+	    if (x.rem >= 0)
+		++x.quo;
+	}
+
+	if (x.quo < prev_x)
+	    in_order = FALSE;
+	prev_x = x.quo;
+    }
+
+    *min_height_out = min_height;
+    *is_vertical_out = is_vertical;
+    return in_order && min_height >= GRID_Y;
+}
+
+/* Drop the edges that have ended from the active list. */
+static void
+active_compact (cairo_sparse_scan_converter_t *self)
+{
+    int i, n;
+
+    for (i = n = 0; i < self->num_active; i++) {
+	if (self->active[i]->height_left)
+	    self->active[n++] = self->active[i];
+    }
+    self->num_active = n;
+}
+
+static void
+sub_row (cairo_sparse_scan_converter_t *self, unsigned int mask)
+{
+    struct edge **active = self->active;
+    int num_active = self->num_active;
+    int xstart = INT_MIN, prev_x = INT_MIN;
+    int winding = 0;
+    cairo_bool_t sorted = TRUE;
+    int i, n;
+
+    for (i = n = 0; i < num_active; i++) {
+	struct edge *edge = active[i];
+	int xend = edge->x.quo;
+	int next_x = i + 1 < num_active ? active[i+1]->x.quo : INT_MAX;
+
+	if (--edge->height_left) {
+	    edge->x.quo += edge->dxdy.quo;
+	    edge->x.rem += edge->dxdy.rem;
+	    if (edge->x.rem >= 0) {
+		++edge->x.quo;
+		edge->x.rem -= edge->dy;
+	    }
+
+	    if (edge->x.quo < prev_x)
+		sorted = FALSE;
+	    else
+		prev_x = edge->x.quo;
+
+	    active[n++] = edge;
+	}
+
+	winding += edge->dir;
+	if ((winding & mask) == 0) {
+	    if (next_x != xend) {
+		add_subspan (self, xstart, xend);
+		xstart = INT_MIN;
+	    }
+	} else if (xstart == INT_MIN)
+	    xstart = xend;
+    }
+    self->num_active = n;
+
+    if (! sorted) {
+	for (i = 1; i < n; i++) {
+	    struct edge *e = active[i];
+	    int j;
+
+	    for (j = i; j && active[j-1]->x.quo > e->x.quo; j--)
+		active[j] = active[j-1];
+	    active[j] = e;
+	}
+    }
+}
+
+inline static void
+full_step (struct edge *e)
+{
+    if (! e->vertical) {
+	e->x.quo += e->dxdy_full.quo;
+	e->x.rem += e->dxdy_full.rem;
+	if (e->x.rem >= 0) {
+	    ++e->x.quo;
+	    e->x.rem -= e->dy;
+	}
+    }
+}
+
+static void
+full_row (cairo_sparse_scan_converter_t *self, unsigned int mask)
+{
+    struct edge **active = self->active;
+    int num_active = self->num_active;
+    int i, j;
+
+    for (i = 0; i + 1 < num_active; i = j + 1) {
+	struct edge *left = active[i], *right;
+	int winding;
+
+	left->height_left -= GRID_Y;
+	winding = left->dir;
+	for (j = i + 1; ; j++) {
+	    right = active[j];
+	    right->height_left -= GRID_Y;
+
+	    winding += right->dir;
+	    if (j + 1 == num_active)
+		break;
+	    if ((winding & mask) == 0 && active[j+1]->x.quo != right->x.quo)
+		break;
+
+	    full_step (right);
+	}
+
+	render_edge (self, left, +1);
+	render_edge (self, right, -1);
+    }
+
+    active_compact (self);
+}
+
+static void
+step_edges (cairo_sparse_scan_converter_t *self, int count)
+{
+    int i;
+
+    count *= GRID_Y;
+    for (i = 0; i < self->num_active; i++)
+	self->active[i]->height_left -= count;
+    active_compact (self);
+}
+
+/* Merge the edges starting on pixel row y into the active list, one
+ * subsample row at a time, and accumulate their coverage. */
+static void
+sample_row (cairo_sparse_scan_converter_t *self,
+	    struct edge **edges, int n,
+	    int32_t y, unsigned int mask)
+{
+    int count[GRID_Y + 1];
+    int sub, i;
+
+    /* Sort the new edges by x and then, stably, by subsample row. */
+    sort_edges (edges, n, self->scratch);
+
+    memset (count, 0, sizeof (count));
+    for (i = 0; i < n; i++)
+	count[edges[i]->ytop - y + 1]++;
+    for (sub = 1; sub <= GRID_Y; sub++)
+	count[sub] += count[sub - 1];
+    for (i = 0; i < n; i++)
+	self->scratch[count[edges[i]->ytop - y]++] = edges[i];
+    memcpy (edges, self->scratch, n * sizeof (struct edge *));
+
+    /* count[sub] now marks the end of the edges on subsample row sub. */
+    for (sub = i = 0; sub < GRID_Y; sub++) {
+	active_merge (self, edges + i, count[sub] - i);
+	i = count[sub];
+
+	sub_row (self, mask);
+    }
+}
+
+/* Bucket sort the edges by their starting pixel row. */
+static cairo_status_t
+sort_edges_by_row (cairo_sparse_scan_converter_t *self)
+{
+    int *row_start;
+    int i;
+
+    self->sorted = _cairo_malloc_ab (self->num_edges, 3 * sizeof (struct edge *));
+    if (unlikely (self->sorted == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    self->active = self->sorted + self->num_edges;
+    self->scratch = self->active + self->num_edges;
+
+    row_start = self->row_start = calloc (self->height + 1, sizeof (int));
+    if (unlikely (row_start == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    for (i = 0; i < self->num_edges; i++)
+	row_start[self->edges[i].row]++;
+    for (i = 1; i < self->height + 1; i++)
+	row_start[i] += row_start[i - 1];
+    for (i = self->num_edges; i--; ) {
+	struct edge *e = &self->edges[i];
+	self->sorted[--row_start[e->row]] = e;
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+add_edge (cairo_sparse_scan_converter_t *self,
+	  const cairo_edge_t *edge)
+{
+    struct edge *e;
+    int32_t top, bottom, p1x, p1y, p2x, p2y;
+    int32_t ytop, ybot, dx, dy;
+
+    INPUT_TO_GRID_Y (edge->top, top);
+    INPUT_TO_GRID_Y (edge->bottom, bottom);
+    if (top >= bottom)
+	return;
+
+    if (top >= self->grid_ymax || bottom <= self->grid_ymin)
+	return;
+
+    INPUT_TO_GRID_Y (edge->line.p1.y, p1y);
+    INPUT_TO_GRID_Y (edge->line.p2.y, p2y);
+    if (p1y == p2y)
+	p2y++; /* little fudge to prevent a div-by-zero */
+
+    p1x = edge->line.p1.x;
+    p2x = edge->line.p2.x;
+
+    e = &self->edges[self->num_edges++];
+
+    dx = p2x - p1x;
+    dy = p2y - p1y;
+    e->dy = dy;
+    e->dir = edge->dir;
+
+    ytop = top >= self->grid_ymin ? top : self->grid_ymin;
+    ybot = bottom <= self->grid_ymax ? bottom : self->grid_ymax;
+    e->ytop = ytop;
+    e->height_left = ybot - ytop;
+    e->row = (ytop - self->grid_ymin) / GRID_Y;
+
+    if (dx == 0) {
+	e->vertical = TRUE;
+	e->x.quo = p1x;
+	e->x.rem = 0;
+	e->dxdy.quo = 0;
+	e->dxdy.rem = 0;
+	e->dxdy_full.quo = 0;
+	e->dxdy_full.rem = 0;
+    } else {
+	e->vertical = FALSE;
+	e->dxdy = floored_divrem (dx, dy);
+	if (ytop == p1y) {
+	    e->x.quo = p1x;
+	    e->x.rem = 0;
+	} else {
+	    e->x = floored_muldivrem (ytop - p1y, dx, dy);
+	    e->x.quo += p1x;
+	}
+
+	if (e->height_left >= GRID_Y) {
+	    e->dxdy_full = floored_muldivrem (GRID_Y, dx, dy);
+	} else {
+	    e->dxdy_full.quo = 0;
+	    e->dxdy_full.rem = 0;
+	}
+    }
+
+    e->x.rem -= dy;		/* Bias the remainder for faster
+				 * edge advancement. */
+}
+
+static cairo_status_t
+render (cairo_sparse_scan_converter_t *self,
+	cairo_span_renderer_t *renderer)
+{
+    unsigned int mask = self->fill_rule == CAIRO_FILL_RULE_WINDING ? ~0 : 1;
+    const int *row_start;
+    int h = self->height;
+    int i, j;
+    cairo_status_t status;
+
+    status = sort_edges_by_row (self);
+    if (unlikely (status))
+	return status;
+
+    row_start = self->row_start;
+
+#define ROW_HAS_EDGES(r) (row_start[(r)] != row_start[(r) + 1])
+
+    /* Render each pixel row. */
+    for (i = 0; i < h; i = j) {
+	int32_t min_height = 0;
+	cairo_bool_t is_vertical = FALSE;
+
+	j = i + 1;
+
+	/* Determine if we can ignore this row or use the full pixel
+	 * stepper. */
+	if (! ROW_HAS_EDGES (i)) {
+	    if (self->num_active == 0) {
+		for (; j < h && ! ROW_HAS_EDGES (j); j++)
+		    ;
+		continue;
+	    }
+
+	    if (can_do_full_row (self, &min_height, &is_vertical)) {
+		/* Step by a full pixel row's worth. */
+		full_row (self, mask);
+
+		if (is_vertical) {
+		    while (j < h &&
+			   ! ROW_HAS_EDGES (j) &&
+			   min_height >= 2*GRID_Y)
+		    {
+			min_height -= GRID_Y;
+			j++;
+		    }
+		    if (j != i + 1)
+			step_edges (self, j - (i + 1));
+		}
+
+		goto blit;
+	    }
+	}
+
+	sample_row (self,
+		    self->sorted + row_start[i],
+		    row_start[i + 1] - row_start[i],
+		    self->grid_ymin + i * GRID_Y,
+		    mask);
+
+    blit:
+	status = blit_row (self, renderer, self->ymin + i, j - i);
+	if (unlikely (status))
+	    return status;
+    }
+
+#undef ROW_HAS_EDGES
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_sparse_scan_converter_destroy (void *converter)
+{
+    cairo_sparse_scan_converter_t *self = converter;
+
+    if (self->spans != self->spans_embedded)
+	free (self->spans);
+    free (self->covered_height);
+    free (self->marks);
+    free (self->touched);
+    free (self->edges);
+    free (self->sorted);
+    free (self->row_start);
+    free (self);
+}
+
+cairo_status_t
+_cairo_sparse_scan_converter_add_polygon (void		*converter,
+					  const cairo_polygon_t *polygon)
+{
+    cairo_sparse_scan_converter_t *self = converter;
+    int i;
+
+    if (self->num_edges + polygon->num_edges > self->size_edges) {
+	int size = self->num_edges + polygon->num_edges;
+	struct edge *edges;
+
+	edges = _cairo_realloc_ab (self->edges, size, sizeof (struct edge));
+	if (unlikely (edges == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	self->edges = edges;
+	self->size_edges = size;
+    }
+
+    for (i = 0; i < polygon->num_edges; i++)
+	add_edge (self, &polygon->edges[i]);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_sparse_scan_converter_generate (void			*converter,
+				       cairo_span_renderer_t	*renderer)
+{
+    cairo_sparse_scan_converter_t *self = converter;
+    cairo_status_t status;
+
+    if (self->width <= 0 || self->height <= 0 || self->num_edges == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    status = render (self, renderer);
+    if (unlikely (status))
+	return _cairo_scan_converter_set_error (self, status);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+cairo_scan_converter_t *
+_cairo_sparse_scan_converter_create (int			xmin,
+				     int			ymin,
+				     int			xmax,
+				     int			ymax,
+				     cairo_fill_rule_t		fill_rule,
+				     cairo_antialias_t		antialias)
+{
+    cairo_sparse_scan_converter_t *self;
+    cairo_status_t status;
+
+    self = calloc (1, sizeof (cairo_sparse_scan_converter_t));
+    if (unlikely (self == NULL)) {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto bail_nomem;
+    }
+
+    self->base.destroy = _cairo_sparse_scan_converter_destroy;
+    self->base.generate = _cairo_sparse_scan_converter_generate;
+
+    self->fill_rule = fill_rule;
+    self->antialias = antialias;
+
+    self->xmin = xmin;
+    self->xmax = xmax;
+    self->ymin = ymin;
+    self->ymax = ymax;
+    self->width = xmax > xmin ? xmax - xmin : 0;
+    self->height = ymax > ymin ? ymax - ymin : 0;
+    self->grid_ymin = int_to_grid_scaled (ymin, GRID_Y);
+    self->grid_ymax = int_to_grid_scaled (ymax, GRID_Y);
+
+    self->spans = self->spans_embedded;
+    if (self->width) {
+	if (self->width + 1 > ARRAY_LENGTH (self->spans_embedded)) {
+	    self->spans = _cairo_malloc_ab (self->width + 1,
+					    sizeof (cairo_half_open_span_t));
+	    if (unlikely (self->spans == NULL)) {
+		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+		goto bail;
+	    }
+	}
+
+	self->covered_height = calloc (self->width, 2 * sizeof (int16_t));
+	self->marks = calloc (self->width, sizeof (uint8_t));
+	self->touched = _cairo_malloc_ab (self->width, 2 * sizeof (int32_t));
+	if (unlikely (self->covered_height == NULL ||
+		      self->marks == NULL ||
+		      self->touched == NULL))
+	{
+	    status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    goto bail;
+	}
+	self->uncovered_area = self->covered_height + self->width;
+	self->touched_tmp = self->touched + self->width;
+    }
+
+    return &self->base;
+
+ bail:
+    self->base.destroy (&self->base);
+ bail_nomem:
+    return _cairo_scan_converter_create_in_error (status);
+}
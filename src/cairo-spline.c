@@ -145,6 +145,8 @@ _lerp_half (const cairo_point_t *a, const cairo_point_t *b, cairo_point_t *resul
     result->y = a->y + ((b->y - a->y) >> 1);
 }
 
+/* Split s1 in half, storing the first half in s2 and leaving the
+ * second half in s1. */
 static void
 _de_casteljau (cairo_spline_knots_t *s1, cairo_spline_knots_t *s2)
 {
@@ -159,14 +161,14 @@ _de_casteljau (cairo_spline_knots_t *s1, cairo_spline_knots_t *s2)
     _lerp_half (&bc, &cd, &bccd);
     _lerp_half (&abbc, &bccd, &final);
 
-    s2->a = final;
-    s2->b = bccd;
-    s2->c = cd;
-    s2->d = s1->d;
+    s2->a = s1->a;
+    s2->b = ab;
+    s2->c = abbc;
+    s2->d = final;
 
-    s1->b = ab;
-    s1->c = abbc;
-    s1->d = final;
+    s1->a = final;
+    s1->b = bccd;
+    s1->c = cd;
 }
 
 /* Return an upper bound on the error (squared) that could result from
@@ -236,35 +238,57 @@ _cairo_spline_error_squared (const cairo_spline_knots_t *knots)
 	return cerr;
 }
 
+/* Each subdivision halves the distances between the knots, which are
+ * at most 32 bits apart, so by this depth any piece has collapsed to
+ * within a unit of fixed point precision.
+ */
+#define CAIRO_SPLINE_MAX_DEPTH 32
+
 static cairo_status_t
-_cairo_spline_decompose_into (cairo_spline_knots_t *s1,
+_cairo_spline_decompose_into (const cairo_spline_knots_t *knots,
 			      double tolerance_squared,
 			      cairo_spline_t *result)
 {
-    cairo_spline_knots_t s2;
+    /* Subdivide without recursing, using a stack of the pieces still
+     * to be emitted with the earliest on top.  Each split replaces the
+     * top piece by its two halves, so the stack never grows beyond the
+     * depth of the subdivision.
+     */
+    cairo_spline_knots_t stack[CAIRO_SPLINE_MAX_DEPTH + 1];
     cairo_status_t status;
+    int top;
 
-    if (_cairo_spline_error_squared (s1) < tolerance_squared)
-	return _cairo_spline_add_point (result, &s1->a, &s1->b);
+    top = 0;
+    stack[0] = *knots;
+    do {
+	cairo_spline_knots_t *s = &stack[top];
 
-    _de_casteljau (s1, &s2);
+	if (top == CAIRO_SPLINE_MAX_DEPTH ||
+	    _cairo_spline_error_squared (s) < tolerance_squared)
+	{
+	    status = _cairo_spline_add_point (result, &s->a, &s->b);
+	    if (unlikely (status))
+		return status;
 
-    status = _cairo_spline_decompose_into (s1, tolerance_squared, result);
-    if (unlikely (status))
-	return status;
+	    top--;
+	} else {
+	    _de_casteljau (&s[0], &s[1]);
+	    top++;
+	}
+    } while (top >= 0);
 
-    return _cairo_spline_decompose_into (&s2, tolerance_squared, result);
+    return CAIRO_STATUS_SUCCESS;
 }
 
 cairo_status_t
 _cairo_spline_decompose (cairo_spline_t *spline, double tolerance)
 {
-    cairo_spline_knots_t s1;
     cairo_status_t status;
 
-    s1 = spline->knots;
-    spline->last_point = s1.a;
-    status = _cairo_spline_decompose_into (&s1, tolerance * tolerance, spline);
+    spline->last_point = spline->knots.a;
+    status = _cairo_spline_decompose_into (&spline->knots,
+					   tolerance * tolerance,
+					   spline);
     if (unlikely (status))
 	return status;
 
@@ -89,6 +89,9 @@ struct _cairo_surface {
     double x_fallback_resolution;
     double y_fallback_resolution;
 
+    /* The number of threads that may render image-based fallbacks */
+    int fallback_threads;
+
     /* A "snapshot" surface is immutable. See _cairo_surface_snapshot. */
     cairo_surface_t *snapshot_of;
     cairo_surface_func_t snapshot_detach;
@@ -40,6 +40,7 @@
 #include "cairoint.h"
 
 #include "cairo-error-private.h"
+#include "cairo-image-surface-inline.h"
 #include "cairo-image-surface-private.h"
 #include "cairo-surface-snapshot-inline.h"
 
@@ -258,6 +259,15 @@ _cairo_surface_snapshot (cairo_surface_t *surface)
     if (snapshot != NULL)
 	return cairo_surface_reference (&snapshot->base);
 
+    /* Land any deferred drawing now, so that the snapshot captures it
+     * and later readers of the snapshot never modify the target.
+     */
+    if (_cairo_surface_is_image (surface)) {
+	status = _cairo_image_surface_flush_deferred ((cairo_image_surface_t *) surface);
+	if (unlikely (status))
+	    return _cairo_surface_create_in_error (status);
+    }
+
     snapshot = malloc (sizeof (cairo_surface_snapshot_t));
     if (unlikely (snapshot == NULL))
 	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_SURFACE_FINISHED));
@@ -46,6 +46,7 @@
 #include "cairo-error-private.h"
 #include "cairo-list-inline.h"
 #include "cairo-image-surface-inline.h"
+#include "cairo-parallel-private.h"
 #include "cairo-recording-surface-private.h"
 #include "cairo-region-private.h"
 #include "cairo-surface-inline.h"
@@ -123,6 +124,7 @@ const cairo_surface_t name = {					\
     0.0,				/* y_resolution */	\
     0.0,				/* x_fallback_resolution */	\
     0.0,				/* y_fallback_resolution */	\
+    1,					/* fallback_threads */	\
     NULL,				/* snapshot_of */	\
     NULL,				/* snapshot_detach */	\
     { NULL, NULL },			/* snapshots */		\
@@ -431,6 +433,7 @@ _cairo_surface_init (cairo_surface_t			*surface,
 
     surface->x_fallback_resolution = CAIRO_SURFACE_FALLBACK_RESOLUTION_DEFAULT;
     surface->y_fallback_resolution = CAIRO_SURFACE_FALLBACK_RESOLUTION_DEFAULT;
+    surface->fallback_threads = 1;
 
     cairo_list_init (&surface->snapshots);
     surface->snapshot_of = NULL;
@@ -1839,6 +1842,59 @@ cairo_surface_get_fallback_resolution (cairo_surface_t	*surface,
 	*y_pixels_per_inch = surface->y_fallback_resolution;
 }
 
+/**
+ * cairo_surface_set_fallback_threads:
+ * @surface: a #cairo_surface_t
+ * @num_threads: the maximum number of threads to use, or 0 for one
+ * per available processor
+ *
+ * Allow cairo to render the image fallbacks of a page using up to
+ * @num_threads threads, each rendering a separate fallback region.
+ * The images are still placed upon the page one after the other, so
+ * the output is identical to that produced with a single thread,
+ * which remains the default.
+ *
+ * Like the fallback resolution, this only has an effect upon natively
+ * vector-oriented backends, and takes effect at the time of completing
+ * a page.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_surface_set_fallback_threads (cairo_surface_t	*surface,
+				    int			 num_threads)
+{
+    if (unlikely (surface->status))
+	return;
+
+    if (unlikely (surface->finished)) {
+	_cairo_surface_set_error (surface, _cairo_error (CAIRO_STATUS_SURFACE_FINISHED));
+	return;
+    }
+
+    if (num_threads <= 0)
+	num_threads = _cairo_parallel_num_cpus ();
+
+    surface->fallback_threads = num_threads;
+}
+
+/**
+ * cairo_surface_get_fallback_threads:
+ * @surface: a #cairo_surface_t
+ *
+ * Returns the maximum number of threads used to render image fallbacks
+ * upon @surface, see cairo_surface_set_fallback_threads().
+ *
+ * Return value: the number of threads, 1 unless otherwise set.
+ *
+ * Since: 1.14
+ **/
+int
+cairo_surface_get_fallback_threads (cairo_surface_t *surface)
+{
+    return surface->fallback_threads;
+}
+
 cairo_bool_t
 _cairo_surface_has_device_transform (cairo_surface_t *surface)
 {
@@ -1932,6 +1988,71 @@ _cairo_surface_default_release_source_image (void                   *surface,
     (void)ignored;
 }
 
+/**
+ * _cairo_surface_get_content_digest:
+ * @surface: a #cairo_surface_t
+ * @mime_types: %NULL-terminated list of the mime types that would be
+ *    embedded in place of the pixel data
+ * @digest: return location for the digest
+ *
+ * Computes a digest of the image data a vector backend would write out
+ * for @surface: the data attached to @surface for any of @mime_types or,
+ * if there is none, its pixels. Surfaces with equal digests may share a
+ * single copy of the image in the output.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if @digest was computed,
+ * %CAIRO_INT_STATUS_UNSUPPORTED for recording surfaces and surfaces
+ * whose pixels cannot be read, or an error status.
+ **/
+cairo_int_status_t
+_cairo_surface_get_content_digest (cairo_surface_t	   *surface,
+				   const char * const	   *mime_types,
+				   cairo_hash_digest_t	   *digest)
+{
+    cairo_image_surface_t *image;
+    void *image_extra;
+    const unsigned char *data;
+    unsigned long length;
+    cairo_bool_t has_mime_data = FALSE;
+    cairo_status_t status;
+    int header[3];
+    int row_length, y;
+
+    if (surface->type == CAIRO_SURFACE_TYPE_RECORDING)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    _cairo_hash_digest_init (digest);
+
+    for (; mime_types != NULL && *mime_types != NULL; mime_types++) {
+	cairo_surface_get_mime_data (surface, *mime_types, &data, &length);
+	if (data == NULL)
+	    continue;
+
+	_cairo_hash_digest_update (digest, *mime_types, strlen (*mime_types));
+	_cairo_hash_digest_update (digest, data, length);
+	has_mime_data = TRUE;
+    }
+    if (has_mime_data)
+	return CAIRO_STATUS_SUCCESS;
+
+    status = _cairo_surface_acquire_source_image (surface, &image, &image_extra);
+    if (unlikely (status))
+	return status;
+
+    header[0] = image->pixman_format;
+    header[1] = image->width;
+    header[2] = image->height;
+    _cairo_hash_digest_update (digest, header, sizeof (header));
+
+    row_length = (image->width * PIXMAN_FORMAT_BPP (image->pixman_format) + 7) / 8;
+    for (y = 0; y < image->height; y++)
+	_cairo_hash_digest_update (digest, image->data + y * image->stride, row_length);
+
+    _cairo_surface_release_source_image (surface, image, image_extra);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 
 cairo_surface_t *
 _cairo_surface_get_source (cairo_surface_t *surface,
@@ -150,8 +150,22 @@ struct cairo_svg_document {
     cairo_svg_version_t svg_version;
 
     cairo_scaled_font_subsets_t *font_subsets;
+
+    cairo_bool_t deduplicate_images;
+    cairo_hash_table_t *image_digests;
+    cairo_hash_table_t *image_aliases;
 };
 
+/* Identical images are only written once: image_digests maps the
+ * digest of each image written to its id, and image_aliases maps the
+ * surfaces that reuse it to that id. */
+typedef struct _cairo_svg_image {
+    cairo_hash_entry_t base;
+    cairo_hash_digest_t digest;
+    unsigned int surface_id;
+    unsigned int image_id;
+} cairo_svg_image_t;
+
 static cairo_status_t
 _cairo_svg_document_create (cairo_output_stream_t	 *stream,
 			    double			  width,
@@ -356,6 +370,32 @@ cairo_svg_surface_restrict_to_version (cairo_surface_t		*abstract_surface,
 	surface->document->svg_version = version;
 }
 
+/**
+ * cairo_svg_surface_set_deduplicate_images:
+ * @surface: a SVG #cairo_surface_t
+ * @deduplicate: %TRUE to write each distinct image only once
+ *
+ * Images are normally shared between uses only when they are drawn
+ * from the same #cairo_surface_t. With deduplication enabled, the
+ * contents of each new image (its attached JPEG, PNG or URI data, or
+ * otherwise its pixels) are hashed, and an image identical to one
+ * already in the document refers to that definition instead of being
+ * encoded again. The default is %FALSE.
+ *
+ * Since: 1.14
+ **/
+void
+cairo_svg_surface_set_deduplicate_images (cairo_surface_t	*abstract_surface,
+					  cairo_bool_t		 deduplicate)
+{
+    cairo_svg_surface_t *surface = NULL; /* hide compiler warning */
+
+    if (! _extract_svg_surface (abstract_surface, &surface))
+	return;
+
+    surface->document->deduplicate_images = deduplicate;
+}
+
 /**
  * cairo_svg_get_versions:
  * @versions: supported version list
@@ -1275,6 +1315,118 @@ _cairo_svg_surface_emit_attr_value (cairo_output_stream_t *stream,
 	_cairo_output_stream_write (stream, q, p - q);
 }
 
+static cairo_bool_t
+_cairo_svg_image_digest_equal (const void *key_a, const void *key_b)
+{
+    const cairo_svg_image_t *a = key_a;
+    const cairo_svg_image_t *b = key_b;
+
+    return _cairo_hash_digest_equal (&a->digest, &b->digest);
+}
+
+static cairo_bool_t
+_cairo_svg_image_alias_equal (const void *key_a, const void *key_b)
+{
+    const cairo_svg_image_t *a = key_a;
+    const cairo_svg_image_t *b = key_b;
+
+    return a->surface_id == b->surface_id;
+}
+
+static void
+_cairo_svg_image_pluck (void *entry, void *closure)
+{
+    cairo_svg_image_t *image = entry;
+    cairo_hash_table_t *images = closure;
+
+    _cairo_hash_table_remove (images, &image->base);
+    free (image);
+}
+
+static unsigned int
+_cairo_svg_document_get_image_id (cairo_svg_document_t *document,
+				  cairo_surface_t      *surface)
+{
+    cairo_svg_image_t key, *alias;
+
+    if (document->image_aliases == NULL)
+	return surface->unique_id;
+
+    key.surface_id = surface->unique_id;
+    key.base.hash = surface->unique_id;
+    alias = _cairo_hash_table_lookup (document->image_aliases, &key.base);
+
+    return alias != NULL ? alias->image_id : surface->unique_id;
+}
+
+/* Looks for an image identical to @surface that has already been
+ * written. If there is one, @surface becomes an alias for it and
+ * *@found is set; otherwise @surface is recorded as the image to use
+ * for any later copies. */
+static cairo_status_t
+_cairo_svg_document_find_image (cairo_svg_document_t	     *document,
+				cairo_surface_t		     *surface,
+				const cairo_rectangle_int_t  *extents,
+				cairo_bool_t		     *found)
+{
+    cairo_svg_image_t key, *image;
+    cairo_hash_table_t **table;
+    cairo_int_status_t status;
+
+    *found = FALSE;
+
+    status = _cairo_surface_get_content_digest (surface,
+						_cairo_svg_supported_mime_types,
+						&key.digest);
+    if (status == CAIRO_INT_STATUS_UNSUPPORTED)
+	return CAIRO_STATUS_SUCCESS;
+    if (unlikely (status))
+	return status;
+
+    /* the <image> element also carries the size */
+    _cairo_hash_digest_update (&key.digest, &extents->width, sizeof (extents->width));
+    _cairo_hash_digest_update (&key.digest, &extents->height, sizeof (extents->height));
+    key.base.hash = _cairo_hash_digest_to_hash (&key.digest);
+
+    if (document->image_digests == NULL) {
+	document->image_digests = _cairo_hash_table_create (_cairo_svg_image_digest_equal);
+	if (unlikely (document->image_digests == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    image = _cairo_hash_table_lookup (document->image_digests, &key.base);
+    if (image != NULL) {
+	key.image_id = image->image_id;
+	key.surface_id = surface->unique_id;
+	key.base.hash = surface->unique_id;
+	table = &document->image_aliases;
+	if (*table == NULL) {
+	    *table = _cairo_hash_table_create (_cairo_svg_image_alias_equal);
+	    if (unlikely (*table == NULL))
+		return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	}
+	*found = TRUE;
+    } else {
+	key.image_id = surface->unique_id;
+	key.surface_id = surface->unique_id;
+	table = &document->image_digests;
+    }
+
+    image = malloc (sizeof (cairo_svg_image_t));
+    if (unlikely (image == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    *image = key;
+    status = _cairo_hash_table_insert (*table, &image->base);
+    if (unlikely (status)) {
+	free (image);
+	*found = FALSE;
+	return status;
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 static cairo_status_t
 _cairo_svg_surface_emit_surface (cairo_svg_document_t *document,
 				 cairo_surface_t *surface)
@@ -1294,6 +1446,21 @@ _cairo_svg_surface_emit_surface (cairo_svg_document_t *document,
     is_bounded = _cairo_surface_get_extents (surface, &extents);
     assert (is_bounded);
 
+    if (document->deduplicate_images) {
+	cairo_bool_t found;
+
+	status = _cairo_svg_document_find_image (document, surface,
+						 &extents, &found);
+	if (unlikely (status))
+	    return status;
+
+	if (found) {
+	    return _cairo_user_data_array_set_data (&surface->user_data,
+						    (cairo_user_data_key_t *) document,
+						    document, NULL);
+	}
+    }
+
     _cairo_output_stream_printf (document->xml_node_defs,
 				 "<image id=\"image%d\" width=\"%d\" height=\"%d\"",
 				 surface->unique_id,
@@ -1364,7 +1531,8 @@ _cairo_svg_surface_emit_composite_surface_pattern (cairo_output_stream_t   *outp
 
     _cairo_output_stream_printf (output,
 				 "<use xlink:href=\"#image%d\"",
-				 pattern->surface->unique_id);
+				 _cairo_svg_document_get_image_id (svg_surface->document,
+								   pattern->surface));
     if (extra_attributes)
 	_cairo_output_stream_printf (output, " %s", extra_attributes);
 
@@ -2682,6 +2850,10 @@ _cairo_svg_document_create (cairo_output_stream_t	 *output_stream,
 
     document->svg_version = version;
 
+    document->deduplicate_images = FALSE;
+    document->image_digests = NULL;
+    document->image_aliases = NULL;
+
     *document_out = document;
     return CAIRO_STATUS_SUCCESS;
 
@@ -2831,6 +3003,19 @@ _cairo_svg_document_finish (cairo_svg_document_t *document)
     if (status == CAIRO_STATUS_SUCCESS)
 	status = status2;
 
+    if (document->image_digests != NULL) {
+	_cairo_hash_table_foreach (document->image_digests,
+				   _cairo_svg_image_pluck,
+				   document->image_digests);
+	_cairo_hash_table_destroy (document->image_digests);
+    }
+    if (document->image_aliases != NULL) {
+	_cairo_hash_table_foreach (document->image_aliases,
+				   _cairo_svg_image_pluck,
+				   document->image_aliases);
+	_cairo_hash_table_destroy (document->image_aliases);
+    }
+
     document->finished = TRUE;
 
     return status;
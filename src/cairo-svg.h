@@ -68,6 +68,10 @@ cairo_public void
 cairo_svg_surface_restrict_to_version (cairo_surface_t 		*surface,
 				       cairo_svg_version_t  	 version);
 
+cairo_public void
+cairo_svg_surface_set_deduplicate_images (cairo_surface_t	*surface,
+					  cairo_bool_t		 deduplicate);
+
 cairo_public void
 cairo_svg_get_versions (cairo_svg_version_t const	**versions,
                         int                      	 *num_versions);
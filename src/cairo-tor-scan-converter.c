@@ -303,7 +303,9 @@ struct pool {
     struct _pool_chunk sentinel[1];
 };
 
-/* A polygon edge. */
+/* A polygon edge.  Edges are allocated by the million for complex
+ * polygons, so the fields read on every subsample row come first and
+ * the flags are packed to keep the whole edge within 56 bytes. */
 struct edge {
     /* Next in y-bucket or active list. */
     struct edge *next, *prev;
@@ -312,10 +314,8 @@ struct edge {
      * edge. */
     grid_scaled_y_t height_left;
 
-    /* Original sign of the edge: +1 for downwards, -1 for upwards
-     * edges.  */
-    int dir;
-    int vertical;
+    /* y2-y1 after orienting the edge downwards.  */
+    grid_scaled_y_t dy;
 
     /* Current x coordinate while the edge is on the active
      * list. Initialised to the x coordinate of the top of the
@@ -326,17 +326,19 @@ struct edge {
     /* Advance of the current x when moving down a subsample line. */
     struct quorem dxdy;
 
+    /* Original sign of the edge: +1 for downwards, -1 for upwards
+     * edges.  */
+    int16_t dir;
+    int16_t vertical;
+
+    /* The clipped y of the top of the edge. */
+    grid_scaled_y_t ytop;
+
     /* Advance of the current x when moving down a full pixel
      * row. Only initialised when the height of the edge is large
      * enough that there's a chance the edge could be stepped by a
      * full row's worth of subsample rows at a time. */
     struct quorem dxdy_full;
-
-    /* The clipped y of the top of the edge. */
-    grid_scaled_y_t ytop;
-
-    /* y2-y1 after orienting the edge downwards.  */
-    grid_scaled_y_t dy;
 };
 
 #define EDGE_Y_BUCKET_INDEX(y, ymin) (((y) - (ymin))/GRID_Y)
@@ -354,6 +356,15 @@ struct polygon {
     struct edge **y_buckets;
     struct edge *y_buckets_embedded[64];
 
+    /* When continuing a band of a larger polygon, the edges which
+     * began above ymin.  These are already active on the first row,
+     * exactly as they would be had the clip extended further upwards,
+     * so that adjacent bands of the same polygon rasterise identically
+     * to a single converter spanning them both.  Otherwise such edges
+     * simply start in the first bucket. */
+    int continued;
+    struct edge *y_clipped;
+
     struct {
 	struct pool base[1];
 	struct edge embedded[32];
@@ -424,6 +435,22 @@ struct cell_list {
 	struct pool base[1];
 	struct cell embedded[32];
     } cell_pool;
+
+    /* Number of cells touched by the current row. */
+    int num_cells;
+
+    /* Rows crowded with cells are accumulated into flat per-pixel
+     * arrays instead of the list, see cell_list_choose_storage().
+     * Slot 0 collects the cells to the left of the clip, slots
+     * 1..width the pixels xmin..xmax-1 and slot width+1 the cells to
+     * the right of the clip. */
+    struct {
+	int16_t *covered_height;
+	int16_t *uncovered_area;
+	uint8_t *coverage;
+	int xmin, width;
+	int enabled;
+    } dense;
 };
 
 struct cell_pair {
@@ -651,12 +678,18 @@ cell_list_init(struct cell_list *cells, jmp_buf *jmp)
     cells->head.x = INT_MIN;
     cells->head.next = &cells->tail;
     cell_list_rewind (cells);
+
+    cells->num_cells = 0;
+    cells->dense.covered_height = NULL;
+    cells->dense.xmin = cells->dense.width = 0;
+    cells->dense.enabled = 0;
 }
 
 static void
 cell_list_fini(struct cell_list *cells)
 {
     pool_fini (cells->cell_pool.base);
+    free (cells->dense.covered_height);
 }
 
 /* Empty the cell list.  This is called at the start of every pixel
@@ -681,6 +714,7 @@ cell_list_alloc (struct cell_list *cells,
     tail->next = cell;
     cell->x = x;
     *(uint32_t *)&cell->uncovered_area = 0;
+    cells->num_cells++;
 
     return cell;
 }
@@ -712,6 +746,69 @@ cell_list_find (struct cell_list *cells, int x)
 
 }
 
+/* Dense rows are only worthwhile if the row is both wide and crowded,
+ * with more than one cell for every DENSE_RATIO pixels, and is to be
+ * sampled subrow by subrow, walking the list GRID_Y times.  Full rows
+ * walk the list just once, which is cheaper than clearing and scanning
+ * the whole width of the arrays. */
+#define DENSE_MIN_WIDTH 64
+#define DENSE_RATIO 8
+
+/* Set the clip for the dense storage, discarding any previous arrays. */
+static void
+cell_list_set_dense_extents (struct cell_list *cells, int xmin, int xmax)
+{
+    free (cells->dense.covered_height);
+    cells->dense.covered_height = NULL;
+    cells->dense.enabled = 0;
+
+    cells->dense.xmin = xmin;
+    cells->dense.width = xmax - xmin;
+}
+
+/* Choose how to accumulate the cells of the next row based upon the
+ * density of the previous one.  Failing to allocate the dense arrays
+ * is not an error, we simply continue to use the list. */
+inline static void
+cell_list_choose_storage (struct cell_list *cells, int sampled)
+{
+    int width = cells->dense.width;
+    int dense;
+
+    dense = sampled && width >= DENSE_MIN_WIDTH &&
+	cells->num_cells * DENSE_RATIO > width;
+    cells->num_cells = 0;
+
+    if (dense && cells->dense.covered_height == NULL) {
+	int16_t *mem;
+
+	mem = _cairo_malloc_ab (width + 2, 2*sizeof (int16_t) + 1);
+	if (unlikely (mem == NULL)) {
+	    cells->dense.enabled = 0;
+	    return;
+	}
+
+	memset (mem, 0, 2*(width + 2)*sizeof (int16_t));
+	cells->dense.covered_height = mem;
+	cells->dense.uncovered_area = mem + width + 2;
+	cells->dense.coverage = (uint8_t *) (mem + 2*(width + 2));
+    }
+
+    cells->dense.enabled = dense;
+}
+
+/* Map a pixel column to its slot in the dense arrays. */
+inline static int
+cell_list_dense_index (const struct cell_list *cells, int x)
+{
+    x -= cells->dense.xmin - 1;
+    if (x < 0)
+	x = 0;
+    else if (x > cells->dense.width)
+	x = cells->dense.width + 1;
+    return x;
+}
+
 /* Find two cells at x1 and x2.	 This is exactly equivalent
  * to
  *
@@ -765,6 +862,23 @@ cell_list_add_subspan(struct cell_list *cells,
     GRID_X_TO_INT_FRAC(x1, ix1, fx1);
     GRID_X_TO_INT_FRAC(x2, ix2, fx2);
 
+    if (cells->dense.enabled) {
+	int i;
+
+	if (ix1 != ix2) {
+	    i = cell_list_dense_index (cells, ix1);
+	    cells->dense.uncovered_area[i] += 2*fx1;
+	    ++cells->dense.covered_height[i];
+	    i = cell_list_dense_index (cells, ix2);
+	    cells->dense.uncovered_area[i] -= 2*fx2;
+	    --cells->dense.covered_height[i];
+	} else {
+	    i = cell_list_dense_index (cells, ix1);
+	    cells->dense.uncovered_area[i] += 2*(fx1-fx2);
+	}
+	return;
+    }
+
     if (ix1 != ix2) {
 	struct cell_pair p;
 	p = cell_list_find_pair(cells, ix1, ix2);
@@ -914,6 +1028,8 @@ polygon_init (struct polygon *polygon, jmp_buf *jmp)
 {
     polygon->ymin = polygon->ymax = 0;
     polygon->y_buckets = polygon->y_buckets_embedded;
+    polygon->continued = FALSE;
+    polygon->y_clipped = NULL;
     pool_init (polygon->edge_pool.base, jmp,
 	       8192 - sizeof (struct _pool_chunk),
 	       sizeof (polygon->edge_pool.embedded));
@@ -955,6 +1071,7 @@ polygon_reset (struct polygon *polygon,
 	    goto bail_no_mem;
     }
     memset (polygon->y_buckets, 0, num_buckets * sizeof (struct edge *));
+    polygon->y_clipped = NULL;
 
     polygon->ymin = ymin;
     polygon->ymax = ymax;
@@ -1029,7 +1146,11 @@ polygon_add_edge (struct polygon *polygon,
 	}
     }
 
-    _polygon_insert_edge_into_its_y_bucket (polygon, e);
+    if (polygon->continued && edge->top < ymin) {
+	e->next = polygon->y_clipped;
+	polygon->y_clipped = e;
+    } else
+	_polygon_insert_edge_into_its_y_bucket (polygon, e);
 
     e->x.rem -= dy;		/* Bias the remainder for faster
 				 * edge advancement. */
@@ -1443,6 +1564,8 @@ glitter_scan_converter_reset(
     } else
 	converter->spans = converter->spans_embedded;
 
+    cell_list_set_dense_extents (converter->coverages, xmin, xmax);
+
     xmin = int_to_grid_scaled_x(xmin);
     ymin = int_to_grid_scaled_y(ymin);
     xmax = int_to_grid_scaled_x(xmax);
@@ -1669,6 +1792,88 @@ blit_a1 (struct cell_list *cells,
     return renderer->render_rows (renderer, y, height, spans, num_spans);
 }
 
+/* Forms the spans of a row accumulated into the dense arrays, which
+ * are left cleared for the next row.  The coverage of each pixel is
+ * a prefix sum over the cell heights less the uncovered area; the
+ * passes are kept separate so that all but the prefix sum itself are
+ * simple loops over flat arrays the compiler is able to vectorize. */
+static glitter_status_t
+blit_dense (struct cell_list *cells,
+	    cairo_span_renderer_t *renderer,
+	    cairo_half_open_span_t *spans,
+	    int y, int height,
+	    int xmin, int xmax,
+	    int antialias)
+{
+    int16_t *covered_height = cells->dense.covered_height;
+    int16_t *uncovered_area = cells->dense.uncovered_area;
+    uint8_t *coverage = cells->dense.coverage;
+    int width = xmax - xmin;
+    uint64_t run;
+    uint8_t last_cover;
+    unsigned num_spans;
+    int16_t cover;
+    int x;
+
+    /* The cells to the left of the clip only contribute their height. */
+    cover = covered_height[0]*GRID_X*2;
+    cells->num_cells = 0;
+    for (x = 1; x <= width; x++) {
+	cells->num_cells += (covered_height[x] | uncovered_area[x]) != 0;
+	cover += covered_height[x]*GRID_X*2;
+	uncovered_area[x] = cover - uncovered_area[x];
+    }
+
+    if (antialias) {
+	for (x = 0; x < width; x++)
+	    coverage[x] = GRID_AREA_TO_ALPHA (uncovered_area[x+1]);
+    } else {
+	for (x = 0; x < width; x++)
+	    coverage[x] = GRID_AREA_TO_A1 (uncovered_area[x+1]);
+    }
+
+    memset (covered_height, 0, (width + 2)*sizeof (int16_t));
+    memset (uncovered_area, 0, (width + 2)*sizeof (int16_t));
+
+    /* Form the spans from the changes in coverage, skipping over
+     * runs of constant coverage a word at a time. */
+    num_spans = 0;
+    last_cover = 0;
+    run = 0;
+    x = 0;
+    while (x < width) {
+	if (x + 8 <= width) {
+	    uint64_t v;
+
+	    memcpy (&v, coverage + x, sizeof (v));
+	    if (v == run) {
+		x += 8;
+		continue;
+	    }
+	}
+
+	if (coverage[x] != last_cover) {
+	    last_cover = coverage[x];
+	    spans[num_spans].x = x + xmin;
+	    spans[num_spans].coverage = last_cover;
+	    ++num_spans;
+	    run = last_cover * (uint64_t) 0x0101010101010101ULL;
+	}
+	x++;
+    }
+
+    if (last_cover) {
+	spans[num_spans].x = xmax;
+	spans[num_spans].coverage = 0;
+	++num_spans;
+    }
+
+    if (num_spans == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* Dump them into the renderer. */
+    return renderer->render_rows (renderer, y, height, spans, num_spans);
+}
 
 I void
 glitter_scan_converter_render(glitter_scan_converter_t *converter,
@@ -1691,6 +1896,17 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
     if (xmin_i >= xmax_i)
 	return;
 
+    if (polygon->y_clipped) {
+	struct edge *e, *prev = NULL;
+
+	for (e = polygon->y_clipped; e; e = e->next) {
+	    e->prev = prev;
+	    prev = e;
+	}
+	active_list_merge_edges_from_bucket (active, polygon->y_clipped);
+	polygon->y_clipped = NULL;
+    }
+
     /* Render each pixel row. */
     for (i = 0; i < h; i = j) {
 	int do_full_row = 0;
@@ -1711,6 +1927,8 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
 	    do_full_row = can_do_full_row (active);
 	}
 
+	cell_list_choose_storage (coverages, ! do_full_row);
+
 	if (do_full_row) {
 	    /* Step by a full pixel row's worth. */
 	    full_row (active, coverages, winding_mask);
@@ -1745,7 +1963,10 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
 	    }
 	}
 
-	if (antialias)
+	if (coverages->dense.enabled)
+	    blit_dense (coverages, renderer, converter->spans,
+			i+ymin_i, j-i, xmin_i, xmax_i, antialias);
+	else if (antialias)
 	    blit_a8 (coverages, renderer, converter->spans,
 		     i+ymin_i, j-i, xmin_i, xmax_i);
 	else
@@ -1835,6 +2056,7 @@ _cairo_tor_scan_converter_create (int			xmin,
 
     self->base.destroy = _cairo_tor_scan_converter_destroy;
     self->base.generate = _cairo_tor_scan_converter_generate;
+    self->base.status = CAIRO_STATUS_SUCCESS;
 
     _glitter_scan_converter_init (self->converter, &self->jmp);
     status = glitter_scan_converter_reset (self->converter,
@@ -1852,3 +2074,28 @@ _cairo_tor_scan_converter_create (int			xmin,
  bail_nomem:
     return _cairo_scan_converter_create_in_error (status);
 }
+
+/* Creates a converter for one of several horizontal bands of the same
+ * polygon.  Edges passing through the top of the band are taken to
+ * be already active, so that a band that starts part way down the
+ * polygon renders exactly the same rows as a single converter for all
+ * the bands would.  The first band must use an ordinary converter. */
+cairo_scan_converter_t *
+_cairo_tor_scan_converter_create_band (int			xmin,
+				       int			ymin,
+				       int			xmax,
+				       int			ymax,
+				       cairo_fill_rule_t	fill_rule,
+				       cairo_antialias_t	antialias)
+{
+    cairo_scan_converter_t *converter;
+
+    converter = _cairo_tor_scan_converter_create (xmin, ymin, xmax, ymax,
+						  fill_rule, antialias);
+    if (likely (converter->status == CAIRO_STATUS_SUCCESS)) {
+	cairo_tor_scan_converter_t *self = (cairo_tor_scan_converter_t *) converter;
+	self->converter->polygon->continued = TRUE;
+    }
+
+    return converter;
+}
@@ -316,10 +316,8 @@ struct edge {
      * edge. */
     grid_scaled_y_t height_left;
 
-    /* Original sign of the edge: +1 for downwards, -1 for upwards
-     * edges.  */
-    int dir;
-    int vertical;
+    /* y2-y1 after orienting the edge downwards.  */
+    grid_scaled_y_t dy;
 
     /* Current x coordinate while the edge is on the active
      * list. Initialised to the x coordinate of the top of the
@@ -330,11 +328,13 @@ struct edge {
     /* Advance of the current x when moving down a subsample line. */
     struct quorem dxdy;
 
+    /* Original sign of the edge: +1 for downwards, -1 for upwards
+     * edges.  */
+    int16_t dir;
+    int16_t vertical;
+
     /* The clipped y of the top of the edge. */
     grid_scaled_y_t ytop;
-
-    /* y2-y1 after orienting the edge downwards.  */
-    grid_scaled_y_t dy;
 };
 
 #define EDGE_Y_BUCKET_INDEX(y, ymin) (((y) - (ymin))/GRID_Y)
@@ -422,8 +422,25 @@ struct cell_list {
 	struct pool base[1];
 	struct cell embedded[32];
     } cell_pool;
+
+    /* Number of cells touched by the current row. */
+    int num_cells;
+
+    /* Rows crowded with cells are accumulated into flat per-pixel
+     * arrays instead of the list, see cell_list_choose_storage().
+     * Slot 0 collects the cells to the left of the clip, slots
+     * 1..width the pixels xmin..xmax-1 and slot width+1 the cells to
+     * the right of the clip. */
+    struct {
+	int16_t *covered_height;
+	int16_t *uncovered_area;
+	uint8_t *coverage;
+	int xmin, width;
+	int enabled;
+    } dense;
 };
 
+
 struct cell_pair {
     struct cell *cell1;
     struct cell *cell2;
@@ -649,12 +666,18 @@ cell_list_init(struct cell_list *cells, jmp_buf *jmp)
     cells->head.x = INT_MIN;
     cells->head.next = &cells->tail;
     cell_list_rewind (cells);
+
+    cells->num_cells = 0;
+    cells->dense.covered_height = NULL;
+    cells->dense.xmin = cells->dense.width = 0;
+    cells->dense.enabled = 0;
 }
 
 static void
 cell_list_fini(struct cell_list *cells)
 {
     pool_fini (cells->cell_pool.base);
+    free (cells->dense.covered_height);
 }
 
 /* Empty the cell list.  This is called at the start of every pixel
@@ -679,6 +702,7 @@ cell_list_alloc (struct cell_list *cells,
     tail->next = cell;
     cell->x = x;
     *(uint32_t *)&cell->uncovered_area = 0;
+    cells->num_cells++;
 
     return cell;
 }
@@ -710,6 +734,69 @@ cell_list_find (struct cell_list *cells, int x)
 
 }
 
+/* Dense rows are only worthwhile if the row is both wide and crowded,
+ * with more than one cell for every DENSE_RATIO pixels, and is to be
+ * sampled subrow by subrow, walking the list GRID_Y times.  Full rows
+ * walk the list just once, which is cheaper than clearing and scanning
+ * the whole width of the arrays. */
+#define DENSE_MIN_WIDTH 64
+#define DENSE_RATIO 8
+
+/* Set the clip for the dense storage, discarding any previous arrays. */
+static void
+cell_list_set_dense_extents (struct cell_list *cells, int xmin, int xmax)
+{
+    free (cells->dense.covered_height);
+    cells->dense.covered_height = NULL;
+    cells->dense.enabled = 0;
+
+    cells->dense.xmin = xmin;
+    cells->dense.width = xmax - xmin;
+}
+
+/* Choose how to accumulate the cells of the next row based upon the
+ * density of the previous one.  Failing to allocate the dense arrays
+ * is not an error, we simply continue to use the list. */
+inline static void
+cell_list_choose_storage (struct cell_list *cells, int sampled)
+{
+    int width = cells->dense.width;
+    int dense;
+
+    dense = sampled && width >= DENSE_MIN_WIDTH &&
+	cells->num_cells * DENSE_RATIO > width;
+    cells->num_cells = 0;
+
+    if (dense && cells->dense.covered_height == NULL) {
+	int16_t *mem;
+
+	mem = _cairo_malloc_ab (width + 2, 2*sizeof (int16_t) + 1);
+	if (unlikely (mem == NULL)) {
+	    cells->dense.enabled = 0;
+	    return;
+	}
+
+	memset (mem, 0, 2*(width + 2)*sizeof (int16_t));
+	cells->dense.covered_height = mem;
+	cells->dense.uncovered_area = mem + width + 2;
+	cells->dense.coverage = (uint8_t *) (mem + 2*(width + 2));
+    }
+
+    cells->dense.enabled = dense;
+}
+
+/* Map a pixel column to its slot in the dense arrays. */
+inline static int
+cell_list_dense_index (const struct cell_list *cells, int x)
+{
+    x -= cells->dense.xmin - 1;
+    if (x < 0)
+	x = 0;
+    else if (x > cells->dense.width)
+	x = cells->dense.width + 1;
+    return x;
+}
+
 /* Find two cells at x1 and x2.	 This is exactly equivalent
  * to
  *
@@ -763,8 +850,26 @@ cell_list_add_subspan(struct cell_list *cells,
     GRID_X_TO_INT_FRAC(x1, ix1, fx1);
     GRID_X_TO_INT_FRAC(x2, ix2, fx2);
 
+    if (cells->dense.enabled) {
+	int i;
+
+	if (ix1 != ix2) {
+	    i = cell_list_dense_index (cells, ix1);
+	    cells->dense.uncovered_area[i] += 2*fx1;
+	    ++cells->dense.covered_height[i];
+	    i = cell_list_dense_index (cells, ix2);
+	    cells->dense.uncovered_area[i] -= 2*fx2;
+	    --cells->dense.covered_height[i];
+	} else {
+	    i = cell_list_dense_index (cells, ix1);
+	    cells->dense.uncovered_area[i] += 2*(fx1-fx2);
+	}
+	return;
+    }
+
     if (ix1 != ix2) {
 	struct cell_pair p;
+
 	p = cell_list_find_pair(cells, ix1, ix2);
 	p.cell1->uncovered_area += 2*fx1;
 	++p.cell1->covered_height;
@@ -1287,18 +1392,24 @@ glitter_scan_converter_reset(
 			     int xmax, int ymax)
 {
     glitter_status_t status;
+    int max_num_spans;
 
     converter->xmin = 0; converter->xmax = 0;
     converter->ymin = 0; converter->ymax = 0;
 
-    if (xmax - xmin > ARRAY_LENGTH(converter->spans_embedded)) {
-	converter->spans = _cairo_malloc_ab (xmax - xmin,
+    /* Room for a span starting at every pixel plus the closing span. */
+    max_num_spans = xmax - xmin + 1;
+
+    if (max_num_spans > ARRAY_LENGTH(converter->spans_embedded)) {
+	converter->spans = _cairo_malloc_ab (max_num_spans,
 					     sizeof (cairo_half_open_span_t));
 	if (unlikely (converter->spans == NULL))
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     } else
 	converter->spans = converter->spans_embedded;
 
+    cell_list_set_dense_extents (converter->coverages, xmin, xmax);
+
     xmin = int_to_grid_scaled_x(xmin);
     ymin = int_to_grid_scaled_y(ymin);
     xmax = int_to_grid_scaled_x(xmax);
@@ -1524,6 +1635,88 @@ blit_a1 (struct cell_list *cells,
     return renderer->render_rows (renderer, y, height, spans, num_spans);
 }
 
+/* Forms the spans of a row accumulated into the dense arrays, which
+ * are left cleared for the next row.  The coverage of each pixel is
+ * a prefix sum over the cell heights less the uncovered area; the
+ * passes are kept separate so that all but the prefix sum itself are
+ * simple loops over flat arrays the compiler is able to vectorize. */
+static glitter_status_t
+blit_dense (struct cell_list *cells,
+	    cairo_span_renderer_t *renderer,
+	    cairo_half_open_span_t *spans,
+	    int y, int height,
+	    int xmin, int xmax,
+	    int antialias)
+{
+    int16_t *covered_height = cells->dense.covered_height;
+    int16_t *uncovered_area = cells->dense.uncovered_area;
+    uint8_t *coverage = cells->dense.coverage;
+    int width = xmax - xmin;
+    uint64_t run;
+    uint8_t last_cover;
+    unsigned num_spans;
+    int16_t cover;
+    int x;
+
+    /* The cells to the left of the clip only contribute their height. */
+    cover = covered_height[0]*GRID_X*2;
+    cells->num_cells = 0;
+    for (x = 1; x <= width; x++) {
+	cells->num_cells += (covered_height[x] | uncovered_area[x]) != 0;
+	cover += covered_height[x]*GRID_X*2;
+	uncovered_area[x] = cover - uncovered_area[x];
+    }
+
+    if (antialias) {
+	for (x = 0; x < width; x++)
+	    coverage[x] = GRID_AREA_TO_ALPHA (uncovered_area[x+1]);
+    } else {
+	for (x = 0; x < width; x++)
+	    coverage[x] = GRID_AREA_TO_A1 (uncovered_area[x+1]);
+    }
+
+    memset (covered_height, 0, (width + 2)*sizeof (int16_t));
+    memset (uncovered_area, 0, (width + 2)*sizeof (int16_t));
+
+    /* Form the spans from the changes in coverage, skipping over
+     * runs of constant coverage a word at a time. */
+    num_spans = 0;
+    last_cover = 0;
+    run = 0;
+    x = 0;
+    while (x < width) {
+	if (x + 8 <= width) {
+	    uint64_t v;
+
+	    memcpy (&v, coverage + x, sizeof (v));
+	    if (v == run) {
+		x += 8;
+		continue;
+	    }
+	}
+
+	if (coverage[x] != last_cover) {
+	    last_cover = coverage[x];
+	    spans[num_spans].x = x + xmin;
+	    spans[num_spans].coverage = last_cover;
+	    ++num_spans;
+	    run = last_cover * (uint64_t) 0x0101010101010101ULL;
+	}
+	x++;
+    }
+
+    if (last_cover) {
+	spans[num_spans].x = xmax;
+	spans[num_spans].coverage = 0;
+	++num_spans;
+    }
+
+    if (num_spans == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* Dump them into the renderer. */
+    return renderer->render_rows (renderer, y, height, spans, num_spans);
+}
 
 I void
 glitter_scan_converter_render(glitter_scan_converter_t *converter,
@@ -1566,6 +1759,8 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
 	    do_full_row = can_do_full_row (active);
 	}
 
+	cell_list_choose_storage (coverages, ! do_full_row);
+
 	if (do_full_row) {
 	    /* Step by a full pixel row's worth. */
 	    full_row (active, coverages, winding_mask);
@@ -1600,7 +1795,10 @@ glitter_scan_converter_render(glitter_scan_converter_t *converter,
 	    }
 	}
 
-	if (antialias)
+	if (coverages->dense.enabled)
+	    blit_dense (coverages, renderer, converter->spans,
+			i+ymin_i, j-i, xmin_i, xmax_i, antialias);
+	else if (antialias)
 	    blit_a8 (coverages, renderer, converter->spans,
 		     i+ymin_i, j-i, xmin_i, xmax_i);
 	else
@@ -1535,7 +1535,15 @@ clip_and_composite_polygon (const cairo_traps_compositor_t *compositor,
     if (antialias == CAIRO_ANTIALIAS_NONE && curvy) {
 	status = _cairo_rasterise_polygon_to_traps (polygon, fill_rule, antialias, &traps.traps);
     } else {
-	status = _cairo_bentley_ottmann_tessellate_polygon (&traps.traps, polygon, fill_rule);
+	int num_threads = 1;
+
+	if (compositor->renderer_threads)
+	    num_threads = compositor->renderer_threads (dst);
+
+	status = _cairo_bentley_ottmann_tessellate_polygon_threads (&traps.traps,
+								    polygon,
+								    fill_rule,
+								    num_threads);
     }
     if (unlikely (status))
 	goto CLEANUP_TRAPS;
@@ -1640,6 +1640,62 @@ cairo_public void
 cairo_scaled_font_get_font_options (cairo_scaled_font_t		*scaled_font,
 				    cairo_font_options_t	*options);
 
+/**
+ * cairo_font_cache_t:
+ * @CAIRO_FONT_CACHE_SCALED_FONTS: unreferenced scaled fonts kept alive in
+ *   case they are used again; each counts as the size of the font
+ *   object, its glyphs are counted in the glyph pages
+ * @CAIRO_FONT_CACHE_GLYPH_PAGES: rendered glyphs of all scaled fonts,
+ *   allocated in pages of several glyphs; counts the pages and the
+ *   glyph images
+ * @CAIRO_FONT_CACHE_IMAGE_GLYPHS: glyphs prepared for compositing by the
+ *   image backend; counts the glyph images
+ *
+ * #cairo_font_cache_t identifies one of the global caches cairo uses
+ * for text, see cairo_font_cache_set_max_bytes() and
+ * cairo_font_cache_get_statistics().
+ *
+ * Since: 1.14
+ **/
+typedef enum _cairo_font_cache {
+    CAIRO_FONT_CACHE_SCALED_FONTS,
+    CAIRO_FONT_CACHE_GLYPH_PAGES,
+    CAIRO_FONT_CACHE_IMAGE_GLYPHS
+} cairo_font_cache_t;
+
+/**
+ * cairo_font_cache_statistics_t:
+ * @hits: number of lookups satisfied by the cache
+ * @misses: number of lookups that had to create a new entry
+ * @evictions: number of entries discarded to stay within the budget
+ * @entries: number of entries currently held
+ * @max_bytes: the current memory budget, in bytes
+ * @bytes: approximate memory held by the entries, in bytes
+ *
+ * Counters describing the use of one of the global font caches, as
+ * returned by cairo_font_cache_get_statistics(). The counters are
+ * accumulated since the cache was created or last reset by
+ * cairo_debug_reset_static_data().
+ *
+ * Since: 1.14
+ **/
+typedef struct _cairo_font_cache_statistics {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long entries;
+    unsigned long max_bytes;
+    unsigned long bytes;
+} cairo_font_cache_statistics_t;
+
+cairo_public cairo_status_t
+cairo_font_cache_set_max_bytes (cairo_font_cache_t cache,
+				unsigned long      max_bytes);
+
+cairo_public cairo_status_t
+cairo_font_cache_get_statistics (cairo_font_cache_t             cache,
+				 cairo_font_cache_statistics_t *statistics);
+
 
 /* Toy fonts */
 
@@ -2475,6 +2531,13 @@ cairo_surface_get_fallback_resolution (cairo_surface_t	*surface,
 				       double		*x_pixels_per_inch,
 				       double		*y_pixels_per_inch);
 
+cairo_public void
+cairo_surface_set_fallback_threads (cairo_surface_t	*surface,
+				    int			 num_threads);
+
+cairo_public int
+cairo_surface_get_fallback_threads (cairo_surface_t	*surface);
+
 cairo_public void
 cairo_surface_copy_page (cairo_surface_t *surface);
 
@@ -2517,6 +2580,20 @@ cairo_image_surface_get_height (cairo_surface_t *surface);
 cairo_public int
 cairo_image_surface_get_stride (cairo_surface_t *surface);
 
+cairo_public void
+cairo_image_surface_set_render_threads (cairo_surface_t *surface,
+					int		 num_threads);
+
+cairo_public int
+cairo_image_surface_get_render_threads (cairo_surface_t *surface);
+
+cairo_public void
+cairo_image_surface_set_deferred (cairo_surface_t *surface,
+				  cairo_bool_t	   deferred);
+
+cairo_public cairo_bool_t
+cairo_image_surface_get_deferred (cairo_surface_t *surface);
+
 #if CAIRO_HAS_PNG_FUNCTIONS
 
 cairo_public cairo_surface_t *
@@ -390,6 +390,25 @@ _cairo_hash_bytes (unsigned long hash,
 		   const void *bytes,
 		   unsigned int length);
 
+/* A 128-bit digest for recognising identical blocks of data, such as
+ * the pixels of two images.  It is fast but not cryptographic. */
+typedef struct _cairo_hash_digest {
+    uint64_t h[2];
+} cairo_hash_digest_t;
+
+cairo_private void
+_cairo_hash_digest_init (cairo_hash_digest_t *digest);
+
+cairo_private void
+_cairo_hash_digest_update (cairo_hash_digest_t *digest,
+			   const void *bytes,
+			   unsigned long length);
+
+#define _cairo_hash_digest_equal(a, b) \
+    ((a)->h[0] == (b)->h[0] && (a)->h[1] == (b)->h[1])
+
+#define _cairo_hash_digest_to_hash(d) ((unsigned long) ((d)->h[0] ^ (d)->h[1]))
+
 #define _cairo_scaled_glyph_index(g) ((g)->hash_entry.hash)
 #define _cairo_scaled_glyph_set_index(g, i)  ((g)->hash_entry.hash = (i))
 
@@ -571,6 +590,25 @@ struct _cairo_scaled_font_backend {
                            long                  offset,
                            unsigned char        *buffer,
                            unsigned long        *length);
+
+    /* Optionally render the images of several glyphs at once, using up
+     * to @num_threads threads.
+     * @scaled_font: font
+     * @scaled_glyphs: distinct glyphs whose metrics are known but which
+     *   lack CAIRO_SCALED_GLYPH_INFO_SURFACE
+     * @num_glyphs: the number of glyphs in @scaled_glyphs
+     * @num_threads: the maximum number of threads to use
+     *
+     * This is only a hint: any glyph left without a surface is later
+     * rendered through scaled_glyph_init().
+     *
+     * Returns CAIRO_INT_STATUS_UNSUPPORTED if the glyphs were not rendered.
+     */
+    cairo_warn cairo_int_status_t
+    (*scaled_glyphs_init_surfaces) (void		        *scaled_font,
+				    cairo_scaled_glyph_t       **scaled_glyphs,
+				    int				 num_glyphs,
+				    int				 num_threads);
 };
 
 struct _cairo_font_face_backend {
@@ -1217,6 +1255,12 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
 			    cairo_scaled_glyph_info_t info,
 			    cairo_scaled_glyph_t **scaled_glyph_ret);
 
+cairo_private cairo_int_status_t
+_cairo_scaled_font_prepare_glyph_surfaces (cairo_scaled_font_t *scaled_font,
+					   const cairo_glyph_t *glyphs,
+					   int num_glyphs,
+					   int num_threads);
+
 cairo_private double
 _cairo_scaled_font_get_max_scale (cairo_scaled_font_t *scaled_font);
 
@@ -1398,6 +1442,11 @@ _cairo_surface_release_source_image (cairo_surface_t        *surface,
 				     cairo_image_surface_t  *image,
 				     void                   *image_extra);
 
+cairo_private cairo_int_status_t
+_cairo_surface_get_content_digest (cairo_surface_t	   *surface,
+				   const char * const	   *mime_types,
+				   cairo_hash_digest_t	   *digest);
+
 cairo_private cairo_surface_t *
 _cairo_surface_snapshot (cairo_surface_t *surface);
 
@@ -1511,6 +1560,15 @@ cairo_private void
 _cairo_image_scaled_glyph_fini (cairo_scaled_font_t *scaled_font,
 				cairo_scaled_glyph_t *scaled_glyph);
 
+cairo_private void
+_cairo_image_glyph_cache_set_max_bytes (unsigned long max_bytes);
+
+cairo_private void
+_cairo_image_glyph_cache_get_statistics (cairo_font_cache_statistics_t *statistics);
+
+cairo_private void
+_cairo_image_compositor_reset_static_data (void);
+
 cairo_private void
 _cairo_image_reset_static_data (void);
 
@@ -1632,6 +1690,13 @@ cairo_private cairo_status_t
 _cairo_polygon_add_contour (cairo_polygon_t *polygon,
 			    const cairo_contour_t *contour);
 
+cairo_private cairo_status_t
+_cairo_polygon_add_edges (cairo_polygon_t *polygon,
+			  const cairo_edge_t *edges,
+			  int num_edges,
+			  cairo_fixed_t dx,
+			  cairo_fixed_t dy);
+
 cairo_private void
 _cairo_polygon_translate (cairo_polygon_t *polygon, int dx, int dy);
 
@@ -1767,6 +1832,12 @@ _cairo_bentley_ottmann_tessellate_polygon (cairo_traps_t         *traps,
 					   const cairo_polygon_t *polygon,
 					   cairo_fill_rule_t      fill_rule);
 
+cairo_private cairo_status_t
+_cairo_bentley_ottmann_tessellate_polygon_threads (cairo_traps_t         *traps,
+						   const cairo_polygon_t *polygon,
+						   cairo_fill_rule_t      fill_rule,
+						   int			  num_threads);
+
 cairo_private cairo_status_t
 _cairo_bentley_ottmann_tessellate_traps (cairo_traps_t *traps,
 					 cairo_fill_rule_t fill_rule);
@@ -0,0 +1,197 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Shared by the pdf, ps and svg deduplicate-images tests: every page
+ * of the document paints a separately created copy of the same image,
+ * and the backend specific count_images() reports how many times the
+ * image data was written to the document.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cairo-test.h"
+
+static cairo_surface_t *
+create_document_surface (const char *filename, int width, int height);
+
+static void
+set_deduplicate_images (cairo_surface_t *surface, cairo_bool_t deduplicate);
+
+static int
+count_images (const char *data, long length);
+
+#define NUM_PAGES 3
+#define SIZE 32
+
+/* The documents hold compressed data, so they cannot be searched as
+ * nul-terminated strings.
+ */
+static const char *
+find (const char *data, long length, const char *needle)
+{
+    long n = strlen (needle);
+    const char *end = data + length - n;
+
+    for (; data <= end; data++) {
+	data = memchr (data, needle[0], end - data + 1);
+	if (data == NULL)
+	    return NULL;
+	if (memcmp (data, needle, n) == 0)
+	    return data;
+    }
+
+    return NULL;
+}
+
+static int
+count (const char *data, long length, const char *needle)
+{
+    const char *end = data + length;
+    const char *p = data;
+    int n = 0;
+
+    while ((p = find (p, end - p, needle)) != NULL) {
+	n++;
+	p++;
+    }
+
+    return n;
+}
+
+static cairo_surface_t *
+create_logo (void)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_set_source_rgb (cr, 1, 0, 0);
+    cairo_arc (cr, SIZE / 2, SIZE / 2, SIZE / 3, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static cairo_status_t
+draw_document (const char *filename, cairo_bool_t deduplicate)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page;
+
+    surface = create_document_surface (filename, SIZE, SIZE);
+    set_deduplicate_images (surface, deduplicate);
+
+    cr = cairo_create (surface);
+    for (page = 0; page < NUM_PAGES; page++) {
+	/* a fresh copy of the same image for every page */
+	cairo_surface_t *logo = create_logo ();
+
+	cairo_set_source_surface (cr, logo, 0, 0);
+	cairo_paint (cr);
+	cairo_surface_destroy (logo);
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static char *
+read_document (const char *filename, long *length)
+{
+    FILE *file;
+    char *data;
+
+    file = fopen (filename, "rb");
+    if (file == NULL)
+	return NULL;
+
+    fseek (file, 0, SEEK_END);
+    *length = ftell (file);
+    fseek (file, 0, SEEK_SET);
+
+    data = malloc (*length);
+    if (data != NULL && fread (data, *length, 1, file) != 1) {
+	free (data);
+	data = NULL;
+    }
+    fclose (file);
+
+    return data;
+}
+
+static cairo_test_status_t
+check_deduplicate_images (cairo_test_context_t *ctx,
+			  const char *plain_filename,
+			  const char *dedup_filename)
+{
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_status_t status;
+    char *plain = NULL, *dedup = NULL;
+    long plain_length, dedup_length;
+    int plain_count, dedup_count;
+
+    status = draw_document (plain_filename, FALSE);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = draw_document (dedup_filename, TRUE);
+    if (status) {
+	cairo_test_log (ctx, "Failed to create document: %s\n",
+			cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    plain = read_document (plain_filename, &plain_length);
+    dedup = read_document (dedup_filename, &dedup_length);
+    if (plain == NULL || dedup == NULL) {
+	cairo_test_log (ctx, "Failed to read back the documents\n");
+	result = CAIRO_TEST_FAILURE;
+    } else {
+	plain_count = count_images (plain, plain_length);
+	dedup_count = count_images (dedup, dedup_length);
+	if (plain_count != NUM_PAGES || dedup_count != 1) {
+	    cairo_test_log (ctx, "Expected %d images without and 1 with deduplication, found %d and %d\n",
+			    NUM_PAGES, plain_count, dedup_count);
+	    result = CAIRO_TEST_FAILURE;
+	}
+    }
+
+    free (plain);
+    free (dedup);
+
+    return result;
+}
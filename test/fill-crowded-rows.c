@@ -0,0 +1,145 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Rows crowded with edges are accumulated by the tor scan converters
+ * into per-pixel arrays rather than their usual list of cells, but
+ * only if the row is at least 64 pixels wide.  Check that a crowded
+ * fill across a wide surface matches the same fill rendered in strips
+ * too narrow for the arrays to be used.
+ */
+
+#include "cairo-test.h"
+
+#define WIDTH 256
+#define HEIGHT 48
+#define STRIP 32
+
+static void
+draw_diamonds (cairo_t *cr)
+{
+    int i, j;
+
+    /* Small diamonds, a few pixels apart, keep every row crowded and
+     * start and end edges in every row so that each is sampled. */
+    for (j = 0; j < HEIGHT / 3; j++) {
+	for (i = 0; i < WIDTH / 3; i++) {
+	    double x = 3 * i + 0.37 * (j % 5) + 0.5;
+	    double y = 3 * j + 0.29 * (i % 7) + 0.5;
+	    double r = 0.9 + 0.13 * ((i + j) % 6);
+
+	    cairo_move_to (cr, x, y - r);
+	    cairo_line_to (cr, x + r, y);
+	    cairo_line_to (cr, x, y + r);
+	    cairo_line_to (cr, x - r, y);
+	    cairo_close_path (cr);
+	}
+    }
+
+    /* and some long slivers crossing them */
+    for (i = 0; i < WIDTH; i += 11) {
+	cairo_move_to (cr, i + 0.25, 0);
+	cairo_line_to (cr, i + 40.75, HEIGHT);
+	cairo_line_to (cr, i + 42.5, HEIGHT);
+	cairo_line_to (cr, i + 2, 0);
+	cairo_close_path (cr);
+    }
+}
+
+static cairo_surface_t *
+render (cairo_antialias_t antialias, int x, int width)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, width, HEIGHT);
+    cr = cairo_create (surface);
+    cairo_translate (cr, -x, 0);
+    cairo_set_antialias (cr, antialias);
+    cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    draw_diamonds (cr);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (surface);
+    return surface;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx, cairo_antialias_t antialias)
+{
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *wide;
+    int x, y;
+
+    wide = render (antialias, 0, WIDTH);
+    for (x = 0; x < WIDTH && result == CAIRO_TEST_SUCCESS; x += STRIP) {
+	cairo_surface_t *strip;
+
+	strip = render (antialias, x, STRIP);
+	for (y = 0; y < HEIGHT; y++) {
+	    const unsigned char *a, *b;
+
+	    a = cairo_image_surface_get_data (wide) + y * cairo_image_surface_get_stride (wide) + x;
+	    b = cairo_image_surface_get_data (strip) + y * cairo_image_surface_get_stride (strip);
+	    if (memcmp (a, b, STRIP)) {
+		cairo_test_log (ctx,
+				"Row %d of the strip at %d differs with antialias %d\n",
+				y, x, antialias);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+	}
+	cairo_surface_destroy (strip);
+    }
+    cairo_surface_destroy (wide);
+
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const cairo_antialias_t antialias[] = {
+	CAIRO_ANTIALIAS_DEFAULT,
+	CAIRO_ANTIALIAS_FAST,
+    };
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_LENGTH (antialias); i++) {
+	cairo_test_status_t status;
+
+	status = compare (ctx, antialias[i]);
+	if (status)
+	    return status;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+CAIRO_TEST (fill_crowded_rows,
+	    "Check that crowded rows rasterise the same however wide they are",
+	    "fill", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,194 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-test.h"
+
+#include <assert.h>
+
+static void
+draw_text (void)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    int i;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 200, 20);
+    cr = cairo_create (surface);
+    cairo_surface_destroy (surface);
+
+    cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, 12);
+    for (i = 0; i < 4; i++) {
+	cairo_move_to (cr, 0, 16);
+	cairo_show_text (cr, "hello cache");
+    }
+
+    cairo_destroy (cr);
+}
+
+static cairo_status_t
+empty_render_glyph (cairo_scaled_font_t  *scaled_font,
+		    unsigned long         glyph,
+		    cairo_t              *cr,
+		    cairo_text_extents_t *extents)
+{
+    return CAIRO_STATUS_SUCCESS;
+}
+
+#define NUM_GLYPHS 4096
+
+/* Fill many glyph pages with one font, then use a few more fonts, some of
+ * which will share its shard. The pages of the first font are within the
+ * global budget and so must all be kept.
+ */
+static cairo_test_status_t
+check_single_font_budget (cairo_test_context_t *ctx)
+{
+    cairo_font_cache_statistics_t before, after;
+    cairo_font_face_t *font_face;
+    cairo_surface_t *surface;
+    cairo_glyph_t *glyphs;
+    cairo_t *cr;
+    int i;
+
+    glyphs = xmalloc (NUM_GLYPHS * sizeof (cairo_glyph_t));
+    for (i = 0; i < NUM_GLYPHS; i++) {
+	glyphs[i].index = i;
+	glyphs[i].x = 0;
+	glyphs[i].y = 0;
+    }
+
+    font_face = cairo_user_font_face_create ();
+    cairo_user_font_face_set_render_glyph_func (font_face, empty_render_glyph);
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, 20, 20);
+    cr = cairo_create (surface);
+    cairo_surface_destroy (surface);
+    cairo_set_font_face (cr, font_face);
+
+    assert (cairo_font_cache_get_statistics (CAIRO_FONT_CACHE_GLYPH_PAGES,
+					     &before) == CAIRO_STATUS_SUCCESS);
+
+    cairo_set_font_size (cr, 10);
+    cairo_show_glyphs (cr, glyphs, NUM_GLYPHS);
+    for (i = 11; i < 43; i++) {
+	cairo_set_font_size (cr, i);
+	cairo_show_glyphs (cr, glyphs, 1);
+    }
+
+    assert (cairo_font_cache_get_statistics (CAIRO_FONT_CACHE_GLYPH_PAGES,
+					     &after) == CAIRO_STATUS_SUCCESS);
+
+    cairo_destroy (cr);
+    cairo_font_face_destroy (font_face);
+    free (glyphs);
+
+    if (after.evictions != before.evictions) {
+	cairo_test_log (ctx, "%lu glyph pages evicted within the budget\n",
+			after.evictions - before.evictions);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_font_cache_statistics_t before, after;
+    cairo_font_cache_t cache;
+
+    /* error handling */
+    assert (cairo_font_cache_get_statistics (CAIRO_FONT_CACHE_GLYPH_PAGES,
+					     NULL) == CAIRO_STATUS_NULL_POINTER);
+    assert (cairo_font_cache_get_statistics ((cairo_font_cache_t) -1,
+					     &before) == CAIRO_STATUS_INVALID_INDEX);
+    assert (cairo_font_cache_set_max_bytes ((cairo_font_cache_t) -1,
+					    1) == CAIRO_STATUS_INVALID_INDEX);
+
+    /* drawing the same text again must hit the glyph page cache */
+    draw_text ();
+    assert (cairo_font_cache_get_statistics (CAIRO_FONT_CACHE_GLYPH_PAGES,
+					     &before) == CAIRO_STATUS_SUCCESS);
+    draw_text ();
+    assert (cairo_font_cache_get_statistics (CAIRO_FONT_CACHE_GLYPH_PAGES,
+					     &after) == CAIRO_STATUS_SUCCESS);
+    if (after.hits < before.hits) {
+	cairo_test_log (ctx, "glyph page hits went backwards: %lu -> %lu\n",
+			before.hits, after.hits);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    /* budgets can be lowered and restored for every cache */
+    for (cache = CAIRO_FONT_CACHE_SCALED_FONTS;
+	 cache <= CAIRO_FONT_CACHE_IMAGE_GLYPHS;
+	 cache++)
+    {
+	assert (cairo_font_cache_get_statistics (cache, &before) == CAIRO_STATUS_SUCCESS);
+	assert (cairo_font_cache_set_max_bytes (cache, 0) == CAIRO_STATUS_SUCCESS);
+
+	draw_text ();
+
+	assert (cairo_font_cache_get_statistics (cache, &after) == CAIRO_STATUS_SUCCESS);
+	if (cache == CAIRO_FONT_CACHE_SCALED_FONTS && after.entries != 0) {
+	    cairo_test_log (ctx, "%lu scaled fonts held over with a budget of 0\n",
+			    after.entries);
+	    return CAIRO_TEST_FAILURE;
+	}
+
+	if (cache == CAIRO_FONT_CACHE_GLYPH_PAGES) {
+	    /* nothing is drawing now, so every page can be discarded */
+	    assert (cairo_font_cache_set_max_bytes (cache, 0) == CAIRO_STATUS_SUCCESS);
+	    assert (cairo_font_cache_get_statistics (cache, &after) == CAIRO_STATUS_SUCCESS);
+	    if (after.entries != 0 || after.bytes != 0) {
+		cairo_test_log (ctx, "%lu glyph pages (%lu bytes) kept with a budget of 0\n",
+				after.entries, after.bytes);
+		return CAIRO_TEST_FAILURE;
+	    }
+	    if (after.evictions <= before.evictions) {
+		cairo_test_log (ctx, "glyph pages discarded without counting evictions\n");
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+
+	assert (cairo_font_cache_set_max_bytes (cache, before.max_bytes) == CAIRO_STATUS_SUCCESS);
+	assert (cairo_font_cache_get_statistics (cache, &after) == CAIRO_STATUS_SUCCESS);
+	if (after.max_bytes != before.max_bytes) {
+	    cairo_test_log (ctx, "budget of cache %d not restored: %lu != %lu\n",
+			    cache, after.max_bytes, before.max_bytes);
+	    return CAIRO_TEST_FAILURE;
+	}
+    }
+
+    return check_single_font_budget (ctx);
+}
+
+CAIRO_TEST (font_cache_statistics,
+	    "Check the budgets and counters of the global font caches.",
+	    "font, api", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* When an image surface allows several render threads, runs of new
+ * glyphs from a FreeType font loaded by cairo from its file are
+ * rasterised by a set of workers, each opening a face of its own for
+ * the run.  Check that the glyphs match those rendered one at a time,
+ * both for such a font and for one created from an FT_Face, which is
+ * never batched.
+ */
+
+#include "cairo-test.h"
+#include "buffer-diff.h"
+#include <cairo-ft.h>
+
+#define SIZE 512
+#define COLUMNS 24
+#define RUN_LENGTH 96
+#define RUNS_PER_SIZE 3
+
+static cairo_surface_t *
+draw_glyphs (cairo_font_face_t *font_face, int font_glyphs, int num_threads)
+{
+    static const double sizes[] = { 11, 19 };
+    cairo_glyph_t glyphs[RUN_LENGTH];
+    cairo_surface_t *surface;
+    cairo_t *cr;
+    unsigned int s;
+    int run, n, k;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_render_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_set_font_face (cr, font_face);
+
+    /* every run is a separate batch of new glyphs */
+    k = 0;
+    for (s = 0; s < ARRAY_LENGTH (sizes); s++) {
+	cairo_set_font_size (cr, sizes[s]);
+	for (run = 0; run < RUNS_PER_SIZE; run++) {
+	    for (n = 0; n < RUN_LENGTH; n++, k++) {
+		glyphs[n].index = 1 + k % (font_glyphs - 1);
+		glyphs[n].x = 4 + (k % COLUMNS) * 21;
+		glyphs[n].y = 18 + (k / COLUMNS) * 21;
+	    }
+	    cairo_show_glyphs (cr, glyphs, RUN_LENGTH);
+	}
+    }
+
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+compare (cairo_test_context_t *ctx,
+	 cairo_surface_t *threaded,
+	 cairo_surface_t *serial,
+	 const char *what)
+{
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    buffer_diff_result_t diff_result;
+    cairo_surface_t *diff;
+    cairo_status_t status;
+
+    status = cairo_surface_status (threaded);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (serial);
+    if (status)
+	return cairo_test_status_from_status (ctx, status);
+
+    diff = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    status = image_diff (ctx, threaded, serial, diff, &diff_result);
+    if (status) {
+	result = cairo_test_status_from_status (ctx, status);
+    } else if (diff_result.pixels_changed) {
+	cairo_test_log (ctx, "%s: %u pixels differ between threaded and serial glyphs\n",
+			what, diff_result.pixels_changed);
+	result = CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (diff);
+
+    return result;
+}
+
+static cairo_scaled_font_t *
+create_scaled_font (cairo_font_face_t *font_face)
+{
+    cairo_font_options_t *font_options;
+    cairo_scaled_font_t *scaled_font;
+    cairo_matrix_t identity;
+
+    cairo_matrix_init_identity (&identity);
+    font_options = cairo_font_options_create ();
+    scaled_font = cairo_scaled_font_create (font_face,
+					    &identity, &identity,
+					    font_options);
+    cairo_font_options_destroy (font_options);
+
+    return scaled_font;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t result, status;
+    cairo_surface_t *threaded, *serial;
+    cairo_font_face_t *file_font_face, *font_face, *serial_font_face;
+    cairo_scaled_font_t *scaled_font;
+    FcPattern *pattern, *resolved;
+    FcResult fc_result;
+    FT_Face ft_face;
+    int font_glyphs;
+
+    /* Any font will do, see ft-font-create-for-ft-face */
+    pattern = FcPatternCreate ();
+    if (! pattern)
+	return cairo_test_status_from_status (ctx, CAIRO_STATUS_NO_MEMORY);
+
+    FcConfigSubstitute (NULL, pattern, FcMatchPattern);
+    FcDefaultSubstitute (pattern);
+    resolved = FcFontMatch (NULL, pattern, &fc_result);
+    FcPatternDestroy (pattern);
+    if (! resolved)
+	return cairo_test_status_from_status (ctx, CAIRO_STATUS_NO_MEMORY);
+
+    file_font_face = cairo_ft_font_face_create_for_pattern (resolved);
+    scaled_font = create_scaled_font (file_font_face);
+    ft_face = cairo_ft_scaled_font_lock_face (scaled_font);
+    if (ft_face == NULL) {
+	cairo_test_log (ctx, "Failed to lock the face of the font\n");
+	cairo_scaled_font_destroy (scaled_font);
+	cairo_font_face_destroy (file_font_face);
+	FcPatternDestroy (resolved);
+	return CAIRO_TEST_FAILURE;
+    }
+    font_glyphs = ft_face->num_glyphs;
+    if (font_glyphs < 2) {
+	cairo_ft_scaled_font_unlock_face (scaled_font);
+	cairo_scaled_font_destroy (scaled_font);
+	cairo_font_face_destroy (file_font_face);
+	FcPatternDestroy (resolved);
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    /* A face supplied by the user.  The second font face only differs
+     * in a flag that is always set for rendering, so that its glyphs
+     * are rendered again, one at a time.
+     */
+    font_face = cairo_ft_font_face_create_for_ft_face (ft_face, 0);
+    serial_font_face =
+	cairo_ft_font_face_create_for_ft_face (ft_face,
+					       FT_LOAD_IGNORE_GLOBAL_ADVANCE_WIDTH);
+    threaded = draw_glyphs (font_face, font_glyphs, 4);
+    serial = draw_glyphs (serial_font_face, font_glyphs, 1);
+    result = compare (ctx, threaded, serial, "FT_Face");
+    cairo_surface_destroy (serial);
+    cairo_surface_destroy (threaded);
+    cairo_font_face_destroy (serial_font_face);
+    cairo_font_face_destroy (font_face);
+
+    cairo_ft_scaled_font_unlock_face (scaled_font);
+    cairo_scaled_font_destroy (scaled_font);
+    cairo_font_face_destroy (file_font_face);
+
+    /* A font loaded from its file; the glyphs cached by the threaded
+     * run are discarded before drawing them again.
+     */
+    cairo_debug_reset_static_data ();
+    font_face = cairo_ft_font_face_create_for_pattern (resolved);
+    threaded = draw_glyphs (font_face, font_glyphs, 4);
+    cairo_font_face_destroy (font_face);
+
+    cairo_debug_reset_static_data ();
+    font_face = cairo_ft_font_face_create_for_pattern (resolved);
+    serial = draw_glyphs (font_face, font_glyphs, 1);
+    cairo_font_face_destroy (font_face);
+
+    status = compare (ctx, threaded, serial, "file");
+    if (status != CAIRO_TEST_SUCCESS)
+	result = status;
+    cairo_surface_destroy (serial);
+    cairo_surface_destroy (threaded);
+
+    FcPatternDestroy (resolved);
+
+    return result;
+}
+
+CAIRO_TEST (ft_glyph_threads,
+	    "Check that glyphs rasterised by several threads match serial rendering",
+	    "ft, font, text", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
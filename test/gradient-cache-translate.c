@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Drawing a gradient again, moved by whole pixels along with what it is
+ * drawn upon, reuses the pixman image created for it the first time.
+ * Check that the result is identical to drawing a gradient that has
+ * never been seen before, whether or not a cached image was found.
+ */
+
+#include "cairo-test.h"
+#include "buffer-diff.h"
+
+#define SIZE 64
+
+static cairo_pattern_t *
+create_gradient (cairo_bool_t radial, cairo_bool_t transformed)
+{
+    cairo_pattern_t *pattern;
+    cairo_matrix_t matrix;
+
+    if (radial)
+	pattern = cairo_pattern_create_radial (12, 14, 2, 20, 18, 24);
+    else
+	pattern = cairo_pattern_create_linear (6, 4, 30, 26);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, 1);
+    cairo_pattern_add_color_stop_rgba (pattern, .4, 0, 1, .5, .75);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, .5);
+    cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
+
+    if (transformed) {
+	cairo_matrix_init_rotate (&matrix, .3);
+	cairo_matrix_scale (&matrix, 1.5, .75);
+	cairo_pattern_set_matrix (pattern, &matrix);
+    }
+
+    return pattern;
+}
+
+static cairo_surface_t *
+draw (cairo_pattern_t *pattern, double x, double y, cairo_bool_t whole)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (surface);
+
+    cairo_translate (cr, x, y);
+    cairo_set_source (cr, pattern);
+    if (whole) {
+	cairo_paint (cr);
+    } else {
+	cairo_rectangle (cr, 4, 2, 40, 30);
+	cairo_fill (cr);
+    }
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const struct {
+	double x, y;
+    } offsets[] = {
+	{ 0, 0 },
+	{ 3, 5 },
+	{ 17, -4 },
+	{ 0.5, 0.25 },
+	{ 7.3, 11.9 },
+	{ -20, 30 },
+    };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *diff;
+    int radial, transformed;
+    unsigned int n;
+
+    diff = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+
+    for (radial = 0; radial <= 1; radial++) {
+	for (transformed = 0; transformed <= 1; transformed++) {
+	    cairo_pattern_t *pattern = create_gradient (radial, transformed);
+
+	    for (n = 0; n < ARRAY_LENGTH (offsets); n++) {
+		cairo_surface_t *cached, *reference;
+		buffer_diff_result_t diff_result;
+		cairo_status_t status;
+
+		cairo_debug_reset_static_data ();
+		reference = draw (pattern, offsets[n].x, offsets[n].y, FALSE);
+
+		/* cache the gradient drawn elsewhere, and over other extents */
+		cairo_debug_reset_static_data ();
+		cairo_surface_destroy (draw (pattern, 0, 0, FALSE));
+		cairo_surface_destroy (draw (pattern, 0, 0, TRUE));
+		cached = draw (pattern, offsets[n].x, offsets[n].y, FALSE);
+
+		status = image_diff (ctx, cached, reference, diff, &diff_result);
+		if (status) {
+		    result = cairo_test_status_from_status (ctx, status);
+		} else if (diff_result.pixels_changed) {
+		    cairo_test_log (ctx,
+				    "%s%s gradient at (%g, %g) differs from an uncached gradient\n",
+				    transformed ? "transformed " : "",
+				    radial ? "radial" : "linear",
+				    offsets[n].x, offsets[n].y);
+		    result = CAIRO_TEST_FAILURE;
+		}
+
+		cairo_surface_destroy (reference);
+		cairo_surface_destroy (cached);
+	    }
+
+	    cairo_pattern_destroy (pattern);
+	}
+    }
+
+    cairo_surface_destroy (diff);
+
+    return result;
+}
+
+CAIRO_TEST (gradient_cache_translate,
+	    "Check that gradients reusing a cached image match uncached gradients",
+	    "gradient, pattern", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,170 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-test.h"
+#include "buffer-diff.h"
+
+/* Check that deferring the drawing upon an image surface and replaying
+ * it gathered by tile matches drawing immediately, exactly. Many of the
+ * small primitives straddle a tile boundary, and the large ones every so
+ * often span several tiles and must keep their place in the order.
+ */
+
+#define SIZE 500
+
+static void
+draw (cairo_t *cr)
+{
+    cairo_surface_t *target = cairo_get_target (cr);
+    cairo_surface_t *copy;
+    cairo_t *cr2;
+    int i;
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    /* lots of small overlapping translucent primitives */
+    for (i = 0; i < 2000; i++) {
+	double x = (i * 37) % (SIZE + 20) - 10;
+	double y = (i * 101) % (SIZE + 20) - 10;
+
+	cairo_set_source_rgba (cr,
+			       (i % 7) / 6.,
+			       (i % 5) / 4.,
+			       (i % 3) / 2.,
+			       .5);
+	if (i % 100 == 0) {
+	    cairo_arc (cr, x, y, 150, 0, 2 * M_PI);
+	    cairo_fill (cr);
+	} else if (i & 1) {
+	    cairo_arc (cr, x, y, 3 + i % 11, 0, 2 * M_PI);
+	    cairo_fill (cr);
+	} else {
+	    cairo_rectangle (cr, x + .5, y + .25, 9.5, 7.75);
+	    cairo_set_line_width (cr, 1 + i % 3);
+	    cairo_stroke (cr);
+	}
+    }
+
+    /* reading back our own pixels forces the pending commands out */
+    cairo_save (cr);
+    cairo_rectangle (cr, SIZE/2, 0, SIZE/2, SIZE/2);
+    cairo_clip (cr);
+    cairo_set_source_surface (cr, target, SIZE/4, 10);
+    cairo_paint_with_alpha (cr, .5);
+    cairo_restore (cr);
+
+    /* as does using the surface as a source elsewhere */
+    copy = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE/4, SIZE/4);
+    cr2 = cairo_create (copy);
+    cairo_set_source_surface (cr2, target, -SIZE/2, -SIZE/2);
+    cairo_paint (cr2);
+    cairo_destroy (cr2);
+
+    cairo_set_line_width (cr, 3);
+    for (i = 0; i < 500; i++) {
+	cairo_move_to (cr, (i * 13) % SIZE, (i * 29) % SIZE);
+	cairo_rel_line_to (cr, 20 - i % 40, 10 - i % 20);
+	cairo_set_source_rgba (cr, 0, 0, (i % 4) / 3., .75);
+	cairo_stroke (cr);
+    }
+
+    cairo_set_source_surface (cr, copy, 10, SIZE - SIZE/4 - 10);
+    cairo_paint (cr);
+    cairo_surface_destroy (copy);
+
+    cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, 24);
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    for (i = 0; i < 20; i++) {
+	cairo_move_to (cr, 5, 20 + i * 24);
+	cairo_show_text (cr, "The quick brown fox jumps");
+    }
+}
+
+static cairo_surface_t *
+render (cairo_bool_t deferred)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_surface_set_device_offset (surface, 3, 5);
+    cairo_image_surface_set_deferred (surface, deferred);
+
+    cr = cairo_create (surface);
+    draw (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (surface);
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *a, *b, *diff;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    buffer_diff_result_t diff_result;
+    cairo_status_t status;
+
+    a = render (FALSE);
+    b = render (TRUE);
+    diff = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+
+    if (! cairo_image_surface_get_deferred (b) ||
+	cairo_image_surface_get_deferred (a))
+    {
+	result = CAIRO_TEST_FAILURE;
+	goto out;
+    }
+
+    status = image_diff (ctx, a, b, diff, &diff_result);
+    if (status) {
+	result = cairo_test_status_from_status (ctx, status);
+	goto out;
+    }
+
+    if (diff_result.pixels_changed || diff_result.max_diff) {
+	cairo_test_log (ctx,
+			"Deferred drawing differs in %u pixels, by up to %u\n",
+			diff_result.pixels_changed, diff_result.max_diff);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+out:
+    cairo_surface_destroy (diff);
+    cairo_surface_destroy (a);
+    cairo_surface_destroy (b);
+    return result;
+}
+
+CAIRO_TEST (image_deferred,
+	    "Check that deferred drawing upon an image matches immediate drawing",
+	    "image", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* With CAIRO_FILTER_FAST, the image backend may evaluate simple
+ * gradients from a table of colours instead of through pixman.  Check
+ * that the result stays close to pixman's, and that RGB24 targets are
+ * left with an opaque alpha byte.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 80
+
+/* The table is interpolated with 8 bits of precision, and pixman
+ * rounds differently again. */
+#define TOLERANCE 4
+
+static cairo_pattern_t *
+create_gradient (int n)
+{
+    cairo_pattern_t *pattern;
+
+    switch (n) {
+    case 0:
+	pattern = cairo_pattern_create_linear (10, 5, 70, 60);
+	cairo_pattern_set_extend (pattern, CAIRO_EXTEND_PAD);
+	break;
+    case 1:
+	pattern = cairo_pattern_create_linear (20, 20, 40, 25);
+	cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
+	break;
+    case 2:
+	pattern = cairo_pattern_create_radial (40, 40, 5, 40, 40, 30);
+	cairo_pattern_set_extend (pattern, CAIRO_EXTEND_REFLECT);
+	break;
+    default:
+	/* the edge of the gradient lies outside the shape */
+	pattern = cairo_pattern_create_radial (35, 45, 0, 35, 45, 50);
+	cairo_pattern_set_extend (pattern, CAIRO_EXTEND_NONE);
+	break;
+    }
+
+    /* The extend modes are chosen to avoid sudden changes in colour,
+     * which a tiny difference in position would turn into a large
+     * difference in colour. */
+
+    cairo_pattern_add_color_stop_rgba (pattern, 0.0, 1, 0, 0, 1);
+    cairo_pattern_add_color_stop_rgba (pattern, 0.4, 0, 1, 0.5, 0.6);
+    cairo_pattern_add_color_stop_rgba (pattern, 1.0, 0, 0, 1, 0.2);
+
+    return pattern;
+}
+
+static cairo_surface_t *
+render (cairo_format_t format, cairo_operator_t op, int n,
+	cairo_filter_t filter)
+{
+    cairo_pattern_t *pattern;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (format, SIZE, SIZE);
+    cr = cairo_create (surface);
+
+    /* OVER is only evaluated directly onto a clear surface, as the
+     * gradient is not opaque. */
+    if (op != CAIRO_OPERATOR_OVER) {
+	cairo_set_source_rgb (cr, 0.2, 0.4, 0.8);
+	cairo_paint (cr);
+    }
+
+    pattern = create_gradient (n);
+    cairo_pattern_set_filter (pattern, filter);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+
+    cairo_set_operator (cr, op);
+    cairo_arc (cr, SIZE / 2, SIZE / 2, SIZE / 2 - 3.3, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (surface);
+    return surface;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_format_t format, cairo_operator_t op, int n)
+{
+    cairo_surface_t *fast, *good;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int x, y, c;
+
+    fast = render (format, op, n, CAIRO_FILTER_FAST);
+    good = render (format, op, n, CAIRO_FILTER_GOOD);
+
+    for (y = 0; y < SIZE && result == CAIRO_TEST_SUCCESS; y++) {
+	const uint32_t *a, *b;
+
+	a = (uint32_t *) (cairo_image_surface_get_data (fast) + y * cairo_image_surface_get_stride (fast));
+	b = (uint32_t *) (cairo_image_surface_get_data (good) + y * cairo_image_surface_get_stride (good));
+	for (x = 0; x < SIZE; x++) {
+	    if (format == CAIRO_FORMAT_RGB24 && a[x] >> 24 != 0xff) {
+		cairo_test_log (ctx,
+				"Gradient %d with operator %d left alpha %02x at (%d, %d)\n",
+				n, op, a[x] >> 24, x, y);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+
+	    for (c = format == CAIRO_FORMAT_RGB24 ? 16 : 24; c >= 0; c -= 8) {
+		int diff = (int) ((a[x] >> c) & 0xff) - (int) ((b[x] >> c) & 0xff);
+		if (diff > TOLERANCE || diff < -TOLERANCE)
+		    break;
+	    }
+	    if (c >= 0) {
+		cairo_test_log (ctx,
+				"Gradient %d with operator %d on format %d differs at (%d, %d): %08x, expected %08x\n",
+				n, op, format, x, y, a[x], b[x]);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+	}
+    }
+
+    cairo_surface_destroy (fast);
+    cairo_surface_destroy (good);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const cairo_format_t formats[] = {
+	CAIRO_FORMAT_ARGB32,
+	CAIRO_FORMAT_RGB24,
+    };
+    const cairo_operator_t ops[] = {
+	CAIRO_OPERATOR_SOURCE,
+	CAIRO_OPERATOR_OVER,
+    };
+    unsigned int i, j;
+    int n;
+
+    for (i = 0; i < ARRAY_LENGTH (formats); i++) {
+	for (j = 0; j < ARRAY_LENGTH (ops); j++) {
+	    for (n = 0; n < 4; n++) {
+		cairo_test_status_t status;
+
+		status = compare (ctx, formats[i], ops[j], n);
+		if (status)
+		    return status;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+CAIRO_TEST (image_gradient_fast,
+	    "Check the fast evaluation of gradients against pixman",
+	    "gradient, image", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
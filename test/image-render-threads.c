@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-test.h"
+
+/* Check that splitting rasterisation into bands across multiple threads
+ * produces exactly the same pixels as a single thread, and that either
+ * way a shape cut by the top of the surface renders the same rows as
+ * the whole shape on a taller surface. */
+
+#define SIZE 1024
+
+static void
+draw (cairo_t *cr, cairo_operator_t op, cairo_antialias_t antialias)
+{
+    cairo_pattern_t *pattern;
+    int i;
+
+    cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
+    cairo_paint (cr);
+
+    pattern = cairo_pattern_create_linear (0, 0, SIZE, SIZE);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, 0.8);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, 0.4);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+
+    cairo_set_operator (cr, op);
+    cairo_set_antialias (cr, antialias);
+
+    /* a self-intersecting star with curved spokes */
+    cairo_move_to (cr, SIZE/2, 3);
+    for (i = 1; i < 37; i++) {
+	double theta = i * 17 * M_PI / 37;
+	cairo_curve_to (cr,
+			SIZE/2, SIZE/2,
+			SIZE/2 + SIZE/3 * sin (theta), SIZE/2,
+			SIZE/2 + (SIZE/2 - 3) * sin (theta),
+			SIZE/2 - (SIZE/2 - 3) * cos (theta));
+    }
+    cairo_close_path (cr);
+    cairo_set_fill_rule (cr, CAIRO_FILL_RULE_EVEN_ODD);
+    cairo_fill_preserve (cr);
+
+    cairo_set_line_width (cr, 7.3);
+    cairo_set_source_rgba (cr, 0, 0.5, 0, 0.7);
+    cairo_stroke (cr);
+}
+
+static cairo_surface_t *
+render (cairo_operator_t op, cairo_antialias_t antialias, int num_threads,
+	int y_offset)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					  SIZE, SIZE - y_offset);
+    cairo_image_surface_set_render_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_translate (cr, 0, -y_offset);
+    draw (cr, op, antialias);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (surface);
+    return surface;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_operator_t op,
+	 cairo_antialias_t antialias,
+	 int num_threads,
+	 int y_offset)
+{
+    cairo_surface_t *a, *b;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int y;
+
+    a = render (op, antialias, 1, 0);
+    b = render (op, antialias, num_threads, y_offset);
+
+    if (cairo_surface_status (a) || cairo_surface_status (b)) {
+	result = cairo_test_status_from_status (ctx,
+						cairo_surface_status (a) ?
+						cairo_surface_status (a) :
+						cairo_surface_status (b));
+	goto out;
+    }
+
+    for (y = y_offset; y < SIZE; y++) {
+	const unsigned char *ra, *rb;
+
+	ra = cairo_image_surface_get_data (a) + y * cairo_image_surface_get_stride (a);
+	rb = cairo_image_surface_get_data (b) + (y - y_offset) * cairo_image_surface_get_stride (b);
+	if (memcmp (ra, rb, 4 * SIZE)) {
+	    cairo_test_log (ctx,
+			    "Row %d differs using %d threads with operator %d, antialias %d, offset %d\n",
+			    y, num_threads, op, antialias, y_offset);
+	    result = CAIRO_TEST_FAILURE;
+	    break;
+	}
+    }
+
+out:
+    cairo_surface_destroy (a);
+    cairo_surface_destroy (b);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const cairo_operator_t ops[] = {
+	CAIRO_OPERATOR_OVER,
+	CAIRO_OPERATOR_SOURCE,
+	CAIRO_OPERATOR_IN,
+	CAIRO_OPERATOR_CLEAR,
+    };
+    const cairo_antialias_t antialias[] = {
+	CAIRO_ANTIALIAS_DEFAULT,
+	CAIRO_ANTIALIAS_BEST,
+	CAIRO_ANTIALIAS_NONE,
+    };
+    /* the shape is cut through its middle, and just below its top */
+    const int y_offsets[] = { 0, SIZE / 3, 5 };
+    cairo_surface_t *surface;
+    unsigned int i, j, k;
+    int num_threads;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 1, 1);
+    if (cairo_image_surface_get_render_threads (surface) != 1) {
+	cairo_surface_destroy (surface);
+	return CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (surface);
+
+    for (num_threads = 0; num_threads <= 7; num_threads += 7) {
+	for (i = 0; i < ARRAY_LENGTH (ops); i++) {
+	    for (j = 0; j < ARRAY_LENGTH (antialias); j++) {
+		for (k = 0; k < ARRAY_LENGTH (y_offsets); k++) {
+		    cairo_test_status_t status;
+
+		    status = compare (ctx, ops[i], antialias[j],
+				      num_threads, y_offsets[k]);
+		    if (status)
+			return status;
+		}
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+CAIRO_TEST (image_render_threads,
+	    "Check that multithreaded rasterisation matches a single thread",
+	    "image, threads", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-test.h"
+
+/* Check that tessellating a very large polygon into trapezoids in
+ * slabs across multiple threads covers exactly the same pixels as a
+ * single sweep.  An unbounded operator under a curved clip is beyond
+ * the span compositor, so the fill is tessellated into trapezoids.
+ */
+
+#define SIZE 256
+#define CELL 2
+
+static void
+draw (cairo_t *cr, cairo_antialias_t antialias, cairo_fill_rule_t fill_rule)
+{
+    int x, y;
+
+    cairo_set_source_rgb (cr, 0.5, 0.5, 0.5);
+    cairo_paint (cr);
+
+    cairo_arc (cr, SIZE/2, SIZE/2, SIZE/2 - 10, 0, 2 * M_PI);
+    cairo_clip (cr);
+
+    /* thousands of small triangles, some overlapping their neighbours */
+    for (y = 0; y < SIZE; y += CELL) {
+	for (x = 0; x < SIZE; x += CELL) {
+	    cairo_move_to (cr, x + 0.3, y + 0.1);
+	    cairo_line_to (cr, x + CELL + 0.7, y + 0.9);
+	    cairo_line_to (cr, x + 0.6 * ((x + y) % 7), y + CELL + 0.4);
+	    cairo_close_path (cr);
+	}
+    }
+
+    cairo_set_source_rgba (cr, 1, 0, 0, 0.8);
+    cairo_set_operator (cr, CAIRO_OPERATOR_IN);
+    cairo_set_antialias (cr, antialias);
+    cairo_set_fill_rule (cr, fill_rule);
+    cairo_fill (cr);
+}
+
+static cairo_surface_t *
+render (cairo_antialias_t antialias, cairo_fill_rule_t fill_rule,
+	int num_threads)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_render_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    draw (cr, antialias, fill_rule);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (surface);
+    return surface;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_antialias_t antialias,
+	 cairo_fill_rule_t fill_rule,
+	 int num_threads)
+{
+    cairo_surface_t *a, *b;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int y;
+
+    a = render (antialias, fill_rule, 1);
+    b = render (antialias, fill_rule, num_threads);
+
+    if (cairo_surface_status (a) || cairo_surface_status (b)) {
+	result = cairo_test_status_from_status (ctx,
+						cairo_surface_status (a) ?
+						cairo_surface_status (a) :
+						cairo_surface_status (b));
+	goto out;
+    }
+
+    for (y = 0; y < SIZE; y++) {
+	const unsigned char *ra, *rb;
+
+	ra = cairo_image_surface_get_data (a) + y * cairo_image_surface_get_stride (a);
+	rb = cairo_image_surface_get_data (b) + y * cairo_image_surface_get_stride (b);
+	if (memcmp (ra, rb, 4 * SIZE)) {
+	    cairo_test_log (ctx,
+			    "Row %d differs using %d threads with antialias %d, fill rule %d\n",
+			    y, num_threads, antialias, fill_rule);
+	    result = CAIRO_TEST_FAILURE;
+	    break;
+	}
+    }
+
+out:
+    cairo_surface_destroy (a);
+    cairo_surface_destroy (b);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const cairo_antialias_t antialias[] = {
+	CAIRO_ANTIALIAS_DEFAULT,
+	CAIRO_ANTIALIAS_NONE,
+    };
+    const cairo_fill_rule_t fill_rules[] = {
+	CAIRO_FILL_RULE_WINDING,
+	CAIRO_FILL_RULE_EVEN_ODD,
+    };
+    const int num_threads[] = { 2, 4, 16 };
+    unsigned int i, j, k;
+
+    for (i = 0; i < ARRAY_LENGTH (antialias); i++) {
+	for (j = 0; j < ARRAY_LENGTH (fill_rules); j++) {
+	    for (k = 0; k < ARRAY_LENGTH (num_threads); k++) {
+		cairo_test_status_t status;
+
+		status = compare (ctx, antialias[i], fill_rules[j],
+				  num_threads[k]);
+		if (status)
+		    return status;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+CAIRO_TEST (image_tessellate_threads,
+	    "Check that tessellating a large polygon in slabs matches a single sweep",
+	    "image, threads", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,133 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Stroking the same path again reuses the outline generated for it
+ * the first time.  Check that the result is identical to the first,
+ * uncached, stroke for a variety of stroke styles and clips.  A clip
+ * containing the whole path still cuts its outline, whereas the
+ * stroker skips the parts of a path lying well outside a smaller one.
+ */
+
+#include "cairo-test.h"
+#include "buffer-diff.h"
+
+#define SIZE 64
+
+enum {
+    NO_CLIP,
+    CLIP_OUTLINE,
+    CLIP_PATH,
+    NUM_CLIPS
+};
+
+static cairo_surface_t *
+stroke (cairo_line_join_t join, cairo_bool_t dashed, int clip)
+{
+    static const double dash[] = { 5, 3, 1, 3 };
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (surface);
+
+    if (clip == CLIP_OUTLINE) {
+	cairo_rectangle (cr, 4, 4, 56, 56);
+	cairo_clip (cr);
+    } else if (clip == CLIP_PATH) {
+	cairo_rectangle (cr, 8, 8, 20, 28);
+	cairo_clip (cr);
+    }
+
+    cairo_move_to (cr, 6, 40);
+    cairo_curve_to (cr, 10, 4, 40, 8, 28, 22);
+    cairo_line_to (cr, 58, 30);
+    cairo_line_to (cr, 20, 58);
+    cairo_rel_line_to (cr, 1, -30);
+
+    cairo_set_line_width (cr, 5);
+    cairo_set_line_join (cr, join);
+    cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+    if (dashed)
+	cairo_set_dash (cr, dash, ARRAY_LENGTH (dash), 2);
+
+    cairo_stroke (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *diff;
+    cairo_line_join_t join;
+    int dashed, clip, n;
+
+    diff = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+
+    for (join = CAIRO_LINE_JOIN_MITER; join <= CAIRO_LINE_JOIN_BEVEL; join++) {
+	for (dashed = 0; dashed <= 1; dashed++) {
+	    for (clip = NO_CLIP; clip < NUM_CLIPS; clip++) {
+		cairo_surface_t *first, *again;
+
+		/* forget the outlines of the previous cases */
+		cairo_debug_reset_static_data ();
+
+		first = stroke (join, dashed, clip);
+		for (n = 0; n < 2; n++) {
+		    buffer_diff_result_t diff_result;
+		    cairo_status_t status;
+
+		    again = stroke (join, dashed, clip);
+		    status = image_diff (ctx, first, again, diff, &diff_result);
+		    if (status) {
+			result = cairo_test_status_from_status (ctx, status);
+		    } else if (diff_result.pixels_changed) {
+			cairo_test_log (ctx,
+					"stroke %d with join %d%s, clip %d differs from the first\n",
+					n + 2, join,
+					dashed ? ", dashed" : "",
+					clip);
+			result = CAIRO_TEST_FAILURE;
+		    }
+		    cairo_surface_destroy (again);
+		}
+		cairo_surface_destroy (first);
+	    }
+	}
+    }
+
+    cairo_surface_destroy (diff);
+
+    return result;
+}
+
+CAIRO_TEST (path_cache_stroke,
+	    "Check that strokes reusing a cached outline match uncached strokes",
+	    "stroke, path", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
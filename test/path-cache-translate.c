@@ -0,0 +1,134 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/* Filling the same shape again at a different position reuses the
+ * polygon generated for it the first time.  Check that the result is
+ * identical to filling a shape that has never been seen before.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 64
+
+static void
+shape (cairo_t *cr, double x, double y)
+{
+    cairo_move_to (cr, x + 4, y + 20);
+    cairo_curve_to (cr, x + 10, y - 6, x + 40, y + 2, x + 28, y + 18);
+    cairo_curve_to (cr, x + 20, y + 30, x + 44, y + 40, x + 30, y + 36);
+    cairo_curve_to (cr, x + 10, y + 30, x + 2, y + 44, x + 4, y + 20);
+    cairo_close_path (cr);
+}
+
+static cairo_surface_t *
+fill (double x, double y, cairo_bool_t clip)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, SIZE, SIZE);
+    cr = cairo_create (surface);
+
+    if (clip) {
+	cairo_rectangle (cr, 8, 8, 20, 28);
+	cairo_clip (cr);
+    }
+
+    shape (cr, x, y);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_bool_t
+surfaces_equal (cairo_surface_t *a, cairo_surface_t *b)
+{
+    unsigned char *da = cairo_image_surface_get_data (a);
+    unsigned char *db = cairo_image_surface_get_data (b);
+    int stride = cairo_image_surface_get_stride (a);
+    int y;
+
+    for (y = 0; y < SIZE; y++) {
+	if (memcmp (da + y * stride, db + y * stride, SIZE))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const struct {
+	double x, y;
+    } offsets[] = {
+	{ 0, 0 },
+	{ 3, 5 },
+	{ 17, -4 },
+	{ 0.5, 0.25 },
+	{ 7.3, 11.9 },
+	{ -20, 30 },
+    };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int clip, n;
+
+    for (clip = 0; clip <= 1; clip++) {
+	for (n = 0; n < ARRAY_LENGTH (offsets); n++) {
+	    cairo_surface_t *cached, *reference;
+
+	    /* A path is only cached once it has been seen before, so
+	     * the first fill after a reset is rendered from scratch. */
+	    cairo_debug_reset_static_data ();
+	    reference = fill (offsets[n].x, offsets[n].y, clip);
+
+	    /* draw the shape often enough for it to be cached */
+	    cairo_surface_destroy (fill (0, 0, FALSE));
+	    cairo_surface_destroy (fill (0, 0, FALSE));
+
+	    cached = fill (offsets[n].x, offsets[n].y, clip);
+
+	    if (! surfaces_equal (cached, reference)) {
+		cairo_test_log (ctx,
+				"fill at (%g, %g)%s differs from an uncached fill\n",
+				offsets[n].x, offsets[n].y,
+				clip ? " with a clip" : "");
+		result = CAIRO_TEST_FAILURE;
+	    }
+
+	    cairo_surface_destroy (reference);
+	    cairo_surface_destroy (cached);
+	}
+    }
+
+    return result;
+}
+
+CAIRO_TEST (path_cache_translate,
+	    "Check that fills reusing a cached polygon match uncached fills",
+	    "fill, path", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,168 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+#include <cairo-pdf.h>
+
+#include "cairo-test.h"
+
+/* Check that compressing streams with several threads writes exactly
+ * the same document as compressing them inline.
+ */
+
+#define NUM_PAGES 4
+#define IMAGE_SIZE 256
+
+struct buffer {
+    unsigned char *data;
+    unsigned long length;
+    unsigned long size;
+};
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    struct buffer *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	unsigned long size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_WRITE_ERROR;
+
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+create_image (int seed)
+{
+    cairo_surface_t *image;
+    unsigned char *data;
+    int stride, x, y;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					IMAGE_SIZE, IMAGE_SIZE);
+    data = cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image);
+    for (y = 0; y < IMAGE_SIZE; y++) {
+	uint32_t *row = (uint32_t *) (data + y * stride);
+	for (x = 0; x < IMAGE_SIZE; x++) {
+	    uint32_t a = (x + seed) & 0xff;
+	    uint32_t v = ((x ^ y) * seed) & 0xff;
+	    v = v * a / 255;
+	    row[x] = a << 24 | v << 16 | (v >> 1) << 8 | (v >> 2);
+	}
+    }
+    cairo_surface_mark_dirty (image);
+
+    return image;
+}
+
+static cairo_status_t
+draw_document (int num_threads, struct buffer *buffer)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page;
+
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, buffer,
+						   IMAGE_SIZE, IMAGE_SIZE);
+    cairo_pdf_surface_set_compression_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    for (page = 0; page < NUM_PAGES; page++) {
+	cairo_surface_t *image;
+
+	image = create_image (page + 1);
+	cairo_set_source_surface (cr, image, 0, 0);
+	cairo_paint (cr);
+	cairo_surface_destroy (image);
+
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	cairo_move_to (cr, 10, 20);
+	cairo_show_text (cr, "cairo");
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    struct buffer serial = { NULL, 0, 0 };
+    struct buffer threaded = { NULL, 0, 0 };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_status_t status;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    status = draw_document (1, &serial);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = draw_document (4, &threaded);
+    if (status) {
+	cairo_test_log (ctx, "Failed to create pdf document: %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+    } else if (serial.length != threaded.length ||
+	       memcmp (serial.data, threaded.data, serial.length))
+    {
+	cairo_test_log (ctx, "Documents differ: %lu bytes serially, %lu bytes threaded\n",
+			serial.length, threaded.length);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    free (serial.data);
+    free (threaded.data);
+
+    return result;
+}
+
+CAIRO_TEST (pdf_compression_threads,
+	    "Check that threaded stream compression does not change the output",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,219 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+#include <cairo-pdf.h>
+
+#include "cairo-test.h"
+
+/* Check that rendering the image fallbacks of a page with several
+ * threads writes exactly the same document as rendering them in turn.
+ * Each page has several separate regions that need a fallback, drawn
+ * with shapes, glyphs from both a normal and a user font, and an image
+ * whose drawing was deferred.
+ */
+
+#define NUM_PAGES 3
+#define SIZE 256
+
+struct buffer {
+    unsigned char *data;
+    unsigned long length;
+    unsigned long size;
+};
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    struct buffer *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	unsigned long size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_WRITE_ERROR;
+
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+render_box_glyph (cairo_scaled_font_t *scaled_font,
+		  unsigned long glyph,
+		  cairo_t *cr,
+		  cairo_text_extents_t *extents)
+{
+    cairo_rectangle (cr, 0.1, -0.1 * (glyph % 8) - 0.2, 0.6, 0.3);
+    cairo_fill (cr);
+
+    extents->x_advance = 0.8;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+create_deferred_image (int seed)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+    int i;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 64, 64);
+    cairo_image_surface_set_deferred (image, TRUE);
+
+    cr = cairo_create (image);
+    for (i = 0; i < 64; i++) {
+	cairo_set_source_rgba (cr,
+			       (i * seed % 7) / 6.,
+			       (i % 5) / 4.,
+			       (i * 3 % 11) / 10.,
+			       .75);
+	cairo_arc (cr, (i * 13 + seed) % 64, (i * 29) % 64, 3 + i % 5, 0, 2 * M_PI);
+	cairo_fill (cr);
+    }
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static cairo_status_t
+draw_document (int num_threads, struct buffer *buffer)
+{
+    cairo_font_face_t *user_font;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page;
+
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, buffer,
+						   SIZE, SIZE);
+    cairo_surface_set_fallback_threads (surface, num_threads);
+
+    user_font = cairo_user_font_face_create ();
+    cairo_user_font_face_set_render_glyph_func (user_font, render_box_glyph);
+
+    cr = cairo_create (surface);
+    for (page = 0; page < NUM_PAGES; page++) {
+	cairo_surface_t *image;
+
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	cairo_paint (cr);
+
+	/* XOR is not supported natively, so each region falls back */
+	cairo_set_operator (cr, CAIRO_OPERATOR_XOR);
+
+	cairo_set_source_rgba (cr, 1, 0, 0, .5);
+	cairo_arc (cr, 40, 40, 30 + page, 0, 2 * M_PI);
+	cairo_fill (cr);
+
+	image = create_deferred_image (page + 1);
+	cairo_set_source_surface (cr, image, 160, 16);
+	cairo_paint (cr);
+	cairo_surface_destroy (image);
+
+	cairo_set_source_rgba (cr, 0, 0, 1, .75);
+	cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+				CAIRO_FONT_SLANT_NORMAL,
+				CAIRO_FONT_WEIGHT_NORMAL);
+	cairo_set_font_size (cr, 24);
+	cairo_move_to (cr, 16, 160);
+	cairo_show_text (cr, "fallback");
+
+	cairo_set_font_face (cr, user_font);
+	cairo_set_font_size (cr, 16);
+	cairo_move_to (cr, 140, 230);
+	cairo_show_text (cr, "threads");
+
+	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+    cairo_font_face_destroy (user_font);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    struct buffer serial = { NULL, 0, 0 };
+    struct buffer threaded = { NULL, 0, 0 };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    /* fallbacks are only rendered concurrently on request */
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, &serial,
+						   SIZE, SIZE);
+    if (cairo_surface_get_fallback_threads (surface) != 1) {
+	cairo_test_log (ctx, "Expected a single fallback thread by default, found %d\n",
+			cairo_surface_get_fallback_threads (surface));
+	result = CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (surface);
+    serial.length = 0;
+
+    status = draw_document (1, &serial);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = draw_document (4, &threaded);
+    if (status) {
+	cairo_test_log (ctx, "Failed to create pdf document: %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+    } else if (serial.length != threaded.length ||
+	       memcmp (serial.data, threaded.data, serial.length))
+    {
+	cairo_test_log (ctx, "Documents differ: %lu bytes serially, %lu bytes threaded\n",
+			serial.length, threaded.length);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    free (serial.data);
+    free (threaded.data);
+
+    return result;
+}
+
+CAIRO_TEST (pdf_fallback_threads,
+	    "Check that threaded fallback rendering does not change the output",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,196 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cairo.h>
+#include <cairo-pdf.h>
+
+#include "cairo-test.h"
+
+/* Check that object streams and a cross-reference stream are only
+ * written when requested and allowed by the PDF version, and that
+ * startxref then points at the cross-reference stream.
+ */
+
+#define NUM_PAGES 150
+#define SIZE 100
+
+static cairo_status_t
+draw_document (cairo_pdf_version_t version, const char *filename)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page;
+
+    surface = cairo_pdf_surface_create (filename, SIZE, SIZE);
+    cairo_pdf_surface_restrict_to_version (surface, version);
+    cairo_pdf_surface_set_object_streams (surface, TRUE);
+
+    cr = cairo_create (surface);
+    for (page = 0; page < NUM_PAGES; page++) {
+	cairo_set_source_rgba (cr, 0, 0, 1, .5);
+	cairo_rectangle (cr, 10, 10, page % 80, 50);
+	cairo_fill (cr);
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static char *
+read_document (const char *filename, long *length)
+{
+    FILE *file;
+    char *data;
+
+    file = fopen (filename, "rb");
+    if (file == NULL)
+	return NULL;
+
+    fseek (file, 0, SEEK_END);
+    *length = ftell (file);
+    fseek (file, 0, SEEK_SET);
+
+    data = malloc (*length);
+    if (data != NULL && fread (data, *length, 1, file) != 1) {
+	free (data);
+	data = NULL;
+    }
+    fclose (file);
+
+    return data;
+}
+
+/* The document holds deflated streams, so it cannot be searched as a
+ * nul-terminated string.
+ */
+static const char *
+find (const char *data, long length, const char *needle)
+{
+    long n = strlen (needle);
+    const char *end = data + length - n;
+
+    for (; data <= end; data++) {
+	data = memchr (data, needle[0], end - data + 1);
+	if (data == NULL)
+	    return NULL;
+	if (memcmp (data, needle, n) == 0)
+	    return data;
+    }
+
+    return NULL;
+}
+
+static cairo_bool_t
+check_xref_stream (cairo_test_context_t *ctx, const char *data, long length)
+{
+    const char *xref = "\n<< /Type /XRef\n";
+    const char *startxref, *obj;
+    long offset;
+
+    if (find (data, length, "/Type /ObjStm") == NULL) {
+	cairo_test_log (ctx, "No object stream was written\n");
+	return FALSE;
+    }
+    if (find (data, length, "\ntrailer\n") != NULL) {
+	cairo_test_log (ctx, "A trailer was written with a cross-reference stream\n");
+	return FALSE;
+    }
+
+    startxref = find (data, length, "startxref\n");
+    if (startxref == NULL) {
+	cairo_test_log (ctx, "No startxref was written\n");
+	return FALSE;
+    }
+    offset = strtol (startxref + strlen ("startxref\n"), NULL, 10);
+    obj = offset > 0 && offset < length ?
+	  memchr (data + offset, '\n', length - offset) : NULL;
+    if (obj == NULL ||
+	find (obj, length - (obj - data), xref) != obj)
+    {
+	cairo_test_log (ctx, "startxref does not point at the cross-reference stream\n");
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    const char *v15_filename = "pdf-object-streams-1.5.out.pdf";
+    const char *v14_filename = "pdf-object-streams-1.4.out.pdf";
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_status_t status;
+    char *v15 = NULL, *v14 = NULL;
+    long v15_length, v14_length;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    status = draw_document (CAIRO_PDF_VERSION_1_5, v15_filename);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = draw_document (CAIRO_PDF_VERSION_1_4, v14_filename);
+    if (status) {
+	cairo_test_log (ctx, "Failed to create pdf document: %s\n",
+			cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    v15 = read_document (v15_filename, &v15_length);
+    v14 = read_document (v14_filename, &v14_length);
+    if (v15 == NULL || v14 == NULL) {
+	cairo_test_log (ctx, "Failed to read back the pdf documents\n");
+	result = CAIRO_TEST_FAILURE;
+    } else if (! check_xref_stream (ctx, v15, v15_length)) {
+	result = CAIRO_TEST_FAILURE;
+    } else if (find (v14, v14_length, "/Type /ObjStm") != NULL ||
+	       find (v14, v14_length, "\ntrailer\n") == NULL)
+    {
+	cairo_test_log (ctx, "Object streams were used in a PDF 1.4 document\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    free (v15);
+    free (v14);
+
+    return result;
+}
+
+CAIRO_TEST (pdf_object_streams,
+	    "Check the use of PDF 1.5 object streams and cross-reference streams",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
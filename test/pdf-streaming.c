@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <cairo.h>
+#include <cairo-pdf.h>
+
+#include "cairo-test.h"
+
+/* Check that streaming mode writes each page out as it is shown,
+ * so that the memory held by the surface does not grow with the
+ * number of pages.
+ */
+
+#define NUM_PAGES 16
+#define IMAGE_SIZE 256
+
+static cairo_status_t
+write_nothing (void *closure, const unsigned char *data, unsigned int length)
+{
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+create_image (int seed)
+{
+    cairo_surface_t *image;
+    unsigned char *data;
+    int stride, x, y;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					IMAGE_SIZE, IMAGE_SIZE);
+    data = cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image);
+    for (y = 0; y < IMAGE_SIZE; y++) {
+	uint32_t *row = (uint32_t *) (data + y * stride);
+	for (x = 0; x < IMAGE_SIZE; x++)
+	    row[x] = (x * seed) << 16 | (y * seed) << 8 | ((x ^ y) & 0xff);
+    }
+    cairo_surface_mark_dirty (image);
+
+    return image;
+}
+
+static cairo_status_t
+draw_document (cairo_bool_t streaming, unsigned long *peak_memory)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+    int page;
+
+    surface = cairo_pdf_surface_create_for_stream (write_nothing, NULL,
+						   IMAGE_SIZE, IMAGE_SIZE);
+    /* queue the compressed streams, so there is something to buffer */
+    cairo_pdf_surface_set_compression_threads (surface, 2);
+    cairo_pdf_surface_set_streaming (surface, streaming);
+
+    cr = cairo_create (surface);
+    cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    for (page = 0; page < NUM_PAGES; page++) {
+	cairo_surface_t *image;
+
+	image = create_image (page + 1);
+	cairo_set_source_surface (cr, image, 0, 0);
+	cairo_paint (cr);
+	cairo_surface_destroy (image);
+
+	cairo_set_source_rgb (cr, 0, 0, 0);
+	cairo_move_to (cr, 10, 20);
+	cairo_show_text (cr, "cairo");
+	cairo_show_page (cr);
+    }
+    status = cairo_status (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_surface_status (surface);
+    *peak_memory = cairo_pdf_surface_get_peak_memory (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    unsigned long buffered, streamed;
+    cairo_status_t status;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    status = draw_document (FALSE, &buffered);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = draw_document (TRUE, &streamed);
+    if (status) {
+	cairo_test_log (ctx, "Failed to create pdf document: %s\n",
+			cairo_status_to_string (status));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    cairo_test_log (ctx, "Peak memory: %lu bytes buffered, %lu bytes streamed\n",
+		    buffered, streamed);
+    if (streamed == 0 || streamed >= buffered) {
+	cairo_test_log (ctx, "Streaming did not reduce the peak memory\n");
+	return CAIRO_TEST_FAILURE;
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+CAIRO_TEST (pdf_streaming,
+	    "Check that streaming mode bounds the memory held by a PDF surface",
+	    "pdf", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
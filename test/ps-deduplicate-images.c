@@ -0,0 +1,88 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-test.h"
+#include <cairo-ps.h>
+
+#include "deduplicate-images.c"
+
+static cairo_surface_t *
+create_document_surface (const char *filename, int width, int height)
+{
+    return cairo_ps_surface_create (filename, width, height);
+}
+
+static void
+set_deduplicate_images (cairo_surface_t *surface, cairo_bool_t deduplicate)
+{
+    cairo_ps_surface_set_deduplicate_images (surface, deduplicate);
+}
+
+/* Image data is either written inline after the image operator, or
+ * defined once as /CairoImageDataN in the document setup, where it
+ * survives the save/restore around each page.
+ */
+static int
+count_images (const char *data, long length)
+{
+    const char *setup, *end_setup, *p;
+    int n;
+
+    n = count (data, length, "/DataSource currentfile");
+
+    setup = find (data, length, "%%BeginSetup\n");
+    if (setup == NULL)
+	return n;
+
+    end_setup = find (setup, length - (setup - data), "%%EndSetup\n");
+    if (end_setup == NULL)
+	return n;
+
+    p = setup;
+    while ((p = find (p, end_setup - p, "\n/CairoImageData")) != NULL) {
+	p += strlen ("\n/CairoImageData");
+	if (*p >= '0' && *p <= '9')
+	    n++;
+    }
+
+    return n;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    if (! cairo_test_is_target_enabled (ctx, "ps"))
+	return CAIRO_TEST_UNTESTED;
+
+    return check_deduplicate_images (ctx,
+				     "ps-deduplicate-images.out.ps",
+				     "ps-deduplicate-images-dedup.out.ps");
+}
+
+CAIRO_TEST (ps_deduplicate_images,
+	    "Check that identical images are only written once when requested",
+	    "ps", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
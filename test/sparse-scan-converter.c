@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* The sparse scan converter, selected by CAIRO_SCAN_CONVERTER=sparse,
+ * must compute exactly the same coverage as tor.  Render a variety of
+ * polygons with each converter, serially and in parallel bands, and
+ * clipped so that edges begin above the first row, and check that the
+ * results are identical.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cairo-test.h"
+#include "buffer-diff.h"
+
+/* large enough to be split into bands when using several threads */
+#define SIZE 576
+
+enum {
+    STAR,
+    CIRCLES,
+    STRIPES,
+    TOP_CLIPPED,
+    NUM_SHAPES
+};
+
+static char tor_env[] = "CAIRO_SCAN_CONVERTER=tor";
+static char sparse_env[] = "CAIRO_SCAN_CONVERTER=sparse";
+
+static void
+use_converter (char *env)
+{
+    putenv (env);
+    /* the converter is chosen once, so forget the previous choice */
+    cairo_debug_reset_static_data ();
+}
+
+static double
+uniform_random (unsigned int *state, double minval, double maxval)
+{
+    *state = *state * 1103515245 + 12345;
+    return minval + (maxval - minval) * ((*state >> 8) & 0xffff) / 65535.;
+}
+
+static void
+shape (cairo_t *cr, int which)
+{
+    unsigned int state = 0x12345678;
+    int i;
+
+    switch (which) {
+    case STAR:
+	/* long self-intersecting edges crossing every row */
+	cairo_move_to (cr, SIZE / 2, SIZE / 2);
+	for (i = 0; i < 200; i++) {
+	    cairo_line_to (cr,
+			   uniform_random (&state, -10, SIZE + 10),
+			   uniform_random (&state, -10, SIZE + 10));
+	}
+	cairo_close_path (cr);
+	break;
+
+    case CIRCLES:
+	/* many short curved edges, with partially covered cells */
+	for (i = 0; i < 300; i++) {
+	    double x = uniform_random (&state, 0, SIZE);
+	    double y = uniform_random (&state, 0, SIZE);
+	    double r = uniform_random (&state, 0.3, 24);
+
+	    cairo_new_sub_path (cr);
+	    cairo_arc (cr, x, y, r, 0, 2 * M_PI);
+	}
+	break;
+
+    case STRIPES:
+	/* thin slanted stripes crowding each row with active edges */
+	for (i = 0; i < 250; i++) {
+	    double x = i * (SIZE + 100.) / 250 - 50;
+
+	    cairo_move_to (cr, x, 0);
+	    cairo_line_to (cr, x + 50.3, SIZE);
+	    cairo_line_to (cr, x + 51.1, SIZE);
+	    cairo_line_to (cr, x + 0.7, 0);
+	    cairo_close_path (cr);
+	}
+	break;
+
+    case TOP_CLIPPED:
+	/* edges beginning above the clip, some ending on its first row */
+	cairo_rectangle (cr, 0, SIZE / 3, SIZE, SIZE - SIZE / 3);
+	cairo_clip (cr);
+	for (i = 0; i < 200; i++) {
+	    double x = uniform_random (&state, -10, SIZE + 10);
+	    double y = uniform_random (&state, SIZE / 3 - 20, SIZE / 3 + 1);
+
+	    cairo_move_to (cr, x, 0);
+	    cairo_line_to (cr, uniform_random (&state, -10, SIZE + 10), y);
+	    cairo_line_to (cr, uniform_random (&state, -10, SIZE + 10), SIZE);
+	    cairo_close_path (cr);
+	}
+	break;
+    }
+}
+
+static cairo_surface_t *
+draw (int which,
+      cairo_fill_rule_t fill_rule,
+      cairo_antialias_t antialias,
+      int num_threads)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cairo_image_surface_set_render_threads (surface, num_threads);
+
+    cr = cairo_create (surface);
+    cairo_set_source_rgba (cr, 0.2, 0.4, 0.8, 0.9);
+    cairo_set_fill_rule (cr, fill_rule);
+    cairo_set_antialias (cr, antialias);
+    shape (cr, which);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const cairo_antialias_t antialias[] = {
+	CAIRO_ANTIALIAS_DEFAULT,
+	CAIRO_ANTIALIAS_GOOD,
+	CAIRO_ANTIALIAS_BEST,
+    };
+    static const int threads[] = { 1, 4 };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    const char *env = getenv ("CAIRO_SCAN_CONVERTER");
+    cairo_bool_t was_sparse = env && strcmp (env, "sparse") == 0;
+    cairo_surface_t *diff;
+    cairo_fill_rule_t fill_rule;
+    unsigned int a, t;
+    int which;
+
+    diff = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+
+    for (which = STAR; which < NUM_SHAPES; which++) {
+	for (fill_rule = CAIRO_FILL_RULE_WINDING;
+	     fill_rule <= CAIRO_FILL_RULE_EVEN_ODD;
+	     fill_rule++)
+	{
+	    for (a = 0; a < ARRAY_LENGTH (antialias); a++) {
+		for (t = 0; t < ARRAY_LENGTH (threads); t++) {
+		    cairo_surface_t *tor, *sparse;
+		    buffer_diff_result_t diff_result;
+		    cairo_status_t status;
+
+		    use_converter (tor_env);
+		    tor = draw (which, fill_rule, antialias[a], threads[t]);
+
+		    use_converter (sparse_env);
+		    sparse = draw (which, fill_rule, antialias[a], threads[t]);
+
+		    status = image_diff (ctx, tor, sparse, diff, &diff_result);
+		    if (status) {
+			result = cairo_test_status_from_status (ctx, status);
+		    } else if (diff_result.pixels_changed) {
+			cairo_test_log (ctx,
+					"shape %d, fill rule %d, antialias %d, %d threads: "
+					"%u pixels differ from tor\n",
+					which, fill_rule, antialias[a], threads[t],
+					diff_result.pixels_changed);
+			result = CAIRO_TEST_FAILURE;
+		    }
+
+		    cairo_surface_destroy (sparse);
+		    cairo_surface_destroy (tor);
+		}
+	    }
+	}
+    }
+
+    cairo_surface_destroy (diff);
+
+    use_converter (was_sparse ? sparse_env : tor_env);
+
+    return result;
+}
+
+CAIRO_TEST (sparse_scan_converter,
+	    "Check that the sparse scan converter matches tor",
+	    "fill", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,64 @@
+/*
+ * Copyright © 2013 the cairo graphics library contributors
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy,
+ * modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "cairo-test.h"
+#include <cairo-svg.h>
+
+#include "deduplicate-images.c"
+
+static cairo_surface_t *
+create_document_surface (const char *filename, int width, int height)
+{
+    return cairo_svg_surface_create (filename, width, height);
+}
+
+static void
+set_deduplicate_images (cairo_surface_t *surface, cairo_bool_t deduplicate)
+{
+    cairo_svg_surface_set_deduplicate_images (surface, deduplicate);
+}
+
+static int
+count_images (const char *data, long length)
+{
+    return count (data, length, "<image id=");
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    if (! cairo_test_is_target_enabled (ctx, "svg"))
+	return CAIRO_TEST_UNTESTED;
+
+    return check_deduplicate_images (ctx,
+				     "svg-deduplicate-images.out.svg",
+				     "svg-deduplicate-images-dedup.out.svg");
+}
+
+CAIRO_TEST (svg_deduplicate_images,
+	    "Check that identical images are only written once when requested",
+	    "svg", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -36,12 +36,24 @@
 
 #include "cairo-script-private.h"
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
 
+#ifdef HAVE_MMAP
+# ifdef HAVE_UNISTD_H
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+# else
+#  undef HAVE_MMAP
+# endif
+#endif
+
 #ifndef MAX
 #define MAX(a,b) (((a)>=(b))?(a):(b))
 #endif
@@ -641,6 +653,27 @@ cairo_script_interpreter_finish (csi_t *ctx)
     return status;
 }
 
+typedef struct _csi_compiled {
+    csi_list_t list;
+    char *filename;
+    char *base;
+    size_t length;
+    const csi_compiled_trailer_t *trailer;
+    const uint64_t *frames;
+} csi_compiled_t;
+
+static void
+_csi_compiled_destroy (csi_compiled_t *compiled)
+{
+#ifdef HAVE_MMAP
+    munmap (compiled->base, compiled->length);
+#else
+    free (compiled->base);
+#endif
+    free (compiled->filename);
+    free (compiled);
+}
+
 static void
 _csi_fini (csi_t *ctx)
 {
@@ -654,6 +687,13 @@ _csi_fini (csi_t *ctx)
     if (ctx->free_string != NULL)
 	csi_string_free (ctx, ctx->free_string);
 
+    while (ctx->_compiled != NULL) {
+	csi_compiled_t *compiled = (csi_compiled_t *) ctx->_compiled;
+
+	ctx->_compiled = compiled->list.next;
+	_csi_compiled_destroy (compiled);
+    }
+
     _csi_slab_fini (ctx);
     _csi_perm_fini (ctx);
 }
@@ -697,3 +737,279 @@ BAIL:
 
     return status;
 }
+
+cairo_status_t
+cairo_script_interpreter_compile_stream (FILE *stream,
+					 cairo_write_func_t write_func,
+					 void *closure)
+{
+    csi_t ctx;
+    csi_object_t src;
+    csi_status_t status;
+
+    _csi_init (&ctx);
+
+    status = csi_file_new_for_stream (&ctx, &src, stream);
+    if (status)
+	goto BAIL;
+
+    status = _csi_compile_file (&ctx, src.datum.file, write_func, closure);
+
+BAIL:
+    csi_object_free (&ctx, &src);
+    _csi_fini (&ctx);
+
+    return status;
+}
+
+static csi_status_t
+_csi_compiled_map (const char *filename, char **base_out, size_t *length_out)
+{
+#ifdef HAVE_MMAP
+    struct stat st;
+    void *base;
+    int fd;
+
+    fd = open (filename, O_RDONLY);
+    if (fd == -1)
+	return _csi_error (CSI_STATUS_FILE_NOT_FOUND);
+
+    if (fstat (fd, &st) == -1 || st.st_size == 0) {
+	close (fd);
+	return _csi_error (CSI_STATUS_READ_ERROR);
+    }
+
+    /* A private writable mapping, so that the few operators that
+     * modify their string arguments in place do not fault. */
+    base = mmap (NULL, st.st_size,
+		 PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		 fd, 0);
+    close (fd);
+    if (base == MAP_FAILED)
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+
+    *base_out = base;
+    *length_out = st.st_size;
+    return CSI_STATUS_SUCCESS;
+#else
+    FILE *file;
+    char *base;
+    long length;
+
+    file = fopen (filename, "rb");
+    if (file == NULL)
+	return _csi_error (CSI_STATUS_FILE_NOT_FOUND);
+
+    if (fseek (file, 0, SEEK_END) == -1 ||
+	(length = ftell (file)) <= 0 ||
+	fseek (file, 0, SEEK_SET) == -1)
+    {
+	fclose (file);
+	return _csi_error (CSI_STATUS_READ_ERROR);
+    }
+
+    base = malloc (length);
+    if (base == NULL) {
+	fclose (file);
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+    }
+
+    if (fread (base, 1, length, file) != (size_t) length) {
+	free (base);
+	fclose (file);
+	return _csi_error (CSI_STATUS_READ_ERROR);
+    }
+    fclose (file);
+
+    *base_out = base;
+    *length_out = length;
+    return CSI_STATUS_SUCCESS;
+#endif
+}
+
+static csi_boolean_t
+_csi_compiled_check (const char *base, size_t length)
+{
+    const csi_compiled_trailer_t *trailer;
+    uint64_t frames_end;
+
+    if (length < CSI_COMPILED_MAGIC_LENGTH + sizeof (*trailer) ||
+	length % sizeof (uint64_t))
+    {
+	return FALSE;
+    }
+
+    trailer = (const csi_compiled_trailer_t *)
+	(base + length - sizeof (*trailer));
+    if (memcmp (base, CSI_COMPILED_MAGIC, CSI_COMPILED_MAGIC_LENGTH) ||
+	memcmp (trailer->magic, CSI_COMPILED_MAGIC, CSI_COMPILED_MAGIC_LENGTH) ||
+	trailer->version != CSI_COMPILED_VERSION ||
+	trailer->byte_order != CSI_COMPILED_BYTE_ORDER)
+    {
+	return FALSE;
+    }
+
+    frames_end = trailer->frames_offset +
+	((uint64_t) trailer->num_frames + 1) * sizeof (uint64_t);
+    return trailer->tokens_offset == CSI_COMPILED_MAGIC_LENGTH &&
+	   trailer->blobs_offset >= trailer->tokens_offset + trailer->tokens_length &&
+	   trailer->frames_offset >= trailer->blobs_offset + trailer->blobs_length &&
+	   trailer->frames_offset % sizeof (uint64_t) == 0 &&
+	   frames_end <= length - sizeof (*trailer);
+}
+
+static csi_status_t
+_csi_compiled_lookup (csi_t *ctx,
+		      const char *filename,
+		      csi_compiled_t **out)
+{
+    csi_compiled_t *compiled;
+    csi_status_t status;
+    unsigned int n;
+    char *base;
+    size_t length;
+
+    /* Successive windows of the same trace share the mapping. */
+    for (compiled = (csi_compiled_t *) ctx->_compiled;
+	 compiled != NULL;
+	 compiled = (csi_compiled_t *) compiled->list.next)
+    {
+	if (strcmp (compiled->filename, filename) == 0) {
+	    *out = compiled;
+	    return CSI_STATUS_SUCCESS;
+	}
+    }
+
+    status = _csi_compiled_map (filename, &base, &length);
+    if (status)
+	return status;
+
+    compiled = malloc (sizeof (csi_compiled_t));
+    if (compiled == NULL) {
+#ifdef HAVE_MMAP
+	munmap (base, length);
+#else
+	free (base);
+#endif
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+    }
+
+    compiled->base = base;
+    compiled->length = length;
+    compiled->filename = strdup (filename);
+    if (compiled->filename == NULL) {
+	_csi_compiled_destroy (compiled);
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+    }
+
+    if (! _csi_compiled_check (base, length)) {
+	_csi_compiled_destroy (compiled);
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+    }
+
+    compiled->trailer = (const csi_compiled_trailer_t *)
+	(base + length - sizeof (csi_compiled_trailer_t));
+    compiled->frames = (const uint64_t *)
+	(base + compiled->trailer->frames_offset);
+
+    for (n = 0; n < compiled->trailer->num_frames; n++) {
+	if (compiled->frames[n] > compiled->frames[n+1] ||
+	    compiled->frames[n+1] - compiled->frames[n] > INT_MAX)
+	{
+	    _csi_compiled_destroy (compiled);
+	    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	}
+    }
+    if (compiled->frames[n] > compiled->trailer->tokens_length ||
+	compiled->trailer->tokens_length - compiled->frames[n] > INT_MAX)
+    {
+	_csi_compiled_destroy (compiled);
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+    }
+
+    compiled->list.prev = NULL;
+    compiled->list.next = ctx->_compiled;
+    if (ctx->_compiled != NULL)
+	ctx->_compiled->prev = &compiled->list;
+    ctx->_compiled = &compiled->list;
+
+    *out = compiled;
+    return CSI_STATUS_SUCCESS;
+}
+
+/* Replays num_frames pages of a trace written by
+ * cairo_script_interpreter_compile_stream(), starting with first_frame.
+ * Pages depend upon the surfaces, fonts and definitions created by the
+ * ones before them, so a window other than the start of the trace must
+ * be preceded by a replay of the earlier pages on the same interpreter.
+ */
+cairo_status_t
+cairo_script_interpreter_run_compiled (csi_t *ctx,
+				       const char *filename,
+				       unsigned int first_frame,
+				       unsigned int num_frames)
+{
+    csi_compiled_t *compiled;
+    const char *old_blobs;
+    uint64_t old_blobs_length;
+    const char *tokens;
+    unsigned int last_frame, n;
+
+    if (ctx->status)
+	return ctx->status;
+    if (ctx->finished)
+	return ctx->status = CSI_STATUS_INTERPRETER_FINISHED;
+
+    ctx->status = _csi_compiled_lookup (ctx, filename, &compiled);
+    if (ctx->status)
+	return ctx->status;
+
+    if (first_frame > compiled->trailer->num_frames)
+	return _csi_error (CAIRO_STATUS_INVALID_INDEX);
+
+    /* The window runs to the end of the trace if it covers the last
+     * page, which then includes whatever follows that page. */
+    last_frame = compiled->trailer->num_frames;
+    if (num_frames < last_frame - first_frame)
+	last_frame = first_frame + num_frames;
+    else
+	last_frame++;
+
+    old_blobs = ctx->scanner.blobs;
+    old_blobs_length = ctx->scanner.blobs_length;
+    ctx->scanner.blobs = compiled->base + compiled->trailer->blobs_offset;
+    ctx->scanner.blobs_length = compiled->trailer->blobs_length;
+
+    /* Each page is executed directly from the mapping, so the
+     * frames are never copied nor the trace read past the window. */
+    tokens = compiled->base + compiled->trailer->tokens_offset;
+    for (n = first_frame; n < last_frame; n++) {
+	csi_object_t file;
+	uint64_t start, end;
+
+	start = compiled->frames[n];
+	if (n < compiled->trailer->num_frames)
+	    end = compiled->frames[n+1];
+	else
+	    end = compiled->trailer->tokens_length;
+	if (start == end)
+	    continue;
+
+	ctx->status = csi_file_new_for_bytes (ctx, &file,
+					      tokens + start, end - start);
+	if (ctx->status)
+	    break;
+
+	file.type |= CSI_OBJECT_ATTR_EXECUTABLE;
+
+	ctx->status = csi_object_execute (ctx, &file);
+	csi_object_free (ctx, &file);
+	if (ctx->status)
+	    break;
+    }
+
+    ctx->scanner.blobs = old_blobs;
+    ctx->scanner.blobs_length = old_blobs_length;
+
+    return ctx->status;
+}
@@ -119,6 +119,17 @@ cairo_script_interpreter_translate_stream (FILE *stream,
 	                                   cairo_write_func_t write_func,
 					   void *closure);
 
+cairo_public cairo_status_t
+cairo_script_interpreter_compile_stream (FILE *stream,
+					 cairo_write_func_t write_func,
+					 void *closure);
+
+cairo_public cairo_status_t
+cairo_script_interpreter_run_compiled (cairo_script_interpreter_t *ctx,
+				       const char *filename,
+				       unsigned int first_frame,
+				       unsigned int num_frames);
+
 CAIRO_END_DECLS
 
 #endif /*CAIRO_SCRIPT_INTERPRETER_H*/
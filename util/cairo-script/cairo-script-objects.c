@@ -509,6 +509,7 @@ csi_string_new (csi_t *ctx,
     string->len = len;
     string->deflate = 0;
     string->method = NONE;
+    string->mapped = FALSE;
 
     string->base.type = CSI_OBJECT_TYPE_STRING;
     string->base.ref = 1;
@@ -559,6 +560,7 @@ csi_string_new_from_bytes (csi_t *ctx,
     string->len = len;
     string->deflate = 0;
     string->method = NONE;
+    string->mapped = FALSE;
 
     string->base.type = CSI_OBJECT_TYPE_STRING;
     string->base.ref = 1;
@@ -591,6 +593,12 @@ _csi_string_execute (csi_t *ctx, csi_string_t *string)
 void
 csi_string_free (csi_t *ctx, csi_string_t *string)
 {
+    /* The bytes belong to a compiled trace mapped by the interpreter. */
+    if (string->mapped) {
+	_csi_slab_free (ctx, string, sizeof (csi_string_t));
+	return;
+    }
+
 #if CSI_DEBUG_MALLOC
     _csi_free (ctx, string->string);
     _csi_slab_free (ctx, string, sizeof (csi_string_t));
@@ -397,6 +397,7 @@ struct _csi_string {
 	ZLIB,
 	LZO,
     } method;
+    csi_boolean_t mapped;
     char *string;
 };
 
@@ -451,8 +452,36 @@ struct _csi_scanner {
     unsigned int accumulator_count;
 
     unsigned int line_number;
+
+    /* out of line strings of the compiled trace being replayed */
+    const char *blobs;
+    uint64_t blobs_length;
 };
 
+/* A compiled trace is the translated token stream, followed by the
+ * strings that were stored out of line, a table of the offsets into
+ * the token stream at which each page ends and this trailer.  It is
+ * written in host byte order and so is only meant to be replayed on
+ * the machine (or at least the architecture) that compiled it.
+ */
+#define CSI_COMPILED_MAGIC "CSI\211trc\n"
+#define CSI_COMPILED_MAGIC_LENGTH 8
+#define CSI_COMPILED_VERSION 1
+#define CSI_COMPILED_BYTE_ORDER 0x01020304
+
+typedef struct _csi_compiled_trailer {
+    uint64_t tokens_offset;
+    uint64_t tokens_length;
+    uint64_t blobs_offset;
+    uint64_t blobs_length;
+    uint64_t frames_offset;
+    uint32_t num_frames;
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t reserved;
+    char magic[CSI_COMPILED_MAGIC_LENGTH];
+} csi_compiled_trailer_t;
+
 typedef cairo_script_interpreter_hooks_t csi_hooks_t;
 
 typedef struct _csi_chunk {
@@ -490,6 +519,7 @@ struct _cairo_script_interpreter {
     /* caches of live data */
     csi_list_t *_images;
     csi_list_t *_faces;
+    csi_list_t *_compiled;
 };
 
 typedef struct _csi_operator_def {
@@ -832,6 +862,12 @@ _csi_translate_file (csi_t *ctx,
 		     cairo_write_func_t write_func,
 		     void *closure);
 
+csi_private csi_status_t
+_csi_compile_file (csi_t *ctx,
+		   csi_file_t *file,
+		   cairo_write_func_t write_func,
+		   void *closure);
+
 csi_private void
 _csi_scanner_fini (csi_t *ctx, csi_scanner_t *scanner);
 
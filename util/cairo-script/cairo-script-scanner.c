@@ -813,6 +813,32 @@ string_read (csi_t *ctx,
     obj->datum.string->string[len] = '\0';
 }
 
+/* Out of line strings of a compiled trace refer directly to the
+ * mapped file, see cairo_script_interpreter_run_compiled(). */
+static void
+blob_read (csi_t *ctx,
+	   csi_scanner_t *scan,
+	   uint64_t offset,
+	   uint32_t len,
+	   csi_object_t *obj)
+{
+    csi_status_t status;
+
+    if (_csi_unlikely (scan->blobs == NULL ||
+		       offset >= scan->blobs_length ||
+		       len >= scan->blobs_length - offset))
+    {
+	longjmp (scan->jmpbuf, _csi_error (CSI_STATUS_INVALID_SCRIPT));
+    }
+
+    status = csi_string_new_from_bytes (ctx, obj,
+					(char *) scan->blobs + offset, len);
+    if (_csi_unlikely (status))
+	longjmp (scan->jmpbuf, status);
+
+    obj->datum.string->mapped = TRUE;
+}
+
 static void
 _scan_file (csi_t *ctx, csi_file_t *src)
 {
@@ -827,6 +853,7 @@ _scan_file (csi_t *ctx, csi_file_t *src)
 	uint32_t u32;
 	float f;
     } u;
+    uint64_t u64;
     int deflate = 0;
     int string_p;
 
@@ -1007,8 +1034,14 @@ scan_none:
 	    string_read (ctx, scan, src, be32 (u.u32), LZO, &obj);
 	    break;
 
+#define BLOB 155
+	case BLOB:
+	    scan_read (scan, src, &u64, 8);
+	    scan_read (scan, src, &u.u32, 4);
+	    blob_read (ctx, scan, u64, u.u32, &obj);
+	    break;
+
 	    /* unassigned */
-	case 155:
 	case 156:
 	case 157:
 	case 158:
@@ -1411,12 +1444,69 @@ _csi_scan_file (csi_t *ctx, csi_file_t *src)
     return CSI_STATUS_SUCCESS;
 }
 
+/* Strings at least this long are stored out of line by compilation. */
+#define CSI_BLOB_THRESHOLD 1024
+
 struct _translate_closure {
     csi_dictionary_t *opcodes;
     cairo_write_func_t write_func;
     void *closure;
+    uint64_t position;
+
+    /* When compiling, large strings are written out of line to blobs
+     * and the offset at which each top-level page ends is recorded. */
+    csi_boolean_t compile;
+    csi_name_t begin_procedure;
+    csi_name_t end_procedure;
+    int show_page, copy_page;
+    int depth;
+    FILE *blobs;
+    uint64_t blobs_length;
+    uint64_t *frames;
+    unsigned int num_frames;
+    unsigned int frames_size;
 };
 
+static void
+_translate_write (struct _translate_closure *closure,
+		  const unsigned char *data,
+		  unsigned int length)
+{
+    closure->write_func (closure->closure, data, length);
+    closure->position += length;
+}
+
+static csi_status_t
+_translate_end_frame (struct _translate_closure *closure)
+{
+    if (closure->num_frames == closure->frames_size) {
+	unsigned int size = closure->frames_size ? 2 * closure->frames_size : 64;
+	uint64_t *frames;
+
+	frames = realloc (closure->frames, size * sizeof (uint64_t));
+	if (_csi_unlikely (frames == NULL))
+	    return _csi_error (CSI_STATUS_NO_MEMORY);
+
+	closure->frames = frames;
+	closure->frames_size = size;
+    }
+
+    closure->frames[closure->num_frames++] = closure->position;
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_translate_track (struct _translate_closure *closure, int code)
+{
+    if (closure->depth == 0 &&
+	(code == closure->show_page || code == closure->copy_page))
+    {
+	return _translate_end_frame (closure);
+    }
+
+    return CSI_STATUS_SUCCESS;
+}
+
 static csi_status_t
 _translate_name (csi_t *ctx,
 	         csi_name_t name,
@@ -1437,14 +1527,25 @@ _translate_name (csi_t *ctx,
 
 	u16 = entry->value.datum.integer;
 	u16 = be16 (u16);
-	closure->write_func (closure->closure, (unsigned char *) &u16, 2);
+	_translate_write (closure, (unsigned char *) &u16, 2);
+
+	if (closure->compile)
+	    return _translate_track (closure, entry->value.datum.integer);
     } else {
-	closure->write_func (closure->closure, (unsigned char *) "/", 1);
+	_translate_write (closure, (unsigned char *) "/", 1);
 STRING:
-	closure->write_func (closure->closure,
-		             (unsigned char *) name,
-			     strlen ((char *) name));
-	closure->write_func (closure->closure, (unsigned char *) "\n", 1);
+	_translate_write (closure,
+			  (unsigned char *) name,
+			  strlen ((char *) name));
+	_translate_write (closure, (unsigned char *) "\n", 1);
+
+	/* In bind mode procedures are passed through as names. */
+	if (executable && closure->compile) {
+	    if (name == closure->begin_procedure)
+		closure->depth++;
+	    else if (name == closure->end_procedure)
+		closure->depth--;
+	}
     }
 
     return CSI_STATUS_SUCCESS;
@@ -1468,7 +1569,10 @@ _translate_operator (csi_t *ctx,
     if (! executable)
 	u16 += 1 << 8;
     u16 = be16 (u16);
-    closure->write_func (closure->closure, (unsigned char *) &u16, 2);
+    _translate_write (closure, (unsigned char *) &u16, 2);
+
+    if (executable && closure->compile)
+	return _translate_track (closure, entry->value.datum.integer);
 
     return CSI_STATUS_SUCCESS;
 }
@@ -1543,8 +1647,8 @@ _translate_integer (csi_t *ctx,
     }
 #endif
 
-    closure->write_func (closure->closure, (unsigned char *) &hdr, 1);
-    closure->write_func (closure->closure, (unsigned char *) &u, len);
+    _translate_write (closure, (unsigned char *) &hdr, 1);
+    _translate_write (closure, (unsigned char *) &u, len);
 
     return CSI_STATUS_SUCCESS;
 }
@@ -1564,8 +1668,82 @@ _translate_real (csi_t *ctx,
 #else
     hdr = LSB_FLOAT32;
 #endif
-    closure->write_func (closure->closure, (unsigned char *) &hdr, 1);
-    closure->write_func (closure->closure, (unsigned char *) &real, 4);
+    _translate_write (closure, (unsigned char *) &hdr, 1);
+    _translate_write (closure, (unsigned char *) &real, 4);
+
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_translate_blob (csi_t *ctx,
+		 csi_string_t *string,
+		 struct _translate_closure *closure)
+{
+    uint8_t hdr = BLOB;
+    uint64_t offset;
+    uint32_t u32;
+    uLongf len;
+    char *buf;
+
+    /* Store the string inflated, so that replay can use the mapped
+     * bytes as they are. */
+    buf = string->string;
+    len = string->len;
+    if (string->method != NONE) {
+	len = string->deflate;
+	buf = malloc (len);
+	if (_csi_unlikely (buf == NULL))
+	    return _csi_error (CSI_STATUS_NO_MEMORY);
+
+	switch (string->method) {
+	default:
+	case NONE:
+	    free (buf);
+	    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+#if HAVE_ZLIB
+	case ZLIB:
+	    if (uncompress ((Bytef *) buf, &len,
+			    (Bytef *) string->string, string->len) != Z_OK)
+	    {
+		free (buf);
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	    }
+	    break;
+#endif
+
+#if HAVE_LZO
+	case LZO:
+	    if (lzo2a_decompress ((lzo_bytep) string->string, string->len,
+				  (lzo_bytep) buf, &len,
+				  NULL))
+	    {
+		free (buf);
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	    }
+	    break;
+#endif
+	}
+    }
+
+    /* Keep the terminating nul, like every other string. */
+    offset = closure->blobs_length;
+    if (fwrite (buf, 1, len, closure->blobs) != len ||
+	fputc ('\0', closure->blobs) == EOF)
+    {
+	if (buf != string->string)
+	    free (buf);
+	return _csi_error (CSI_STATUS_WRITE_ERROR);
+    }
+    closure->blobs_length += len + 1;
+
+    if (buf != string->string)
+	free (buf);
+
+    u32 = len;
+    _translate_write (closure, (unsigned char *) &hdr, 1);
+    _translate_write (closure, (unsigned char *) &offset, 8);
+    _translate_write (closure, (unsigned char *) &u32, 4);
 
     return CSI_STATUS_SUCCESS;
 }
@@ -1585,6 +1763,12 @@ _translate_string (csi_t *ctx,
     unsigned long hdr_len, buf_len, deflate;
     int method;
 
+    if (closure->compile &&
+	(string->method == NONE ? string->len : string->deflate) >= CSI_BLOB_THRESHOLD)
+    {
+	return _translate_blob (ctx, string, closure);
+    }
+
     buf = string->string;
     buf_len = string->len;
     deflate = string->deflate;
@@ -1704,13 +1888,13 @@ _translate_string (csi_t *ctx,
 	}
     }
 
-    closure->write_func (closure->closure, (unsigned char *) &hdr, 1);
-    closure->write_func (closure->closure, (unsigned char *) &u, hdr_len);
+    _translate_write (closure, (unsigned char *) &hdr, 1);
+    _translate_write (closure, (unsigned char *) &u, hdr_len);
     if (deflate) {
 	uint32_t u32 = to_be32 (deflate);
-	closure->write_func (closure->closure, (unsigned char *) &u32, 4);
+	_translate_write (closure, (unsigned char *) &u32, 4);
     }
-    closure->write_func (closure->closure, (unsigned char *) buf, buf_len);
+    _translate_write (closure, (unsigned char *) buf, buf_len);
 
     if (buf != string->string)
 	free (buf);
@@ -1865,25 +2049,59 @@ FAIL:
     return status;
 }
 
-csi_status_t
-_csi_translate_file (csi_t *ctx,
-	             csi_file_t *file,
-		     cairo_write_func_t write_func,
-		     void *closure)
+static int
+_translate_lookup_opcode (csi_t *ctx,
+			  struct _translate_closure *closure,
+			  const char *str)
+{
+    csi_dictionary_entry_t *entry;
+    csi_object_t name;
+
+    if (csi_name_new_static (ctx, &name, str))
+	return -1;
+
+    entry = _csi_hash_table_lookup (&closure->opcodes->hash_table,
+				    (csi_hash_entry_t *) &name.datum.name);
+    if (entry == NULL)
+	return -1;
+
+    return entry->value.datum.integer;
+}
+
+static csi_status_t
+_translate_file (csi_t *ctx,
+		 csi_file_t *file,
+		 struct _translate_closure *translator)
 {
     csi_status_t status;
-    struct _translate_closure translator;
 
     if ((status = setjmp (ctx->scanner.jmpbuf)))
 	return status;
 
-    status = build_opcodes (ctx, &translator.opcodes);
+    status = build_opcodes (ctx, &translator->opcodes);
     if (_csi_unlikely (status))
 	return status;
 
-    translator.write_func = write_func;
-    translator.closure = closure;
-    ctx->scanner.closure = &translator;
+    if (translator->compile) {
+	csi_object_t name;
+
+	status = csi_name_new_static (ctx, &name, "{");
+	if (_csi_unlikely (status))
+	    goto FAIL;
+	translator->begin_procedure = name.datum.name;
+
+	status = csi_name_new_static (ctx, &name, "}");
+	if (_csi_unlikely (status))
+	    goto FAIL;
+	translator->end_procedure = name.datum.name;
+
+	translator->show_page =
+	    _translate_lookup_opcode (ctx, translator, "show-page");
+	translator->copy_page =
+	    _translate_lookup_opcode (ctx, translator, "copy-page");
+    }
+
+    ctx->scanner.closure = translator;
 
     ctx->scanner.bind = 1;
     ctx->scanner.push = _translate_push;
@@ -1895,7 +2113,100 @@ _csi_translate_file (csi_t *ctx,
     ctx->scanner.push = _scan_push;
     ctx->scanner.execute = _scan_execute;
 
-    csi_dictionary_free (ctx, translator.opcodes);
+FAIL:
+    csi_dictionary_free (ctx, translator->opcodes);
 
-    return CSI_STATUS_SUCCESS;
+    return status;
+}
+
+csi_status_t
+_csi_translate_file (csi_t *ctx,
+	             csi_file_t *file,
+		     cairo_write_func_t write_func,
+		     void *closure)
+{
+    struct _translate_closure translator;
+
+    memset (&translator, 0, sizeof (translator));
+    translator.write_func = write_func;
+    translator.closure = closure;
+
+    return _translate_file (ctx, file, &translator);
+}
+
+csi_status_t
+_csi_compile_file (csi_t *ctx,
+		   csi_file_t *file,
+		   cairo_write_func_t write_func,
+		   void *closure)
+{
+    struct _translate_closure translator;
+    csi_compiled_trailer_t trailer;
+    csi_status_t status;
+    uint64_t u64;
+    char buf[4096];
+    size_t len;
+
+    memset (&translator, 0, sizeof (translator));
+    translator.write_func = write_func;
+    translator.closure = closure;
+    translator.compile = TRUE;
+
+    translator.blobs = tmpfile ();
+    if (translator.blobs == NULL)
+	return _csi_error (CSI_STATUS_WRITE_ERROR);
+
+    write_func (closure,
+		(unsigned char *) CSI_COMPILED_MAGIC,
+		CSI_COMPILED_MAGIC_LENGTH);
+
+    status = _translate_file (ctx, file, &translator);
+    if (_csi_unlikely (status))
+	goto BAIL;
+
+    memset (&trailer, 0, sizeof (trailer));
+    trailer.tokens_offset = CSI_COMPILED_MAGIC_LENGTH;
+    trailer.tokens_length = translator.position;
+
+    /* Append the out of line strings, padded so that the frame table
+     * and trailer are naturally aligned in the mapped file. */
+    trailer.blobs_offset = trailer.tokens_offset + trailer.tokens_length;
+    trailer.blobs_length = translator.blobs_length;
+    rewind (translator.blobs);
+    while ((len = fread (buf, 1, sizeof (buf), translator.blobs)) > 0)
+	write_func (closure, (unsigned char *) buf, len);
+    if (ferror (translator.blobs)) {
+	status = _csi_error (CSI_STATUS_READ_ERROR);
+	goto BAIL;
+    }
+
+    trailer.frames_offset = trailer.blobs_offset + trailer.blobs_length;
+    len = -trailer.frames_offset & 7;
+    if (len) {
+	memset (buf, 0, len);
+	write_func (closure, (unsigned char *) buf, len);
+	trailer.frames_offset += len;
+    }
+
+    /* Frame n spans from entry n to entry n+1 of the table, anything
+     * after the last page is replayed only with the final frame. */
+    u64 = 0;
+    write_func (closure, (unsigned char *) &u64, sizeof (u64));
+    if (translator.num_frames) {
+	write_func (closure,
+		    (unsigned char *) translator.frames,
+		    translator.num_frames * sizeof (uint64_t));
+    }
+
+    trailer.num_frames = translator.num_frames;
+    trailer.version = CSI_COMPILED_VERSION;
+    trailer.byte_order = CSI_COMPILED_BYTE_ORDER;
+    memcpy (trailer.magic, CSI_COMPILED_MAGIC, CSI_COMPILED_MAGIC_LENGTH);
+    write_func (closure, (unsigned char *) &trailer, sizeof (trailer));
+
+BAIL:
+    free (translator.frames);
+    fclose (translator.blobs);
+
+    return status;
 }
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static cairo_status_t
 write_func (void *closure,
@@ -15,13 +16,32 @@ write_func (void *closure,
     return CAIRO_STATUS_SUCCESS;
 }
 
+typedef cairo_status_t
+(*translate_func_t) (FILE *stream,
+		     cairo_write_func_t write_func,
+		     void *closure);
+
 int
 main (int argc, char **argv)
 {
     FILE *in = stdin, *out = stdout;
+    translate_func_t translate = cairo_script_interpreter_translate_stream;
     cairo_status_t status;
     int i;
 
+    /* -c writes an indexed, compiled trace for a single input */
+    if (argc > 1 && strcmp (argv[1], "-c") == 0) {
+	translate = cairo_script_interpreter_compile_stream;
+	argv[1] = argv[0];
+	argv++;
+	argc--;
+
+	if (argc > 3) {
+	    fprintf (stderr, "Only a single input may be compiled\n");
+	    return 1;
+	}
+    }
+
     if (argc >= 3) {
 	if (strcmp (argv[argc-1], "-")) {
 	    out = fopen (argv[argc-1], "w");
@@ -40,7 +60,7 @@ main (int argc, char **argv)
 		return 1;
 	    }
 
-	    status = cairo_script_interpreter_translate_stream (in, write_func, out);
+	    status = translate (in, write_func, out);
 	    fclose (in);
 
 	    if (status)
@@ -57,7 +77,7 @@ main (int argc, char **argv)
 	    }
 	}
 
-	status = cairo_script_interpreter_translate_stream (in, write_func, out);
+	status = translate (in, write_func, out);
 
 	if (in != stdin)
 	    fclose (in);
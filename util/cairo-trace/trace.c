@@ -45,6 +45,9 @@
 #include <stdlib.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
 
 #include <cairo.h>
 #if CAIRO_HAS_FT_FONT
@@ -206,11 +209,13 @@ static cairo_bool_t _flush;
 static cairo_bool_t _error;
 static cairo_bool_t _line_info;
 static cairo_bool_t _mark_dirty;
+static cairo_bool_t _buffered;
 static const cairo_user_data_key_t destroy_key;
 static pthread_once_t once_control = PTHREAD_ONCE_INIT;
 static pthread_key_t counter_key;
 
 static void _init_trace (void);
+static void _init_sampling (void);
 
 #define INIT_TRACE_ONCE() pthread_once (&once_control, _init_trace)
 
@@ -487,10 +492,236 @@ _init_trace (void)
     _type_create ("cairo_surface_t", SURFACE, "s");
 }
 
+/* In buffered mode (CAIRO_TRACE_BUFFERED) the trace is collected in
+ * memory and written out by a separate thread, so that the traced
+ * threads never wait upon the file.  The trace is a single script whose
+ * operand stack is shared by all threads, so it is still composed under
+ * the write lock; full chunks are then handed to the writer through a
+ * lock-free list and returned to a lock-free free list once written.
+ */
+#define TRACE_CHUNK_SIZE (64 * 1024)
+
+typedef struct _trace_chunk {
+    struct _trace_chunk *next;
+    size_t length;
+    char data[TRACE_CHUNK_SIZE];
+} trace_chunk_t;
+
+static trace_chunk_t *_chunk; /* being filled, under the write lock */
+static trace_chunk_t *_spare_chunks; /* ditto */
+static trace_chunk_t *volatile _pending_chunks; /* newest first */
+static trace_chunk_t *volatile _free_chunks;
+static sem_t _writer_sem;
+static pthread_t _writer;
+static volatile int _writer_exit;
+
+static void
+_chunk_push (trace_chunk_t *volatile *list, trace_chunk_t *chunk)
+{
+    trace_chunk_t *old;
+
+    do {
+	old = *list;
+	chunk->next = old;
+    } while (! __sync_bool_compare_and_swap (list, old, chunk));
+}
+
+static void
+_publish_chunk (void)
+{
+    trace_chunk_t *chunk = _chunk;
+
+    if (chunk == NULL || chunk->length == 0)
+	return;
+
+    _chunk = NULL;
+    _chunk_push (&_pending_chunks, chunk);
+    sem_post (&_writer_sem);
+}
+
+static trace_chunk_t *
+_get_chunk (void)
+{
+    trace_chunk_t *chunk;
+
+    if (_spare_chunks == NULL)
+	_spare_chunks = __sync_lock_test_and_set (&_free_chunks, NULL);
+
+    chunk = _spare_chunks;
+    if (chunk != NULL)
+	_spare_chunks = chunk->next;
+    else
+	chunk = malloc (sizeof (trace_chunk_t));
+    if (chunk != NULL)
+	chunk->length = 0;
+
+    return chunk;
+}
+
+static void
+_trace_write (const void *data, size_t length)
+{
+    int ret_ignored;
+
+    if (! _buffered) {
+	ret_ignored = fwrite (data, 1, length, logfile);
+	(void)ret_ignored;
+	return;
+    }
+
+    while (length) {
+	size_t n;
+
+	if (_chunk == NULL || _chunk->length == TRACE_CHUNK_SIZE) {
+	    _publish_chunk ();
+	    _chunk = _get_chunk ();
+	    if (_chunk == NULL) {
+		_error = TRUE;
+		return;
+	    }
+	}
+
+	n = TRACE_CHUNK_SIZE - _chunk->length;
+	if (n > length)
+	    n = length;
+	memcpy (_chunk->data + _chunk->length, data, n);
+	_chunk->length += n;
+
+	data = (const char *) data + n;
+	length -= n;
+    }
+}
+
+static void *
+_writer_thread (void *closure)
+{
+    int fd = fileno (logfile);
+    int done;
+
+    do {
+	trace_chunk_t *list, *chunk, *next;
+
+	while (sem_wait (&_writer_sem) == -1 && errno == EINTR)
+	    ;
+
+	done = _writer_exit;
+
+	/* reverse into the order in which the chunks were filled */
+	list = NULL;
+	chunk = __sync_lock_test_and_set (&_pending_chunks, NULL);
+	while (chunk != NULL) {
+	    next = chunk->next;
+	    chunk->next = list;
+	    list = chunk;
+	    chunk = next;
+	}
+
+	for (chunk = list; chunk != NULL; chunk = next) {
+	    const char *data = chunk->data;
+	    size_t length = chunk->length;
+
+	    while (length) {
+		ssize_t ret = write (fd, data, length);
+		if (ret == -1) {
+		    if (errno == EINTR)
+			continue;
+		    _error = TRUE;
+		    break;
+		}
+		data += ret;
+		length -= ret;
+	    }
+
+	    next = chunk->next;
+	    _chunk_push (&_free_chunks, chunk);
+	}
+    } while (! done);
+
+    return NULL;
+}
+
+static void
+_free_chunks_list (trace_chunk_t *chunk)
+{
+    while (chunk != NULL) {
+	trace_chunk_t *next = chunk->next;
+	free (chunk);
+	chunk = next;
+    }
+}
+
+/* A forked child has no writer thread, and the chunks it inherited are
+ * the parent's to write, so it discards them and continues unbuffered.
+ */
+static void
+_writer_atfork_child (void)
+{
+    if (! _buffered)
+	return;
+
+    if (_chunk != NULL) {
+	free (_chunk);
+	_chunk = NULL;
+    }
+    _free_chunks_list (_spare_chunks);
+    _spare_chunks = NULL;
+    _free_chunks_list (_pending_chunks);
+    _pending_chunks = NULL;
+    _free_chunks_list (_free_chunks);
+    _free_chunks = NULL;
+
+    _buffered = FALSE;
+}
+
+static cairo_bool_t
+_writer_init (void)
+{
+    static cairo_bool_t atfork_registered;
+
+    /* Everything is written by the thread from now on. */
+    fflush (logfile);
+
+    if (! atfork_registered) {
+	if (pthread_atfork (NULL, NULL, _writer_atfork_child))
+	    return FALSE;
+	atfork_registered = TRUE;
+    }
+
+    if (sem_init (&_writer_sem, 0, 0))
+	return FALSE;
+
+    if (pthread_create (&_writer, NULL, _writer_thread, NULL)) {
+	sem_destroy (&_writer_sem);
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+_writer_fini (void)
+{
+    _publish_chunk ();
+
+    _writer_exit = 1;
+    sem_post (&_writer_sem);
+    pthread_join (_writer, NULL);
+    sem_destroy (&_writer_sem);
+
+    _free_chunks_list (__sync_lock_test_and_set (&_free_chunks, NULL));
+    _free_chunks_list (_spare_chunks);
+    _spare_chunks = NULL;
+
+    _buffered = FALSE;
+}
+
 static void
 _close_trace (void)
 {
     if (logfile != NULL) {
+	if (_buffered)
+	    _writer_fini ();
+
 	fclose (logfile);
 	logfile = NULL;
     }
@@ -620,7 +851,6 @@ _trace_vprintf (const char *fmt, va_list ap)
     const char *f, *start;
     int length_modifier, width;
     cairo_bool_t var_width;
-    int ret_ignored;
 
     assert (_should_trace ());
 
@@ -663,7 +893,7 @@ _trace_vprintf (const char *fmt, va_list ap)
 	single_fmt[single_fmt_length] = '\0';
 
 	/* Flush contents of buffer before snprintf()'ing into it. */
-	ret_ignored = fwrite (buffer, 1, p-buffer, logfile);
+	_trace_write (buffer, p-buffer);
 
 	/* We group signed and unsigned together in this switch, the
 	 * only thing that matters here is the size of the arguments,
@@ -719,8 +949,7 @@ _trace_vprintf (const char *fmt, va_list ap)
 	f++;
     }
 
-    ret_ignored = fwrite (buffer, 1, p-buffer, logfile);
-    (void)ret_ignored;
+    _trace_write (buffer, p-buffer);
 }
 
 static void CAIRO_PRINTF_FORMAT(1, 2)
@@ -850,6 +1079,13 @@ _init_logfile (void)
 
 done:
     atexit (_close_trace);
+
+    env = getenv ("CAIRO_TRACE_BUFFERED");
+    if (env != NULL && atoi (env))
+	_buffered = _writer_init ();
+
+    _init_sampling ();
+
     _emit_header ();
     return TRUE;
 }
@@ -878,14 +1114,128 @@ _write_unlock (void)
     if (logfile == NULL)
 	return;
 
+    if (_flush && _buffered)
+	_publish_chunk ();
+
 #if HAVE_FLOCKFILE && HAVE_FUNLOCKFILE
     funlockfile (logfile);
 #endif
 
-    if (_flush)
+    if (_flush && ! _buffered)
 	fflush (logfile);
 }
 
+/* Drawing is only recorded for the sampled frames, the end of a frame
+ * being marked by showing or copying a page or flushing a surface.
+ * Everything else is still traced as the later frames depend upon the
+ * state it sets up, but outside of the sampled frames fill and stroke
+ * are reduced to new-path, and paint, mask and glyphs are not recorded
+ * (text only by the move of the current point it leaves behind).
+ *
+ *   CAIRO_TRACE_SAMPLE_FRAMES=n   record every nth frame
+ *   CAIRO_TRACE_SAMPLE_SIGNAL=s   record once signal s is received...
+ *   CAIRO_TRACE_SAMPLE_SECONDS=t  ...for t seconds, else until the next
+ */
+static unsigned int _sample_frames;
+static int _sample_signal;
+static unsigned int _sample_seconds;
+static unsigned int _frame;
+static cairo_bool_t _frame_sampled = TRUE;
+static cairo_bool_t _sample_window;
+static time_t _sample_window_end;
+static volatile sig_atomic_t _sample_signalled;
+
+static void
+_sample_signal_handler (int sig)
+{
+    _sample_signalled = 1;
+}
+
+static void
+_sample_frame (void)
+{
+    cairo_bool_t sampled = TRUE;
+
+    if (_sample_frames > 1 && _frame % _sample_frames)
+	sampled = FALSE;
+
+    if (_sample_signal) {
+	if (_sample_signalled) {
+	    _sample_signalled = 0;
+	    if (_sample_seconds) {
+		_sample_window = TRUE;
+		_sample_window_end = time (NULL) + _sample_seconds;
+	    } else {
+		_sample_window = ! _sample_window;
+	    }
+	} else if (_sample_window && _sample_seconds &&
+		   time (NULL) >= _sample_window_end)
+	{
+	    _sample_window = FALSE;
+	}
+
+	if (! _sample_window)
+	    sampled = FALSE;
+    }
+
+    _frame_sampled = sampled;
+}
+
+static void
+_init_sampling (void)
+{
+    const char *env;
+
+    env = getenv ("CAIRO_TRACE_SAMPLE_FRAMES");
+    if (env != NULL)
+	_sample_frames = atoi (env);
+
+    env = getenv ("CAIRO_TRACE_SAMPLE_SECONDS");
+    if (env != NULL)
+	_sample_seconds = atoi (env);
+
+    env = getenv ("CAIRO_TRACE_SAMPLE_SIGNAL");
+    if (env != NULL && atoi (env) > 0) {
+	struct sigaction sa;
+
+	memset (&sa, 0, sizeof (sa));
+	sa.sa_handler = _sample_signal_handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset (&sa.sa_mask);
+	if (sigaction (atoi (env), &sa, NULL) == 0)
+	    _sample_signal = atoi (env);
+    }
+
+    _sample_frame ();
+}
+
+static void
+_end_frame (void)
+{
+    if (! _write_lock ())
+	return;
+
+    _frame++;
+    _sample_frame ();
+
+    _write_unlock ();
+}
+
+/* As _write_lock(), but fails outside of the sampled frames. */
+static cairo_bool_t
+_write_lock_drawing (void)
+{
+    if (! _write_lock ())
+	return FALSE;
+
+    if (! _frame_sampled) {
+	_write_unlock ();
+	return FALSE;
+    }
+
+    return TRUE;
+}
+
 
 static Object *
 _type_object_create (enum operand_type op_type, const void *ptr)
@@ -1340,7 +1690,6 @@ _write_base85_data (struct _data_stream *stream,
 		    unsigned long	   length)
 {
     unsigned char five_tuple[5];
-    int ret;
 
     assert (_should_trace ());
 
@@ -1348,10 +1697,9 @@ _write_base85_data (struct _data_stream *stream,
 	stream->four_tuple[stream->base85_pending++] = *data++;
 	if (stream->base85_pending == 4) {
 	    if (_expand_four_tuple_to_five (stream->four_tuple, five_tuple))
-		ret = fwrite ("z", 1, 1, logfile);
+		_trace_write ("z", 1);
 	    else
-		ret = fwrite (five_tuple, 5, 1, logfile);
-	    (void)ret;
+		_trace_write (five_tuple, 5);
 	    stream->base85_pending = 0;
 	}
     }
@@ -1427,7 +1775,6 @@ static void
 _write_base85_data_end (struct _data_stream *stream)
 {
     unsigned char five_tuple[5];
-    int ret;
 
     assert (_should_trace ());
 
@@ -1435,8 +1782,7 @@ _write_base85_data_end (struct _data_stream *stream)
 	memset (stream->four_tuple + stream->base85_pending,
 		0, 4 - stream->base85_pending);
 	_expand_four_tuple_to_five (stream->four_tuple, five_tuple);
-	ret = fwrite (five_tuple, stream->base85_pending+1, 1, logfile);
-	(void) ret;
+	_trace_write (five_tuple, stream->base85_pending+1);
     }
 }
 
@@ -1872,11 +2218,9 @@ ESCAPED_CHAR:
 		_trace_printf ("%c", c);
 	    } else {
 		char buf[4] = { '\\' };
-		int ret_ignored;
 
 		to_octal (c, buf+1, 3);
-		ret_ignored = fwrite (buf, 4, 1, logfile);
-		(void)ret_ignored;
+		_trace_write (buf, 4);
 	    }
 	    break;
 	}
@@ -1928,6 +2272,25 @@ _emit_cairo_op (cairo_t *cr, const char *fmt, ...)
     _write_unlock ();
 }
 
+/* As _emit_cairo_op(), but only within the sampled frames. */
+static cairo_bool_t CAIRO_PRINTF_FORMAT(2, 3)
+_emit_cairo_draw_op (cairo_t *cr, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (cr == NULL || ! _write_lock_drawing ())
+	return FALSE;
+
+    _emit_context (cr);
+
+    va_start (ap, fmt);
+    _trace_vprintf ( fmt, ap);
+    va_end (ap);
+
+    _write_unlock ();
+    return TRUE;
+}
+
 cairo_t *
 cairo_create (cairo_surface_t *target)
 {
@@ -2660,7 +3023,7 @@ cairo_paint (cairo_t *cr)
 {
     _enter_trace ();
     _emit_line_info ();
-    _emit_cairo_op (cr, "paint\n");
+    _emit_cairo_draw_op (cr, "paint\n");
     DLCALL (cairo_paint, cr);
     _exit_trace ();
 }
@@ -2670,7 +3033,7 @@ cairo_paint_with_alpha (cairo_t *cr, double alpha)
 {
     _enter_trace ();
     _emit_line_info ();
-    _emit_cairo_op (cr, "%g paint-with-alpha\n", alpha);
+    _emit_cairo_draw_op (cr, "%g paint-with-alpha\n", alpha);
     DLCALL (cairo_paint_with_alpha, cr, alpha);
     _exit_trace ();
 }
@@ -2680,7 +3043,7 @@ cairo_mask (cairo_t *cr, cairo_pattern_t *pattern)
 {
     _enter_trace ();
     _emit_line_info ();
-    if (cr != NULL && pattern != NULL && _write_lock ()) {
+    if (cr != NULL && pattern != NULL && _write_lock_drawing ()) {
 	Object *obj = _get_object (PATTERN, pattern);
 	cairo_bool_t need_context_and_pattern = TRUE;
 
@@ -2720,7 +3083,7 @@ cairo_mask_surface (cairo_t *cr, cairo_surface_t *surface, double x, double y)
 {
     _enter_trace ();
     _emit_line_info ();
-    if (cr != NULL && surface != NULL && _write_lock ()) {
+    if (cr != NULL && surface != NULL && _write_lock_drawing ()) {
 	Object *obj = _get_object (SURFACE, surface);
 	if (_is_current (SURFACE, surface, 0) &&
 	    _is_current (CONTEXT, cr, 1))
@@ -2759,7 +3122,8 @@ cairo_stroke (cairo_t *cr)
 {
     _enter_trace ();
     _emit_line_info ();
-    _emit_cairo_op (cr, "stroke\n");
+    if (! _emit_cairo_draw_op (cr, "stroke\n"))
+	_emit_cairo_op (cr, "new-path\n");
     DLCALL (cairo_stroke, cr);
     _exit_trace ();
 }
@@ -2769,7 +3133,7 @@ cairo_stroke_preserve (cairo_t *cr)
 {
     _enter_trace ();
     _emit_line_info ();
-    _emit_cairo_op (cr, "stroke+\n");
+    _emit_cairo_draw_op (cr, "stroke+\n");
     DLCALL (cairo_stroke_preserve, cr);
     _exit_trace ();
 }
@@ -2779,7 +3143,8 @@ cairo_fill (cairo_t *cr)
 {
     _enter_trace ();
     _emit_line_info ();
-    _emit_cairo_op (cr, "fill\n");
+    if (! _emit_cairo_draw_op (cr, "fill\n"))
+	_emit_cairo_op (cr, "new-path\n");
     DLCALL (cairo_fill, cr);
     _exit_trace ();
 }
@@ -2789,7 +3154,7 @@ cairo_fill_preserve (cairo_t *cr)
 {
     _enter_trace ();
     _emit_line_info ();
-    _emit_cairo_op (cr, "fill+\n");
+    _emit_cairo_draw_op (cr, "fill+\n");
     DLCALL (cairo_fill_preserve, cr);
     _exit_trace ();
 }
@@ -2800,6 +3165,7 @@ cairo_copy_page (cairo_t *cr)
     _enter_trace ();
     _emit_line_info ();
     _emit_cairo_op (cr, "copy-page\n");
+    _end_frame ();
     DLCALL (cairo_copy_page, cr);
     _exit_trace ();
 }
@@ -2810,6 +3176,7 @@ cairo_show_page (cairo_t *cr)
     _enter_trace ();
     _emit_line_info ();
     _emit_cairo_op (cr, "show-page\n");
+    _end_frame ();
     DLCALL (cairo_show_page, cr);
     _exit_trace ();
 }
@@ -3178,18 +3545,62 @@ cairo_scaled_font_create (cairo_font_face_t *font_face,
     return ret;
 }
 
+/* Outside of the sampled frames text is not recorded, but showing it
+ * may still move the current point, upon which any relative path
+ * operators that follow depend. Such a move is recorded as a move-to.
+ */
+typedef struct _current_point {
+    cairo_bool_t has_current_point;
+    double x, y;
+} current_point_t;
+
+static void
+_get_current_point (cairo_t *cr, current_point_t *point)
+{
+    point->has_current_point = DLCALL (cairo_has_current_point, cr);
+    point->x = point->y = 0;
+    if (point->has_current_point)
+	DLCALL (cairo_get_current_point, cr, &point->x, &point->y);
+}
+
+static void
+_emit_current_point_moved (cairo_t *cr, const current_point_t *before)
+{
+    current_point_t after;
+
+    _get_current_point (cr, &after);
+    if (! after.has_current_point)
+	return;
+
+    if (before->has_current_point &&
+	after.x == before->x && after.y == before->y)
+    {
+	return;
+    }
+
+    _emit_cairo_op (cr, "%g %g m ", after.x, after.y);
+}
+
 void
 cairo_show_text (cairo_t *cr, const char *utf8)
 {
+    current_point_t point;
+    cairo_bool_t traced = FALSE;
+
     _enter_trace ();
     _emit_line_info ();
-    if (cr != NULL && _write_lock ()) {
+    if (cr != NULL && _write_lock_drawing ()) {
 	_emit_context (cr);
 	_emit_string_literal (utf8, -1);
 	_trace_printf (" show-text\n");
 	_write_unlock ();
+	traced = TRUE;
+    } else if (cr != NULL) {
+	_get_current_point (cr, &point);
     }
     DLCALL (cairo_show_text, cr, utf8);
+    if (cr != NULL && ! traced)
+	_emit_current_point_moved (cr, &point);
     _exit_trace ();
 }
 
@@ -3288,7 +3699,7 @@ cairo_show_glyphs (cairo_t *cr, const cairo_glyph_t *glyphs, int num_glyphs)
 {
     _enter_trace ();
     _emit_line_info ();
-    if (cr != NULL && glyphs != NULL && _write_lock ()) {
+    if (cr != NULL && glyphs != NULL && _write_lock_drawing ()) {
 	cairo_scaled_font_t *font;
 
 	_emit_context (cr);
@@ -3324,13 +3735,17 @@ cairo_show_text_glyphs (cairo_t			   *cr,
 			cairo_text_cluster_flags_t  backward)
 {
     cairo_scaled_font_t *font;
+    current_point_t point;
+    cairo_bool_t traced = FALSE;
 
     _enter_trace ();
 
     font = DLCALL (cairo_get_scaled_font, cr);
 
     _emit_line_info ();
-    if (cr != NULL && glyphs != NULL && clusters != NULL && _write_lock ()) {
+    if (cr != NULL && glyphs != NULL && clusters != NULL &&
+	_write_lock_drawing ())
+    {
 	int n;
 
 	_emit_context (cr);
@@ -3348,6 +3763,9 @@ cairo_show_text_glyphs (cairo_t			   *cr,
 		       _direction_to_string (backward));
 
 	_write_unlock ();
+	traced = TRUE;
+    } else if (cr != NULL) {
+	_get_current_point (cr, &point);
     }
 
     DLCALL (cairo_show_text_glyphs, cr,
@@ -3355,6 +3773,8 @@ cairo_show_text_glyphs (cairo_t			   *cr,
 				    glyphs, num_glyphs,
 				    clusters, num_clusters,
 				    backward);
+    if (cr != NULL && ! traced)
+	_emit_current_point_moved (cr, &point);
     _exit_trace ();
 }
 
@@ -3792,6 +4212,7 @@ cairo_surface_flush (cairo_surface_t *surface)
 	_trace_printf ("%% s%ld flush\n", _get_surface_id (surface));
 	_write_unlock ();
     }
+    _end_frame ();
     DLCALL (cairo_surface_flush, surface);
     _exit_trace ();
 }
@@ -3873,6 +4294,7 @@ cairo_surface_copy_page (cairo_surface_t *surface)
     _enter_trace ();
     _emit_line_info ();
     _emit_surface_op (surface, "copy-page\n");
+    _end_frame ();
     DLCALL (cairo_surface_copy_page, surface);
     _exit_trace ();
 }
@@ -3883,6 +4305,7 @@ cairo_surface_show_page (cairo_surface_t *surface)
     _enter_trace ();
     _emit_line_info ();
     _emit_surface_op (surface, "show-page\n");
+    _end_frame ();
     DLCALL (cairo_surface_show_page, surface);
     _exit_trace ();
 }